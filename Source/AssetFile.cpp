@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetfile.cpp
+// ============
+// read an asset from the mounted asset pack, or else from its loose file
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetFile.h"
+
+#include "ResourceRegistry.h"
+
+/***********************************************************
+ *  AssetFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetFile::AssetFile()
+{
+	m_pEntry = NULL;
+	m_pData = NULL;
+	m_size = 0;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for opening an asset by its relative
+ *  path - from the mounted pack when it holds the asset, or
+ *  else by mapping the loose file.
+ ***********************************************************/
+bool AssetFile::Open(const std::string& name)
+{
+	Close();
+
+	const AssetPack* pPack = AssetPack::GetMounted();
+	if (NULL != pPack)
+	{
+		m_pEntry = pPack->Find(name);
+		if (NULL != m_pEntry)
+		{
+			m_pData = pPack->GetData(*m_pEntry);
+			m_size = (size_t)m_pEntry->size;
+			return true;
+		}
+	}
+
+	if (!m_looseFile.Open(name))
+	{
+		return false;
+	}
+
+	m_pData = m_looseFile.GetData();
+	m_size = m_looseFile.GetSize();
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for closing the asset, unmapping its
+ *  loose file.
+ ***********************************************************/
+void AssetFile::Close()
+{
+	m_pEntry = NULL;
+	m_pData = NULL;
+	m_size = 0;
+	m_looseFile.Close();
+}
+
+/***********************************************************
+ *  GetData()
+ *
+ *  This method is used for getting the bytes of the asset.
+ ***********************************************************/
+const unsigned char* AssetFile::GetData() const
+{
+	return m_pData;
+}
+
+/***********************************************************
+ *  GetSize()
+ *
+ *  This method is used for getting the size of the asset.
+ ***********************************************************/
+size_t AssetFile::GetSize() const
+{
+	return m_size;
+}
+
+/***********************************************************
+ *  GetHash()
+ *
+ *  This method is used for getting the content hash of the
+ *  asset.  A packed asset was hashed when the pack was
+ *  built, so its data is not read.
+ ***********************************************************/
+uint64_t AssetFile::GetHash() const
+{
+	if (NULL != m_pEntry)
+	{
+		return m_pEntry->hash;
+	}
+
+	return ResourceRegistry::HashBytes(m_pData, m_size);
+}
+
+/***********************************************************
+ *  IsPacked()
+ *
+ *  This method is used for checking if an asset is read
+ *  from the mounted pack.
+ ***********************************************************/
+bool AssetFile::IsPacked(const std::string& name)
+{
+	const AssetPack* pPack = AssetPack::GetMounted();
+	return (NULL != pPack) && (NULL != pPack->Find(name));
+}
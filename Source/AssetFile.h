@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetfile.h
+// ============
+// read an asset from the mounted asset pack, or else from its loose file
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AssetPack.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  AssetFile
+ *
+ *  This class contains the code for opening an asset by its
+ *  relative path.  When the asset is in the mounted pack its
+ *  data points into the pack mapping, otherwise the loose
+ *  file is mapped on its own.  Either way the data is read
+ *  in place, without being copied.
+ ***********************************************************/
+class AssetFile
+{
+public:
+	// constructor
+	AssetFile();
+
+	// a mapping cannot be shared between two objects
+	AssetFile(const AssetFile&) = delete;
+	AssetFile& operator=(const AssetFile&) = delete;
+
+private:
+	// the asset in the mounted pack, NULL for a loose file
+	const AssetPack::ASSET_ENTRY* m_pEntry;
+	const unsigned char* m_pData;
+	size_t m_size;
+	// the mapping of a loose file
+	MappedFile m_looseFile;
+
+public:
+	// open an asset, closing any asset that was already open
+	bool Open(const std::string& name);
+	// close the asset
+	void Close();
+
+	// get the bytes of the asset
+	const unsigned char* GetData() const;
+	// get the size of the asset in bytes
+	size_t GetSize() const;
+	// get the content hash of the asset - read from the pack index,
+	// or hashed from the data of a loose file
+	uint64_t GetHash() const;
+
+	// check if an asset is in the mounted pack
+	static bool IsPacked(const std::string& name);
+};
@@ -0,0 +1,411 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.cpp
+// ============
+// pack the asset files into one memory mapped file with an index of the
+// assets by name
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetPack.h"
+
+#include "ResourceRegistry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	// the pack file identifier and version
+	const unsigned char g_PackIdentifier[8] = { 'A', 'S', 'S', 'E', 'T', 'P', 'A', 'K' };
+	const uint32_t g_PackVersion = 1;
+	// size of the fixed header, which the index follows
+	const size_t g_PackHeaderSize = 32;
+	// size of an index entry without its name
+	const size_t g_IndexEntrySize = 32;
+	// alignment of the asset data - large assets are aligned to
+	// the allocation granularity of a Windows file view
+	const uint64_t g_PageAlignment = 4096;
+	const uint64_t g_LargeAssetAlignment = 65536;
+
+	// the pack mounted for the process
+	AssetPack g_MountedPack;
+	bool g_bPackMounted = false;
+
+	uint32_t ReadUInt32(const unsigned char* data, size_t offset)
+	{
+		uint32_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadUInt64(const unsigned char* data, size_t offset)
+	{
+		uint64_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	void WriteUInt32(std::vector<unsigned char>& data, size_t offset, uint32_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	void WriteUInt64(std::vector<unsigned char>& data, size_t offset, uint64_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+}
+
+/***********************************************************
+ *  AssetPack()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetPack::AssetPack()
+{
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a pack file and reading
+ *  its index.  Only the header and index pages are touched.
+ ***********************************************************/
+bool AssetPack::Open(const std::string& filename)
+{
+	Close();
+
+	if (!m_file.Open(filename))
+	{
+		return false;
+	}
+
+	if (!ParseIndex())
+	{
+		std::cout << "Invalid asset pack:" << filename << std::endl;
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the pack and clearing
+ *  its index.
+ ***********************************************************/
+void AssetPack::Close()
+{
+	m_entries.clear();
+	m_names.clear();
+	m_file.Close();
+}
+
+/***********************************************************
+ *  ParseIndex()
+ *
+ *  This method is used for checking the header of the mapped
+ *  pack and reading its index.  Every asset must lie inside
+ *  the file.
+ ***********************************************************/
+bool AssetPack::ParseIndex()
+{
+	const unsigned char* data = m_file.GetData();
+	size_t dataSize = m_file.GetSize();
+
+	if ((data == NULL) || (dataSize < g_PackHeaderSize) || (memcmp(data, g_PackIdentifier, sizeof(g_PackIdentifier)) != 0) ||
+		(ReadUInt32(data, 8) != g_PackVersion))
+	{
+		return false;
+	}
+
+	uint32_t entryCount = ReadUInt32(data, 12);
+	uint64_t indexSize = ReadUInt64(data, 16);
+	if (indexSize > dataSize - g_PackHeaderSize)
+	{
+		return false;
+	}
+
+	size_t position = g_PackHeaderSize;
+	size_t indexEnd = g_PackHeaderSize + (size_t)indexSize;
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		if (position + g_IndexEntrySize > indexEnd)
+		{
+			return false;
+		}
+
+		ASSET_ENTRY entry;
+		entry.offset = ReadUInt64(data, position);
+		entry.size = ReadUInt64(data, position + 8);
+		entry.hash = ReadUInt64(data, position + 16);
+		entry.format = (AssetFormat)ReadUInt32(data, position + 24);
+		uint32_t nameLength = ReadUInt32(data, position + 28);
+		position += g_IndexEntrySize;
+
+		if ((nameLength > indexEnd - position) || (entry.offset > dataSize) || (entry.size > dataSize - entry.offset))
+		{
+			return false;
+		}
+		entry.name.assign((const char*)data + position, nameLength);
+		position += (size_t)AlignOffset(nameLength, 8);
+
+		m_names[entry.name] = m_entries.size();
+		m_entries.push_back(entry);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for finding an asset by its relative
+ *  path, in either slash direction.
+ ***********************************************************/
+const AssetPack::ASSET_ENTRY* AssetPack::Find(const std::string& name) const
+{
+	std::unordered_map<std::string, size_t>::const_iterator found = m_names.find(GetAssetName(name));
+	if (found == m_names.end())
+	{
+		return NULL;
+	}
+
+	return &m_entries[found->second];
+}
+
+/***********************************************************
+ *  GetData()
+ *
+ *  This method is used for getting the mapped data of an
+ *  asset.  Its pages are read from the file when touched.
+ ***********************************************************/
+const unsigned char* AssetPack::GetData(const ASSET_ENTRY& entry) const
+{
+	return m_file.GetData() + entry.offset;
+}
+
+/***********************************************************
+ *  GetNames()
+ *
+ *  This method is used for listing the assets in a folder
+ *  and its subfolders, in the order of the index.
+ ***********************************************************/
+std::vector<std::string> AssetPack::GetNames(const std::string& folder) const
+{
+	std::vector<std::string> names;
+	std::string prefix = GetAssetName(folder) + "/";
+
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		if (m_entries[i].name.compare(0, prefix.size(), prefix) == 0)
+		{
+			names.push_back(m_entries[i].name);
+		}
+	}
+
+	return names;
+}
+
+/***********************************************************
+ *  GetFormat()
+ *
+ *  This method is used for getting the format of an asset
+ *  from its file extension.
+ ***********************************************************/
+AssetPack::AssetFormat AssetPack::GetFormat(const std::string& name)
+{
+	std::string extension = std::filesystem::path(name).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+
+	if ((extension == ".jpg") || (extension == ".jpeg"))
+	{
+		return jpeg;
+	}
+	if (extension == ".png")
+	{
+		return png;
+	}
+	if (extension == ".glsl")
+	{
+		return glsl;
+	}
+	if (extension == ".obj")
+	{
+		return obj;
+	}
+	if (extension == ".ktx2")
+	{
+		return ktx2;
+	}
+
+	return unknown;
+}
+
+/***********************************************************
+ *  GetAssetName()
+ *
+ *  This method is used for getting the name an asset is
+ *  packed under - its relative path with forward slashes.
+ ***********************************************************/
+std::string AssetPack::GetAssetName(const std::string& path)
+{
+	std::string name = std::filesystem::path(path).lexically_normal().generic_string();
+
+	while (name.compare(0, 2, "./") == 0)
+	{
+		name.erase(0, 2);
+	}
+
+	return name;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for packing every file in the passed
+ *  in folders, named by their paths relative to the current
+ *  folder.  The pack is written to a temporary name first,
+ *  so a running reader never sees half a file.
+ ***********************************************************/
+bool AssetPack::Build(const std::string& packFile, const std::vector<std::string>& folders)
+{
+	std::vector<ASSET_ENTRY> entries;
+	std::error_code error;
+
+	for (size_t i = 0; i < folders.size(); i++)
+	{
+		if (!std::filesystem::is_directory(folders[i], error))
+		{
+			continue;
+		}
+		for (const std::filesystem::directory_entry& file : std::filesystem::recursive_directory_iterator(folders[i], error))
+		{
+			// temporary files of an interrupted cache write are left out
+			if (file.is_regular_file() && (file.path().extension() != ".tmp"))
+			{
+				ASSET_ENTRY entry;
+				entry.name = GetAssetName(file.path().string());
+				entry.offset = 0;
+				entry.size = 0;
+				entry.hash = 0;
+				entry.format = GetFormat(entry.name);
+				entries.push_back(entry);
+			}
+		}
+	}
+	std::sort(entries.begin(), entries.end(), [](const ASSET_ENTRY& a, const ASSET_ENTRY& b) { return a.name < b.name; });
+
+	// the index size only depends on the names
+	size_t indexSize = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		indexSize += g_IndexEntrySize + (size_t)AlignOffset(entries[i].name.size(), 8);
+	}
+
+	std::vector<unsigned char> header(g_PackHeaderSize + indexSize, 0);
+	std::string tempFile = packFile + ".tmp";
+	std::ofstream output(tempFile, std::ios::binary | std::ios::trunc);
+	uint64_t offset = header.size();
+
+	// reserve the header and index, which are written once the
+	// offsets, sizes and hashes are known
+	output.write((const char*)header.data(), (std::streamsize)header.size());
+
+	for (size_t i = 0; (i < entries.size()) && output.good(); i++)
+	{
+		// an empty file cannot be mapped, it is packed as an empty asset
+		MappedFile file;
+		if (!file.Open(entries[i].name) && (std::filesystem::file_size(entries[i].name, error) != 0))
+		{
+			std::cout << "Could not read asset:" << entries[i].name << std::endl;
+			output.close();
+			std::filesystem::remove(tempFile, error);
+			return false;
+		}
+
+		uint64_t alignment = (file.GetSize() >= g_LargeAssetAlignment) ? g_LargeAssetAlignment : g_PageAlignment;
+		uint64_t aligned = AlignOffset(offset, alignment);
+		std::vector<char> padding((size_t)(aligned - offset), 0);
+		output.write(padding.data(), (std::streamsize)padding.size());
+		if (file.GetSize() > 0)
+		{
+			output.write((const char*)file.GetData(), (std::streamsize)file.GetSize());
+		}
+
+		entries[i].offset = aligned;
+		entries[i].size = file.GetSize();
+		entries[i].hash = ResourceRegistry::HashBytes(file.GetData(), file.GetSize());
+		offset = aligned + file.GetSize();
+	}
+
+	memcpy(&header[0], g_PackIdentifier, sizeof(g_PackIdentifier));
+	WriteUInt32(header, 8, g_PackVersion);
+	WriteUInt32(header, 12, (uint32_t)entries.size());
+	WriteUInt64(header, 16, (uint64_t)indexSize);
+	size_t position = g_PackHeaderSize;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		WriteUInt64(header, position, entries[i].offset);
+		WriteUInt64(header, position + 8, entries[i].size);
+		WriteUInt64(header, position + 16, entries[i].hash);
+		WriteUInt32(header, position + 24, (uint32_t)entries[i].format);
+		WriteUInt32(header, position + 28, (uint32_t)entries[i].name.size());
+		position += g_IndexEntrySize;
+		memcpy(&header[position], entries[i].name.data(), entries[i].name.size());
+		position += (size_t)AlignOffset(entries[i].name.size(), 8);
+	}
+	output.seekp(0);
+	output.write((const char*)header.data(), (std::streamsize)header.size());
+	output.close();
+
+	if (!output.good())
+	{
+		std::cout << "Could not write asset pack:" << packFile << std::endl;
+		std::filesystem::remove(tempFile, error);
+		return false;
+	}
+
+	std::filesystem::rename(tempFile, packFile, error);
+	if (error)
+	{
+		std::cout << "Could not write asset pack:" << packFile << std::endl;
+		std::filesystem::remove(tempFile, error);
+		return false;
+	}
+
+	std::cout << "Packed " << entries.size() << " assets into " << packFile << " - " << offset << " bytes" << std::endl;
+	return true;
+}
+
+/***********************************************************
+ *  Mount()
+ *
+ *  This method is used for mapping the pack that assets are
+ *  looked up in before their loose files.
+ ***********************************************************/
+bool AssetPack::Mount(const std::string& filename)
+{
+	g_bPackMounted = g_MountedPack.Open(filename);
+	return g_bPackMounted;
+}
+
+/***********************************************************
+ *  GetMounted()
+ *
+ *  This method is used for getting the mounted pack, or NULL
+ *  when no pack is mounted.
+ ***********************************************************/
+const AssetPack* AssetPack::GetMounted()
+{
+	return g_bPackMounted ? &g_MountedPack : NULL;
+}
@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.h
+// ============
+// pack the asset files into one memory mapped file with an index of the
+// assets by name
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  AssetPack
+ *
+ *  This class contains the code for building and reading an
+ *  asset pack.  The pack starts with a header and an index
+ *  holding the name, offset, size, content hash and format
+ *  of every asset, followed by the asset data.  Each asset
+ *  starts on a 4K page, and assets of 64K or more on a 64K
+ *  boundary, so they can be mapped or read without touching
+ *  their neighbours.  The whole pack is mapped once, and an
+ *  asset is read through the page faults of its own pages.
+ *  A pack mounted for the process is searched before the
+ *  loose files - see AssetFile.
+ ***********************************************************/
+class AssetPack
+{
+public:
+	// constructor
+	AssetPack();
+
+	// the mapping cannot be shared between two objects
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	enum AssetFormat
+	{
+		unknown,
+		jpeg,
+		png,
+		glsl,
+		obj,
+		ktx2
+	};
+
+	// one asset in the index
+	struct ASSET_ENTRY
+	{
+		std::string name;
+		uint64_t offset;
+		uint64_t size;
+		// FNV-1a hash of the asset data, as ResourceRegistry::HashBytes
+		uint64_t hash;
+		AssetFormat format;
+	};
+
+private:
+	MappedFile m_file;
+	std::vector<ASSET_ENTRY> m_entries;
+	// index of each entry by its name
+	std::unordered_map<std::string, size_t> m_names;
+
+	// read and check the index of the mapped pack
+	bool ParseIndex();
+
+public:
+	// map a pack and read its index, closing any pack already open
+	bool Open(const std::string& filename);
+	// unmap the pack
+	void Close();
+
+	// find an asset by its relative path, NULL if it is not packed
+	const ASSET_ENTRY* Find(const std::string& name) const;
+	// get the mapped data of an asset
+	const unsigned char* GetData(const ASSET_ENTRY& entry) const;
+	// get the names of the assets in a folder and its subfolders
+	std::vector<std::string> GetNames(const std::string& folder) const;
+
+	// get the format of an asset from its file extension
+	static AssetFormat GetFormat(const std::string& name);
+	// get the relative path used as the name of an asset
+	static std::string GetAssetName(const std::string& path);
+
+	// build a pack from every file in the folders
+	static bool Build(const std::string& packFile, const std::vector<std::string>& folders);
+
+	// map a pack that is searched before the loose files - call
+	// before any asset is loaded, it stays mapped until exit
+	static bool Mount(const std::string& filename);
+	// get the mounted pack, NULL when the loose files are used
+	static const AssetPack* GetMounted();
+};
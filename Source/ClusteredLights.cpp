@@ -0,0 +1,633 @@
+///////////////////////////////////////////////////////////////////////////////
+// clusteredlights.cpp
+// ============
+// assign many local lights to the clusters of the view for forward shading
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ClusteredLights.h"
+
+#include "ShaderCompiler.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// the SSE2 assignment is used whenever the target guarantees SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define CLUSTERED_LIGHTS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// screen tiles across and down, and depth slices of the grid
+	const int g_ClusterCountX = 16;
+	const int g_ClusterCountY = 12;
+	const int g_ClusterCountZ = 24;
+	const int g_ClusterCount = g_ClusterCountX * g_ClusterCountY * g_ClusterCountZ;
+	// lights kept for a cluster - the rest are left out of its list
+	const int g_MaxClusterLights = 256;
+	// invocations of a compute group, as local_size_x in the shader
+	const int g_AssignGroupSize = 64;
+	// floats of a light in the light buffer - three vec4
+	const size_t g_LightFloats = 12;
+
+	// software renderers run compute shaders on the CPU, much slower
+	// than the CPU assignment
+	bool IsSoftwareRenderer()
+	{
+		const GLubyte* renderer = glGetString(GL_RENDERER);
+		if (renderer == NULL)
+		{
+			return false;
+		}
+
+		const char* const softwareRenderers[] = { "llvmpipe", "softpipe", "SwiftShader", "GDI Generic", "Basic Render" };
+		for (size_t i = 0; i < sizeof(softwareRenderers) / sizeof(softwareRenderers[0]); i++)
+		{
+			if (strstr((const char*)renderer, softwareRenderers[i]) != NULL)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// the view space point at depth 1 on the ray through a point of
+	// the screen, as ViewRay() in the compute shader
+	glm::vec3 ViewRay(const glm::mat4& inverseProjection, float x, float y)
+	{
+		glm::vec4 point = inverseProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		point /= point.w;
+		return glm::vec3(point) / -point.z;
+	}
+}
+
+/***********************************************************
+ *  ClusteredLights()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ClusteredLights::ClusteredLights()
+{
+	m_bSupported = false;
+	m_assignProgram = 0;
+	m_assignMode = cpuSSE2;
+	m_lightBuffer = 0;
+	m_gridBuffer = 0;
+	m_indexBuffer = 0;
+	m_bLightsChanged = false;
+	m_projection = glm::mat4(0.0f);
+	m_viewportWidth = 1;
+	m_viewportHeight = 1;
+	m_nearDepth = 0.1f;
+	m_farDepth = 100.0f;
+	m_timerQuery = 0;
+	m_bTimerPending = false;
+	m_assignMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~ClusteredLights()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ClusteredLights::~ClusteredLights()
+{
+	if (m_assignProgram != 0)
+	{
+		glDeleteProgram(m_assignProgram);
+	}
+	if (m_lightBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_lightBuffer);
+		glDeleteBuffers(1, &m_gridBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+	if (m_timerQuery != 0)
+	{
+		glDeleteQueries(1, &m_timerQuery);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for checking that the driver can
+ *  read storage buffers in the fragment shader, creating the
+ *  buffers, and building the compute program that assigns
+ *  the lights.  Without compute shaders, or with a software
+ *  renderer, the lights are assigned on the CPU instead.
+ ***********************************************************/
+bool ClusteredLights::Initialize(const std::string& computeShaderFile)
+{
+	m_bSupported = (GLEW_VERSION_4_3 != GL_FALSE);
+	if (!m_bSupported)
+	{
+		std::cout << "Clustered lights need OpenGL 4.3, the local lights are not drawn" << std::endl;
+		return false;
+	}
+
+	glGenBuffers(1, &m_lightBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, g_LightFloats * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+	// the grid starts with empty lists for the frames before the
+	// first assignment
+	std::vector<uint32_t> emptyGrid(g_ClusterCount * 2, 0);
+	glGenBuffers(1, &m_gridBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_gridBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, emptyGrid.size() * sizeof(uint32_t), emptyGrid.data(), GL_DYNAMIC_DRAW);
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_indexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)g_ClusterCount * g_MaxClusterLights * sizeof(uint32_t), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glGenQueries(1, &m_timerQuery);
+
+	m_clusterLights.resize((size_t)g_ClusterCount * g_MaxClusterLights);
+	m_clusterCounts.resize(g_ClusterCount);
+	m_gridData.resize(g_ClusterCount * 2);
+	m_indexData.reserve((size_t)g_ClusterCount * 8);
+
+	std::string source;
+	if (ShaderCompiler::ReadSource(computeShaderFile, source))
+	{
+		ShaderCompiler compiler;
+		compiler.StartCompute("light cluster shader", source);
+		m_assignProgram = compiler.Finish();
+	}
+
+	m_assignMode = ((m_assignProgram != 0) && !IsSoftwareRenderer()) ? computeShader : cpuSSE2;
+	std::cout << "Assigning the local lights with the " << GetAssignModeName(m_assignMode) << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the clustered lights
+ *  can be drawn by the driver.
+ ***********************************************************/
+bool ClusteredLights::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  CanAssignOnGPU()
+ *
+ *  This method is used for checking if the compute program
+ *  that assigns the lights was built.
+ ***********************************************************/
+bool ClusteredLights::CanAssignOnGPU() const
+{
+	return m_assignProgram != 0;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for replacing the local lights.  They
+ *  are uploaded by the next update.
+ ***********************************************************/
+void ClusteredLights::SetLights(const std::vector<LOCAL_LIGHT>& lights)
+{
+	m_lights = lights;
+	m_lightData.assign(std::max<size_t>(lights.size(), 1) * g_LightFloats, 0.0f);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		float* light = &m_lightData[i * g_LightFloats];
+		light[0] = lights[i].position.x;
+		light[1] = lights[i].position.y;
+		light[2] = lights[i].position.z;
+		light[3] = lights[i].radius;
+		light[4] = lights[i].diffuse.r;
+		light[5] = lights[i].diffuse.g;
+		light[6] = lights[i].diffuse.b;
+		light[8] = lights[i].specular.r;
+		light[9] = lights[i].specular.g;
+		light[10] = lights[i].specular.b;
+	}
+	m_bLightsChanged = true;
+}
+
+/***********************************************************
+ *  GetLightCount()
+ *
+ *  This method is used for getting the number of local
+ *  lights.
+ ***********************************************************/
+int ClusteredLights::GetLightCount() const
+{
+	return (int)m_lights.size();
+}
+
+/***********************************************************
+ *  SetAssignMode()
+ *
+ *  This method is used for choosing where the lights are
+ *  assigned to the clusters.  The compute shader is only
+ *  used when its program was built.
+ ***********************************************************/
+void ClusteredLights::SetAssignMode(AssignMode mode)
+{
+	if ((mode == computeShader) && (m_assignProgram == 0))
+	{
+		mode = cpuSSE2;
+	}
+	m_assignMode = mode;
+	m_bTimerPending = false;
+}
+
+ClusteredLights::AssignMode ClusteredLights::GetAssignMode() const
+{
+	return m_assignMode;
+}
+
+/***********************************************************
+ *  GetAssignTime()
+ *
+ *  This method is used for getting the time the last light
+ *  assignment took in milliseconds.  On the GPU it is the
+ *  time of an assignment a frame or two earlier.
+ ***********************************************************/
+double ClusteredLights::GetAssignTime() const
+{
+	return m_assignMilliseconds;
+}
+
+/***********************************************************
+ *  ComputeClusterBounds()
+ *
+ *  This method is used for computing the view space box of
+ *  every cluster for the CPU assignment, the same way the
+ *  compute shader does.  The boxes only change with the
+ *  projection.
+ ***********************************************************/
+void ClusteredLights::ComputeClusterBounds(const glm::mat4& projection)
+{
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	float depthRatio = m_farDepth / m_nearDepth;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		m_boundsMin[axis].resize(g_ClusterCount);
+		m_boundsMax[axis].resize(g_ClusterCount);
+	}
+
+	for (int z = 0; z < g_ClusterCountZ; z++)
+	{
+		float nearDepth = m_nearDepth * std::pow(depthRatio, (float)z / g_ClusterCountZ);
+		float farDepth = m_nearDepth * std::pow(depthRatio, (float)(z + 1) / g_ClusterCountZ);
+		for (int y = 0; y < g_ClusterCountY; y++)
+		{
+			float ndcMinY = (((float)y / g_ClusterCountY) * 2.0f) - 1.0f;
+			float ndcMaxY = (((float)(y + 1) / g_ClusterCountY) * 2.0f) - 1.0f;
+			for (int x = 0; x < g_ClusterCountX; x++)
+			{
+				float ndcMinX = (((float)x / g_ClusterCountX) * 2.0f) - 1.0f;
+				float ndcMaxX = (((float)(x + 1) / g_ClusterCountX) * 2.0f) - 1.0f;
+				glm::vec3 rays[4] =
+				{
+					ViewRay(inverseProjection, ndcMinX, ndcMinY),
+					ViewRay(inverseProjection, ndcMaxX, ndcMinY),
+					ViewRay(inverseProjection, ndcMinX, ndcMaxY),
+					ViewRay(inverseProjection, ndcMaxX, ndcMaxY)
+				};
+
+				glm::vec3 boundsMin(1.0e30f);
+				glm::vec3 boundsMax(-1.0e30f);
+				for (int i = 0; i < 4; i++)
+				{
+					boundsMin = glm::min(boundsMin, glm::min(rays[i] * nearDepth, rays[i] * farDepth));
+					boundsMax = glm::max(boundsMax, glm::max(rays[i] * nearDepth, rays[i] * farDepth));
+				}
+
+				int cluster = (((z * g_ClusterCountY) + y) * g_ClusterCountX) + x;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					m_boundsMin[axis][cluster] = boundsMin[axis];
+					m_boundsMax[axis][cluster] = boundsMax[axis];
+				}
+			}
+		}
+	}
+
+	m_projection = projection;
+}
+
+/***********************************************************
+ *  AssignLightsGPU()
+ *
+ *  This method is used for dispatching the compute program
+ *  that builds the light list of every cluster.  The program
+ *  that draws is made current again afterwards, as the
+ *  shader manager sets its uniforms on the current program.
+ ***********************************************************/
+void ClusteredLights::AssignLightsGPU(const glm::mat4& view, const glm::mat4& projection)
+{
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(m_assignProgram);
+
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	glUniformMatrix4fv(glGetUniformLocation(m_assignProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(glGetUniformLocation(m_assignProgram, "inverseProjection"), 1, GL_FALSE, glm::value_ptr(inverseProjection));
+	glUniform3i(glGetUniformLocation(m_assignProgram, "clusterDimensions"), g_ClusterCountX, g_ClusterCountY, g_ClusterCountZ);
+	glUniform2f(glGetUniformLocation(m_assignProgram, "clusterDepthRange"), m_nearDepth, m_farDepth);
+	glUniform1i(glGetUniformLocation(m_assignProgram, "localLightCount"), (GLint)m_lights.size());
+	glUniform1i(glGetUniformLocation(m_assignProgram, "maxClusterLights"), g_MaxClusterLights);
+
+	// only one timing is in flight, it is read when it is ready
+	bool bTimed = !m_bTimerPending;
+	if (bTimed)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQuery);
+	}
+	glDispatchCompute((g_ClusterCount + g_AssignGroupSize - 1) / g_AssignGroupSize, 1, 1);
+	if (bTimed)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_bTimerPending = true;
+	}
+	// the fragment shaders read the lists the compute shader wrote
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glUseProgram((GLuint)previousProgram);
+}
+
+/***********************************************************
+ *  AssignLightsCPU()
+ *
+ *  This method is used for building the light lists on the
+ *  CPU.  Each light is moved to view space and only tested
+ *  against the clusters under its screen and depth bounds,
+ *  four clusters at a time with SSE2.  The lists are then
+ *  packed together and uploaded.
+ ***********************************************************/
+void ClusteredLights::AssignLightsCPU(const glm::mat4& view, const glm::mat4& projection)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if ((projection != m_projection) || m_boundsMin[0].empty())
+	{
+		ComputeClusterBounds(projection);
+	}
+	std::fill(m_clusterCounts.begin(), m_clusterCounts.end(), 0);
+
+	float depthScale = g_ClusterCountZ / std::log(m_farDepth / m_nearDepth);
+	float depthBias = -depthScale * std::log(m_nearDepth);
+
+	for (size_t light = 0; light < m_lights.size(); light++)
+	{
+		glm::vec3 center = glm::vec3(view * glm::vec4(m_lights[light].position, 1.0f));
+		float radius = m_lights[light].radius;
+		float depth = -center.z;
+		if (((depth + radius) < m_nearDepth) || ((depth - radius) > m_farDepth))
+		{
+			continue;
+		}
+
+		// the depth slices the sphere spans
+		float minDepth = std::max(depth - radius, m_nearDepth);
+		float maxDepth = std::min(depth + radius, m_farDepth);
+		int minZ = std::clamp((int)std::floor((std::log(minDepth) * depthScale) + depthBias), 0, g_ClusterCountZ - 1);
+		int maxZ = std::clamp((int)std::floor((std::log(maxDepth) * depthScale) + depthBias), 0, g_ClusterCountZ - 1);
+
+		// the screen tiles under the box around the sphere, from its
+		// corners at the nearest and farthest depth
+		float ndcMin[2] = { 1.0e30f, 1.0e30f };
+		float ndcMax[2] = { -1.0e30f, -1.0e30f };
+		for (int axis = 0; axis < 2; axis++)
+		{
+			for (int side = -1; side <= 1; side += 2)
+			{
+				float coordinate = center[axis] + (side * radius);
+				float nearNDC = ((projection[axis][axis] * coordinate) / minDepth) - projection[2][axis];
+				float farNDC = ((projection[axis][axis] * coordinate) / maxDepth) - projection[2][axis];
+				ndcMin[axis] = std::min(ndcMin[axis], std::min(nearNDC, farNDC));
+				ndcMax[axis] = std::max(ndcMax[axis], std::max(nearNDC, farNDC));
+			}
+		}
+		if ((ndcMin[0] > 1.0f) || (ndcMax[0] < -1.0f) || (ndcMin[1] > 1.0f) || (ndcMax[1] < -1.0f))
+		{
+			continue;
+		}
+		int minX = std::clamp((int)std::floor(((ndcMin[0] * 0.5f) + 0.5f) * g_ClusterCountX), 0, g_ClusterCountX - 1);
+		int maxX = std::clamp((int)std::floor(((ndcMax[0] * 0.5f) + 0.5f) * g_ClusterCountX), 0, g_ClusterCountX - 1);
+		int minY = std::clamp((int)std::floor(((ndcMin[1] * 0.5f) + 0.5f) * g_ClusterCountY), 0, g_ClusterCountY - 1);
+		int maxY = std::clamp((int)std::floor(((ndcMax[1] * 0.5f) + 0.5f) * g_ClusterCountY), 0, g_ClusterCountY - 1);
+
+		float radiusSquared = radius * radius;
+		for (int z = minZ; z <= maxZ; z++)
+		{
+			for (int y = minY; y <= maxY; y++)
+			{
+				int row = ((z * g_ClusterCountY) + y) * g_ClusterCountX;
+				int cluster = row + minX;
+				int rowEnd = row + maxX + 1;
+
+#ifdef CLUSTERED_LIGHTS_SSE2
+				// the sphere against the boxes of four clusters of the row
+				if (m_assignMode == cpuSSE2)
+				{
+					__m128 centerX = _mm_set1_ps(center.x);
+					__m128 centerY = _mm_set1_ps(center.y);
+					__m128 centerZ = _mm_set1_ps(center.z);
+					__m128 radius4 = _mm_set1_ps(radiusSquared);
+					for (; cluster + 4 <= rowEnd; cluster += 4)
+					{
+						__m128 dx = _mm_sub_ps(_mm_min_ps(_mm_max_ps(centerX, _mm_loadu_ps(&m_boundsMin[0][cluster])), _mm_loadu_ps(&m_boundsMax[0][cluster])), centerX);
+						__m128 dy = _mm_sub_ps(_mm_min_ps(_mm_max_ps(centerY, _mm_loadu_ps(&m_boundsMin[1][cluster])), _mm_loadu_ps(&m_boundsMax[1][cluster])), centerY);
+						__m128 dz = _mm_sub_ps(_mm_min_ps(_mm_max_ps(centerZ, _mm_loadu_ps(&m_boundsMin[2][cluster])), _mm_loadu_ps(&m_boundsMax[2][cluster])), centerZ);
+						__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+						int mask = _mm_movemask_ps(_mm_cmple_ps(distance, radius4));
+						for (int lane = 0; mask != 0; lane++, mask >>= 1)
+						{
+							uint32_t& count = m_clusterCounts[cluster + lane];
+							if (((mask & 1) != 0) && (count < (uint32_t)g_MaxClusterLights))
+							{
+								m_clusterLights[((size_t)(cluster + lane) * g_MaxClusterLights) + count] = (uint32_t)light;
+								count++;
+							}
+						}
+					}
+				}
+#endif
+				for (; cluster < rowEnd; cluster++)
+				{
+					float dx = std::clamp(center.x, m_boundsMin[0][cluster], m_boundsMax[0][cluster]) - center.x;
+					float dy = std::clamp(center.y, m_boundsMin[1][cluster], m_boundsMax[1][cluster]) - center.y;
+					float dz = std::clamp(center.z, m_boundsMin[2][cluster], m_boundsMax[2][cluster]) - center.z;
+					uint32_t& count = m_clusterCounts[cluster];
+					if ((((dx * dx) + (dy * dy) + (dz * dz)) <= radiusSquared) && (count < (uint32_t)g_MaxClusterLights))
+					{
+						m_clusterLights[((size_t)cluster * g_MaxClusterLights) + count] = (uint32_t)light;
+						count++;
+					}
+				}
+			}
+		}
+	}
+
+	// pack the lists one after another
+	m_indexData.clear();
+	for (int cluster = 0; cluster < g_ClusterCount; cluster++)
+	{
+		const uint32_t* lights = &m_clusterLights[(size_t)cluster * g_MaxClusterLights];
+		m_gridData[(cluster * 2) + 0] = (uint32_t)m_indexData.size();
+		m_gridData[(cluster * 2) + 1] = m_clusterCounts[cluster];
+		m_indexData.insert(m_indexData.end(), lights, lights + m_clusterCounts[cluster]);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_gridBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_gridData.size() * sizeof(uint32_t), m_gridData.data());
+	if (!m_indexData.empty())
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_indexBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_indexData.size() * sizeof(uint32_t), m_indexData.data());
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+	m_assignMilliseconds = time.count();
+}
+
+/***********************************************************
+ *  UploadLights()
+ *
+ *  This method is used for uploading the lights to the light
+ *  buffer when they have changed since the last upload.
+ ***********************************************************/
+void ClusteredLights::UploadLights()
+{
+	if (m_bLightsChanged)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, m_lightData.size() * sizeof(float), m_lightData.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		m_bLightsChanged = false;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for assigning the lights to the
+ *  clusters of the view of the frame, and binding the
+ *  buffers the fragment shader reads.  The depth range of
+ *  the grid is taken from the perspective projection.
+ ***********************************************************/
+void ClusteredLights::Update(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (!m_bSupported)
+	{
+		return;
+	}
+
+	// the GPU time of an earlier assignment, once it is ready
+	if (m_bTimerPending)
+	{
+		GLint bAvailable = GL_FALSE;
+		glGetQueryObjectiv(m_timerQuery, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (bAvailable != GL_FALSE)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(m_timerQuery, GL_QUERY_RESULT, &nanoseconds);
+			m_assignMilliseconds = nanoseconds / 1000000.0;
+			m_bTimerPending = false;
+		}
+	}
+
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	m_viewportWidth = std::max(viewport[2], 1);
+	m_viewportHeight = std::max(viewport[3], 1);
+	float nearDepth = projection[3][2] / (projection[2][2] - 1.0f);
+	float farDepth = projection[3][2] / (projection[2][2] + 1.0f);
+	if ((nearDepth != m_nearDepth) || (farDepth != m_farDepth))
+	{
+		m_nearDepth = nearDepth;
+		m_farDepth = farDepth;
+		m_boundsMin[0].clear();
+	}
+
+	UploadLights();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_gridBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_indexBuffer);
+
+	if ((m_assignMode == computeShader) && (m_assignProgram != 0))
+	{
+		AssignLightsGPU(view, projection);
+	}
+	else
+	{
+		AssignLightsCPU(view, projection);
+	}
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for setting the size of the grid and
+ *  the slicing of its depth on a program, which must be the
+ *  current program.  A program without clustered lights
+ *  ignores them.
+ ***********************************************************/
+void ClusteredLights::SetShaderValues(GLuint program) const
+{
+	if (!m_bSupported)
+	{
+		return;
+	}
+
+	float depthScale = g_ClusterCountZ / std::log(m_farDepth / m_nearDepth);
+	float depthBias = -depthScale * std::log(m_nearDepth);
+
+	glUniform3i(glGetUniformLocation(program, "clusterDimensions"), g_ClusterCountX, g_ClusterCountY, g_ClusterCountZ);
+	glUniform2f(glGetUniformLocation(program, "clusterTileSize"), (float)m_viewportWidth / g_ClusterCountX, (float)m_viewportHeight / g_ClusterCountY);
+	glUniform2f(glGetUniformLocation(program, "clusterDepthScaleBias"), depthScale, depthBias);
+}
+
+/***********************************************************
+ *  GetLightBuffer()
+ *
+ *  This method is used for getting the buffer the lights are
+ *  stored in, for drawing them without the clusters.  The
+ *  changed lights are uploaded first.  It is 0 when the
+ *  clustered lights are not supported.
+ ***********************************************************/
+GLuint ClusteredLights::GetLightBuffer()
+{
+	if (!m_bSupported)
+	{
+		return 0;
+	}
+
+	UploadLights();
+	return m_lightBuffer;
+}
+
+/***********************************************************
+ *  GetAssignModeName()
+ *
+ *  This method is used for getting the name of an assignment
+ *  mode for the console messages.
+ ***********************************************************/
+const char* ClusteredLights::GetAssignModeName(AssignMode mode)
+{
+	switch (mode)
+	{
+	case computeShader:
+		return "compute shader";
+	case cpuScalar:
+		return "CPU";
+	default:
+		return "CPU with SSE2";
+	}
+}
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// clusteredlights.h
+// ============
+// assign many local lights to the clusters of the view for forward shading
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ClusteredLights
+ *
+ *  This class contains the code for shading with hundreds
+ *  of local point lights.  The view is split into a grid of
+ *  clusters - screen tiles over exponentially growing ranges
+ *  of view depth - and every frame each cluster gets the
+ *  list of the lights whose range reaches it, so a fragment
+ *  only evaluates the lights of its own cluster.  The lists
+ *  are built by a compute shader, or on the CPU with SSE2
+ *  when the driver renders in software, and are read by the
+ *  fragment shader from shader storage buffers.
+ ***********************************************************/
+class ClusteredLights
+{
+public:
+	// constructor
+	ClusteredLights();
+	// destructor
+	~ClusteredLights();
+
+	// the buffers cannot be shared between two objects
+	ClusteredLights(const ClusteredLights&) = delete;
+	ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+	// a point light that only reaches a limited distance
+	struct LOCAL_LIGHT
+	{
+		glm::vec3 position;
+		float radius;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+	};
+
+	// where the lights are assigned to the clusters
+	enum AssignMode
+	{
+		computeShader,
+		cpuScalar,
+		cpuSSE2
+	};
+
+private:
+	// true when the driver can read the lists in the fragment shader
+	bool m_bSupported;
+	// the program assigning the lights on the GPU, 0 without compute
+	// shaders
+	GLuint m_assignProgram;
+	AssignMode m_assignMode;
+	std::vector<LOCAL_LIGHT> m_lights;
+	// the lights in the layout of the light buffer
+	std::vector<float> m_lightData;
+	// the light, grid and index buffers, bound to the storage buffer
+	// binding points 0, 1 and 2
+	GLuint m_lightBuffer;
+	GLuint m_gridBuffer;
+	GLuint m_indexBuffer;
+	bool m_bLightsChanged;
+	// the view of the last assignment
+	glm::mat4 m_projection;
+	int m_viewportWidth;
+	int m_viewportHeight;
+	float m_nearDepth;
+	float m_farDepth;
+	// the view space box of every cluster for the CPU assignment, one
+	// array per coordinate so four clusters are tested at once
+	std::vector<float> m_boundsMin[3];
+	std::vector<float> m_boundsMax[3];
+	// the fixed size light lists of the CPU assignment, and the lists
+	// packed together for uploading
+	std::vector<uint32_t> m_clusterLights;
+	std::vector<uint32_t> m_clusterCounts;
+	std::vector<uint32_t> m_gridData;
+	std::vector<uint32_t> m_indexData;
+	// timing of the last assignment - the GPU time is read from a
+	// query a frame later so it never waits
+	GLuint m_timerQuery;
+	bool m_bTimerPending;
+	double m_assignMilliseconds;
+
+	// compute the view space box of every cluster
+	void ComputeClusterBounds(const glm::mat4& projection);
+	// assign the lights on the GPU
+	void AssignLightsGPU(const glm::mat4& view, const glm::mat4& projection);
+	// assign the lights on the CPU and upload the lists
+	void AssignLightsCPU(const glm::mat4& view, const glm::mat4& projection);
+	// upload the lights when they have changed
+	void UploadLights();
+
+public:
+	// check the driver support and build the assignment program - needs
+	// the OpenGL context to be current
+	bool Initialize(const std::string& computeShaderFile);
+	// check if the clustered lights can be drawn
+	bool IsSupported() const;
+	// check if the lights can be assigned by the compute shader
+	bool CanAssignOnGPU() const;
+
+	// replace the local lights
+	void SetLights(const std::vector<LOCAL_LIGHT>& lights);
+	// get the number of local lights
+	int GetLightCount() const;
+	// choose where the lights are assigned to the clusters
+	void SetAssignMode(AssignMode mode);
+	AssignMode GetAssignMode() const;
+	// get the time the last assignment took in milliseconds
+	double GetAssignTime() const;
+
+	// assign the lights to the clusters of the view and bind the
+	// buffers for drawing - call once per frame before drawing
+	void Update(const glm::mat4& view, const glm::mat4& projection);
+	// set the grid values on a program that draws with the clusters
+	void SetShaderValues(GLuint program) const;
+	// get the buffer of the lights, with their changes uploaded - three
+	// vec4 per light, position and radius, diffuse and specular
+	GLuint GetLightBuffer();
+
+	// get the name of an assignment mode for the console messages
+	static const char* GetAssignModeName(AssignMode mode);
+};
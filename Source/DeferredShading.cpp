@@ -0,0 +1,320 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredshading.cpp
+// ============
+// light the surfaces of the scene from a G-buffer after they are drawn
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeferredShading.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// formats of the G-buffer targets - 8 bits are enough for the colors,
+	// the normal gets 16 bits for each of its two values
+	const GLenum g_TargetFormats[DeferredShading::targetCount] = { GL_RGBA8, GL_RG16, GL_RGBA8, GL_RGBA8 };
+	const GLenum g_TargetLayouts[DeferredShading::targetCount] = { GL_RGBA, GL_RG, GL_RGBA, GL_RGBA };
+	// the sampler of every target in the light pass programs, then the
+	// sampler of the depth
+	const char* g_TargetSamplerNames[DeferredShading::targetCount + 1] = {
+		"gBufferAlbedo", "gBufferNormal", "gBufferDiffuse", "gBufferSpecular", "gBufferDepth" };
+	// the G-buffer is bound to the texture units after the 16 units of
+	// the scene textures
+	const int g_FirstTextureUnit = 16;
+	// the attributes of the local light rectangles, one light per
+	// instance - three vec4 of the light buffer
+	const GLuint g_LightAttributeLocation = 4;
+	const int g_LightAttributeCount = 3;
+}
+
+/***********************************************************
+ *  DeferredShading()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeferredShading::DeferredShading()
+{
+	m_bSupported = false;
+	m_framebuffer = 0;
+	for (int i = 0; i < targetCount; i++)
+	{
+		m_colorTextures[i] = 0;
+	}
+	m_depthTexture = 0;
+	m_width = 0;
+	m_height = 0;
+	m_screenVertexArray = 0;
+	m_targetFramebuffer = 0;
+	m_lightVertexArray = 0;
+	m_inverseViewProjection = glm::mat4(1.0f);
+}
+
+/***********************************************************
+ *  ~DeferredShading()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeferredShading::~DeferredShading()
+{
+	DeleteTextures();
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+	}
+	if (m_screenVertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_screenVertexArray);
+		glDeleteVertexArrays(1, &m_lightVertexArray);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the G-buffer at the
+ *  size of the viewport.  Deferred shading is not supported
+ *  when the driver cannot draw to all of its targets.
+ ***********************************************************/
+bool DeferredShading::Initialize()
+{
+	GLint drawBuffers = 0;
+	glGetIntegerv(GL_MAX_DRAW_BUFFERS, &drawBuffers);
+	if (drawBuffers < targetCount)
+	{
+		std::cout << "Deferred shading needs " << targetCount << " draw buffers" << std::endl;
+		return false;
+	}
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glGenVertexArrays(1, &m_screenVertexArray);
+	glGenVertexArrays(1, &m_lightVertexArray);
+
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	m_bSupported = CreateTextures(std::max(viewport[2], 1), std::max(viewport[3], 1));
+	if (!m_bSupported)
+	{
+		std::cout << "The G-buffer cannot be drawn to, deferred shading is not supported" << std::endl;
+	}
+
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the scene can be
+ *  shaded deferred.
+ ***********************************************************/
+bool DeferredShading::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  CreateTextures()
+ *
+ *  This method is used for creating the G-buffer textures
+ *  at a size and attaching them to the framebuffer.  The
+ *  pixels are read one to one, so the textures have a
+ *  single level without filtering.
+ ***********************************************************/
+bool DeferredShading::CreateTextures(int width, int height)
+{
+	DeleteTextures();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glGenTextures(targetCount, m_colorTextures);
+	for (int i = 0; i < targetCount; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, m_colorTextures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, g_TargetFormats[i], width, height, 0, g_TargetLayouts[i], GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, m_colorTextures[i], 0);
+	}
+
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_width = width;
+	m_height = height;
+	return (status == GL_FRAMEBUFFER_COMPLETE);
+}
+
+/***********************************************************
+ *  DeleteTextures()
+ *
+ *  This method is used for deleting the G-buffer textures.
+ ***********************************************************/
+void DeferredShading::DeleteTextures()
+{
+	if (m_depthTexture != 0)
+	{
+		glDeleteTextures(targetCount, m_colorTextures);
+		glDeleteTextures(1, &m_depthTexture);
+		for (int i = 0; i < targetCount; i++)
+		{
+			m_colorTextures[i] = 0;
+		}
+		m_depthTexture = 0;
+	}
+}
+
+/***********************************************************
+ *  BeginGeometryPass()
+ *
+ *  This method is used for drawing the following objects
+ *  into the G-buffer.  It is sized to the viewport, which
+ *  may have changed with the window or the scale of the
+ *  frame.  Blending is off, as each pixel keeps the nearest
+ *  surface only.
+ ***********************************************************/
+void DeferredShading::BeginGeometryPass()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_targetFramebuffer);
+
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	int width = std::max(viewport[2], 1);
+	int height = std::max(viewport[3], 1);
+	if ((width != m_width) || (height != m_height))
+	{
+		CreateTextures(width, height);
+	}
+
+	const GLenum drawBuffers[targetCount] = {
+		GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glDrawBuffers(targetCount, drawBuffers);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+}
+
+/***********************************************************
+ *  BeginLightPass()
+ *
+ *  This method is used for drawing the following light
+ *  passes into the framebuffer the frame was drawn into
+ *  before the geometry pass.  The G-buffer textures
+ *  are bound for reading, and the depth test is off as the
+ *  passes cover the drawn pixels exactly once.
+ ***********************************************************/
+void DeferredShading::BeginLightPass(const glm::mat4& view, const glm::mat4& projection)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_targetFramebuffer);
+	glDisable(GL_DEPTH_TEST);
+
+	for (int i = 0; i < targetCount; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + g_FirstTextureUnit + i);
+		glBindTexture(GL_TEXTURE_2D, m_colorTextures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0 + g_FirstTextureUnit + targetCount);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	m_inverseViewProjection = glm::inverse(projection * view);
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for pointing the samplers of a light
+ *  pass program at the G-buffer textures and setting the
+ *  matrix that rebuilds the positions from the depth.
+ ***********************************************************/
+void DeferredShading::SetShaderValues(GLuint program) const
+{
+	for (int i = 0; i <= targetCount; i++)
+	{
+		glUniform1i(glGetUniformLocation(program, g_TargetSamplerNames[i]), g_FirstTextureUnit + i);
+	}
+	glUniformMatrix4fv(glGetUniformLocation(program, "inverseViewProjection"), 1, GL_FALSE, glm::value_ptr(m_inverseViewProjection));
+}
+
+/***********************************************************
+ *  DrawSceneLights()
+ *
+ *  This method is used for lighting every drawn pixel with
+ *  the scene lights, by drawing one triangle that covers
+ *  the screen.  It writes the first color of the pixels,
+ *  and their depth from the G-buffer, so the transparent
+ *  objects drawn into the window afterwards are hidden
+ *  behind the surfaces.
+ ***********************************************************/
+void DeferredShading::DrawSceneLights(GLuint program)
+{
+	SetShaderValues(program);
+
+	glDisable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glBindVertexArray(m_screenVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_DEPTH_TEST);
+}
+
+/***********************************************************
+ *  DrawLocalLights()
+ *
+ *  This method is used for adding the local lights to the
+ *  lit pixels.  Each light is an instance of a rectangle
+ *  that the vertex shader fits around the screen bounds of
+ *  its sphere, and its attributes are read straight from
+ *  the light buffer, so only the pixels it may reach run
+ *  its lighting.
+ ***********************************************************/
+void DeferredShading::DrawLocalLights(GLuint program, GLuint lightBuffer, int lightCount)
+{
+	if ((lightBuffer == 0) || (lightCount <= 0))
+	{
+		return;
+	}
+
+	SetShaderValues(program);
+
+	glBindVertexArray(m_lightVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, lightBuffer);
+	for (int i = 0; i < g_LightAttributeCount; i++)
+	{
+		glEnableVertexAttribArray(g_LightAttributeLocation + i);
+		glVertexAttribPointer(g_LightAttributeLocation + i, 4, GL_FLOAT, GL_FALSE,
+			g_LightAttributeCount * 4 * sizeof(float), (const void*)(i * 4 * sizeof(float)));
+		glVertexAttribDivisor(g_LightAttributeLocation + i, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, lightCount);
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  EndLightPass()
+ *
+ *  This method is used for restoring the depth test and the
+ *  transparent blending the objects are drawn with.
+ ***********************************************************/
+void DeferredShading::EndLightPass()
+{
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredshading.h
+// ============
+// light the surfaces of the scene from a G-buffer after they are drawn
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  DeferredShading
+ *
+ *  This class contains the code for shading the scene in
+ *  two passes.  The geometry pass draws the objects into a
+ *  G-buffer that keeps the surface of the nearest object of
+ *  every pixel - its color, normal and material - and the
+ *  light passes then light each pixel once, so the lights
+ *  are not evaluated for the fragments that are overdrawn.
+ *  The scene lights are drawn over the whole screen, and
+ *  each local light only over the screen rectangle its
+ *  sphere covers.  A pixel keeps a single surface, so the
+ *  transparent objects are drawn forward over the lit
+ *  pixels afterwards.
+ ***********************************************************/
+class DeferredShading
+{
+public:
+	// constructor
+	DeferredShading();
+	// destructor
+	~DeferredShading();
+
+	// the framebuffer cannot be shared between two objects
+	DeferredShading(const DeferredShading&) = delete;
+	DeferredShading& operator=(const DeferredShading&) = delete;
+
+	// the color targets of the G-buffer
+	enum GBufferTarget
+	{
+		// surface color
+		albedo,
+		// octahedral normal
+		normal,
+		// material diffuse color
+		diffuse,
+		// material specular color and shininess
+		specular,
+		targetCount
+	};
+
+private:
+	bool m_bSupported;
+	GLuint m_framebuffer;
+	GLuint m_colorTextures[targetCount];
+	// the depth the positions are rebuilt from
+	GLuint m_depthTexture;
+	int m_width;
+	int m_height;
+	// the vertex arrays of the screen triangle, which has no
+	// attributes, and of the local light rectangles
+	GLuint m_screenVertexArray;
+	GLuint m_lightVertexArray;
+	glm::mat4 m_inverseViewProjection;
+	// the framebuffer the frame was drawn into before the geometry pass,
+	// which the light passes draw into
+	GLint m_targetFramebuffer;
+
+	// create the G-buffer textures at a size, and check that they can
+	// be drawn to
+	bool CreateTextures(int width, int height);
+	// delete the G-buffer textures
+	void DeleteTextures();
+	// set the G-buffer textures and the inverse camera matrix on a
+	// light pass program
+	void SetShaderValues(GLuint program) const;
+
+public:
+	// create the G-buffer at the size of the viewport - needs the
+	// OpenGL context to be current
+	bool Initialize();
+	// check if the scene can be shaded deferred
+	bool IsSupported() const;
+
+	// draw the following objects into the G-buffer, resizing it to the
+	// viewport first
+	void BeginGeometryPass();
+	// draw the following light passes into the display window from the
+	// G-buffer
+	void BeginLightPass(const glm::mat4& view, const glm::mat4& projection);
+	// light every drawn pixel with the scene lights
+	void DrawSceneLights(GLuint program);
+	// add the local lights of a light buffer over their screen bounds
+	void DrawLocalLights(GLuint program, GLuint lightBuffer, int lightCount);
+	// restore the state the objects are drawn with
+	void EndLightPass();
+};
@@ -0,0 +1,343 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.cpp
+// ============
+// lay down the depth of the opaque objects before they are lit, and measure
+// whether that saves more fragments than it costs
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DepthPrepass.h"
+
+#include <iostream>
+
+namespace
+{
+	// the weight of a new measurement in the averages
+	const double g_MeasurementWeight = 0.1;
+	// the pre-pass is turned on once it saves a tenth more than it
+	// costs, and off once it saves a tenth less, so the choice does not
+	// flip on the noise of the timings
+	const double g_EnableMargin = 1.1;
+	const double g_DisableMargin = 0.9;
+	// the frames between two measurements of the overdraw while the
+	// pre-pass is off
+	const int g_ProbeInterval = 120;
+
+	// move an average towards a new measurement
+	void Average(double& average, double measurement, bool bFirst)
+	{
+		average = bFirst ? measurement : average + ((measurement - average) * g_MeasurementWeight);
+	}
+}
+
+/***********************************************************
+ *  DepthPrepass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DepthPrepass::DepthPrepass()
+{
+	m_bSupported = false;
+	for (int i = 0; i < frameQueryCount; i++)
+	{
+		m_queries[i] = 0;
+	}
+	m_bMeasuring = false;
+	m_bPending = false;
+	m_bPendingPrepass = false;
+	m_shadedFragments = 0.0;
+	m_overdrawRatio = 0.0;
+	m_fragmentNanoseconds = 0.0;
+	m_prepassMilliseconds = 0.0;
+	m_bOverdrawMeasured = false;
+	m_bCostMeasured = false;
+	// the pre-pass is drawn until it has been measured
+	m_bWorthwhile = true;
+	m_framesSinceProbe = 0;
+}
+
+/***********************************************************
+ *  ~DepthPrepass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DepthPrepass::~DepthPrepass()
+{
+	if (m_queries[0] != 0)
+	{
+		glDeleteQueries(frameQueryCount, m_queries);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the queries that
+ *  measure the passes.  The GPU time needs timer queries,
+ *  without them the pre-pass can still be drawn but not
+ *  chosen automatically.
+ ***********************************************************/
+bool DepthPrepass::Initialize()
+{
+	if ((GLEW_VERSION_3_3 == GL_FALSE) && (GLEW_ARB_timer_query == GL_FALSE))
+	{
+		std::cout << "Timer queries are not supported - the depth pre-pass is not chosen automatically" << std::endl;
+		return false;
+	}
+
+	glGenQueries(frameQueryCount, m_queries);
+	m_bSupported = true;
+
+	return true;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the passes can be
+ *  measured.
+ ***********************************************************/
+bool DepthPrepass::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for reading the measurements of an
+ *  earlier frame once they are ready, and getting whether
+ *  the pre-pass is worth drawing in this frame.  Only one
+ *  frame is measured at a time, so the queries are not read
+ *  before the GPU has finished with them.  While the pre-
+ *  pass is not worth drawing it is still drawn every few
+ *  seconds, as the overdraw can only be measured with it.
+ ***********************************************************/
+bool DepthPrepass::BeginFrame()
+{
+	if (!m_bSupported)
+	{
+		m_bMeasuring = false;
+		return m_bWorthwhile;
+	}
+
+	if (m_bPending)
+	{
+		GLint bAvailable = GL_FALSE;
+		glGetQueryObjectiv(m_queries[colorTime], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (bAvailable != GL_FALSE)
+		{
+			ReadMeasurements();
+			m_bPending = false;
+		}
+	}
+	m_bMeasuring = !m_bPending;
+
+	if (m_bWorthwhile)
+	{
+		m_framesSinceProbe = 0;
+		return true;
+	}
+	m_framesSinceProbe++;
+	if (m_bMeasuring && (m_framesSinceProbe >= g_ProbeInterval))
+	{
+		m_framesSinceProbe = 0;
+		return true;
+	}
+
+	return false;
+}
+
+/***********************************************************
+ *  BeginPrepass()
+ *
+ *  This method is used for drawing the following objects
+ *  into the depth buffer only.  The fragment shader writes
+ *  no color and leaves the depth to the fixed function, so
+ *  the fragments hidden by nearer objects are rejected
+ *  before it runs.
+ ***********************************************************/
+void DepthPrepass::BeginPrepass()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	if (m_bMeasuring)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries[prepassSamples]);
+		glBeginQuery(GL_TIME_ELAPSED, m_queries[prepassTime]);
+	}
+}
+
+/***********************************************************
+ *  EndPrepass()
+ *
+ *  This method is used for finishing the depth of the
+ *  opaque objects and writing the colors again.
+ ***********************************************************/
+void DepthPrepass::EndPrepass()
+{
+	if (m_bMeasuring)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+/***********************************************************
+ *  BeginColorPass()
+ *
+ *  This method is used for drawing the following objects
+ *  in color.  After the pre-pass only the fragment that
+ *  wrote the depth of its pixel is equal to it, and the
+ *  depth is already complete so it is not written again.
+ ***********************************************************/
+void DepthPrepass::BeginColorPass(bool bPrepassDrawn)
+{
+	if (bPrepassDrawn)
+	{
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+
+	if (m_bMeasuring)
+	{
+		m_bPendingPrepass = bPrepassDrawn;
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries[colorSamples]);
+		glBeginQuery(GL_TIME_ELAPSED, m_queries[colorTime]);
+	}
+}
+
+/***********************************************************
+ *  EndColorPass()
+ *
+ *  This method is used for finishing the opaque objects and
+ *  restoring the depth test the rest of the frame is drawn
+ *  with.
+ ***********************************************************/
+void DepthPrepass::EndColorPass()
+{
+	if (m_bMeasuring)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		glEndQuery(GL_SAMPLES_PASSED);
+		m_bMeasuring = false;
+		m_bPending = true;
+	}
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+/***********************************************************
+ *  ReadMeasurements()
+ *
+ *  This method is used for adding the results of a measured
+ *  frame to the averages.  With the pre-pass, its samples
+ *  are the fragments the color pass lights without it and
+ *  the color pass only lights the visible ones, which gives
+ *  the overdraw.  Either way the color pass gives the cost
+ *  of a lit fragment.
+ ***********************************************************/
+void DepthPrepass::ReadMeasurements()
+{
+	GLuint64 results[frameQueryCount] = { 0, 0, 0, 0 };
+	int first = m_bPendingPrepass ? prepassSamples : colorSamples;
+	for (int i = first; i < frameQueryCount; i++)
+	{
+		glGetQueryObjectui64v(m_queries[i], GL_QUERY_RESULT, &results[i]);
+	}
+	if (results[colorSamples] == 0)
+	{
+		return;
+	}
+
+	Average(m_fragmentNanoseconds, (double)results[colorTime] / results[colorSamples], !m_bCostMeasured);
+	m_bCostMeasured = true;
+	if (m_bPendingPrepass)
+	{
+		Average(m_shadedFragments, (double)results[prepassSamples], !m_bOverdrawMeasured);
+		Average(m_overdrawRatio, (double)results[prepassSamples] / results[colorSamples], !m_bOverdrawMeasured);
+		Average(m_prepassMilliseconds, results[prepassTime] / 1000000.0, !m_bOverdrawMeasured);
+		m_bOverdrawMeasured = true;
+	}
+	else if (m_bOverdrawMeasured)
+	{
+		Average(m_shadedFragments, (double)results[colorSamples], false);
+	}
+
+	UpdateDecision();
+}
+
+/***********************************************************
+ *  UpdateDecision()
+ *
+ *  This method is used for deciding whether the pre-pass is
+ *  worth drawing.  It saves lighting every fragment past
+ *  the visible one of its pixel, and costs the time of the
+ *  pass itself.
+ ***********************************************************/
+void DepthPrepass::UpdateDecision()
+{
+	if (!m_bOverdrawMeasured || (m_overdrawRatio <= 0.0))
+	{
+		return;
+	}
+
+	double hiddenFragments = m_shadedFragments * (1.0 - (1.0 / m_overdrawRatio));
+	double savedMilliseconds = (hiddenFragments * m_fragmentNanoseconds) / 1000000.0;
+	if (m_bWorthwhile && (savedMilliseconds < (m_prepassMilliseconds * g_DisableMargin)))
+	{
+		m_bWorthwhile = false;
+	}
+	else if (!m_bWorthwhile && (savedMilliseconds > (m_prepassMilliseconds * g_EnableMargin)))
+	{
+		m_bWorthwhile = true;
+	}
+}
+
+/***********************************************************
+ *  GetOverdrawRatio()
+ *
+ *  This method is used for getting the fragments the color
+ *  pass lights without the pre-pass for every visible one.
+ ***********************************************************/
+double DepthPrepass::GetOverdrawRatio() const
+{
+	return m_overdrawRatio;
+}
+
+/***********************************************************
+ *  GetFragmentCost()
+ *
+ *  This method is used for getting the time a lit fragment
+ *  takes in nanoseconds.
+ ***********************************************************/
+double DepthPrepass::GetFragmentCost() const
+{
+	return m_fragmentNanoseconds;
+}
+
+/***********************************************************
+ *  GetPrepassTime()
+ *
+ *  This method is used for getting the time the pre-pass
+ *  takes in milliseconds.
+ ***********************************************************/
+double DepthPrepass::GetPrepassTime() const
+{
+	return m_prepassMilliseconds;
+}
+
+/***********************************************************
+ *  IsWorthwhile()
+ *
+ *  This method is used for checking if the pre-pass saves
+ *  more than it costs.
+ ***********************************************************/
+bool DepthPrepass::IsWorthwhile() const
+{
+	return m_bWorthwhile;
+}
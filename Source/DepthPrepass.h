@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.h
+// ============
+// lay down the depth of the opaque objects before they are lit, and measure
+// whether that saves more fragments than it costs
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  DepthPrepass
+ *
+ *  This class contains the code for the depth pre-pass of
+ *  the forward frames.  The opaque objects are first drawn
+ *  into the depth buffer alone, from their positions only,
+ *  and then drawn in color where their depth is equal to
+ *  it, so every pixel runs the light loop once however
+ *  many objects overlap on it.  The samples and the GPU
+ *  time of both passes are measured, giving the overdraw
+ *  of the scene and the cost of a lit fragment, and the
+ *  pre-pass is only worth drawing while the fragments it
+ *  saves cost more than the pass itself.
+ ***********************************************************/
+class DepthPrepass
+{
+public:
+	// constructor
+	DepthPrepass();
+	// destructor
+	~DepthPrepass();
+
+	// the queries cannot be shared between two objects
+	DepthPrepass(const DepthPrepass&) = delete;
+	DepthPrepass& operator=(const DepthPrepass&) = delete;
+
+private:
+	// the queries of a measured frame - the samples that passed the
+	// depth test and the GPU time of each pass
+	enum FrameQuery
+	{
+		prepassSamples,
+		prepassTime,
+		colorSamples,
+		colorTime,
+		frameQueryCount
+	};
+
+	bool m_bSupported;
+	GLuint m_queries[frameQueryCount];
+	// whether the current frame is measured, and whether a measured
+	// frame has not been read back yet and drew the pre-pass
+	bool m_bMeasuring;
+	bool m_bPending;
+	bool m_bPendingPrepass;
+	// the averaged measurements - the fragments the color pass lights
+	// without the pre-pass, how many of them land on each pixel, the
+	// nanoseconds a lit fragment takes and the milliseconds of the
+	// pre-pass
+	double m_shadedFragments;
+	double m_overdrawRatio;
+	double m_fragmentNanoseconds;
+	double m_prepassMilliseconds;
+	bool m_bOverdrawMeasured;
+	bool m_bCostMeasured;
+	// whether the pre-pass saves more than it costs, and the frames
+	// since it was last drawn to measure the overdraw again
+	bool m_bWorthwhile;
+	int m_framesSinceProbe;
+
+	// add the results of a measured frame to the averages
+	void ReadMeasurements();
+	// decide whether the pre-pass is worth drawing from the averages
+	void UpdateDecision();
+
+public:
+	// create the queries - needs the OpenGL context to be current
+	bool Initialize();
+	// check if the passes can be measured
+	bool IsSupported() const;
+
+	// read the measurements of an earlier frame once they are ready -
+	// returns whether the pre-pass is worth drawing this frame, which
+	// is also true now and then while it is not, to measure the
+	// overdraw again
+	bool BeginFrame();
+	// draw the following objects into the depth buffer only
+	void BeginPrepass();
+	void EndPrepass();
+	// draw the following objects in color - only where their depth is
+	// equal to the pre-pass when it was drawn
+	void BeginColorPass(bool bPrepassDrawn);
+	void EndColorPass();
+
+	// get the lit fragments for every visible one, 0 before the
+	// pre-pass was measured
+	double GetOverdrawRatio() const;
+	// get the time a lit fragment takes in nanoseconds
+	double GetFragmentCost() const;
+	// get the time the pre-pass takes in milliseconds
+	double GetPrepassTime() const;
+	// check if the pre-pass saves more than it costs
+	bool IsWorthwhile() const;
+};
@@ -0,0 +1,392 @@
+///////////////////////////////////////////////////////////////////////////////
+// facematerialmeshes.cpp
+// ============
+// create multi-material meshes for the capped 3D primitives:
+//     box, cylinder, tapered cylinder
+//
+// every vertex carries the ID of the face it belongs to, so that a different
+// texture and material can be applied per face within a single draw command
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FaceMaterialMeshes.h"
+
+#include <cmath>
+
+namespace
+{
+	const GLuint g_FloatsPerVertex = 3;	// Number of coordinates per vertex
+	const GLuint g_FloatsPerNormal = 3;	// Number of values per vertex normal
+	const GLuint g_FloatsPerUV = 2;		// Number of texture coordinate values
+	const GLuint g_FloatsPerFaceID = 1;	// Number of face ID values
+	const GLuint g_FloatsPerMeshVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV + g_FloatsPerFaceID;
+
+	// the vertex attribute location of the face ID in the vertex shader
+	const GLuint g_FaceIDAttribute = 3;
+
+	// number of segments around the cylinder circumference - matches
+	// the 10 degree steps used by the ShapeMeshes cylinders
+	const int g_CylinderSegments = 36;
+}
+
+/***********************************************************
+ *  FaceMaterialMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FaceMaterialMeshes::FaceMaterialMeshes()
+{
+	m_BoxMesh = {};
+	m_CylinderMesh = {};
+	m_TaperedCylinderMesh = {};
+	m_bPositionOnly = false;
+}
+
+/***********************************************************
+ *  ~FaceMaterialMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FaceMaterialMeshes::~FaceMaterialMeshes()
+{
+	DestroyMesh(m_BoxMesh);
+	DestroyMesh(m_CylinderMesh);
+	DestroyMesh(m_TaperedCylinderMesh);
+}
+
+/***********************************************************
+ *  AddVertex()
+ *
+ *  This method is used for appending one interleaved vertex
+ *  (position, normal, texture coordinate, face ID) into the
+ *  passed in vertex data.
+ ***********************************************************/
+void FaceMaterialMeshes::AddVertex(
+	std::vector<GLfloat>& verts,
+	glm::vec3 position,
+	glm::vec3 normal,
+	glm::vec2 uv,
+	MeshFace face)
+{
+	verts.push_back(position.x);
+	verts.push_back(position.y);
+	verts.push_back(position.z);
+	verts.push_back(normal.x);
+	verts.push_back(normal.y);
+	verts.push_back(normal.z);
+	verts.push_back(uv.x);
+	verts.push_back(uv.y);
+	verts.push_back((GLfloat)face);
+}
+
+/***********************************************************
+ *  LoadBoxMesh()
+ *
+ *  Create a box mesh with the same vertices, normals and
+ *  texture coordinates as the ShapeMeshes box, plus the
+ *  face ID of every side.
+ ***********************************************************/
+void FaceMaterialMeshes::LoadBoxMesh()
+{
+	std::vector<GLfloat> verts;
+
+	//Back Face				//Negative Z Normal
+	AddVertex(verts, glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec2(0.0f, 1.0f), back);
+	AddVertex(verts, glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec2(0.0f, 0.0f), back);
+	AddVertex(verts, glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec2(1.0f, 0.0f), back);
+	AddVertex(verts, glm::vec3(-0.5f, 0.5f, -0.5f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec2(1.0f, 1.0f), back);
+
+	//Bottom Face			//Negative Y Normal
+	AddVertex(verts, glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(0.0f, 1.0f), bottom);
+	AddVertex(verts, glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(0.0f, 0.0f), bottom);
+	AddVertex(verts, glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(1.0f, 0.0f), bottom);
+	AddVertex(verts, glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(1.0f, 1.0f), bottom);
+
+	//Left Face				//Negative X Normal
+	AddVertex(verts, glm::vec3(-0.5f, 0.5f, -0.5f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec2(0.0f, 1.0f), left);
+	AddVertex(verts, glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec2(0.0f, 0.0f), left);
+	AddVertex(verts, glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec2(1.0f, 0.0f), left);
+	AddVertex(verts, glm::vec3(-0.5f, 0.5f, 0.5f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec2(1.0f, 1.0f), left);
+
+	//Right Face			//Positive X Normal
+	AddVertex(verts, glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec2(0.0f, 1.0f), right);
+	AddVertex(verts, glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec2(0.0f, 0.0f), right);
+	AddVertex(verts, glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec2(1.0f, 0.0f), right);
+	AddVertex(verts, glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec2(1.0f, 1.0f), right);
+
+	//Top Face				//Positive Y Normal
+	AddVertex(verts, glm::vec3(-0.5f, 0.5f, -0.5f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 1.0f), top);
+	AddVertex(verts, glm::vec3(-0.5f, 0.5f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 0.0f), top);
+	AddVertex(verts, glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 0.0f), top);
+	AddVertex(verts, glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 1.0f), top);
+
+	//Front Face			//Positive Z Normal
+	AddVertex(verts, glm::vec3(-0.5f, 0.5f, 0.5f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, 1.0f), front);
+	AddVertex(verts, glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.0f, 0.0f), front);
+	AddVertex(verts, glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(1.0f, 0.0f), front);
+	AddVertex(verts, glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(1.0f, 1.0f), front);
+
+	// Index data
+	std::vector<GLuint> indices = {
+		0,1,2,
+		0,3,2,
+		4,5,6,
+		4,7,6,
+		8,9,10,
+		8,11,10,
+		12,13,14,
+		12,15,14,
+		16,17,18,
+		16,19,18,
+		20,21,22,
+		20,23,22
+	};
+
+	UploadMesh(m_BoxMesh, verts, indices);
+}
+
+/***********************************************************
+ *  BuildCylinder()
+ *
+ *  This method is used for building the vertex and index
+ *  data for a cylinder with a radius of 1 at the bottom,
+ *  the passed in radius at the top, and a height of 1.  The
+ *  bottom cap, top cap and body get their own face IDs.
+ ***********************************************************/
+void FaceMaterialMeshes::BuildCylinder(
+	float topRadius,
+	std::vector<GLfloat>& verts,
+	std::vector<GLuint>& indices)
+{
+	const float bottomRadius = 1.0f;
+	const float stepRadians = glm::radians(360.0f / g_CylinderSegments);
+	GLuint baseIndex = 0;
+
+	// the caps use the same planar texture mapping as the
+	// ShapeMeshes cylinders - (1, 0) maps to (0.5, 1.0)
+	for (int cap = 0; cap < 2; cap++)
+	{
+		float y = (float)cap;
+		float radius = (cap == 0) ? bottomRadius : topRadius;
+		glm::vec3 normal = glm::vec3(0.0f, (cap == 0) ? -1.0f : 1.0f, 0.0f);
+		MeshFace face = (cap == 0) ? bottom : top;
+
+		baseIndex = (GLuint)(verts.size() / g_FloatsPerMeshVertex);
+		for (int i = 0; i < g_CylinderSegments; i++)
+		{
+			float x = cos(i * stepRadians);
+			float z = -sin(i * stepRadians);
+			AddVertex(
+				verts,
+				glm::vec3(x * radius, y, z * radius),
+				normal,
+				glm::vec2(0.5f + (0.5f * z), 0.5f + (0.5f * x)),
+				face);
+		}
+		// triangulate the cap as a fan around the first rim vertex
+		for (int i = 1; i < g_CylinderSegments - 1; i++)
+		{
+			indices.push_back(baseIndex);
+			indices.push_back(baseIndex + i);
+			indices.push_back(baseIndex + i + 1);
+		}
+	}
+
+	// the body wraps the texture once around the circumference - the
+	// seam vertices are duplicated so the U coordinate can reach 1.0
+	baseIndex = (GLuint)(verts.size() / g_FloatsPerMeshVertex);
+	float slope = bottomRadius - topRadius;
+	for (int i = 0; i <= g_CylinderSegments; i++)
+	{
+		float x = cos(i * stepRadians);
+		float z = -sin(i * stepRadians);
+		float u = (float)i / (float)g_CylinderSegments;
+		glm::vec3 normal = glm::normalize(glm::vec3(x, slope, z));
+
+		AddVertex(verts, glm::vec3(x * bottomRadius, 0.0f, z * bottomRadius), normal, glm::vec2(u, 0.0f), sides);
+		AddVertex(verts, glm::vec3(x * topRadius, 1.0f, z * topRadius), normal, glm::vec2(u, 1.0f), sides);
+	}
+	for (int i = 0; i < g_CylinderSegments; i++)
+	{
+		GLuint bottom0 = baseIndex + (i * 2);
+		GLuint top0 = bottom0 + 1;
+		GLuint bottom1 = bottom0 + 2;
+		GLuint top1 = bottom0 + 3;
+
+		indices.push_back(bottom0);
+		indices.push_back(bottom1);
+		indices.push_back(top0);
+		indices.push_back(top0);
+		indices.push_back(bottom1);
+		indices.push_back(top1);
+	}
+}
+
+/***********************************************************
+ *  LoadCylinderMesh()
+ *
+ *  Create a cylinder mesh matching the dimensions of the
+ *  ShapeMeshes cylinder, with face IDs for the top, bottom
+ *  and sides.
+ ***********************************************************/
+void FaceMaterialMeshes::LoadCylinderMesh()
+{
+	std::vector<GLfloat> verts;
+	std::vector<GLuint> indices;
+
+	BuildCylinder(1.0f, verts, indices);
+	UploadMesh(m_CylinderMesh, verts, indices);
+}
+
+/***********************************************************
+ *  LoadTaperedCylinderMesh()
+ *
+ *  Create a tapered cylinder mesh matching the dimensions of
+ *  the ShapeMeshes tapered cylinder (top radius of 0.5),
+ *  with face IDs for the top, bottom and sides.
+ ***********************************************************/
+void FaceMaterialMeshes::LoadTaperedCylinderMesh()
+{
+	std::vector<GLfloat> verts;
+	std::vector<GLuint> indices;
+
+	BuildCylinder(0.5f, verts, indices);
+	UploadMesh(m_TaperedCylinderMesh, verts, indices);
+}
+
+/***********************************************************
+ *  UploadMesh()
+ *
+ *  This method is used for sending the vertex and index data
+ *  to the GPU and defining the memory layout of the mesh.
+ *  The first three attributes match the ShapeMeshes layout
+ *  and the face ID is added as attribute 3.
+ ***********************************************************/
+void FaceMaterialMeshes::UploadMesh(
+	GLMesh& mesh,
+	const std::vector<GLfloat>& verts,
+	const std::vector<GLuint>& indices)
+{
+	mesh.nVertices = (GLuint)(verts.size() / g_FloatsPerMeshVertex);
+	mesh.nIndices = (GLuint)indices.size();
+
+	glGenVertexArrays(1, &mesh.vao);
+	glBindVertexArray(mesh.vao);
+
+	// Create 2 buffers: first one for the vertex data; second one for the indices
+	glGenBuffers(2, mesh.vbos);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
+	glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(GLfloat), verts.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	GLint stride = sizeof(GLfloat) * g_FloatsPerMeshVertex;
+
+	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * g_FloatsPerVertex));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * (g_FloatsPerVertex + g_FloatsPerNormal)));
+	glEnableVertexAttribArray(2);
+
+	glVertexAttribPointer(g_FaceIDAttribute, g_FloatsPerFaceID, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV)));
+	glEnableVertexAttribArray(g_FaceIDAttribute);
+
+	// the positions are also packed on their own for the depth only
+	// passes, which share the indices
+	std::vector<GLfloat> positions;
+	positions.reserve(mesh.nVertices * g_FloatsPerVertex);
+	for (size_t vertex = 0; vertex < verts.size(); vertex += g_FloatsPerMeshVertex)
+	{
+		positions.insert(positions.end(), verts.begin() + vertex, verts.begin() + vertex + g_FloatsPerVertex);
+	}
+
+	glGenVertexArrays(1, &mesh.positionVao);
+	glBindVertexArray(mesh.positionVao);
+
+	glGenBuffers(1, &mesh.positionVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.positionVbo);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
+
+	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * g_FloatsPerVertex, 0);
+	glEnableVertexAttribArray(0);
+
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  DestroyMesh()
+ *
+ *  This method is used for freeing the GPU memory used by
+ *  the passed in mesh.
+ ***********************************************************/
+void FaceMaterialMeshes::DestroyMesh(GLMesh& mesh)
+{
+	if (mesh.vao != 0)
+	{
+		glDeleteVertexArrays(1, &mesh.vao);
+		glDeleteBuffers(2, mesh.vbos);
+		glDeleteVertexArrays(1, &mesh.positionVao);
+		glDeleteBuffers(1, &mesh.positionVbo);
+		mesh = {};
+	}
+}
+
+/***********************************************************
+ *  DrawBoxMesh()
+ *
+ *  Draw all six sides of the box mesh with one draw command.
+ ***********************************************************/
+void FaceMaterialMeshes::DrawBoxMesh()
+{
+	glBindVertexArray(m_bPositionOnly ? m_BoxMesh.positionVao : m_BoxMesh.vao);
+
+	glDrawElements(GL_TRIANGLES, m_BoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  DrawCylinderMesh()
+ *
+ *  Draw the top, bottom and sides of the cylinder mesh with
+ *  one draw command.
+ ***********************************************************/
+void FaceMaterialMeshes::DrawCylinderMesh()
+{
+	glBindVertexArray(m_bPositionOnly ? m_CylinderMesh.positionVao : m_CylinderMesh.vao);
+
+	glDrawElements(GL_TRIANGLES, m_CylinderMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  DrawTaperedCylinderMesh()
+ *
+ *  Draw the top, bottom and sides of the tapered cylinder
+ *  mesh with one draw command.
+ ***********************************************************/
+void FaceMaterialMeshes::DrawTaperedCylinderMesh()
+{
+	glBindVertexArray(m_bPositionOnly ? m_TaperedCylinderMesh.positionVao : m_TaperedCylinderMesh.vao);
+
+	glDrawElements(GL_TRIANGLES, m_TaperedCylinderMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  SetPositionOnly()
+ *
+ *  This method is used for drawing the meshes from their
+ *  packed positions, which is all the depth only passes
+ *  read, or from their full vertices again.
+ ***********************************************************/
+void FaceMaterialMeshes::SetPositionOnly(bool bPositionOnly)
+{
+	m_bPositionOnly = bPositionOnly;
+}
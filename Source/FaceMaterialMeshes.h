@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// facematerialmeshes.h
+// ============
+// create multi-material meshes for the capped 3D primitives:
+//     box, cylinder, tapered cylinder
+//
+// every vertex carries the ID of the face it belongs to, so that a different
+// texture and material can be applied per face within a single draw command
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  FaceMaterialMeshes
+ *
+ *  This class contains the code for defining the capped
+ *  3D shapes with a face ID vertex attribute, loading them
+ *  into memory, and drawing them with one draw command.
+ ***********************************************************/
+class FaceMaterialMeshes
+{
+public:
+	// constructor
+	FaceMaterialMeshes();
+	// destructor
+	~FaceMaterialMeshes();
+
+	// the face IDs written into the face ID vertex attribute - the
+	// box faces use the same ordering as ShapeMeshes::BoxSide
+	enum MeshFace
+	{
+		front,
+		back,
+		left,
+		right,
+		top,
+		bottom,
+		sides
+	};
+	// total number of face IDs - must match TOTAL_MESH_FACES in the shaders
+	static const int TOTAL_MESH_FACES = 7;
+
+private:
+
+	// stores the GL data relative to a given mesh
+	struct GLMesh
+	{
+		GLuint vao;         // Handle for the vertex array object
+		GLuint vbos[2];     // Handles for the vertex buffer objects
+		GLuint nVertices;	// Number of vertices for the mesh
+		GLuint nIndices;    // Number of indices for the mesh
+		GLuint positionVao; // Handle for the vertex array of the positions alone
+		GLuint positionVbo; // Handle for the packed positions
+	};
+
+	// the available multi-material 3D shapes
+	GLMesh m_BoxMesh;
+	GLMesh m_CylinderMesh;
+	GLMesh m_TaperedCylinderMesh;
+	// true when the meshes are drawn from their positions alone
+	bool m_bPositionOnly;
+
+	// append a single vertex into the passed in vertex data
+	void AddVertex(
+		std::vector<GLfloat>& verts,
+		glm::vec3 position,
+		glm::vec3 normal,
+		glm::vec2 uv,
+		MeshFace face);
+
+	// build the vertex and index data for a capped cylinder
+	void BuildCylinder(
+		float topRadius,
+		std::vector<GLfloat>& verts,
+		std::vector<GLuint>& indices);
+
+	// send the vertex and index data to the GPU and set the memory layout
+	void UploadMesh(
+		GLMesh& mesh,
+		const std::vector<GLfloat>& verts,
+		const std::vector<GLuint>& indices);
+
+	// free the GPU memory used by the passed in mesh
+	void DestroyMesh(GLMesh& mesh);
+
+public:
+
+	// methods for loading the shape mesh data
+	// into memory
+	void LoadBoxMesh();
+	void LoadCylinderMesh();
+	void LoadTaperedCylinderMesh();
+
+	// methods for drawing the filled shape mesh, including
+	// all of its faces, with one draw command
+	void DrawBoxMesh();
+	void DrawCylinderMesh();
+	void DrawTaperedCylinderMesh();
+
+	// draw the meshes from their positions alone, for the passes that
+	// only write the depth
+	void SetPositionOnly(bool bPositionOnly);
+};
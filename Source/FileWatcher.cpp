@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.cpp
+// ============
+// watch asset folders for changed files on a background thread
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.h"
+
+#include "AssetPack.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// time a changed file must be left alone before it is reported,
+	// so the several writes of one save are reported once
+	const std::chrono::milliseconds g_SettleTime(20);
+	// size of the buffer the change notifications are read into
+	const size_t g_EventBufferSize = 16384;
+#ifndef _WIN32
+	// longest the watcher thread sleeps before checking if it
+	// should exit
+	const int g_StopCheckMilliseconds = 100;
+#endif
+}
+
+/***********************************************************
+ *  FileWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FileWatcher::FileWatcher(const std::vector<std::string>& folders)
+{
+	m_folders = folders;
+	m_bStopping = false;
+#ifdef _WIN32
+	m_hStopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+#endif
+
+	m_thread = std::thread(&FileWatcher::WatchLoop, this);
+}
+
+/***********************************************************
+ *  ~FileWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FileWatcher::~FileWatcher()
+{
+	m_bStopping = true;
+#ifdef _WIN32
+	SetEvent((HANDLE)m_hStopEvent);
+#endif
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+#ifdef _WIN32
+	CloseHandle((HANDLE)m_hStopEvent);
+	m_hStopEvent = NULL;
+#endif
+}
+
+/***********************************************************
+ *  WatchLoop()
+ *
+ *  This method is run by the watcher thread.  It asks the
+ *  operating system for the files written or renamed into
+ *  the watched folders, and records each change until the
+ *  watcher is stopped.
+ ***********************************************************/
+#ifdef _WIN32
+void FileWatcher::WatchLoop()
+{
+	struct WATCHED_FOLDER
+	{
+		std::string folder;
+		HANDLE hDirectory;
+		OVERLAPPED overlapped;
+		// the notifications are DWORD aligned
+		std::vector<DWORD> buffer;
+	};
+	const DWORD notifyFilter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME;
+	std::vector<WATCHED_FOLDER> watched(m_folders.size());
+	std::vector<HANDLE> events;
+	std::vector<size_t> eventFolders;
+
+	// the stop event is first, so it wins over pending changes
+	events.push_back((HANDLE)m_hStopEvent);
+	for (size_t i = 0; i < m_folders.size(); i++)
+	{
+		WATCHED_FOLDER& folder = watched[i];
+		folder.folder = m_folders[i];
+		folder.hDirectory = CreateFileA(
+			m_folders[i].c_str(),
+			FILE_LIST_DIRECTORY,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			NULL,
+			OPEN_EXISTING,
+			FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+			NULL);
+		if (folder.hDirectory == INVALID_HANDLE_VALUE)
+		{
+			std::cout << "Could not watch folder:" << m_folders[i] << std::endl;
+			continue;
+		}
+
+		ZeroMemory(&folder.overlapped, sizeof(folder.overlapped));
+		folder.overlapped.hEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+		folder.buffer.resize(g_EventBufferSize / sizeof(DWORD));
+		ReadDirectoryChangesW(folder.hDirectory, folder.buffer.data(), (DWORD)g_EventBufferSize, FALSE,
+			notifyFilter, NULL, &folder.overlapped, NULL);
+		events.push_back(folder.overlapped.hEvent);
+		eventFolders.push_back(i);
+	}
+
+	while (!m_bStopping)
+	{
+		DWORD signaled = WaitForMultipleObjects((DWORD)events.size(), events.data(), FALSE, INFINITE);
+		if ((signaled <= WAIT_OBJECT_0) || (signaled >= WAIT_OBJECT_0 + events.size()))
+		{
+			break;
+		}
+
+		WATCHED_FOLDER& folder = watched[eventFolders[signaled - WAIT_OBJECT_0 - 1]];
+		DWORD bytes = 0;
+		// no bytes means the buffer overflowed, and the changed
+		// files are not known
+		if (GetOverlappedResult(folder.hDirectory, &folder.overlapped, &bytes, FALSE) && (bytes > 0))
+		{
+			const unsigned char* data = (const unsigned char*)folder.buffer.data();
+			while (true)
+			{
+				const FILE_NOTIFY_INFORMATION* pInfo = (const FILE_NOTIFY_INFORMATION*)data;
+				if ((pInfo->Action == FILE_ACTION_ADDED) || (pInfo->Action == FILE_ACTION_MODIFIED) ||
+					(pInfo->Action == FILE_ACTION_RENAMED_NEW_NAME))
+				{
+					int wideLength = (int)(pInfo->FileNameLength / sizeof(WCHAR));
+					int length = WideCharToMultiByte(CP_UTF8, 0, pInfo->FileName, wideLength, NULL, 0, NULL, NULL);
+					std::string file(length, '\0');
+					WideCharToMultiByte(CP_UTF8, 0, pInfo->FileName, wideLength, &file[0], length, NULL, NULL);
+					RecordChange(folder.folder, file);
+				}
+				if (pInfo->NextEntryOffset == 0)
+				{
+					break;
+				}
+				data += pInfo->NextEntryOffset;
+			}
+		}
+
+		ReadDirectoryChangesW(folder.hDirectory, folder.buffer.data(), (DWORD)g_EventBufferSize, FALSE,
+			notifyFilter, NULL, &folder.overlapped, NULL);
+	}
+
+	// the pending reads must finish before their buffers are freed
+	for (size_t i = 0; i < watched.size(); i++)
+	{
+		if (watched[i].hDirectory == INVALID_HANDLE_VALUE)
+		{
+			continue;
+		}
+		DWORD bytes = 0;
+		CancelIoEx(watched[i].hDirectory, &watched[i].overlapped);
+		GetOverlappedResult(watched[i].hDirectory, &watched[i].overlapped, &bytes, TRUE);
+		CloseHandle(watched[i].overlapped.hEvent);
+		CloseHandle(watched[i].hDirectory);
+	}
+}
+#else
+void FileWatcher::WatchLoop()
+{
+	int inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify < 0)
+	{
+		std::cout << "Could not watch the asset folders for changes" << std::endl;
+		return;
+	}
+
+	// an editor either writes the file in place or renames a
+	// finished temporary file over it
+	std::map<int, std::string> folders;
+	for (size_t i = 0; i < m_folders.size(); i++)
+	{
+		int watch = inotify_add_watch(inotify, m_folders[i].c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (watch < 0)
+		{
+			std::cout << "Could not watch folder:" << m_folders[i] << std::endl;
+			continue;
+		}
+		folders[watch] = m_folders[i];
+	}
+
+	alignas(struct inotify_event) char buffer[g_EventBufferSize];
+	while (!m_bStopping)
+	{
+		pollfd descriptor = { inotify, POLLIN, 0 };
+		if (poll(&descriptor, 1, g_StopCheckMilliseconds) <= 0)
+		{
+			continue;
+		}
+
+		ssize_t length = read(inotify, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length; )
+		{
+			const struct inotify_event* pEvent = (const struct inotify_event*)(buffer + offset);
+			std::map<int, std::string>::const_iterator folder = folders.find(pEvent->wd);
+			if ((pEvent->len > 0) && (folder != folders.end()))
+			{
+				RecordChange(folder->second, pEvent->name);
+			}
+			offset += sizeof(struct inotify_event) + pEvent->len;
+		}
+	}
+
+	close(inotify);
+}
+#endif
+
+/***********************************************************
+ *  RecordChange()
+ *
+ *  This method is used for recording that a file in one of
+ *  the watched folders changed.  The temporary files of the
+ *  cache and pack writers are left out.
+ ***********************************************************/
+void FileWatcher::RecordChange(const std::string& folder, const std::string& file)
+{
+	std::string name = AssetPack::GetAssetName(folder + "/" + file);
+	if ((name.size() >= 4) && (name.compare(name.size() - 4, 4, ".tmp") == 0))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_changes[name] = std::chrono::steady_clock::now();
+}
+
+/***********************************************************
+ *  PollChanges()
+ *
+ *  This method is used for getting the files that changed
+ *  and have been left alone for the settling time since the
+ *  last poll.  Files still being written are reported by a
+ *  later poll.
+ ***********************************************************/
+void FileWatcher::PollChanges(std::vector<std::string>& changed)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<std::string, std::chrono::steady_clock::time_point>::iterator change = m_changes.begin();
+	while (change != m_changes.end())
+	{
+		if (now - change->second >= g_SettleTime)
+		{
+			changed.push_back(change->first);
+			change = m_changes.erase(change);
+		}
+		else
+		{
+			change++;
+		}
+	}
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.h
+// ============
+// watch asset folders for changed files on a background thread
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FileWatcher
+ *
+ *  This class contains the code for watching folders for
+ *  files that are written or renamed into place - through
+ *  inotify, or ReadDirectoryChangesW on Windows.  A watcher
+ *  thread sleeps until the operating system reports a
+ *  change.  Editors often save a file in several writes, so
+ *  a changed file is only reported once it has been left
+ *  alone for a short settling time.  Subfolders are not
+ *  watched.
+ ***********************************************************/
+class FileWatcher
+{
+public:
+	// constructor - starts watching the folders
+	FileWatcher(const std::vector<std::string>& folders);
+	// destructor
+	~FileWatcher();
+
+	// the watcher thread cannot be shared between two objects
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+private:
+	std::vector<std::string> m_folders;
+	std::thread m_thread;
+	std::atomic<bool> m_bStopping;
+#ifdef _WIN32
+	// signalled to wake the watcher thread when it should exit
+	void* m_hStopEvent;
+#endif
+
+	// changed files by asset name, and when each last changed
+	std::mutex m_mutex;
+	std::map<std::string, std::chrono::steady_clock::time_point> m_changes;
+
+	// the loop run by the watcher thread
+	void WatchLoop();
+	// record a change to a file in a watched folder
+	void RecordChange(const std::string& folder, const std::string& file);
+
+public:
+	// get the asset names of the files that changed and have settled
+	// since the last poll - never waits on the watcher thread
+	void PollChanges(std::vector<std::string>& changed);
+};
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.cpp
+// ============
+// decode texture image files, reducing JPEG files in the DCT domain when
+// only a smaller resolution is needed
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageDecoder.h"
+
+#include "AssetFile.h"
+#include "stb_image.h"
+
+#include <algorithm>
+
+#ifdef USE_LIBJPEG_TURBO
+#include <turbojpeg.h>
+#endif
+
+#ifdef USE_LIBJPEG_TURBO
+namespace
+{
+	// the smallest scale the JPEG decoder supports is 1/8
+	const int g_MaxScaledLevels = 3;
+
+	/***********************************************************
+	 *  DecodeScaledJpeg()
+	 *
+	 *  Decode a JPEG file at the scale of the levels it should
+	 *  skip, up to 1/8.  Returns false if the file is not a JPEG
+	 *  or libjpeg-turbo cannot decode it, so it can be handed
+	 *  to stb_image instead.
+	 ***********************************************************/
+	bool DecodeScaledJpeg(const AssetFile& file, int maxResolution, int minSkippedLevels, ImageDecoder::DECODED_IMAGE& image)
+	{
+		if ((file.GetSize() < 2) || (file.GetData()[0] != 0xFF) || (file.GetData()[1] != 0xD8))
+		{
+			return false;
+		}
+
+		tjhandle decompressor = tjInitDecompress();
+		if (decompressor == NULL)
+		{
+			return false;
+		}
+
+		int width = 0;
+		int height = 0;
+		int subsampling = 0;
+		int colorspace = 0;
+		unsigned char* jpegData = const_cast<unsigned char*>(file.GetData());
+		unsigned long jpegSize = (unsigned long)file.GetSize();
+		bool bDecoded = false;
+
+		if (tjDecompressHeader3(decompressor, jpegData, jpegSize, &width, &height, &subsampling, &colorspace) == 0)
+		{
+			image.skippedLevels = ImageDecoder::GetSkippedLevels(width, height, maxResolution, minSkippedLevels);
+
+			// reduce by as many of the skipped levels as the decoder
+			// supports
+			tjscalingfactor scale = { 1, 1 };
+			int factorCount = 0;
+			tjscalingfactor* factors = tjGetScalingFactors(&factorCount);
+			image.scaledLevels = 0;
+			for (int level = std::min(image.skippedLevels, g_MaxScaledLevels); (level > 0) && (image.scaledLevels == 0); level--)
+			{
+				for (int i = 0; (factors != NULL) && (i < factorCount); i++)
+				{
+					if ((factors[i].num == 1) && (factors[i].denom == (1 << level)))
+					{
+						scale = factors[i];
+						image.scaledLevels = level;
+					}
+				}
+			}
+
+			image.width = TJSCALED(width, scale);
+			image.height = TJSCALED(height, scale);
+			image.colorChannels = 3;
+			image.pixels = tjAlloc(image.width * image.height * 3);
+			image.bLibJpeg = true;
+			bDecoded = (image.pixels != NULL) &&
+				(tjDecompress2(decompressor, jpegData, jpegSize, image.pixels, image.width, 0, image.height, TJPF_RGB, 0) == 0);
+		}
+
+		tjDestroy(decompressor);
+		if (!bDecoded)
+		{
+			ImageDecoder::Free(image);
+		}
+
+		return bDecoded;
+	}
+}
+#endif
+
+/***********************************************************
+ *  GetSkippedLevels()
+ *
+ *  This method is used for getting the number of levels an
+ *  image skips - at least the minimum, and then as many as
+ *  it takes to fit in the max resolution.
+ ***********************************************************/
+int ImageDecoder::GetSkippedLevels(int width, int height, int maxResolution, int minSkippedLevels)
+{
+	int skipped = 0;
+
+	while (((width >> skipped) > 1) || ((height >> skipped) > 1))
+	{
+		int size = std::max(std::max(1, width >> skipped), std::max(1, height >> skipped));
+		if ((skipped >= minSkippedLevels) && ((maxResolution <= 0) || (size <= maxResolution)))
+		{
+			break;
+		}
+		skipped++;
+	}
+
+	return skipped;
+}
+
+/***********************************************************
+ *  Decode()
+ *
+ *  This method is used for decoding an image file at the
+ *  resolution it will be used at, as far as the decoder can
+ *  reduce it.  It can be run on a worker thread.
+ ***********************************************************/
+bool ImageDecoder::Decode(const std::string& filename, int maxResolution, int minSkippedLevels, DECODED_IMAGE& image)
+{
+	image.pixels = NULL;
+	image.width = 0;
+	image.height = 0;
+	image.colorChannels = 0;
+	image.skippedLevels = 0;
+	image.scaledLevels = 0;
+	image.bLibJpeg = false;
+
+	AssetFile file;
+	if (!file.Open(filename))
+	{
+		return false;
+	}
+
+#ifdef USE_LIBJPEG_TURBO
+	if (DecodeScaledJpeg(file, maxResolution, minSkippedLevels, image))
+	{
+		return true;
+	}
+#endif
+
+	// try to parse the image data from the mapped image file
+	image.pixels = stbi_load_from_memory(
+		file.GetData(),
+		(int)file.GetSize(),
+		&image.width,
+		&image.height,
+		&image.colorChannels,
+		0);
+	if (image.pixels == NULL)
+	{
+		return false;
+	}
+
+	image.skippedLevels = GetSkippedLevels(image.width, image.height, maxResolution, minSkippedLevels);
+	image.scaledLevels = 0;
+
+	return true;
+}
+
+/***********************************************************
+ *  Free()
+ *
+ *  This method is used for freeing the pixels of a decoded
+ *  image with the allocator of the decoder that made them.
+ ***********************************************************/
+void ImageDecoder::Free(DECODED_IMAGE& image)
+{
+#ifdef USE_LIBJPEG_TURBO
+	if (image.bLibJpeg)
+	{
+		tjFree(image.pixels);
+		image.pixels = NULL;
+		image.bLibJpeg = false;
+		return;
+	}
+#endif
+
+	stbi_image_free(image.pixels);
+	image.pixels = NULL;
+}
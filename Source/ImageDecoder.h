@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.h
+// ============
+// decode texture image files, reducing JPEG files in the DCT domain when
+// only a smaller resolution is needed
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+
+/***********************************************************
+ *  ImageDecoder
+ *
+ *  This class contains the code for decoding an image file
+ *  at the resolution it will be used at.  Each skipped level
+ *  halves the width and height.  When the project is built
+ *  with USE_LIBJPEG_TURBO defined and linked to turbojpeg,
+ *  JPEG files are decoded at 1/2, 1/4 or 1/8 scale straight
+ *  from their DCT coefficients, so the skipped levels are
+ *  never decoded.  Any other file, or any level beyond 1/8,
+ *  is decoded by stb_image and left for the caller to drop
+ *  while building the mips.
+ ***********************************************************/
+class ImageDecoder
+{
+public:
+	// a decoded image
+	struct DECODED_IMAGE
+	{
+		unsigned char* pixels;
+		int width;
+		int height;
+		int colorChannels;
+		// levels the image should lose, and how many of them the
+		// decoder already removed - the rest are still in the pixels
+		int skippedLevels;
+		int scaledLevels;
+		// true when the pixels were allocated by libjpeg-turbo
+		bool bLibJpeg;
+	};
+
+	// get the number of levels to skip so the image is no larger
+	// than the max resolution, 0 for no limit, and skips at least
+	// the minimum - a 1 x 1 image is never reduced further
+	static int GetSkippedLevels(int width, int height, int maxResolution, int minSkippedLevels);
+
+	// decode an image file, reducing it by the levels it should skip
+	static bool Decode(const std::string& filename, int maxResolution, int minSkippedLevels, DECODED_IMAGE& image);
+	// free the pixels of a decoded image
+	static void Free(DECODED_IMAGE& image);
+};
@@ -0,0 +1,862 @@
+///////////////////////////////////////////////////////////////////////////////
+// imageprocessing.cpp
+// ============
+// convert decoded images into the texel layout the GPU uses, with SSE2 and
+// AVX2 kernels for the per-texel work
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageProcessing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+// the SSE2 kernels are used whenever the target guarantees SSE2, and the
+// AVX2 kernels are compiled alongside them and picked at run time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IMAGE_PROCESSING_SSE2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles the AVX2 intrinsics without a target option
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	// source texels weighted by each Kaiser filtered texel, per axis
+	const int g_KaiserTaps = 8;
+	// shape of the Kaiser window - higher is smoother and blurrier
+	const float g_KaiserBeta = 4.0f;
+
+	// conversion tables between sRGB bytes and linear values
+	struct COLOR_TABLES
+	{
+		float toLinear[256];
+		unsigned char toSRGB[4096];
+
+		COLOR_TABLES()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = (float)i / 255.0f;
+				toLinear[i] = (c <= 0.04045f) ? (c / 12.92f) : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < 4096; i++)
+			{
+				float l = (float)i / 4095.0f;
+				float c = (l <= 0.0031308f) ? (l * 12.92f) : ((1.055f * std::pow(l, 1.0f / 2.4f)) - 0.055f);
+				toSRGB[i] = (unsigned char)std::min(255.0f, std::floor((c * 255.0f) + 0.5f));
+			}
+		}
+	};
+
+	const COLOR_TABLES& GetColorTables()
+	{
+		static const COLOR_TABLES tables;
+		return tables;
+	}
+
+	ImageProcessing::SIMDLevel DetectSIMDLevel()
+	{
+#ifdef IMAGE_PROCESSING_SSE2
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return ImageProcessing::sse2;
+		}
+		// AVX needs the OS to save the YMM registers
+		__cpuid(info, 1);
+		if (((info[2] & (1 << 27)) == 0) || ((info[2] & (1 << 28)) == 0) || ((_xgetbv(0) & 6) != 6))
+		{
+			return ImageProcessing::sse2;
+		}
+		__cpuidex(info, 7, 0);
+		return ((info[1] & (1 << 5)) != 0) ? ImageProcessing::avx2 : ImageProcessing::sse2;
+#else
+		return __builtin_cpu_supports("avx2") ? ImageProcessing::avx2 : ImageProcessing::sse2;
+#endif
+#else
+		return ImageProcessing::scalar;
+#endif
+	}
+
+	ImageProcessing::SIMDLevel GetSupportedSIMDLevel()
+	{
+		static const ImageProcessing::SIMDLevel supported = DetectSIMDLevel();
+		return supported;
+	}
+
+	std::atomic<int> g_RequestedSIMDLevel(ImageProcessing::avx2);
+
+	// the SIMD kernels process what fits their registers and return the
+	// number of elements done - the scalar kernels finish the rest
+
+	void SwapBytesScalar(unsigned char* a, unsigned char* b, size_t start, size_t count)
+	{
+		for (size_t i = start; i < count; i++)
+		{
+			std::swap(a[i], b[i]);
+		}
+	}
+
+	void ExpandRGBToRGBAScalar(const unsigned char* source, unsigned char* target, size_t start, size_t count)
+	{
+		for (size_t i = start; i < count; i++)
+		{
+			target[(i * 4) + 0] = source[(i * 3) + 0];
+			target[(i * 4) + 1] = source[(i * 3) + 1];
+			target[(i * 4) + 2] = source[(i * 3) + 2];
+			target[(i * 4) + 3] = 255;
+		}
+	}
+
+	void LinearToSRGBScalar(const float* source, unsigned char* target, size_t start, size_t count)
+	{
+		const COLOR_TABLES& tables = GetColorTables();
+		for (size_t i = start; i < count; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				float value = std::min(std::max(source[(i * 4) + c], 0.0f), 1.0f);
+				target[(i * 4) + c] = tables.toSRGB[(int)((value * 4095.0f) + 0.5f)];
+			}
+			float alpha = std::min(std::max(source[(i * 4) + 3], 0.0f), 1.0f);
+			target[(i * 4) + 3] = (unsigned char)((alpha * 255.0f) + 0.5f);
+		}
+	}
+
+	void PremultiplyAlphaScalar(float* pixels, size_t start, size_t count)
+	{
+		for (size_t i = start; i < count; i++)
+		{
+			pixels[(i * 4) + 0] *= pixels[(i * 4) + 3];
+			pixels[(i * 4) + 1] *= pixels[(i * 4) + 3];
+			pixels[(i * 4) + 2] *= pixels[(i * 4) + 3];
+		}
+	}
+
+	void DownsampleBoxRowScalar(const float* row0, const float* row1, int width, int start, int targetWidth, float* target)
+	{
+		for (int x = start; x < targetWidth; x++)
+		{
+			int x0 = std::min(x * 2, width - 1);
+			int x1 = std::min((x * 2) + 1, width - 1);
+			for (int c = 0; c < 4; c++)
+			{
+				target[(x * 4) + c] = 0.25f * (row0[(x0 * 4) + c] + row0[(x1 * 4) + c] + row1[(x0 * 4) + c] + row1[(x1 * 4) + c]);
+			}
+		}
+	}
+
+	void AccumulateRowScalar(const float* source, float weight, float* target, size_t start, size_t count)
+	{
+		for (size_t i = start; i < count; i++)
+		{
+			target[i] += weight * source[i];
+		}
+	}
+
+#ifdef IMAGE_PROCESSING_SSE2
+	size_t SwapBytesSSE2(unsigned char* a, unsigned char* b, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i rowA = _mm_loadu_si128((const __m128i*)(a + i));
+			__m128i rowB = _mm_loadu_si128((const __m128i*)(b + i));
+			_mm_storeu_si128((__m128i*)(a + i), rowB);
+			_mm_storeu_si128((__m128i*)(b + i), rowA);
+		}
+		return i;
+	}
+
+	AVX2_FUNCTION size_t SwapBytesAVX2(unsigned char* a, unsigned char* b, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			__m256i rowA = _mm256_loadu_si256((const __m256i*)(a + i));
+			__m256i rowB = _mm256_loadu_si256((const __m256i*)(b + i));
+			_mm256_storeu_si256((__m256i*)(a + i), rowB);
+			_mm256_storeu_si256((__m256i*)(b + i), rowA);
+		}
+		return i;
+	}
+
+	// SSE2 has no byte shuffle, so the expansion needs the SSSE3 shuffle
+	// that every AVX2 CPU has - eight pixels are read as two overlapping
+	// 16 byte loads, one per lane
+	AVX2_FUNCTION size_t ExpandRGBToRGBAAVX2(const unsigned char* source, unsigned char* target, size_t count)
+	{
+		const __m256i shuffle = _mm256_setr_epi8(
+			0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+			0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+		size_t i = 0;
+
+		// the second load reads 4 bytes past the 24 that are used
+		for (; (i * 3) + 28 <= count * 3; i += 8)
+		{
+			__m128i low = _mm_loadu_si128((const __m128i*)(source + (i * 3)));
+			__m128i high = _mm_loadu_si128((const __m128i*)(source + (i * 3) + 12));
+			__m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+			pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha);
+			_mm256_storeu_si256((__m256i*)(target + (i * 4)), pixels);
+		}
+		return i;
+	}
+
+	// the table lookups stay scalar, the clamping and scaling of the
+	// four channels into table indices is done at once
+	size_t LinearToSRGBSSE2(const float* source, unsigned char* target, size_t count)
+	{
+		const COLOR_TABLES& tables = GetColorTables();
+		const __m128 scale = _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		alignas(16) int indices[4];
+
+		for (size_t i = 0; i < count; i++)
+		{
+			__m128 pixel = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + (i * 4)), zero), one);
+			_mm_store_si128((__m128i*)indices, _mm_cvtps_epi32(_mm_mul_ps(pixel, scale)));
+			target[(i * 4) + 0] = tables.toSRGB[indices[0]];
+			target[(i * 4) + 1] = tables.toSRGB[indices[1]];
+			target[(i * 4) + 2] = tables.toSRGB[indices[2]];
+			target[(i * 4) + 3] = (unsigned char)indices[3];
+		}
+		return count;
+	}
+
+	size_t PremultiplyAlphaSSE2(float* pixels, size_t count)
+	{
+		const __m128 colorMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+
+		for (size_t i = 0; i < count; i++)
+		{
+			__m128 pixel = _mm_loadu_ps(pixels + (i * 4));
+			__m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 premultiplied = _mm_mul_ps(pixel, alpha);
+			pixel = _mm_or_ps(_mm_and_ps(colorMask, premultiplied), _mm_andnot_ps(colorMask, pixel));
+			_mm_storeu_ps(pixels + (i * 4), pixel);
+		}
+		return count;
+	}
+
+	AVX2_FUNCTION size_t PremultiplyAlphaAVX2(float* pixels, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			__m256 pixel = _mm256_loadu_ps(pixels + (i * 4));
+			__m256 alpha = _mm256_permute_ps(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+			// keep the alpha lane of both pixels
+			pixel = _mm256_blend_ps(_mm256_mul_ps(pixel, alpha), pixel, 0x88);
+			_mm256_storeu_ps(pixels + (i * 4), pixel);
+		}
+		return i;
+	}
+
+	// a texel of the row is one register, so a target texel is the
+	// sum of four loads
+	int DownsampleBoxRowSSE2(const float* row0, const float* row1, int targetWidth, float* target)
+	{
+		const __m128 quarter = _mm_set1_ps(0.25f);
+
+		for (int x = 0; x < targetWidth; x++)
+		{
+			__m128 sum = _mm_add_ps(
+				_mm_add_ps(_mm_loadu_ps(row0 + (x * 8)), _mm_loadu_ps(row0 + (x * 8) + 4)),
+				_mm_add_ps(_mm_loadu_ps(row1 + (x * 8)), _mm_loadu_ps(row1 + (x * 8) + 4)));
+			_mm_storeu_ps(target + (x * 4), _mm_mul_ps(sum, quarter));
+		}
+		return targetWidth;
+	}
+
+	// two target texels at a time - the vertical sums of four source
+	// texels are regrouped across the lanes into horizontal pairs
+	AVX2_FUNCTION int DownsampleBoxRowAVX2(const float* row0, const float* row1, int targetWidth, float* target)
+	{
+		const __m256 quarter = _mm256_set1_ps(0.25f);
+		int x = 0;
+
+		for (; x + 2 <= targetWidth; x += 2)
+		{
+			__m256 first = _mm256_add_ps(_mm256_loadu_ps(row0 + (x * 8)), _mm256_loadu_ps(row1 + (x * 8)));
+			__m256 second = _mm256_add_ps(_mm256_loadu_ps(row0 + (x * 8) + 8), _mm256_loadu_ps(row1 + (x * 8) + 8));
+			__m256 even = _mm256_permute2f128_ps(first, second, 0x20);
+			__m256 odd = _mm256_permute2f128_ps(first, second, 0x31);
+			_mm256_storeu_ps(target + (x * 4), _mm256_mul_ps(_mm256_add_ps(even, odd), quarter));
+		}
+		return x;
+	}
+
+	size_t AccumulateRowSSE2(const float* source, float weight, float* target, size_t count)
+	{
+		const __m128 scale = _mm_set1_ps(weight);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(target + i, _mm_add_ps(_mm_loadu_ps(target + i), _mm_mul_ps(scale, _mm_loadu_ps(source + i))));
+		}
+		return i;
+	}
+
+	AVX2_FUNCTION size_t AccumulateRowAVX2(const float* source, float weight, float* target, size_t count)
+	{
+		const __m256 scale = _mm256_set1_ps(weight);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_ps(target + i, _mm256_add_ps(_mm256_loadu_ps(target + i), _mm256_mul_ps(scale, _mm256_loadu_ps(source + i))));
+		}
+		return i;
+	}
+#endif
+
+	// add a weighted source row into a target row
+	void AccumulateRow(const float* source, float weight, float* target, size_t count, ImageProcessing::SIMDLevel level)
+	{
+		size_t done = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+		if (level == ImageProcessing::avx2)
+		{
+			done = AccumulateRowAVX2(source, weight, target, count);
+		}
+		else if (level == ImageProcessing::sse2)
+		{
+			done = AccumulateRowSSE2(source, weight, target, count);
+		}
+#endif
+		AccumulateRowScalar(source, weight, target, done, count);
+	}
+
+	// zeroth order modified Bessel function of the first kind
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 20; k++)
+		{
+			term *= (x / (2.0f * (float)k)) * (x / (2.0f * (float)k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// the source texels and weights of every target texel along one
+	// axis, for a Kaiser windowed sinc at the target sampling rate
+	void BuildKaiserTaps(int sourceSize, int targetSize, std::vector<int>& indices, std::vector<float>& weights)
+	{
+		const float pi = 3.14159265f;
+		float scale = (float)sourceSize / (float)targetSize;
+		float radius = (float)g_KaiserTaps / (2.0f * scale);
+
+		indices.resize((size_t)targetSize * g_KaiserTaps);
+		weights.resize((size_t)targetSize * g_KaiserTaps);
+
+		for (int t = 0; t < targetSize; t++)
+		{
+			float center = (((float)t + 0.5f) * scale) - 0.5f;
+			int first = (int)std::floor(center) - (g_KaiserTaps / 2) + 1;
+			float total = 0.0f;
+
+			for (int k = 0; k < g_KaiserTaps; k++)
+			{
+				int index = first + k;
+				float distance = ((float)index - center) / scale;
+				float sinc = (std::fabs(distance) < 1e-5f) ? 1.0f : (std::sin(pi * distance) / (pi * distance));
+				float ratio = distance / radius;
+				float window = (std::fabs(ratio) < 1.0f) ? (BesselI0(g_KaiserBeta * std::sqrt(1.0f - (ratio * ratio))) / BesselI0(g_KaiserBeta)) : 0.0f;
+
+				// wrap like a repeating texture
+				indices[((size_t)t * g_KaiserTaps) + k] = ((index % sourceSize) + sourceSize) % sourceSize;
+				weights[((size_t)t * g_KaiserTaps) + k] = sinc * window;
+				total += sinc * window;
+			}
+			for (int k = 0; k < g_KaiserTaps; k++)
+			{
+				weights[((size_t)t * g_KaiserTaps) + k] /= total;
+			}
+		}
+	}
+
+	const char* GetSIMDLevelName(ImageProcessing::SIMDLevel level)
+	{
+		switch (level)
+		{
+		case ImageProcessing::avx2:
+			return "AVX2";
+		case ImageProcessing::sse2:
+			return "SSE2";
+		default:
+			return "scalar";
+		}
+	}
+}
+
+/***********************************************************
+ *  GetSIMDLevel()
+ *
+ *  This method is used for getting the instruction set the
+ *  kernels use - the requested one, limited to what the CPU
+ *  supports.
+ ***********************************************************/
+ImageProcessing::SIMDLevel ImageProcessing::GetSIMDLevel()
+{
+	return (SIMDLevel)std::min((int)g_RequestedSIMDLevel, (int)GetSupportedSIMDLevel());
+}
+
+/***********************************************************
+ *  SetSIMDLevel()
+ *
+ *  This method is used for limiting the instruction set the
+ *  kernels use, for comparing them.
+ ***********************************************************/
+void ImageProcessing::SetSIMDLevel(SIMDLevel level)
+{
+	g_RequestedSIMDLevel = level;
+}
+
+/***********************************************************
+ *  FlipVertical()
+ *
+ *  This method is used for swapping the rows of an image in
+ *  place, so the first row is the bottom of the image as
+ *  OpenGL expects.
+ ***********************************************************/
+void ImageProcessing::FlipVertical(unsigned char* pixels, size_t rowBytes, int height)
+{
+	SIMDLevel level = GetSIMDLevel();
+
+	for (int y = 0; y < height / 2; y++)
+	{
+		unsigned char* top = pixels + ((size_t)y * rowBytes);
+		unsigned char* bottom = pixels + ((size_t)(height - 1 - y) * rowBytes);
+		size_t done = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+		if (level == avx2)
+		{
+			done = SwapBytesAVX2(top, bottom, rowBytes);
+		}
+		else if (level == sse2)
+		{
+			done = SwapBytesSSE2(top, bottom, rowBytes);
+		}
+#endif
+		SwapBytesScalar(top, bottom, done, rowBytes);
+	}
+}
+
+/***********************************************************
+ *  ExpandRGBToRGBA()
+ *
+ *  This method is used for adding an opaque alpha channel to
+ *  RGB pixels, so every row is 4 byte aligned and matches
+ *  the texture format without a conversion in the driver.
+ ***********************************************************/
+void ImageProcessing::ExpandRGBToRGBA(const unsigned char* source, unsigned char* target, size_t pixelCount)
+{
+	size_t done = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+	if (GetSIMDLevel() == avx2)
+	{
+		done = ExpandRGBToRGBAAVX2(source, target, pixelCount);
+	}
+#endif
+	ExpandRGBToRGBAScalar(source, target, done, pixelCount);
+}
+
+/***********************************************************
+ *  SRGBToLinear()
+ *
+ *  This method is used for converting sRGB encoded colors
+ *  into linear values for filtering.  Every byte has its own
+ *  table entry, which is faster than any arithmetic, so this
+ *  kernel has no SIMD version.
+ ***********************************************************/
+void ImageProcessing::SRGBToLinear(const unsigned char* source, float* target, size_t pixelCount)
+{
+	const COLOR_TABLES& tables = GetColorTables();
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		target[(i * 4) + 0] = tables.toLinear[source[(i * 4) + 0]];
+		target[(i * 4) + 1] = tables.toLinear[source[(i * 4) + 1]];
+		target[(i * 4) + 2] = tables.toLinear[source[(i * 4) + 2]];
+		target[(i * 4) + 3] = (float)source[(i * 4) + 3] * (1.0f / 255.0f);
+	}
+}
+
+/***********************************************************
+ *  LinearToSRGB()
+ *
+ *  This method is used for converting linear colors back
+ *  into sRGB encoded bytes, through a table fine enough to
+ *  stay within one step of the exact encoding.
+ ***********************************************************/
+void ImageProcessing::LinearToSRGB(const float* source, unsigned char* target, size_t pixelCount)
+{
+	size_t done = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+	if (GetSIMDLevel() != scalar)
+	{
+		done = LinearToSRGBSSE2(source, target, pixelCount);
+	}
+#endif
+	LinearToSRGBScalar(source, target, done, pixelCount);
+}
+
+/***********************************************************
+ *  PremultiplyAlpha()
+ *
+ *  This method is used for multiplying the colors by their
+ *  alpha, so transparent texels add no color when they are
+ *  filtered together with opaque ones.
+ ***********************************************************/
+void ImageProcessing::PremultiplyAlpha(float* pixels, size_t pixelCount)
+{
+	size_t done = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+	SIMDLevel level = GetSIMDLevel();
+	if (level == avx2)
+	{
+		done = PremultiplyAlphaAVX2(pixels, pixelCount);
+	}
+	else if (level == sse2)
+	{
+		done = PremultiplyAlphaSSE2(pixels, pixelCount);
+	}
+#endif
+	PremultiplyAlphaScalar(pixels, done, pixelCount);
+}
+
+/***********************************************************
+ *  DownsampleBox()
+ *
+ *  This method is used for building the next mip level by
+ *  averaging each 2x2 group of texels.  Odd edges reuse
+ *  their last texel.
+ ***********************************************************/
+void ImageProcessing::DownsampleBox(const float* source, int width, int height, float* target)
+{
+	int targetWidth = std::max(1, width / 2);
+	int targetHeight = std::max(1, height / 2);
+	SIMDLevel level = GetSIMDLevel();
+
+	for (int y = 0; y < targetHeight; y++)
+	{
+		const float* row0 = source + ((size_t)std::min(y * 2, height - 1) * width * 4);
+		const float* row1 = source + ((size_t)std::min((y * 2) + 1, height - 1) * width * 4);
+		float* targetRow = target + ((size_t)y * targetWidth * 4);
+		int done = 0;
+
+#ifdef IMAGE_PROCESSING_SSE2
+		// the SIMD kernels need a pair of texels for every target texel
+		if (width >= 2)
+		{
+			if (level == avx2)
+			{
+				done = DownsampleBoxRowAVX2(row0, row1, targetWidth, targetRow);
+			}
+			if (level >= sse2)
+			{
+				done += DownsampleBoxRowSSE2(row0 + (done * 8), row1 + (done * 8), targetWidth - done, targetRow + (done * 4));
+			}
+		}
+#endif
+		DownsampleBoxRowScalar(row0, row1, width, done, targetWidth, targetRow);
+	}
+}
+
+/***********************************************************
+ *  DownsampleKaiser()
+ *
+ *  This method is used for building the next mip level with
+ *  a Kaiser windowed sinc filter, which keeps more detail
+ *  than the box filter without aliasing.  The filter runs
+ *  across the rows one texel per register, then down the
+ *  columns a whole row at a time.
+ ***********************************************************/
+void ImageProcessing::DownsampleKaiser(const float* source, int width, int height, float* target)
+{
+	int targetWidth = std::max(1, width / 2);
+	int targetHeight = std::max(1, height / 2);
+	SIMDLevel level = GetSIMDLevel();
+	std::vector<int> columns;
+	std::vector<float> columnWeights;
+	std::vector<int> rows;
+	std::vector<float> rowWeights;
+	std::vector<float> filteredRows((size_t)targetWidth * height * 4);
+
+	BuildKaiserTaps(width, targetWidth, columns, columnWeights);
+	BuildKaiserTaps(height, targetHeight, rows, rowWeights);
+
+	for (int y = 0; y < height; y++)
+	{
+		const float* sourceRow = source + ((size_t)y * width * 4);
+		float* filteredRow = &filteredRows[(size_t)y * targetWidth * 4];
+
+		for (int x = 0; x < targetWidth; x++)
+		{
+			const int* taps = &columns[(size_t)x * g_KaiserTaps];
+			const float* weights = &columnWeights[(size_t)x * g_KaiserTaps];
+#ifdef IMAGE_PROCESSING_SSE2
+			if (level != scalar)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (int k = 0; k < g_KaiserTaps; k++)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(sourceRow + (taps[k] * 4))));
+				}
+				_mm_storeu_ps(filteredRow + (x * 4), sum);
+				continue;
+			}
+#endif
+			for (int c = 0; c < 4; c++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < g_KaiserTaps; k++)
+				{
+					sum += weights[k] * sourceRow[(taps[k] * 4) + c];
+				}
+				filteredRow[(x * 4) + c] = sum;
+			}
+		}
+	}
+
+	size_t rowFloats = (size_t)targetWidth * 4;
+	for (int y = 0; y < targetHeight; y++)
+	{
+		float* targetRow = target + ((size_t)y * rowFloats);
+		std::fill(targetRow, targetRow + rowFloats, 0.0f);
+		for (int k = 0; k < g_KaiserTaps; k++)
+		{
+			const float* filteredRow = &filteredRows[(size_t)rows[((size_t)y * g_KaiserTaps) + k] * rowFloats];
+			AccumulateRow(filteredRow, rowWeights[((size_t)y * g_KaiserTaps) + k], targetRow, rowFloats, level);
+		}
+	}
+}
+
+/***********************************************************
+ *  Process()
+ *
+ *  This method is used for converting a decoded image into
+ *  the RGBA mip chain a texture is created from.  The rows
+ *  are flipped and expanded to RGBA first, then the mip
+ *  levels are filtered in linear space - averaging the sRGB
+ *  values directly would darken every level - and encoded
+ *  back to sRGB bytes.  Skipped levels are filtered but not
+ *  kept.
+ ***********************************************************/
+bool ImageProcessing::Process(
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int colorChannels,
+	const PROCESS_OPTIONS& options,
+	PROCESSED_IMAGE& image)
+{
+	if ((pixels == NULL) || (width <= 0) || (height <= 0) || ((colorChannels != 3) && (colorChannels != 4)))
+	{
+		return false;
+	}
+
+	// the size of every level down to the last one kept
+	std::vector<IMAGE_LEVEL> allLevels;
+	int skipLevels = 0;
+	int levelWidth = width;
+	int levelHeight = height;
+	while (true)
+	{
+		IMAGE_LEVEL level;
+		level.offset = 0;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		allLevels.push_back(level);
+
+		bool bLast = (levelWidth == 1) && (levelHeight == 1);
+		if (!bLast && (skipLevels < options.skipLevels))
+		{
+			skipLevels++;
+		}
+		else if (bLast || ((options.maxLevels > 0) && ((int)allLevels.size() - skipLevels >= options.maxLevels)))
+		{
+			break;
+		}
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+
+	// lay out the kept levels one after another
+	image.width = allLevels[skipLevels].width;
+	image.height = allLevels[skipLevels].height;
+	image.bAlpha = (colorChannels == 4);
+	image.levels.assign(allLevels.begin() + skipLevels, allLevels.end());
+	size_t offset = 0;
+	for (size_t i = 0; i < image.levels.size(); i++)
+	{
+		image.levels[i].offset = offset;
+		offset += (size_t)image.levels[i].width * image.levels[i].height * 4;
+	}
+	image.texels.resize(offset);
+
+	// the first level is converted in place when it is kept
+	size_t pixelCount = (size_t)width * height;
+	std::vector<unsigned char> firstLevel;
+	unsigned char* texels = image.texels.data();
+	if (skipLevels > 0)
+	{
+		firstLevel.resize(pixelCount * 4);
+		texels = firstLevel.data();
+	}
+
+	if (colorChannels == 3)
+	{
+		ExpandRGBToRGBA(pixels, texels, pixelCount);
+	}
+	else
+	{
+		memcpy(texels, pixels, pixelCount * 4);
+	}
+
+	if (options.bFlipVertical)
+	{
+		FlipVertical(texels, (size_t)width * 4, height);
+	}
+
+	if ((allLevels.size() == 1) && !options.bPremultiplyAlpha)
+	{
+		return true;
+	}
+
+	std::vector<float> linear(pixelCount * 4);
+	std::vector<float> next;
+	SRGBToLinear(texels, linear.data(), pixelCount);
+	if (options.bPremultiplyAlpha)
+	{
+		PremultiplyAlpha(linear.data(), pixelCount);
+		if (skipLevels == 0)
+		{
+			LinearToSRGB(linear.data(), texels, pixelCount);
+		}
+	}
+	// a skipped first level is not needed past its conversion
+	std::vector<unsigned char>().swap(firstLevel);
+
+	for (size_t i = 1; i < allLevels.size(); i++)
+	{
+		const IMAGE_LEVEL& previous = allLevels[i - 1];
+		const IMAGE_LEVEL& level = allLevels[i];
+		next.resize((size_t)level.width * level.height * 4);
+
+		if (options.mipFilter == kaiser)
+		{
+			DownsampleKaiser(linear.data(), previous.width, previous.height, next.data());
+		}
+		else
+		{
+			DownsampleBox(linear.data(), previous.width, previous.height, next.data());
+		}
+		if ((int)i >= skipLevels)
+		{
+			LinearToSRGB(next.data(), &image.texels[image.levels[i - skipLevels].offset], (size_t)level.width * level.height);
+		}
+		linear.swap(next);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  RunBenchmarks()
+ *
+ *  This method is used for timing every kernel on a 2048 x
+ *  2048 image with each instruction set the CPU supports,
+ *  and printing the throughput of the source data in MB/s.
+ ***********************************************************/
+void ImageProcessing::RunBenchmarks()
+{
+	const int size = 2048;
+	const int repeats = 5;
+	const size_t pixelCount = (size_t)size * size;
+	std::vector<unsigned char> rgb(pixelCount * 3);
+	std::vector<unsigned char> rgba(pixelCount * 4);
+	std::vector<float> linear(pixelCount * 4);
+	std::vector<float> half(pixelCount);
+	int requested = g_RequestedSIMDLevel;
+
+	// a repeatable noise image
+	unsigned int seed = 12345;
+	for (size_t i = 0; i < rgb.size(); i++)
+	{
+		seed = (seed * 1103515245u) + 12345u;
+		rgb[i] = (unsigned char)(seed >> 16);
+	}
+	ExpandRGBToRGBA(rgb.data(), rgba.data(), pixelCount);
+	SRGBToLinear(rgba.data(), linear.data(), pixelCount);
+
+	// run a kernel once to warm the caches, then time the repeats
+	auto measure = [repeats](size_t bytes, const std::function<void()>& kernel)
+	{
+		kernel();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < repeats; i++)
+		{
+			kernel();
+		}
+		std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+		return ((double)bytes * repeats) / (seconds.count() * 1024.0 * 1024.0);
+	};
+
+	std::cout << "\n***** IMAGE PROCESSING THROUGHPUT (" << size << " x " << size << ", MB/s of source data): *****\n";
+	std::cout << std::left << std::setw(20) << "kernel";
+	for (int level = scalar; level <= (int)GetSupportedSIMDLevel(); level++)
+	{
+		std::cout << std::right << std::setw(10) << GetSIMDLevelName((SIMDLevel)level);
+	}
+	std::cout << "\n";
+
+	struct BENCHMARK
+	{
+		const char* name;
+		size_t bytes;
+		std::function<void()> kernel;
+	};
+	const BENCHMARK benchmarks[] =
+	{
+		{ "flip vertical", pixelCount * 4, [&]() { FlipVertical(rgba.data(), (size_t)size * 4, size); } },
+		{ "rgb to rgba", pixelCount * 3, [&]() { ExpandRGBToRGBA(rgb.data(), rgba.data(), pixelCount); } },
+		{ "srgb to linear", pixelCount * 4, [&]() { SRGBToLinear(rgba.data(), linear.data(), pixelCount); } },
+		{ "linear to srgb", pixelCount * 16, [&]() { LinearToSRGB(linear.data(), rgba.data(), pixelCount); } },
+		{ "premultiply alpha", pixelCount * 16, [&]() { PremultiplyAlpha(linear.data(), pixelCount); } },
+		{ "box downsample", pixelCount * 16, [&]() { DownsampleBox(linear.data(), size, size, half.data()); } },
+		{ "kaiser downsample", pixelCount * 16, [&]() { DownsampleKaiser(linear.data(), size, size, half.data()); } }
+	};
+
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+	{
+		std::cout << std::left << std::setw(20) << benchmarks[i].name;
+		for (int level = scalar; level <= (int)GetSupportedSIMDLevel(); level++)
+		{
+			SetSIMDLevel((SIMDLevel)level);
+			double throughput = measure(benchmarks[i].bytes, benchmarks[i].kernel);
+			std::cout << std::right << std::setw(10) << std::fixed << std::setprecision(0) << throughput;
+		}
+		std::cout << "\n";
+	}
+	std::cout << std::flush;
+
+	g_RequestedSIMDLevel = requested;
+}
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// imageprocessing.h
+// ============
+// convert decoded images into the texel layout the GPU uses, with SSE2 and
+// AVX2 kernels for the per-texel work
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  ImageProcessing
+ *
+ *  This class contains the kernels for preparing decoded
+ *  images on the worker threads - flipping the rows, adding
+ *  the alpha channel, converting between sRGB and linear,
+ *  premultiplying the alpha and downsampling the mip levels.
+ *  Each kernel picks the widest instruction set the CPU
+ *  supports when it is called.  Process() runs them in order
+ *  and produces the RGBA mip chain the texture is created
+ *  from, so the driver never has to convert the data.
+ ***********************************************************/
+class ImageProcessing
+{
+public:
+	enum MipFilter
+	{
+		box,
+		kaiser
+	};
+
+	enum SIMDLevel
+	{
+		scalar,
+		sse2,
+		avx2
+	};
+
+	struct PROCESS_OPTIONS
+	{
+		// flip the rows so the first row is the bottom of the image
+		bool bFlipVertical;
+		// multiply the colors by the alpha before filtering
+		bool bPremultiplyAlpha;
+		MipFilter mipFilter;
+		// number of levels to build, 0 builds the full chain
+		int maxLevels;
+		// number of largest levels left out, for images decoded at a
+		// higher resolution than they are used at
+		int skipLevels;
+	};
+
+	struct IMAGE_LEVEL
+	{
+		size_t offset;
+		int width;
+		int height;
+	};
+
+	// an RGBA mip chain, largest level first
+	struct PROCESSED_IMAGE
+	{
+		int width;
+		int height;
+		// true when the source image had an alpha channel
+		bool bAlpha;
+		std::vector<IMAGE_LEVEL> levels;
+		std::vector<unsigned char> texels;
+	};
+
+	// get the instruction set the kernels use
+	static SIMDLevel GetSIMDLevel();
+	// limit the instruction set, never above what the CPU supports
+	static void SetSIMDLevel(SIMDLevel level);
+
+	// swap the rows of an image in place
+	static void FlipVertical(unsigned char* pixels, size_t rowBytes, int height);
+	// add an opaque alpha channel to RGB pixels
+	static void ExpandRGBToRGBA(const unsigned char* source, unsigned char* target, size_t pixelCount);
+	// convert sRGB RGBA bytes into linear RGBA floats - alpha is linear
+	static void SRGBToLinear(const unsigned char* source, float* target, size_t pixelCount);
+	// convert linear RGBA floats into sRGB RGBA bytes
+	static void LinearToSRGB(const float* source, unsigned char* target, size_t pixelCount);
+	// multiply the colors of linear RGBA pixels by their alpha
+	static void PremultiplyAlpha(float* pixels, size_t pixelCount);
+	// halve a linear RGBA image by averaging 2x2 texels
+	static void DownsampleBox(const float* source, int width, int height, float* target);
+	// halve a linear RGBA image with a Kaiser windowed sinc, wrapping
+	// at the edges like a repeating texture
+	static void DownsampleKaiser(const float* source, int width, int height, float* target);
+
+	// convert a decoded RGB or RGBA image into an RGBA mip chain,
+	// returns false for any other number of channels
+	static bool Process(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int colorChannels,
+		const PROCESS_OPTIONS& options,
+		PROCESSED_IMAGE& image);
+
+	// print the throughput of every kernel on every instruction set
+	static void RunBenchmarks();
+};
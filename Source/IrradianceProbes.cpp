@@ -0,0 +1,799 @@
+///////////////////////////////////////////////////////////////////////////////
+// irradianceprobes.cpp
+// ============
+// bake the ambient light of the scene into a grid of spherical harmonics
+// probes, for lighting the objects that are not baked
+///////////////////////////////////////////////////////////////////////////////
+
+#include "IrradianceProbes.h"
+
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+	// the texture unit of the probes, after the occlusion of the vertices
+	const int g_ProbeTextureUnit = 25;
+	// world distance between two probes, which grows when the scene would
+	// take more probes along an axis than the limit
+	const float g_ProbeSpacing = 1.0f;
+	const int g_MaxProbesPerAxis = 32;
+	// rays a probe gathers its light with, four to a packet
+	const int g_ProbeRays = 64;
+	// share of the rays of a probe that may hit the back of a surface
+	// before the probe is taken to be inside an object
+	const float g_MaxBackFaceShare = 0.25f;
+	// world distance around a changed object within which the probes
+	// are baked again
+	const float g_ChangeReach = 3.0f;
+	// light below which a spot light no longer reaches a probe
+	const float g_MinLight = 1.0f / 256.0f;
+	// probes a bake job gathers the light of
+	const size_t g_ProbesPerJob = 64;
+	const float g_MaxRayDistance = 1.0e4f;
+	const float g_Pi = 3.14159265358979f;
+
+	// the second order spherical harmonics of a direction
+	void EvaluateHarmonics(const glm::vec3& direction, float harmonics[9])
+	{
+		harmonics[0] = 0.282095f;
+		harmonics[1] = 0.488603f * direction.y;
+		harmonics[2] = 0.488603f * direction.z;
+		harmonics[3] = 0.488603f * direction.x;
+		harmonics[4] = 1.092548f * direction.x * direction.y;
+		harmonics[5] = 1.092548f * direction.y * direction.z;
+		harmonics[6] = 0.315392f * ((3.0f * direction.z * direction.z) - 1.0f);
+		harmonics[7] = 1.092548f * direction.x * direction.z;
+		harmonics[8] = 0.546274f * ((direction.x * direction.x) - (direction.y * direction.y));
+	}
+
+	// the rays of a probe, spread evenly over the sphere on a spiral
+	glm::vec3 GetSphereRay(int ray, int rayCount)
+	{
+		const float goldenAngle = g_Pi * (3.0f - std::sqrt(5.0f));
+		float z = 1.0f - ((2.0f * (float)ray + 1.0f) / (float)rayCount);
+		float radius = std::sqrt(std::max(0.0f, 1.0f - (z * z)));
+		float angle = goldenAngle * (float)ray;
+		return glm::vec3(std::cos(angle) * radius, std::sin(angle) * radius, z);
+	}
+
+	// the hash of a single light
+	uint64_t HashLight(const LightmapBaker::BAKED_LIGHT& light)
+	{
+		return LightmapBaker::HashLights(std::vector<LightmapBaker::BAKED_LIGHT>(1, light));
+	}
+
+	// the distance a spot light reaches before its light fades below the
+	// limit, infinite when it does not fade
+	float GetLightReach(const LightmapBaker::BAKED_LIGHT& light)
+	{
+		float brightest = std::max(std::max(light.ambient.x, light.ambient.y), light.ambient.z);
+		brightest = std::max(brightest, std::max(std::max(light.diffuse.x, light.diffuse.y), light.diffuse.z));
+		// the distance where constant + linear d + quadratic d^2 reaches
+		// the brightest value over the limit
+		float target = (brightest / g_MinLight) - light.constant;
+		if (target <= 0.0f)
+		{
+			return 0.0f;
+		}
+		if (light.quadratic > 0.0f)
+		{
+			return (-light.linear + std::sqrt((light.linear * light.linear) + (4.0f * light.quadratic * target))) / (2.0f * light.quadratic);
+		}
+		if (light.linear > 0.0f)
+		{
+			return target / light.linear;
+		}
+		return std::numeric_limits<float>::max();
+	}
+}
+
+// everything a bake reads and writes, shared by its jobs so it outlives
+// the probes when the bake is dropped
+struct IrradianceProbes::BAKE_STATE
+{
+	std::vector<LightmapBaker::BAKED_LIGHT> lights;
+	std::vector<SceneCapture::CAPTURED_OBJECT> objects;
+	std::vector<SceneCapture::CAPTURED_VERTEX> vertices;
+	SceneBVH bvh;
+	std::vector<int> triangleObjects;
+	// the grid, and the probes of it that are baked
+	glm::vec3 gridMin;
+	glm::vec3 gridSpacing;
+	glm::ivec3 gridSize;
+	std::vector<size_t> probes;
+	std::vector<PROBE_COEFFICIENTS> coefficients;
+	std::vector<unsigned char> valid;
+	// jobs still running
+	std::atomic<int> pendingJobs;
+	std::atomic<bool> bFinished;
+	std::chrono::steady_clock::time_point startTime;
+	double milliseconds;
+};
+
+/***********************************************************
+ *  IrradianceProbes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+IrradianceProbes::IrradianceProbes()
+{
+	m_bSupported = false;
+	m_texture = 0;
+	m_gridMin = glm::vec3(0.0f);
+	m_gridSpacing = glm::vec3(0.0f);
+	m_gridSize = glm::ivec3(0);
+	m_dirtyCount = 0;
+	m_bSceneSet = false;
+	m_bLightsSet = false;
+	m_bReady = false;
+	m_bakeMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~IrradianceProbes()
+ *
+ *  The destructor for the class.  A running bake finishes
+ *  on its own and is dropped.
+ ***********************************************************/
+IrradianceProbes::~IrradianceProbes()
+{
+	if (m_texture != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the probe texture.
+ ***********************************************************/
+bool IrradianceProbes::Initialize()
+{
+	glGenTextures(1, &m_texture);
+	m_bSupported = (m_texture != 0);
+
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the probes can be
+ *  baked.
+ ***********************************************************/
+bool IrradianceProbes::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for setting the scene lights the
+ *  probes gather.  A changed spot light bakes again the
+ *  probes within its reach, and any other change bakes
+ *  every probe - the directional and point lights of the
+ *  shader do not fade with distance.
+ ***********************************************************/
+void IrradianceProbes::SetLights(const std::vector<LightmapBaker::BAKED_LIGHT>& lights)
+{
+	if (!m_bLightsSet || (lights.size() != m_lights.size()))
+	{
+		MarkAllProbes();
+	}
+	else
+	{
+		for (size_t i = 0; i < lights.size(); i++)
+		{
+			if (HashLight(lights[i]) == HashLight(m_lights[i]))
+			{
+				continue;
+			}
+			if ((lights[i].type != LightmapBaker::spotLight) || (m_lights[i].type != LightmapBaker::spotLight))
+			{
+				MarkAllProbes();
+				break;
+			}
+			float oldReach = GetLightReach(m_lights[i]);
+			float newReach = GetLightReach(lights[i]);
+			MarkProbes(m_lights[i].position - glm::vec3(oldReach), m_lights[i].position + glm::vec3(oldReach));
+			MarkProbes(lights[i].position - glm::vec3(newReach), lights[i].position + glm::vec3(newReach));
+		}
+	}
+
+	m_lights = lights;
+	m_bLightsSet = true;
+}
+
+/***********************************************************
+ *  SetScene()
+ *
+ *  This method is used for setting the captured scene the
+ *  probes are baked in.  The objects are matched to the
+ *  ones of the last scene in their drawing order, and the
+ *  probes around an object that was added, removed, moved
+ *  or recolored are baked again - every probe when the
+ *  grid itself has to change.
+ ***********************************************************/
+void IrradianceProbes::SetScene(const SceneCapture& capture)
+{
+	const std::vector<SceneCapture::CAPTURED_OBJECT>& objects = capture.GetObjects();
+	const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices = capture.GetVertices();
+
+	if (PlaceGrid(vertices) || !m_bSceneSet)
+	{
+		MarkAllProbes();
+	}
+	else
+	{
+		size_t objectCount = std::max(objects.size(), m_objects.size());
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			bool bOld = (i < m_objects.size());
+			bool bNew = (i < objects.size());
+			if (bOld && bNew &&
+				(objects[i].transformHash == m_objects[i].transformHash) &&
+				(objects[i].triangleCount == m_objects[i].triangleCount) &&
+				(objects[i].albedo == m_objects[i].albedo) &&
+				(objects[i].diffuseColor == m_objects[i].diffuseColor))
+			{
+				continue;
+			}
+
+			glm::vec3 boundsMin;
+			glm::vec3 boundsMax;
+			if (bOld)
+			{
+				GetObjectBounds(m_objects[i], m_vertices, boundsMin, boundsMax);
+				MarkProbes(boundsMin - glm::vec3(g_ChangeReach), boundsMax + glm::vec3(g_ChangeReach));
+			}
+			if (bNew)
+			{
+				GetObjectBounds(objects[i], vertices, boundsMin, boundsMax);
+				MarkProbes(boundsMin - glm::vec3(g_ChangeReach), boundsMax + glm::vec3(g_ChangeReach));
+			}
+		}
+	}
+
+	m_objects = objects;
+	m_vertices = vertices;
+	m_bSceneSet = true;
+}
+
+/***********************************************************
+ *  PlaceGrid()
+ *
+ *  This method is used for laying the probes out over the
+ *  box of the captured triangles, one probe spacing apart
+ *  or farther when the box is large.  The coefficients are
+ *  cleared when the grid changes.
+ ***********************************************************/
+bool IrradianceProbes::PlaceGrid(const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices)
+{
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+	if (vertices.empty())
+	{
+		boundsMin = glm::vec3(0.0f);
+		boundsMax = glm::vec3(0.0f);
+	}
+
+	glm::vec3 gridMin = boundsMin;
+	glm::vec3 gridSpacing;
+	glm::ivec3 gridSize;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = boundsMax[axis] - boundsMin[axis];
+		gridSize[axis] = std::min(std::max((int)std::ceil(extent / g_ProbeSpacing) + 1, 2), g_MaxProbesPerAxis);
+		gridSpacing[axis] = std::max(extent / (float)(gridSize[axis] - 1), 1.0e-3f);
+	}
+
+	if ((gridMin == m_gridMin) && (gridSpacing == m_gridSpacing) && (gridSize == m_gridSize))
+	{
+		return false;
+	}
+
+	m_gridMin = gridMin;
+	m_gridSpacing = gridSpacing;
+	m_gridSize = gridSize;
+	size_t probeCount = (size_t)gridSize.x * gridSize.y * gridSize.z;
+	m_probes.assign(probeCount, PROBE_COEFFICIENTS());
+	m_validProbes.assign(probeCount, 0);
+	m_dirtyProbes.assign(probeCount, 0);
+	m_dirtyCount = 0;
+	m_bReady = false;
+	return true;
+}
+
+/***********************************************************
+ *  MarkProbes()
+ *
+ *  This method is used for marking the probes in a box, and
+ *  the ones right outside it that blend into it, to be
+ *  baked again.
+ ***********************************************************/
+void IrradianceProbes::MarkProbes(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	if (m_dirtyProbes.empty())
+	{
+		return;
+	}
+
+	glm::ivec3 first;
+	glm::ivec3 last;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lower = std::floor((boundsMin[axis] - m_gridMin[axis]) / m_gridSpacing[axis]);
+		float upper = std::ceil((boundsMax[axis] - m_gridMin[axis]) / m_gridSpacing[axis]);
+		first[axis] = (int)std::max(lower, 0.0f);
+		last[axis] = (int)std::min(upper, (float)(m_gridSize[axis] - 1));
+		if (first[axis] > last[axis])
+		{
+			return;
+		}
+	}
+
+	for (int z = first.z; z <= last.z; z++)
+	{
+		for (int y = first.y; y <= last.y; y++)
+		{
+			for (int x = first.x; x <= last.x; x++)
+			{
+				unsigned char& dirty = m_dirtyProbes[((size_t)z * m_gridSize.y + y) * m_gridSize.x + x];
+				if (dirty == 0)
+				{
+					dirty = 1;
+					m_dirtyCount++;
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  MarkAllProbes()
+ *
+ *  This method is used for marking every probe to be baked
+ *  again.
+ ***********************************************************/
+void IrradianceProbes::MarkAllProbes()
+{
+	std::fill(m_dirtyProbes.begin(), m_dirtyProbes.end(), (unsigned char)1);
+	m_dirtyCount = m_dirtyProbes.size();
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for keeping the probes in step with
+ *  the scene and the lights.  A finished bake is uploaded,
+ *  and once the scene and the lights are set the probes
+ *  marked since the last bake are handed to a new one - a
+ *  probe marked while a bake runs waits for the next.
+ ***********************************************************/
+void IrradianceProbes::Update(ThreadPool* threadPool)
+{
+	if (m_bake && m_bake->bFinished)
+	{
+		FinishBake();
+	}
+
+	if (!m_bSupported || !m_bSceneSet || !m_bLightsSet || m_bake || (m_dirtyCount == 0))
+	{
+		return;
+	}
+	StartBake(threadPool);
+}
+
+/***********************************************************
+ *  IsReady()
+ *
+ *  This method is used for checking if every probe of the
+ *  grid has been baked and uploaded.
+ ***********************************************************/
+bool IrradianceProbes::IsReady() const
+{
+	return m_bReady;
+}
+
+/***********************************************************
+ *  GetBakeTime()
+ *
+ *  This method is used for getting the time the last
+ *  finished bake took in milliseconds.
+ ***********************************************************/
+double IrradianceProbes::GetBakeTime() const
+{
+	return m_bakeMilliseconds;
+}
+
+/***********************************************************
+ *  StartBake()
+ *
+ *  This method is used for handing a copy of the scene, the
+ *  lights and the marked probes to a new bake on the worker
+ *  threads.
+ ***********************************************************/
+void IrradianceProbes::StartBake(ThreadPool* threadPool)
+{
+	m_bake = std::make_shared<BAKE_STATE>();
+	m_bake->lights = m_lights;
+	m_bake->objects = m_objects;
+	m_bake->vertices = m_vertices;
+	m_bake->gridMin = m_gridMin;
+	m_bake->gridSpacing = m_gridSpacing;
+	m_bake->gridSize = m_gridSize;
+	m_bake->probes.reserve(m_dirtyCount);
+	for (size_t probe = 0; probe < m_dirtyProbes.size(); probe++)
+	{
+		if (m_dirtyProbes[probe] != 0)
+		{
+			m_bake->probes.push_back(probe);
+			m_dirtyProbes[probe] = 0;
+		}
+	}
+	m_dirtyCount = 0;
+	m_bake->pendingJobs = 0;
+	m_bake->bFinished = false;
+	m_bake->startTime = std::chrono::steady_clock::now();
+	m_bake->milliseconds = 0.0;
+
+	std::shared_ptr<BAKE_STATE> state = m_bake;
+	threadPool->QueueJob([state, threadPool]()
+	{
+		QueueBakeJobs(state, threadPool);
+	});
+}
+
+/***********************************************************
+ *  QueueBakeJobs()
+ *
+ *  This method is used for building the BVH of a bake and
+ *  queueing the jobs that gather its probes, on a worker
+ *  thread - the last job finishes the bake.
+ ***********************************************************/
+void IrradianceProbes::QueueBakeJobs(std::shared_ptr<BAKE_STATE> state, ThreadPool* threadPool)
+{
+	std::vector<glm::vec3> positions(state->vertices.size());
+	for (size_t i = 0; i < state->vertices.size(); i++)
+	{
+		positions[i] = state->vertices[i].position;
+	}
+	state->bvh.Build(positions);
+	state->triangleObjects.assign(state->vertices.size() / 3, 0);
+	for (size_t object = 0; object < state->objects.size(); object++)
+	{
+		const SceneCapture::CAPTURED_OBJECT& captured = state->objects[object];
+		for (size_t triangle = captured.firstTriangle; triangle < captured.firstTriangle + captured.triangleCount; triangle++)
+		{
+			state->triangleObjects[triangle] = (int)object;
+		}
+	}
+	state->coefficients.assign(state->probes.size(), PROBE_COEFFICIENTS());
+	state->valid.assign(state->probes.size(), 0);
+
+	size_t probeCount = state->probes.size();
+	int jobCount = (int)((probeCount + g_ProbesPerJob - 1) / g_ProbesPerJob);
+	if (jobCount == 0)
+	{
+		state->bFinished = true;
+		return;
+	}
+
+	state->pendingJobs = jobCount;
+	for (int job = 0; job < jobCount; job++)
+	{
+		threadPool->QueueJob([state, job, probeCount]()
+		{
+			size_t first = (size_t)job * g_ProbesPerJob;
+			BakeProbes(*state, first, std::min(first + g_ProbesPerJob, probeCount));
+			if (state->pendingJobs.fetch_sub(1) == 1)
+			{
+				std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - state->startTime;
+				state->milliseconds = time.count();
+				state->bFinished = true;
+			}
+		});
+	}
+}
+
+/***********************************************************
+ *  BakeProbes()
+ *
+ *  This method is used for gathering the light of a range
+ *  of the probes of a bake.  The rays of a probe leave it
+ *  evenly over the sphere, four at a time.  A ray that hits
+ *  the front of a surface brings the light the surface
+ *  reflects, lit as the lightmap samples are, and a ray
+ *  that hits nothing brings the flat ambient of the lights
+ *  at the probe.  The light is projected onto the spherical
+ *  harmonics and turned into irradiance by the cosine lobe,
+ *  scaled so a probe seeing only the flat ambient returns
+ *  it unchanged.  A probe that sees the back of too many
+ *  surfaces is inside an object, and keeps the flat ambient
+ *  until it is filled from its neighbors.
+ ***********************************************************/
+void IrradianceProbes::BakeProbes(BAKE_STATE& state, size_t first, size_t last)
+{
+	// the cosine lobe of every band, over pi
+	const float bandScales[3] = { 1.0f, 2.0f / 3.0f, 1.0f / 4.0f };
+	const int coefficientBands[9] = { 0, 1, 1, 1, 2, 2, 2, 2, 2 };
+
+	for (size_t entry = first; entry < last; entry++)
+	{
+		size_t probe = state.probes[entry];
+		glm::ivec3 cell((int)(probe % state.gridSize.x), (int)((probe / state.gridSize.x) % state.gridSize.y),
+			(int)(probe / ((size_t)state.gridSize.x * state.gridSize.y)));
+		glm::vec3 position = state.gridMin + (glm::vec3(cell) * state.gridSpacing);
+
+		glm::vec3 flatAmbient;
+		glm::vec3 unused;
+		LightmapBaker::LightSurface(state.lights, state.bvh, position, glm::vec3(0.0f, 1.0f, 0.0f), flatAmbient, unused);
+
+		glm::vec3 projected[9];
+		for (int i = 0; i < 9; i++)
+		{
+			projected[i] = glm::vec3(0.0f);
+		}
+		int frontRays = 0;
+		int backRays = 0;
+		for (int packet = 0; packet < g_ProbeRays / 4; packet++)
+		{
+			glm::vec3 origins[4] = { position, position, position, position };
+			glm::vec3 directions[4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				directions[lane] = GetSphereRay((packet * 4) + lane, g_ProbeRays);
+			}
+
+			SceneBVH::RAY_HIT hits[4];
+			state.bvh.IntersectPacket(origins, directions, g_MaxRayDistance, hits);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				glm::vec3 radiance = flatAmbient;
+				if (hits[lane].triangle >= 0)
+				{
+					const SceneCapture::CAPTURED_VERTEX* vertices = &state.vertices[(size_t)hits[lane].triangle * 3];
+					float u = hits[lane].u;
+					float v = hits[lane].v;
+					glm::vec3 normal = (vertices[0].normal * (1.0f - u - v)) + (vertices[1].normal * u) + (vertices[2].normal * v);
+					if ((glm::dot(normal, directions[lane]) >= 0.0f) || (glm::dot(normal, normal) < 1.0e-12f))
+					{
+						backRays++;
+						continue;
+					}
+					normal = glm::normalize(normal);
+					glm::vec3 point = (vertices[0].position * (1.0f - u - v)) + (vertices[1].position * u) + (vertices[2].position * v);
+					const SceneCapture::CAPTURED_OBJECT& object = state.objects[state.triangleObjects[hits[lane].triangle]];
+					glm::vec3 ambient;
+					glm::vec3 direct;
+					LightmapBaker::LightSurface(state.lights, state.bvh, point, normal, ambient, direct);
+					radiance = object.albedo * (ambient + (direct * object.diffuseColor));
+				}
+
+				float harmonics[9];
+				EvaluateHarmonics(directions[lane], harmonics);
+				for (int i = 0; i < 9; i++)
+				{
+					projected[i] += radiance * harmonics[i];
+				}
+				frontRays++;
+			}
+		}
+
+		float coefficients[COEFFICIENT_SETS * 4] = {};
+		if ((frontRays == 0) || ((float)backRays > (g_MaxBackFaceShare * (float)g_ProbeRays)))
+		{
+			// the flat ambient alone, as the first harmonic of a constant
+			glm::vec3 constant = flatAmbient * (4.0f * g_Pi * 0.282095f);
+			coefficients[0] = constant.x;
+			coefficients[1] = constant.y;
+			coefficients[2] = constant.z;
+		}
+		else
+		{
+			state.valid[entry] = 1;
+			float weight = (4.0f * g_Pi) / (float)frontRays;
+			for (int i = 0; i < 9; i++)
+			{
+				glm::vec3 coefficient = projected[i] * (weight * bandScales[coefficientBands[i]]);
+				coefficients[(i * 3) + 0] = coefficient.x;
+				coefficients[(i * 3) + 1] = coefficient.y;
+				coefficients[(i * 3) + 2] = coefficient.z;
+			}
+		}
+
+		PROBE_COEFFICIENTS& result = state.coefficients[entry];
+		for (int set = 0; set < COEFFICIENT_SETS; set++)
+		{
+			result.sets[set] = glm::vec4(coefficients[(set * 4) + 0], coefficients[(set * 4) + 1],
+				coefficients[(set * 4) + 2], coefficients[(set * 4) + 3]);
+		}
+	}
+}
+
+/***********************************************************
+ *  FinishBake()
+ *
+ *  This method is used for copying the probes of a bake
+ *  that has finished into the grid and uploading it.  A
+ *  bake for a grid that has changed since it started is
+ *  dropped.
+ ***********************************************************/
+void IrradianceProbes::FinishBake()
+{
+	std::shared_ptr<BAKE_STATE> state = m_bake;
+	m_bake.reset();
+
+	if ((state->gridMin != m_gridMin) || (state->gridSpacing != m_gridSpacing) || (state->gridSize != m_gridSize))
+	{
+		return;
+	}
+
+	for (size_t entry = 0; entry < state->probes.size(); entry++)
+	{
+		m_probes[state->probes[entry]] = state->coefficients[entry];
+		m_validProbes[state->probes[entry]] = state->valid[entry];
+	}
+	if (!UploadProbes())
+	{
+		return;
+	}
+
+	// the probes of the first bake are all there are
+	if (!m_bReady)
+	{
+		std::cout << "Baked " << state->probes.size() << " irradiance probes in a " << m_gridSize.x << "x" << m_gridSize.y
+			<< "x" << m_gridSize.z << " grid in " << state->milliseconds << " ms" << std::endl;
+	}
+	else
+	{
+		std::cout << "Baked " << state->probes.size() << " changed irradiance probes in " << state->milliseconds << " ms" << std::endl;
+	}
+	m_bReady = true;
+	m_bakeMilliseconds = state->milliseconds;
+}
+
+/***********************************************************
+ *  UploadProbes()
+ *
+ *  This method is used for uploading the grid into the
+ *  probe texture.  A probe inside an object takes the mean
+ *  of the probes around it that are outside, so the light
+ *  inside a wall does not bleed into the surfaces next to
+ *  it.  The seven sets of coefficients are laid
+ *  out as seven grids stacked along its depth, each filtered
+ *  linearly between its probes - the shader keeps to the
+ *  inside of a grid, so two sets never blend.
+ ***********************************************************/
+bool IrradianceProbes::UploadProbes()
+{
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize);
+	int depth = m_gridSize.z * COEFFICIENT_SETS;
+	if ((m_gridSize.x > maxSize) || (m_gridSize.y > maxSize) || (depth > maxSize))
+	{
+		std::cout << "The irradiance probes are larger than the 3D textures of the driver" << std::endl;
+		return false;
+	}
+
+	std::vector<glm::vec4> texels((size_t)m_gridSize.x * m_gridSize.y * depth);
+	size_t setSize = m_probes.size();
+	for (size_t probe = 0; probe < m_probes.size(); probe++)
+	{
+		PROBE_COEFFICIENTS coefficients = m_probes[probe];
+		if (m_validProbes[probe] == 0)
+		{
+			glm::ivec3 cell((int)(probe % m_gridSize.x), (int)((probe / m_gridSize.x) % m_gridSize.y),
+				(int)(probe / ((size_t)m_gridSize.x * m_gridSize.y)));
+			PROBE_COEFFICIENTS total = {};
+			int count = 0;
+			for (int i = 0; i < 27; i++)
+			{
+				glm::ivec3 neighbor = cell + glm::ivec3((i % 3) - 1, ((i / 3) % 3) - 1, (i / 9) - 1);
+				if ((neighbor.x < 0) || (neighbor.y < 0) || (neighbor.z < 0) ||
+					(neighbor.x >= m_gridSize.x) || (neighbor.y >= m_gridSize.y) || (neighbor.z >= m_gridSize.z))
+				{
+					continue;
+				}
+				size_t index = ((size_t)neighbor.z * m_gridSize.y + neighbor.y) * m_gridSize.x + neighbor.x;
+				if (m_validProbes[index] == 0)
+				{
+					continue;
+				}
+				for (int set = 0; set < COEFFICIENT_SETS; set++)
+				{
+					total.sets[set] += m_probes[index].sets[set];
+				}
+				count++;
+			}
+			if (count > 0)
+			{
+				for (int set = 0; set < COEFFICIENT_SETS; set++)
+				{
+					coefficients.sets[set] = total.sets[set] / (float)count;
+				}
+			}
+		}
+		for (int set = 0; set < COEFFICIENT_SETS; set++)
+		{
+			texels[(set * setSize) + probe] = coefficients.sets[set];
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_3D, m_texture);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, m_gridSize.x, m_gridSize.y, depth, 0, GL_RGBA, GL_FLOAT, texels.data());
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_3D, 0);
+
+	return true;
+}
+
+/***********************************************************
+ *  GetObjectBounds()
+ *
+ *  This method is used for getting the world box of the
+ *  triangles of a captured object.
+ ***********************************************************/
+void IrradianceProbes::GetObjectBounds(
+	const SceneCapture::CAPTURED_OBJECT& object,
+	const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices,
+	glm::vec3& boundsMin,
+	glm::vec3& boundsMax)
+{
+	boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+	for (size_t i = object.firstTriangle * 3; i < (object.firstTriangle + object.triangleCount) * 3; i++)
+	{
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding the probe texture to its
+ *  texture unit.
+ ***********************************************************/
+void IrradianceProbes::BindTexture() const
+{
+	if (!m_bReady)
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + g_ProbeTextureUnit);
+	glBindTexture(GL_TEXTURE_3D, m_texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for setting the probe texture and
+ *  the grid on a program that draws with the probes.
+ ***********************************************************/
+void IrradianceProbes::SetShaderValues(GLuint program) const
+{
+	glUniform1i(glGetUniformLocation(program, "irradianceProbes"), g_ProbeTextureUnit);
+	glUniform3f(glGetUniformLocation(program, "irradianceGridMin"), m_gridMin.x, m_gridMin.y, m_gridMin.z);
+	glUniform3f(glGetUniformLocation(program, "irradianceGridSpacing"), m_gridSpacing.x, m_gridSpacing.y, m_gridSpacing.z);
+	glUniform3i(glGetUniformLocation(program, "irradianceGridSize"), m_gridSize.x, m_gridSize.y, m_gridSize.z);
+}
@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+// irradianceprobes.h
+// ============
+// bake the ambient light of the scene into a grid of spherical harmonics
+// probes, for lighting the objects that are not baked
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LightmapBaker.h"
+#include "SceneCapture.h"
+#include "ThreadPool.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/***********************************************************
+ *  IrradianceProbes
+ *
+ *  This class contains the code for the irradiance volume of
+ *  the scene.  Probes are spread in a grid over the captured
+ *  scene, and each one gathers the light arriving from all
+ *  around it with rays through the BVH of the scene - the
+ *  scene lights reflected by the surfaces it sees, and the
+ *  flat ambient of the lights where it sees none - as the
+ *  nine second order spherical harmonics coefficients of
+ *  the irradiance.  The fragment shader blends the eight
+ *  probes around a point and reads the light for its normal,
+ *  in place of the flat ambient of the lights, so a moved
+ *  object still matches the light around it.  The probes
+ *  are baked on the worker threads, and a change of the
+ *  scene or of a light only bakes again the probes it
+ *  reaches.
+ ***********************************************************/
+class IrradianceProbes
+{
+public:
+	// constructor
+	IrradianceProbes();
+	// destructor
+	~IrradianceProbes();
+
+	// the texture cannot be shared between two objects
+	IrradianceProbes(const IrradianceProbes&) = delete;
+	IrradianceProbes& operator=(const IrradianceProbes&) = delete;
+
+	// the coefficients of a probe - nine for each color channel, packed
+	// in order into the four channels of seven texels
+	static const int COEFFICIENT_SETS = 7;
+	struct PROBE_COEFFICIENTS
+	{
+		glm::vec4 sets[COEFFICIENT_SETS];
+	};
+
+private:
+	struct BAKE_STATE;
+
+	bool m_bSupported;
+	GLuint m_texture;
+	// the grid of the probes - the first probe, the distance between two
+	// probes, and the probes along every axis
+	glm::vec3 m_gridMin;
+	glm::vec3 m_gridSpacing;
+	glm::ivec3 m_gridSize;
+	// the coefficients of every probe, whether it is outside the objects,
+	// and the probes to bake again
+	std::vector<PROBE_COEFFICIENTS> m_probes;
+	std::vector<unsigned char> m_validProbes;
+	std::vector<unsigned char> m_dirtyProbes;
+	size_t m_dirtyCount;
+	// the scene and lights to bake
+	std::vector<LightmapBaker::BAKED_LIGHT> m_lights;
+	std::vector<SceneCapture::CAPTURED_OBJECT> m_objects;
+	std::vector<SceneCapture::CAPTURED_VERTEX> m_vertices;
+	bool m_bSceneSet;
+	bool m_bLightsSet;
+	// the bake running on the worker threads, NULL when none is
+	std::shared_ptr<BAKE_STATE> m_bake;
+	// every probe has been baked once
+	bool m_bReady;
+	double m_bakeMilliseconds;
+
+	// lay the grid out over a captured scene, returns true when it
+	// differs from the current one
+	bool PlaceGrid(const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices);
+	// mark the probes in a box to be baked again
+	void MarkProbes(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	void MarkAllProbes();
+	// start baking the marked probes
+	void StartBake(ThreadPool* threadPool);
+	// copy a finished bake into the probes and upload them
+	void FinishBake();
+	bool UploadProbes();
+
+	// the steps of a bake, run on the worker threads
+	static void QueueBakeJobs(std::shared_ptr<BAKE_STATE> state, ThreadPool* threadPool);
+	static void BakeProbes(BAKE_STATE& state, size_t first, size_t last);
+	// get the world box of the triangles of a captured object
+	static void GetObjectBounds(
+		const SceneCapture::CAPTURED_OBJECT& object,
+		const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices,
+		glm::vec3& boundsMin,
+		glm::vec3& boundsMax);
+
+public:
+	// create the probe texture - needs the OpenGL context to be current
+	bool Initialize();
+	// check if the probes can be baked
+	bool IsSupported() const;
+
+	// set the scene lights - the probes they reach are baked again when
+	// they have changed
+	void SetLights(const std::vector<LightmapBaker::BAKED_LIGHT>& lights);
+	// set the captured scene - the probes around the objects that have
+	// changed are baked again
+	void SetScene(const SceneCapture& capture);
+	// start a bake of the changed probes, and upload a finished bake -
+	// call once per frame
+	void Update(ThreadPool* threadPool);
+	// check if every probe has been baked
+	bool IsReady() const;
+	// get the time the last bake took in milliseconds
+	double GetBakeTime() const;
+
+	// bind the probe texture for the lit programs - call once per frame
+	void BindTexture() const;
+	// set the grid on a program that draws with the probes
+	void SetShaderValues(GLuint program) const;
+};
@@ -0,0 +1,1190 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.cpp
+// ============
+// bake the light of the static scene lights into a lightmap atlas on the
+// worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapBaker.h"
+
+#include "MappedFile.h"
+#include "OcclusionBaker.h"
+#include "ResourceRegistry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	// the cache file identifier and version
+	const unsigned char g_CacheIdentifier[8] = { 'L', 'I', 'G', 'H', 'T', 'M', 'A', 'P' };
+	const uint32_t g_CacheVersion = 2;
+	// sizes of the fixed header and of a brick in the cache file
+	const size_t g_CacheHeaderSize = 48;
+	const size_t g_CacheBrickSize = 48;
+
+	// the texture unit of the atlas, after the shadow maps
+	const int g_AtlasTextureUnit = 23;
+	// width of the atlas, whose height grows with the bricks
+	const int g_AtlasWidth = 2048;
+	// world distance between the samples of a brick, which grows when
+	// the bricks would hold more samples than the limit
+	const float g_SampleSpacing = 0.25f;
+	const size_t g_MaxSamples = 2 * 1024 * 1024;
+	// most samples along an axis of a brick
+	const int g_MaxBrickSize = 64;
+	// samples a bake job lights
+	const size_t g_SamplesPerJob = 2048;
+	// rays gathering the bounced light of a sample, four to a packet
+	const int g_BounceRays = 32;
+	// distance a ray starts off its surface, and the length of the rays
+	// towards the directional light
+	const float g_RayOffset = 0.01f;
+	const float g_MaxRayDistance = 1.0e4f;
+
+	uint32_t ReadUInt32(const unsigned char* data, size_t offset)
+	{
+		uint32_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadUInt64(const unsigned char* data, size_t offset)
+	{
+		uint64_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	void WriteUInt32(std::vector<unsigned char>& data, size_t offset, uint32_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	void WriteUInt64(std::vector<unsigned char>& data, size_t offset, uint64_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	// the closest point of a triangle to a point, and its weights of
+	// the three vertices
+	glm::vec3 ClosestPointOnTriangle(const glm::vec3& point, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, glm::vec3& weights)
+	{
+		glm::vec3 ab = b - a;
+		glm::vec3 ac = c - a;
+		glm::vec3 ap = point - a;
+		float d1 = glm::dot(ab, ap);
+		float d2 = glm::dot(ac, ap);
+		if ((d1 <= 0.0f) && (d2 <= 0.0f))
+		{
+			weights = glm::vec3(1.0f, 0.0f, 0.0f);
+			return a;
+		}
+
+		glm::vec3 bp = point - b;
+		float d3 = glm::dot(ab, bp);
+		float d4 = glm::dot(ac, bp);
+		if ((d3 >= 0.0f) && (d4 <= d3))
+		{
+			weights = glm::vec3(0.0f, 1.0f, 0.0f);
+			return b;
+		}
+
+		float vc = (d1 * d4) - (d3 * d2);
+		if ((vc <= 0.0f) && (d1 >= 0.0f) && (d3 <= 0.0f))
+		{
+			float v = d1 / (d1 - d3);
+			weights = glm::vec3(1.0f - v, v, 0.0f);
+			return a + (ab * v);
+		}
+
+		glm::vec3 cp = point - c;
+		float d5 = glm::dot(ab, cp);
+		float d6 = glm::dot(ac, cp);
+		if ((d6 >= 0.0f) && (d5 <= d6))
+		{
+			weights = glm::vec3(0.0f, 0.0f, 1.0f);
+			return c;
+		}
+
+		float vb = (d5 * d2) - (d1 * d6);
+		if ((vb <= 0.0f) && (d2 >= 0.0f) && (d6 <= 0.0f))
+		{
+			float w = d2 / (d2 - d6);
+			weights = glm::vec3(1.0f - w, 0.0f, w);
+			return a + (ac * w);
+		}
+
+		float va = (d3 * d6) - (d5 * d4);
+		if ((va <= 0.0f) && ((d4 - d3) >= 0.0f) && ((d5 - d6) >= 0.0f))
+		{
+			float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			weights = glm::vec3(0.0f, 1.0f - w, w);
+			return b + ((c - b) * w);
+		}
+
+		float denominator = 1.0f / (va + vb + vc);
+		float v = vb * denominator;
+		float w = vc * denominator;
+		weights = glm::vec3(1.0f - v - w, v, w);
+		return a + (ab * v) + (ac * w);
+	}
+}
+
+// everything a bake reads and writes, shared by its jobs so it outlives
+// the baker when the bake is cancelled
+struct LightmapBaker::BAKE_STATE
+{
+	std::vector<BAKED_LIGHT> lights;
+	std::vector<SceneCapture::CAPTURED_OBJECT> objects;
+	std::vector<SceneCapture::CAPTURED_VERTEX> vertices;
+	uint64_t sceneHash;
+	uint64_t lightHash;
+	// the triangles of every object, and the object of every triangle
+	SceneBVH bvh;
+	std::vector<int> triangleObjects;
+	// the brick of every object, and its first sample
+	std::vector<LIGHTMAP_BRICK> bricks;
+	std::vector<size_t> firstSamples;
+	int atlasWidth;
+	int atlasHeight;
+	// the surface point of every sample, 0 for a sample with no surface
+	// of its object near it
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<unsigned char> surfaceFlags;
+	// the ambient light, the direct light from the lights and the total
+	// light of every sample
+	std::vector<glm::vec3> ambient;
+	std::vector<glm::vec3> direct;
+	std::vector<glm::vec3> light;
+	// the finished atlas
+	std::vector<uint32_t> texels;
+	// jobs of the current step still running
+	std::atomic<int> pendingJobs;
+	std::atomic<bool> bCancelled;
+	std::atomic<bool> bFinished;
+	bool bFailed;
+	std::chrono::steady_clock::time_point startTime;
+	double milliseconds;
+};
+
+/***********************************************************
+ *  LightmapBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightmapBaker::LightmapBaker()
+{
+	m_atlasTexture = 0;
+	m_atlasSceneHash = 0;
+	m_atlasLightHash = 0;
+	m_sceneHash = 0;
+	m_lightHash = 0;
+	m_bSceneSet = false;
+	m_bLightsSet = false;
+	m_currentObject = -1;
+	m_bObjectBaked = false;
+	m_bakeMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~LightmapBaker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightmapBaker::~LightmapBaker()
+{
+	// the jobs of a running bake keep its state and stop early
+	if (m_bake)
+	{
+		m_bake->bCancelled = true;
+	}
+	if (m_atlasTexture != 0)
+	{
+		glDeleteTextures(1, &m_atlasTexture);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for setting the path of the file
+ *  the atlas is cached in.
+ ***********************************************************/
+void LightmapBaker::Initialize(const std::string& cacheFile)
+{
+	m_cacheFile = cacheFile;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for setting the scene lights that
+ *  are baked.
+ ***********************************************************/
+void LightmapBaker::SetLights(const std::vector<BAKED_LIGHT>& lights)
+{
+	m_lights = lights;
+	m_lightHash = HashLights(lights);
+	m_bLightsSet = true;
+}
+
+/***********************************************************
+ *  SetScene()
+ *
+ *  This method is used for setting the captured scene that
+ *  is baked.
+ ***********************************************************/
+void LightmapBaker::SetScene(const SceneCapture& capture)
+{
+	m_objects = capture.GetObjects();
+	m_vertices = capture.GetVertices();
+	m_sceneHash = capture.GetSceneHash();
+	m_bSceneSet = true;
+
+	m_transformHashes.resize(m_objects.size());
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		m_transformHashes[i] = m_objects[i].transformHash;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for keeping the atlas in step with
+ *  the scene and the lights.  Once both are set and differ
+ *  from the atlas, the cached atlas is loaded when it was
+ *  baked for them, or else a bake is started - a bake for
+ *  lights that changed again is abandoned for a new one.
+ *  A finished bake is uploaded and written to the cache.
+ ***********************************************************/
+void LightmapBaker::Update(ThreadPool* threadPool)
+{
+	if (m_bake && m_bake->bFinished)
+	{
+		FinishBake();
+	}
+
+	if (!m_bSceneSet || !m_bLightsSet || IsReady())
+	{
+		return;
+	}
+	if (m_bake && (m_bake->sceneHash == m_sceneHash) && (m_bake->lightHash == m_lightHash))
+	{
+		return;
+	}
+
+	if (LoadCache())
+	{
+		if (m_bake)
+		{
+			m_bake->bCancelled = true;
+			m_bake.reset();
+		}
+		return;
+	}
+	StartBake(threadPool);
+}
+
+/***********************************************************
+ *  IsReady()
+ *
+ *  This method is used for checking if the atlas was baked
+ *  for the current scene and lights.
+ ***********************************************************/
+bool LightmapBaker::IsReady() const
+{
+	return (m_atlasTexture != 0) && m_bSceneSet && m_bLightsSet &&
+		(m_atlasSceneHash == m_sceneHash) && (m_atlasLightHash == m_lightHash);
+}
+
+/***********************************************************
+ *  IsBaking()
+ *
+ *  This method is used for checking if a bake is running on
+ *  the worker threads.
+ ***********************************************************/
+bool LightmapBaker::IsBaking() const
+{
+	return (bool)m_bake;
+}
+
+/***********************************************************
+ *  GetBakeTime()
+ *
+ *  This method is used for getting the time the last
+ *  finished bake took in milliseconds, 0 when the atlas was
+ *  loaded from the cache.
+ ***********************************************************/
+double LightmapBaker::GetBakeTime() const
+{
+	return m_bakeMilliseconds;
+}
+
+/***********************************************************
+ *  StartBake()
+ *
+ *  This method is used for handing a copy of the scene and
+ *  the lights to a new bake on the worker threads.
+ ***********************************************************/
+void LightmapBaker::StartBake(ThreadPool* threadPool)
+{
+	if (m_bake)
+	{
+		m_bake->bCancelled = true;
+	}
+
+	m_bake = std::make_shared<BAKE_STATE>();
+	m_bake->lights = m_lights;
+	m_bake->objects = m_objects;
+	m_bake->vertices = m_vertices;
+	m_bake->sceneHash = m_sceneHash;
+	m_bake->lightHash = m_lightHash;
+	m_bake->atlasWidth = 0;
+	m_bake->atlasHeight = 0;
+	m_bake->pendingJobs = 0;
+	m_bake->bCancelled = false;
+	m_bake->bFinished = false;
+	m_bake->bFailed = false;
+	m_bake->startTime = std::chrono::steady_clock::now();
+	m_bake->milliseconds = 0.0;
+
+	std::cout << "Baking the lightmaps of " << m_objects.size() << " objects on "
+		<< threadPool->GetThreadCount() << " threads" << std::endl;
+
+	std::shared_ptr<BAKE_STATE> state = m_bake;
+	threadPool->QueueJob([state, threadPool]()
+	{
+		QueueBakeJobs(state, threadPool);
+	});
+}
+
+/***********************************************************
+ *  QueueBakeJobs()
+ *
+ *  This method is used for laying out a bake and queueing
+ *  its jobs, on a worker thread.  Every object gets a brick
+ *  of samples over the box of its triangles in its own
+ *  space, spaced evenly in the world, and the bricks are
+ *  packed into rows of the atlas from the tallest.  The
+ *  samples are then placed and lit directly, and once all
+ *  of them are lit the bounced light is gathered - the last
+ *  job of a step queues the next one.
+ ***********************************************************/
+void LightmapBaker::QueueBakeJobs(std::shared_ptr<BAKE_STATE> state, ThreadPool* threadPool)
+{
+	if (state->bCancelled)
+	{
+		return;
+	}
+
+	size_t objectCount = state->objects.size();
+	size_t triangleCount = state->vertices.size() / 3;
+
+	// the triangles for tracing, and the object each belongs to
+	std::vector<glm::vec3> positions(state->vertices.size());
+	for (size_t i = 0; i < state->vertices.size(); i++)
+	{
+		positions[i] = state->vertices[i].position;
+	}
+	state->bvh.Build(positions);
+	state->triangleObjects.assign(triangleCount, -1);
+
+	// the local box of every object and its size in the world
+	std::vector<glm::vec3> boundsMin(objectCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> boundsMax(objectCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> worldSizes(objectCount, glm::vec3(0.0f));
+	for (size_t object = 0; object < objectCount; object++)
+	{
+		const SceneCapture::CAPTURED_OBJECT& captured = state->objects[object];
+		for (size_t triangle = captured.firstTriangle; triangle < captured.firstTriangle + captured.triangleCount; triangle++)
+		{
+			state->triangleObjects[triangle] = (int)object;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const glm::vec3& local = state->vertices[(triangle * 3) + corner].localPosition;
+				bool bFirst = (triangle == captured.firstTriangle) && (corner == 0);
+				boundsMin[object] = bFirst ? local : glm::min(boundsMin[object], local);
+				boundsMax[object] = bFirst ? local : glm::max(boundsMax[object], local);
+			}
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			worldSizes[object][axis] = (boundsMax[object][axis] - boundsMin[object][axis]) * glm::length(glm::vec3(captured.model[axis]));
+		}
+	}
+
+	// the sample spacing, widened until the samples fit the limit
+	state->bricks.resize(objectCount);
+	size_t sampleCount = 0;
+	for (float spacing = g_SampleSpacing; ; spacing *= 1.25f)
+	{
+		sampleCount = 0;
+		for (size_t object = 0; object < objectCount; object++)
+		{
+			LIGHTMAP_BRICK& brick = state->bricks[object];
+			brick.boundsMin = boundsMin[object];
+			brick.boundsSize = boundsMax[object] - boundsMin[object];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				int size = (int)std::ceil(worldSizes[object][axis] / spacing) + 1;
+				brick.size[axis] = std::clamp(size, 1, g_MaxBrickSize);
+			}
+			if (state->objects[object].triangleCount == 0)
+			{
+				brick.size = glm::ivec3(0);
+			}
+			sampleCount += (size_t)brick.size.x * brick.size.y * brick.size.z;
+		}
+		if (sampleCount <= g_MaxSamples)
+		{
+			break;
+		}
+	}
+
+	// the slices of a brick are laid out in rows of about as many as
+	// columns, and the bricks are packed into shelves of the atlas
+	std::vector<size_t> order(objectCount);
+	for (size_t object = 0; object < objectCount; object++)
+	{
+		LIGHTMAP_BRICK& brick = state->bricks[object];
+		brick.columns = std::max((int)std::ceil(std::sqrt((float)brick.size.z)), 1);
+		order[object] = object;
+	}
+	auto GetFootprint = [state](size_t object)
+	{
+		const LIGHTMAP_BRICK& brick = state->bricks[object];
+		int rows = (brick.size.z + brick.columns - 1) / brick.columns;
+		return glm::ivec2(brick.columns * brick.size.x, rows * brick.size.y);
+	};
+	std::sort(order.begin(), order.end(), [&GetFootprint](size_t a, size_t b)
+	{
+		return GetFootprint(a).y > GetFootprint(b).y;
+	});
+	glm::ivec2 cursor(0, 0);
+	int shelfHeight = 0;
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		LIGHTMAP_BRICK& brick = state->bricks[order[i]];
+		glm::ivec2 footprint = GetFootprint(order[i]);
+		if ((cursor.x + footprint.x) > g_AtlasWidth)
+		{
+			cursor = glm::ivec2(0, cursor.y + shelfHeight);
+			shelfHeight = 0;
+		}
+		brick.atlasOrigin = cursor;
+		cursor.x += footprint.x;
+		shelfHeight = std::max(shelfHeight, footprint.y);
+	}
+	state->atlasWidth = g_AtlasWidth;
+	state->atlasHeight = std::max(cursor.y + shelfHeight, 1);
+
+	state->firstSamples.resize(objectCount);
+	sampleCount = 0;
+	for (size_t object = 0; object < objectCount; object++)
+	{
+		const LIGHTMAP_BRICK& brick = state->bricks[object];
+		state->firstSamples[object] = sampleCount;
+		sampleCount += (size_t)brick.size.x * brick.size.y * brick.size.z;
+	}
+	state->positions.assign(sampleCount, glm::vec3(0.0f));
+	state->normals.assign(sampleCount, glm::vec3(0.0f));
+	state->surfaceFlags.assign(sampleCount, 0);
+	state->ambient.assign(sampleCount, glm::vec3(0.0f));
+	state->direct.assign(sampleCount, glm::vec3(0.0f));
+	state->light.assign(sampleCount, glm::vec3(0.0f));
+
+	int jobCount = (int)((sampleCount + g_SamplesPerJob - 1) / g_SamplesPerJob);
+	if (jobCount == 0)
+	{
+		state->bFailed = true;
+		state->bFinished = true;
+		return;
+	}
+
+	// the bounce is gathered once every sample is lit directly, then
+	// the atlas is filled
+	auto QueueBounceJobs = [state, threadPool, jobCount, sampleCount]()
+	{
+		state->pendingJobs = jobCount;
+		for (int job = 0; job < jobCount; job++)
+		{
+			threadPool->QueueJob([state, job, sampleCount]()
+			{
+				if (!state->bCancelled)
+				{
+					size_t first = (size_t)job * g_SamplesPerJob;
+					GatherBounce(*state, first, std::min(first + g_SamplesPerJob, sampleCount));
+				}
+				if ((state->pendingJobs.fetch_sub(1) != 1) || state->bCancelled)
+				{
+					return;
+				}
+
+				state->texels.assign((size_t)state->atlasWidth * state->atlasHeight, 0);
+				for (size_t object = 0; object < state->bricks.size(); object++)
+				{
+					const LIGHTMAP_BRICK& brick = state->bricks[object];
+					size_t sample = state->firstSamples[object];
+					for (int z = 0; z < brick.size.z; z++)
+					{
+						glm::ivec2 slice = brick.atlasOrigin + glm::ivec2((z % brick.columns) * brick.size.x, (z / brick.columns) * brick.size.y);
+						for (int y = 0; y < brick.size.y; y++)
+						{
+							for (int x = 0; x < brick.size.x; x++, sample++)
+							{
+								state->texels[((size_t)(slice.y + y) * state->atlasWidth) + slice.x + x] = PackSharedExponent(state->light[sample]);
+							}
+						}
+					}
+				}
+
+				std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - state->startTime;
+				state->milliseconds = time.count();
+				state->bFinished = true;
+			});
+		}
+	};
+
+	state->pendingJobs = jobCount;
+	for (int job = 0; job < jobCount; job++)
+	{
+		threadPool->QueueJob([state, job, sampleCount, QueueBounceJobs]()
+		{
+			if (!state->bCancelled)
+			{
+				size_t first = (size_t)job * g_SamplesPerJob;
+				PlaceSamples(*state, first, std::min(first + g_SamplesPerJob, sampleCount));
+			}
+			if ((state->pendingJobs.fetch_sub(1) == 1) && !state->bCancelled)
+			{
+				QueueBounceJobs();
+			}
+		});
+	}
+}
+
+/***********************************************************
+ *  PlaceSamples()
+ *
+ *  This method is used for placing a range of samples on
+ *  the surface of their objects and lighting them directly.
+ *  A sample moves to the closest point of the triangles of
+ *  its object, and is left out when that point is farther
+ *  than the diagonal between two samples - no surface of the
+ *  object passes between it and its neighbors, so it is
+ *  never read.  The lights are applied as the shader does,
+ *  the diffuse light only where a shadow ray reaches the
+ *  light.
+ ***********************************************************/
+void LightmapBaker::PlaceSamples(BAKE_STATE& state, size_t first, size_t last)
+{
+	size_t object = std::upper_bound(state.firstSamples.begin(), state.firstSamples.end(), first) - state.firstSamples.begin() - 1;
+
+	for (size_t sample = first; sample < last; sample++)
+	{
+		while ((object + 1 < state.firstSamples.size()) && (sample >= state.firstSamples[object + 1]))
+		{
+			object++;
+		}
+		const SceneCapture::CAPTURED_OBJECT& captured = state.objects[object];
+		const LIGHTMAP_BRICK& brick = state.bricks[object];
+
+		// the sample in the object and in the world
+		size_t index = sample - state.firstSamples[object];
+		glm::ivec3 voxel((int)(index % brick.size.x), (int)((index / brick.size.x) % brick.size.y), (int)(index / ((size_t)brick.size.x * brick.size.y)));
+		glm::vec3 local;
+		glm::vec3 spacing;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float step = (brick.size[axis] > 1) ? brick.boundsSize[axis] / (float)(brick.size[axis] - 1) : 0.0f;
+			local[axis] = (brick.size[axis] > 1) ? brick.boundsMin[axis] + (step * (float)voxel[axis]) : brick.boundsMin[axis] + (brick.boundsSize[axis] * 0.5f);
+			spacing[axis] = step * glm::length(glm::vec3(captured.model[axis]));
+		}
+		glm::vec3 world = glm::vec3(captured.model * glm::vec4(local, 1.0f));
+		float reach = glm::length(spacing) + g_RayOffset;
+
+		// the closest surface of the object
+		float bestDistance = reach * reach;
+		size_t bestTriangle = 0;
+		glm::vec3 bestPoint(0.0f);
+		glm::vec3 bestWeights(0.0f);
+		bool bFound = false;
+		for (size_t triangle = captured.firstTriangle; triangle < captured.firstTriangle + captured.triangleCount; triangle++)
+		{
+			const SceneCapture::CAPTURED_VERTEX* vertices = &state.vertices[triangle * 3];
+			glm::vec3 weights;
+			glm::vec3 point = ClosestPointOnTriangle(world, vertices[0].position, vertices[1].position, vertices[2].position, weights);
+			glm::vec3 offset = point - world;
+			float distance = glm::dot(offset, offset);
+			if (distance <= bestDistance)
+			{
+				bestDistance = distance;
+				bestTriangle = triangle;
+				bestPoint = point;
+				bestWeights = weights;
+				bFound = true;
+			}
+		}
+		if (!bFound)
+		{
+			continue;
+		}
+
+		const SceneCapture::CAPTURED_VERTEX* vertices = &state.vertices[bestTriangle * 3];
+		glm::vec3 normal = (vertices[0].normal * bestWeights.x) + (vertices[1].normal * bestWeights.y) + (vertices[2].normal * bestWeights.z);
+		if (glm::dot(normal, normal) < 1.0e-12f)
+		{
+			normal = glm::cross(vertices[1].position - vertices[0].position, vertices[2].position - vertices[0].position);
+		}
+		if (glm::dot(normal, normal) < 1.0e-12f)
+		{
+			continue;
+		}
+		normal = glm::normalize(normal);
+
+		state.positions[sample] = bestPoint;
+		state.normals[sample] = normal;
+		state.surfaceFlags[sample] = 1;
+
+		glm::vec3 ambient;
+		glm::vec3 direct;
+		LightSurface(state.lights, state.bvh, bestPoint, normal, ambient, direct);
+		state.ambient[sample] = ambient;
+		state.direct[sample] = direct * captured.diffuseColor;
+	}
+}
+
+/***********************************************************
+ *  LightSurface()
+ *
+ *  This method is used for lighting a point of a surface
+ *  with a list of lights, as the shader does - the ambient
+ *  light of every light, and its diffuse light only where a
+ *  shadow ray reaches it.
+ ***********************************************************/
+void LightmapBaker::LightSurface(
+	const std::vector<BAKED_LIGHT>& lights,
+	const SceneBVH& bvh,
+	const glm::vec3& position,
+	const glm::vec3& normal,
+	glm::vec3& ambient,
+	glm::vec3& direct)
+{
+	ambient = glm::vec3(0.0f);
+	direct = glm::vec3(0.0f);
+	glm::vec3 rayOrigin = position + (normal * g_RayOffset);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const BAKED_LIGHT& light = lights[i];
+		glm::vec3 lightDirection;
+		float distance = g_MaxRayDistance;
+		float scale = 1.0f;
+		if (light.type == directionalLight)
+		{
+			lightDirection = glm::normalize(-light.direction);
+		}
+		else
+		{
+			glm::vec3 toLight = light.position - position;
+			distance = glm::length(toLight);
+			if (distance <= 0.0f)
+			{
+				continue;
+			}
+			lightDirection = toLight / distance;
+		}
+		if (light.type == spotLight)
+		{
+			float attenuation = 1.0f / (light.constant + (light.linear * distance) + (light.quadratic * distance * distance));
+			float theta = glm::dot(lightDirection, glm::normalize(-light.direction));
+			float epsilon = light.cutOff - light.outerCutOff;
+			float intensity = (epsilon != 0.0f) ? glm::clamp((theta - light.outerCutOff) / epsilon, 0.0f, 1.0f) : ((theta >= light.cutOff) ? 1.0f : 0.0f);
+			scale = attenuation * intensity;
+		}
+
+		ambient += light.ambient * scale;
+		float diffuse = glm::dot(normal, lightDirection) * scale;
+		if ((diffuse > 0.0f) && !bvh.IsOccluded(rayOrigin, lightDirection, distance - g_RayOffset))
+		{
+			direct += light.diffuse * diffuse;
+		}
+	}
+}
+
+/***********************************************************
+ *  SampleDirectLight()
+ *
+ *  This method is used for reading the direct light of an
+ *  object at a point in its own space, blended from the
+ *  samples of its brick around the point that have a
+ *  surface.
+ ***********************************************************/
+glm::vec3 LightmapBaker::SampleDirectLight(const BAKE_STATE& state, int object, const glm::vec3& localPosition)
+{
+	const LIGHTMAP_BRICK& brick = state.bricks[object];
+	if (brick.size.x == 0)
+	{
+		return glm::vec3(0.0f);
+	}
+
+	glm::vec3 position = glm::clamp((localPosition - brick.boundsMin) / glm::max(brick.boundsSize, glm::vec3(1.0e-6f)), 0.0f, 1.0f) * glm::vec3(brick.size - 1);
+	glm::ivec3 corner;
+	glm::vec3 fraction;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		corner[axis] = std::min((int)position[axis], std::max(brick.size[axis] - 2, 0));
+		fraction[axis] = position[axis] - (float)corner[axis];
+	}
+
+	glm::vec3 total(0.0f);
+	float totalWeight = 0.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::ivec3 offset((i & 1), (i >> 1) & 1, (i >> 2) & 1);
+		glm::ivec3 voxel;
+		float weight = 1.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			voxel[axis] = std::min(corner[axis] + offset[axis], brick.size[axis] - 1);
+			weight *= (offset[axis] != 0) ? fraction[axis] : 1.0f - fraction[axis];
+		}
+		size_t sample = state.firstSamples[object] + ((size_t)voxel.z * brick.size.y + voxel.y) * brick.size.x + voxel.x;
+		if (state.surfaceFlags[sample] == 0)
+		{
+			continue;
+		}
+		total += state.direct[sample] * weight;
+		totalWeight += weight;
+	}
+
+	return (totalWeight > 0.0f) ? total / totalWeight : glm::vec3(0.0f);
+}
+
+/***********************************************************
+ *  GatherBounce()
+ *
+ *  This method is used for gathering the light bounced onto
+ *  a range of samples.  Rays leave a sample over the
+ *  hemisphere of its normal, spread by the cosine so every
+ *  ray counts the same, and are traced four at a time.  A
+ *  ray reflects the direct light of the surface it hits
+ *  times the color of that surface, and a ray hitting the
+ *  back of a surface or nothing brings no light.  The rays
+ *  blocked close to the sample also occlude its ambient
+ *  light, as the vertices of the objects are occluded.
+ ***********************************************************/
+void LightmapBaker::GatherBounce(BAKE_STATE& state, size_t first, size_t last)
+{
+	size_t object = std::upper_bound(state.firstSamples.begin(), state.firstSamples.end(), first) - state.firstSamples.begin() - 1;
+
+	for (size_t sample = first; sample < last; sample++)
+	{
+		while ((object + 1 < state.firstSamples.size()) && (sample >= state.firstSamples[object + 1]))
+		{
+			object++;
+		}
+		if (state.surfaceFlags[sample] == 0)
+		{
+			continue;
+		}
+
+		glm::vec3 normal = state.normals[sample];
+		glm::vec3 origin = state.positions[sample] + (normal * g_RayOffset);
+		uint32_t seed = (uint32_t)(sample * 2654435761u) | 1u;
+
+		glm::vec3 bounce(0.0f);
+		float occlusion = 0.0f;
+		for (int packet = 0; packet < g_BounceRays / 4; packet++)
+		{
+			glm::vec3 origins[4] = { origin, origin, origin, origin };
+			glm::vec3 directions[4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				directions[lane] = SceneBVH::GetHemisphereRay(normal, (packet * 4) + lane, g_BounceRays, seed);
+			}
+
+			SceneBVH::RAY_HIT hits[4];
+			state.bvh.IntersectPacket(origins, directions, g_MaxRayDistance, hits);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (hits[lane].triangle < 0)
+				{
+					continue;
+				}
+				occlusion += OcclusionBaker::GetHitOcclusion(hits[lane].distance);
+				const SceneCapture::CAPTURED_VERTEX* vertices = &state.vertices[(size_t)hits[lane].triangle * 3];
+				float u = hits[lane].u;
+				float v = hits[lane].v;
+				glm::vec3 hitNormal = (vertices[0].normal * (1.0f - u - v)) + (vertices[1].normal * u) + (vertices[2].normal * v);
+				if (glm::dot(hitNormal, directions[lane]) >= 0.0f)
+				{
+					continue;
+				}
+				glm::vec3 hitLocal = (vertices[0].localPosition * (1.0f - u - v)) + (vertices[1].localPosition * u) + (vertices[2].localPosition * v);
+				int hitObject = state.triangleObjects[hits[lane].triangle];
+				bounce += state.objects[hitObject].albedo * SampleDirectLight(state, hitObject, hitLocal);
+			}
+		}
+
+		glm::vec3 indirect = state.objects[object].diffuseColor * bounce / (float)g_BounceRays;
+		// the ambient light is occluded by the surfaces close by
+		glm::vec3 ambient = state.ambient[sample] * (1.0f - (occlusion / (float)g_BounceRays));
+		state.light[sample] = ambient + state.direct[sample] + indirect;
+	}
+}
+
+/***********************************************************
+ *  FinishBake()
+ *
+ *  This method is used for uploading the atlas of a bake
+ *  that has finished, and writing it to the cache file.  A
+ *  bake for a scene or lights that have changed since it
+ *  started is dropped.
+ ***********************************************************/
+void LightmapBaker::FinishBake()
+{
+	std::shared_ptr<BAKE_STATE> state = m_bake;
+	m_bake.reset();
+
+	if (state->bFailed || (state->sceneHash != m_sceneHash) || (state->lightHash != m_lightHash))
+	{
+		return;
+	}
+
+	m_bricks = state->bricks;
+	if (!CreateAtlas(state->atlasWidth, state->atlasHeight, state->texels))
+	{
+		return;
+	}
+	m_atlasSceneHash = state->sceneHash;
+	m_atlasLightHash = state->lightHash;
+	m_bakeMilliseconds = state->milliseconds;
+	std::cout << "Baked the lightmaps into a " << state->atlasWidth << "x" << state->atlasHeight
+		<< " atlas in " << state->milliseconds << " ms" << std::endl;
+
+	SaveCache(state->atlasWidth, state->atlasHeight, state->texels);
+}
+
+/***********************************************************
+ *  CreateAtlas()
+ *
+ *  This method is used for creating the atlas texture.  The
+ *  light is kept as three 9 bit values sharing an exponent,
+ *  a third of the size of floats, and is filtered linearly
+ *  within the slices of a brick - the shader blends two
+ *  slices itself.
+ ***********************************************************/
+bool LightmapBaker::CreateAtlas(int width, int height, const std::vector<uint32_t>& texels)
+{
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	if ((width > maxSize) || (height > maxSize))
+	{
+		std::cout << "The lightmap atlas is larger than the textures of the driver" << std::endl;
+		return false;
+	}
+
+	if (m_atlasTexture == 0)
+	{
+		glGenTextures(1, &m_atlasTexture);
+	}
+	glBindTexture(GL_TEXTURE_2D, m_atlasTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB9_E5, width, height, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, texels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return true;
+}
+
+/***********************************************************
+ *  LoadCache()
+ *
+ *  This method is used for loading the atlas from the cache
+ *  file when it was baked for the current scene and lights.
+ ***********************************************************/
+bool LightmapBaker::LoadCache()
+{
+	std::error_code error;
+	if (m_cacheFile.empty() || !std::filesystem::is_regular_file(m_cacheFile, error))
+	{
+		return false;
+	}
+
+	MappedFile file;
+	if (!file.Open(m_cacheFile) || (file.GetSize() < g_CacheHeaderSize))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	uint32_t brickCount = ReadUInt32(data, 12);
+	uint32_t width = ReadUInt32(data, 32);
+	uint32_t height = ReadUInt32(data, 36);
+	size_t brickBytes = (size_t)brickCount * g_CacheBrickSize;
+	size_t texelBytes = (size_t)width * height * sizeof(uint32_t);
+	if ((memcmp(data, g_CacheIdentifier, sizeof(g_CacheIdentifier)) != 0) ||
+		(ReadUInt32(data, 8) != g_CacheVersion) ||
+		(ReadUInt64(data, 16) != m_sceneHash) ||
+		(ReadUInt64(data, 24) != m_lightHash) ||
+		(brickCount != m_objects.size()) ||
+		(file.GetSize() != g_CacheHeaderSize + brickBytes + texelBytes) ||
+		(ResourceRegistry::HashBytes(data + g_CacheHeaderSize, brickBytes + texelBytes) != ReadUInt64(data, 40)))
+	{
+		return false;
+	}
+
+	std::vector<LIGHTMAP_BRICK> bricks(brickCount);
+	for (uint32_t i = 0; i < brickCount; i++)
+	{
+		const unsigned char* record = data + g_CacheHeaderSize + (i * g_CacheBrickSize);
+		memcpy(&bricks[i].boundsMin[0], record, 12);
+		memcpy(&bricks[i].boundsSize[0], record + 12, 12);
+		memcpy(&bricks[i].size[0], record + 24, 12);
+		memcpy(&bricks[i].columns, record + 36, 4);
+		memcpy(&bricks[i].atlasOrigin[0], record + 40, 8);
+	}
+	std::vector<uint32_t> texels((size_t)width * height);
+	memcpy(texels.data(), data + g_CacheHeaderSize + brickBytes, texelBytes);
+
+	if (!CreateAtlas((int)width, (int)height, texels))
+	{
+		return false;
+	}
+	m_bricks = bricks;
+	m_atlasSceneHash = m_sceneHash;
+	m_atlasLightHash = m_lightHash;
+	m_bakeMilliseconds = 0.0;
+	std::cout << "Loaded the lightmaps from the cache file:" << m_cacheFile << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  SaveCache()
+ *
+ *  This method is used for writing the atlas and its bricks
+ *  to the cache file, under a temporary name that is then
+ *  renamed so a reader never sees half of it.
+ ***********************************************************/
+void LightmapBaker::SaveCache(int width, int height, const std::vector<uint32_t>& texels) const
+{
+	if (m_cacheFile.empty())
+	{
+		return;
+	}
+
+	size_t brickBytes = m_bricks.size() * g_CacheBrickSize;
+	size_t texelBytes = texels.size() * sizeof(uint32_t);
+	std::vector<unsigned char> data(g_CacheHeaderSize + brickBytes + texelBytes, 0);
+	for (size_t i = 0; i < m_bricks.size(); i++)
+	{
+		unsigned char* record = &data[g_CacheHeaderSize + (i * g_CacheBrickSize)];
+		memcpy(record, &m_bricks[i].boundsMin[0], 12);
+		memcpy(record + 12, &m_bricks[i].boundsSize[0], 12);
+		memcpy(record + 24, &m_bricks[i].size[0], 12);
+		memcpy(record + 36, &m_bricks[i].columns, 4);
+		memcpy(record + 40, &m_bricks[i].atlasOrigin[0], 8);
+	}
+	if (texelBytes > 0)
+	{
+		memcpy(&data[g_CacheHeaderSize + brickBytes], texels.data(), texelBytes);
+	}
+
+	memcpy(&data[0], g_CacheIdentifier, sizeof(g_CacheIdentifier));
+	WriteUInt32(data, 8, g_CacheVersion);
+	WriteUInt32(data, 12, (uint32_t)m_bricks.size());
+	WriteUInt64(data, 16, m_atlasSceneHash);
+	WriteUInt64(data, 24, m_atlasLightHash);
+	WriteUInt32(data, 32, (uint32_t)width);
+	WriteUInt32(data, 36, (uint32_t)height);
+	WriteUInt64(data, 40, ResourceRegistry::HashBytes(&data[g_CacheHeaderSize], brickBytes + texelBytes));
+
+	std::string tempFile = m_cacheFile + ".tmp";
+	std::error_code error;
+	std::filesystem::path folder = std::filesystem::path(m_cacheFile).parent_path();
+	if (!folder.empty())
+	{
+		std::filesystem::create_directories(folder, error);
+	}
+	{
+		std::ofstream output(tempFile, std::ios::binary | std::ios::trunc);
+		output.write((const char*)data.data(), (std::streamsize)data.size());
+		if (!output.good())
+		{
+			std::cout << "Could not write lightmap cache file:" << m_cacheFile << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(tempFile, m_cacheFile, error);
+	if (error)
+	{
+		std::cout << "Could not write lightmap cache file:" << m_cacheFile << std::endl;
+		std::filesystem::remove(tempFile, error);
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a frame, whose objects
+ *  are matched to the bricks in their drawing order.
+ ***********************************************************/
+void LightmapBaker::BeginFrame()
+{
+	m_currentObject = -1;
+	m_bObjectBaked = false;
+}
+
+/***********************************************************
+ *  SetObject()
+ *
+ *  This method is used for selecting the brick of the next
+ *  drawn object.  An object drawn with another transform
+ *  than the one it was baked at has no brick, and is lit by
+ *  the shader.
+ ***********************************************************/
+void LightmapBaker::SetObject(uint64_t transformHash)
+{
+	SelectObject(m_currentObject + 1, transformHash);
+}
+
+/***********************************************************
+ *  GetCurrentObject()
+ *
+ *  This method is used for getting the drawing order of the
+ *  current object in the frame.
+ ***********************************************************/
+int LightmapBaker::GetCurrentObject() const
+{
+	return m_currentObject;
+}
+
+/***********************************************************
+ *  SelectObject()
+ *
+ *  This method is used for selecting the brick of an object
+ *  by its drawing order, for an object that is drawn again
+ *  after the others.
+ ***********************************************************/
+void LightmapBaker::SelectObject(int object, uint64_t transformHash)
+{
+	m_currentObject = object;
+	m_bObjectBaked = IsReady() && (m_currentObject >= 0) && (m_currentObject < (int)m_bricks.size()) &&
+		(m_transformHashes[m_currentObject] == transformHash) && (m_bricks[m_currentObject].size.x > 0);
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding the atlas to its texture
+ *  unit.
+ ***********************************************************/
+void LightmapBaker::BindTexture() const
+{
+	if (m_atlasTexture == 0)
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + g_AtlasTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, m_atlasTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for setting the atlas and the brick
+ *  of the current object on a program that draws with the
+ *  lightmaps - a brick of no samples for an object that was
+ *  not baked.
+ ***********************************************************/
+void LightmapBaker::SetShaderValues(GLuint program) const
+{
+	glUniform1i(glGetUniformLocation(program, "lightmapAtlas"), g_AtlasTextureUnit);
+	if (!m_bObjectBaked)
+	{
+		glUniform3i(glGetUniformLocation(program, "lightmapBrickSize"), 0, 0, 0);
+		return;
+	}
+
+	const LIGHTMAP_BRICK& brick = m_bricks[m_currentObject];
+	glUniform3f(glGetUniformLocation(program, "lightmapBoundsMin"), brick.boundsMin.x, brick.boundsMin.y, brick.boundsMin.z);
+	glUniform3f(glGetUniformLocation(program, "lightmapBoundsSize"), brick.boundsSize.x, brick.boundsSize.y, brick.boundsSize.z);
+	glUniform3i(glGetUniformLocation(program, "lightmapBrickSize"), brick.size.x, brick.size.y, brick.size.z);
+	glUniform3i(glGetUniformLocation(program, "lightmapBrickLayout"), brick.atlasOrigin.x, brick.atlasOrigin.y, brick.columns);
+}
+
+/***********************************************************
+ *  HashLights()
+ *
+ *  This method is used for getting the hash of a list of
+ *  lights, from every value the bake reads.
+ ***********************************************************/
+uint64_t LightmapBaker::HashLights(const std::vector<BAKED_LIGHT>& lights)
+{
+	uint64_t hash = ResourceRegistry::HashBytes(NULL, 0);
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const BAKED_LIGHT& light = lights[i];
+		float values[17] = {
+			(float)light.type,
+			light.position.x, light.position.y, light.position.z,
+			light.direction.x, light.direction.y, light.direction.z,
+			light.ambient.x, light.ambient.y, light.ambient.z,
+			light.diffuse.x, light.diffuse.y, light.diffuse.z,
+			light.cutOff, light.outerCutOff, light.constant, light.linear };
+		hash = ResourceRegistry::HashBytes(values, sizeof(values), hash);
+		hash = ResourceRegistry::HashBytes(&light.quadratic, sizeof(light.quadratic), hash);
+	}
+
+	return hash;
+}
+
+/***********************************************************
+ *  PackSharedExponent()
+ *
+ *  This method is used for packing a color into three 9 bit
+ *  values and a 5 bit exponent they share, as the RGB9_E5
+ *  format reads them.
+ ***********************************************************/
+uint32_t LightmapBaker::PackSharedExponent(const glm::vec3& color)
+{
+	const int mantissaBits = 9;
+	const int exponentBias = 15;
+	const int maxExponent = 31;
+	const float maxValue = (511.0f / 512.0f) * std::ldexp(1.0f, maxExponent - exponentBias);
+
+	glm::vec3 clamped = glm::clamp(color, glm::vec3(0.0f), glm::vec3(maxValue));
+	float largest = std::max(clamped.x, std::max(clamped.y, clamped.z));
+	if (largest <= 0.0f)
+	{
+		return 0;
+	}
+
+	int exponent = std::max(-exponentBias - 1, (int)std::floor(std::log2(largest))) + 1 + exponentBias;
+	float scale = std::ldexp(1.0f, exponent - exponentBias - mantissaBits);
+	if ((int)std::floor((largest / scale) + 0.5f) == (1 << mantissaBits))
+	{
+		exponent++;
+		scale *= 2.0f;
+	}
+
+	uint32_t red = (uint32_t)std::floor((clamped.x / scale) + 0.5f);
+	uint32_t green = (uint32_t)std::floor((clamped.y / scale) + 0.5f);
+	uint32_t blue = (uint32_t)std::floor((clamped.z / scale) + 0.5f);
+	return red | (green << 9) | (blue << 18) | ((uint32_t)exponent << 27);
+}
@@ -0,0 +1,178 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.h
+// ============
+// bake the light of the static scene lights into a lightmap atlas on the
+// worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneBVH.h"
+#include "SceneCapture.h"
+#include "ThreadPool.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  LightmapBaker
+ *
+ *  This class contains the code for baking the scene lights
+ *  into lightmaps.  The meshes have no lightmap coordinates
+ *  of their own, so every object gets a brick of light
+ *  samples over the box it takes up in its own space, which
+ *  the fragment shader reads back with its position in the
+ *  object - the samples are placed on the nearest surface
+ *  of the object, lit directly with shadow rays and
+ *  indirectly with one bounce gathered in ray packets from
+ *  the directly lit bricks.  The bake runs on the worker
+ *  threads while the frames are lit by the shader, and the
+ *  bricks are then packed into an atlas that is cached on
+ *  disk - a later run with the same triangles and lights
+ *  loads it instead of baking, and a change of the lights
+ *  bakes it again.
+ ***********************************************************/
+class LightmapBaker
+{
+public:
+	// constructor
+	LightmapBaker();
+	// destructor
+	~LightmapBaker();
+
+	// the atlas cannot be shared between two objects
+	LightmapBaker(const LightmapBaker&) = delete;
+	LightmapBaker& operator=(const LightmapBaker&) = delete;
+
+	enum LightType
+	{
+		directionalLight,
+		pointLight,
+		spotLight
+	};
+
+	// a scene light, as set up on the shader program
+	struct BAKED_LIGHT
+	{
+		LightType type;
+		glm::vec3 position;
+		glm::vec3 direction;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		// the cone and the attenuation of the spot light
+		float cutOff;
+		float outerCutOff;
+		float constant;
+		float linear;
+		float quadratic;
+	};
+
+	// the samples of an object, and where they are in the atlas - the
+	// slices of the brick along its z axis are laid out in rows
+	struct LIGHTMAP_BRICK
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsSize;
+		glm::ivec3 size;
+		int columns;
+		glm::ivec2 atlasOrigin;
+	};
+
+private:
+	struct BAKE_STATE;
+
+	std::string m_cacheFile;
+	GLuint m_atlasTexture;
+	// the bricks of the objects in their drawing order, with the hash of
+	// the transform each was baked for
+	std::vector<LIGHTMAP_BRICK> m_bricks;
+	std::vector<uint64_t> m_transformHashes;
+	// the hashes of the scene and lights in the atlas, and of the ones
+	// set since
+	uint64_t m_atlasSceneHash;
+	uint64_t m_atlasLightHash;
+	uint64_t m_sceneHash;
+	uint64_t m_lightHash;
+	bool m_bSceneSet;
+	bool m_bLightsSet;
+	// the scene and lights to bake
+	std::vector<BAKED_LIGHT> m_lights;
+	std::vector<SceneCapture::CAPTURED_OBJECT> m_objects;
+	std::vector<SceneCapture::CAPTURED_VERTEX> m_vertices;
+	// the bake running on the worker threads, NULL when none is
+	std::shared_ptr<BAKE_STATE> m_bake;
+	// the object being drawn
+	int m_currentObject;
+	bool m_bObjectBaked;
+	double m_bakeMilliseconds;
+
+	// lay the bricks out and start baking them
+	void StartBake(ThreadPool* threadPool);
+	// upload a finished bake into the atlas
+	void FinishBake();
+	// create the atlas texture from its texels
+	bool CreateAtlas(int width, int height, const std::vector<uint32_t>& texels);
+	// read the atlas from the cache file, or write it there
+	bool LoadCache();
+	void SaveCache(int width, int height, const std::vector<uint32_t>& texels) const;
+
+	// the steps of a bake, run on the worker threads
+	static void QueueBakeJobs(std::shared_ptr<BAKE_STATE> state, ThreadPool* threadPool);
+	static void PlaceSamples(BAKE_STATE& state, size_t first, size_t last);
+	static void GatherBounce(BAKE_STATE& state, size_t first, size_t last);
+	static glm::vec3 SampleDirectLight(const BAKE_STATE& state, int object, const glm::vec3& localPosition);
+
+public:
+	// set the path of the cache file
+	void Initialize(const std::string& cacheFile);
+
+	// set the scene lights - the lightmaps are baked again when they
+	// have changed
+	void SetLights(const std::vector<BAKED_LIGHT>& lights);
+	// set the captured scene the lightmaps are baked for
+	void SetScene(const SceneCapture& capture);
+	// load the cached atlas or start a bake when the scene or the lights
+	// have changed, and upload a finished bake - call once per frame
+	void Update(ThreadPool* threadPool);
+	// check if the atlas matches the scene and the lights
+	bool IsReady() const;
+	// check if a bake is running
+	bool IsBaking() const;
+	// get the time the last bake took in milliseconds
+	double GetBakeTime() const;
+
+	// start a frame - the objects are matched to their bricks by their
+	// drawing order and transforms
+	void BeginFrame();
+	// select the brick of the next drawn object
+	void SetObject(uint64_t transformHash);
+	// get the drawing order of the current object, and select the brick
+	// of an object drawn earlier in the frame again
+	int GetCurrentObject() const;
+	void SelectObject(int object, uint64_t transformHash);
+	// bind the atlas for the lit programs - call once per frame
+	void BindTexture() const;
+	// set the brick of the current object on a program that draws with
+	// the lightmaps
+	void SetShaderValues(GLuint program) const;
+
+	// get the hash of a list of lights
+	static uint64_t HashLights(const std::vector<BAKED_LIGHT>& lights);
+	// pack a color into the shared exponent format of the atlas
+	static uint32_t PackSharedExponent(const glm::vec3& color);
+	// light a point of a surface with a list of lights, the diffuse light
+	// only where the lights are not blocked
+	static void LightSurface(
+		const std::vector<BAKED_LIGHT>& lights,
+		const SceneBVH& bvh,
+		const glm::vec3& position,
+		const glm::vec3& normal,
+		glm::vec3& ambient,
+		glm::vec3& direct);
+};
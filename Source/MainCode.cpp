@@ -9,6 +9,12 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp, strncmp
+#include <chrono>           // startup and frame timing
+#include <functional>       // benchmark frame callbacks
+#include <iomanip>          // benchmark table
+#include <random>           // benchmark sort distances
+#include <vector>
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -18,6 +24,11 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "AssetPack.h"
+#include "ImageProcessing.h"
+#include "ProgramCache.h"
+#include "ResourceRegistry.h"
+#include "ShaderCompiler.h"
 #include "SceneManager.h"
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
@@ -30,6 +41,17 @@ namespace
 	const char* const WINDOW_TITLE = "7-1 FinalProject and Milestones"; 
 	// software version number
 	const char* const SW_VERSION = "20240902SMGA135";
+	// asset pack that is read instead of the loose asset files when present
+	const char* const ASSET_PACK_FILE = "assets.pak";
+	// shader source files of the scene program
+	const char* const VERTEX_SHADER_FILE = "shaders/vertexShader.glsl";
+	const char* const FRAGMENT_SHADER_FILE = "shaders/fragmentShader.glsl";
+	// folder next to the executable that linked programs are cached in
+	const char* const PROGRAM_CACHE_FOLDER = "shadercache";
+	// number of candles and fairy lights on the table by default
+	const int DEFAULT_LOCAL_LIGHTS = 256;
+	// number of frames every benchmark run is timed over
+	const int BENCHMARK_FRAMES = 100;
 
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
@@ -40,6 +62,10 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// registry handle of the shader program, which the shader manager owns
+	std::shared_ptr<GLuint> g_ShaderProgram;
+	// the resolution scale last printed to the console
+	float g_ReportedScale = 1.0f;
 }
 
 int main(int argc, char* argv[]);
@@ -48,6 +74,16 @@ int main(int argc, char* argv[]);
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+SceneManager::TextureQuality GetTextureQuality(int argc, char* argv[]);
+int GetLocalLightCount(int argc, char* argv[]);
+void SetResolutionOptions(int argc, char* argv[]);
+void RenderFrame();
+double TimeFrames(int warmupFrames, std::function<bool()> isReady, std::function<void()> onFrame);
+void RunLightBenchmark();
+void RunOcclusionBenchmark();
+void RunTransparencyBenchmark();
+void RunDepthPrepassBenchmark();
+void RunResolutionBenchmark();
 
 
 /***********************************************************
@@ -58,6 +94,29 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// measure the texture preprocessing kernels, or pack the asset
+	// folders into a single file, without opening a window
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark-images") == 0)
+		{
+			ImageProcessing::RunBenchmarks();
+			return(EXIT_SUCCESS);
+		}
+		if (strcmp(argv[i], "--pack") == 0)
+		{
+			std::vector<std::string> folders = { "textures", "shaders", "meshes" };
+			const char* packFile = ((i + 1) < argc) ? argv[i + 1] : ASSET_PACK_FILE;
+			return(AssetPack::Build(packFile, folders) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	// a deployment can ship the assets as one pack file
+	if (AssetPack::Mount(ASSET_PACK_FILE))
+	{
+		std::cout << "Reading assets from " << ASSET_PACK_FILE << std::endl;
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -82,19 +141,146 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"shaders/vertexShader.glsl",
-		"shaders/fragmentShader.glsl");
+	// cache the linked shader programs unless told to build them all
+	// from source, for comparing the startup times
+	bool bProgramCache = true;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-program-cache") == 0)
+		{
+			bProgramCache = false;
+		}
+	}
+	if (bProgramCache && !ProgramCache::Open(PROGRAM_CACHE_FOLDER))
+	{
+		std::cout << "The driver cannot cache program binaries" << std::endl;
+	}
+
+	// build the shader program from the external GLSL files, loading
+	// it from the program cache when it is there
+	std::chrono::steady_clock::time_point shaderStart = std::chrono::steady_clock::now();
+	std::string vertexSource;
+	std::string fragmentSource;
+	GLuint program = 0;
+	bool bProgramCached = false;
+	if (ShaderCompiler::ReadSource(VERTEX_SHADER_FILE, vertexSource) &&
+		ShaderCompiler::ReadSource(FRAGMENT_SHADER_FILE, fragmentSource))
+	{
+		ShaderCompiler compiler;
+		compiler.Start("scene shaders", vertexSource, fragmentSource);
+		program = compiler.Finish();
+		bProgramCached = compiler.WasCached();
+	}
+	if (program != 0)
+	{
+		g_ShaderManager->m_programID = program;
+	}
+	else
+	{
+		// let the shader manager report the errors
+		g_ShaderManager->LoadShaders(
+			VERTEX_SHADER_FILE,
+			FRAGMENT_SHADER_FILE);
+	}
 	g_ShaderManager->use();
+	std::chrono::duration<double, std::milli> shaderTime = std::chrono::steady_clock::now() - shaderStart;
+	std::cout << "Scene shaders " << (bProgramCached ? "loaded from the program cache" : "compiled") <<
+		" in " << shaderTime.count() << " ms" << std::endl;
+
+	// register the shader program under the hash of its sources so it
+	// is counted with the other live resources
+	uint64_t vertexHash = 0;
+	uint64_t fragmentHash = 0;
+	if (ResourceRegistry::HashFile(VERTEX_SHADER_FILE, vertexHash) &&
+		ResourceRegistry::HashFile(FRAGMENT_SHADER_FILE, fragmentHash))
+	{
+		g_ShaderProgram = ResourceRegistry::Get().Register<GLuint>(
+			ResourceRegistry::shaderProgram,
+			ResourceRegistry::HashBytes(&fragmentHash, sizeof(fragmentHash), vertexHash),
+			"scene shaders",
+			new GLuint(g_ShaderManager->m_programID),
+			[](GLuint*) {});
+	}
 
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(g_ShaderManager, g_Window);
+	g_SceneManager->SetTextureQuality(GetTextureQuality(argc, argv));
+	g_SceneManager->SetShaderFiles(VERTEX_SHADER_FILE, FRAGMENT_SHADER_FILE);
+	g_SceneManager->SetLocalLightCount(GetLocalLightCount(argc, argv));
 	g_SceneManager->PrepareScene();
+	// reload the textures and shaders when they are edited
+	g_SceneManager->WatchAssetFiles();
+
+	// start with deferred shading, or the object light lists, when asked
+	// to - and light the scene in the shader instead of baking it - and
+	// note the benchmarks to run instead of the interactive loop
+	std::vector<void (*)()> benchmarks;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--dynamic-lights") == 0)
+		{
+			g_SceneManager->SetUseLightmaps(false);
+		}
+		if ((strcmp(argv[i], "--deferred") == 0) && !g_SceneManager->SetRenderPath(SceneManager::deferredShading))
+		{
+			std::cout << "Deferred shading is not supported - using forward shading" << std::endl;
+		}
+		if ((strcmp(argv[i], "--object-lights") == 0) && !g_SceneManager->SetLightListMode(SceneManager::objectLightLists))
+		{
+			std::cout << "Object light lists are not supported - using the clusters" << std::endl;
+		}
+		if (strcmp(argv[i], "--sorted-transparency") == 0)
+		{
+			g_SceneManager->SetTransparencyMode(SceneManager::sortedTransparency);
+		}
+		if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			g_SceneManager->SetDepthPrepassMode(SceneManager::alwaysDepthPrepass);
+		}
+		if (strcmp(argv[i], "--no-depth-prepass") == 0)
+		{
+			g_SceneManager->SetDepthPrepassMode(SceneManager::noDepthPrepass);
+		}
+		// time the frames with more and more local lights
+		if (strcmp(argv[i], "--benchmark-lights") == 0)
+		{
+			benchmarks.push_back(RunLightBenchmark);
+		}
+		// time baking the ambient occlusion of the scene and of many
+		// copies of it
+		if (strcmp(argv[i], "--benchmark-occlusion") == 0)
+		{
+			benchmarks.push_back(RunOcclusionBenchmark);
+		}
+		// time the frames with the transparent objects blended by each
+		// mode, and sorting more and more objects
+		if (strcmp(argv[i], "--benchmark-transparency") == 0)
+		{
+			benchmarks.push_back(RunTransparencyBenchmark);
+		}
+		// time the forward frames with and without the depth pre-pass,
+		// and with it chosen automatically
+		if (strcmp(argv[i], "--benchmark-prepass") == 0)
+		{
+			benchmarks.push_back(RunDepthPrepassBenchmark);
+		}
+		// time the frames at the window resolution, at fixed scales of
+		// it, and at the scale that keeps them within the frame time
+		if (strcmp(argv[i], "--benchmark-resolution") == 0)
+		{
+			benchmarks.push_back(RunResolutionBenchmark);
+		}
+	}
+	// the frames are drawn at the scale that keeps them within the frame
+	// time unless told otherwise
+	SetResolutionOptions(argc, argv);
 
-	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
-	g_SceneManager->PrepareScene();
+	// run the benchmarks that were asked for, then exit
+	for (size_t i = 0; i < benchmarks.size(); i++)
+	{
+		benchmarks[i]();
+		glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+	}
 
 	std::cout << "\n***** KEY FUNCTIONS: *****\n";
 	std::cout << "ESC - close the window and exit\n";
@@ -107,6 +293,7 @@ int main(int argc, char* argv[])
 	std::cout << "I - side orthographic view\n";
 	std::cout << "U - top orthographic view\n";
 	std::cout << "P - perspective view\n";
+	std::cout << "G - switch between forward and deferred shading\n";
 	std::cout << "Mouse Wheel Scroll to Zoom In/Out\n";
 
 
@@ -114,25 +301,7 @@ int main(int argc, char* argv[])
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
-
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
-
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
-
-
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
-
-		// query the latest GLFW events
-		glfwPollEvents();
+		RenderFrame();
 	}
 
 	// clear the allocated manager objects from memory
@@ -141,6 +310,15 @@ int main(int argc, char* argv[])
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
+	g_ShaderProgram.reset();
+
+	if (ProgramCache::GetOpened() != NULL)
+	{
+		ProgramCache::GetOpened()->PrintStatistics();
+	}
+
+	// every resource should have been freed with its scene
+	ResourceRegistry::Get().PrintLiveResources();
 	if (NULL != g_ViewManager)
 	{
 		delete g_ViewManager;
@@ -209,3 +387,546 @@ bool InitializeGLEW()
 
 	return(true);
 }
+
+/***********************************************************
+ *	GetTextureQuality()
+ *
+ *  This function is used to read the texture quality preset
+ *  from the command line, given as --texture-quality=high,
+ *  medium, low or lowest.  The default is high.
+ ***********************************************************/
+SceneManager::TextureQuality GetTextureQuality(int argc, char* argv[])
+{
+	const char* const QUALITY_OPTION = "--texture-quality=";
+	const char* const QUALITY_NAMES[] = { "high", "medium", "low", "lowest" };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], QUALITY_OPTION, strlen(QUALITY_OPTION)) != 0)
+		{
+			continue;
+		}
+
+		const char* value = argv[i] + strlen(QUALITY_OPTION);
+		for (int quality = SceneManager::high; quality <= SceneManager::lowest; quality++)
+		{
+			if (strcmp(value, QUALITY_NAMES[quality]) == 0)
+			{
+				return (SceneManager::TextureQuality)quality;
+			}
+		}
+		std::cout << "Unknown texture quality " << value << " - using high" << std::endl;
+	}
+
+	return SceneManager::high;
+}
+
+/***********************************************************
+ *	RenderFrame()
+ *
+ *  This function is used to render one frame of the scene
+ *  and present it.
+ ***********************************************************/
+void RenderFrame()
+{
+	// swap in any edited assets before the frame uses them
+	g_SceneManager->ReloadChangedAssets();
+
+	// draw into the target of the resolution the frame is drawn at
+	g_SceneManager->BeginFrame();
+
+	// Enable z-depth
+	glEnable(GL_DEPTH_TEST);
+
+	// Clear the frame and z buffers
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// convert from 3D object space to 2D view
+	g_ViewManager->PrepareSceneView();
+
+	// switch between forward and deferred shading
+	if (g_ViewManager->WasRenderPathToggled())
+	{
+		SceneManager::RenderPath path = (g_SceneManager->GetRenderPath() == SceneManager::forwardShading) ?
+			SceneManager::deferredShading : SceneManager::forwardShading;
+		if (g_SceneManager->SetRenderPath(path))
+		{
+			std::cout << "Rendering with " << SceneManager::GetRenderPathName(path) << std::endl;
+		}
+		else
+		{
+			std::cout << "Deferred shading is not supported" << std::endl;
+		}
+	}
+
+	// pass the camera values used for the level of detail selection
+	// and by the shader program variants
+	g_SceneManager->SetCameraView(
+		g_ViewManager->GetViewMatrix(),
+		g_ViewManager->GetProjectionMatrix(),
+		g_ViewManager->GetCameraPosition(),
+		g_ViewManager->GetViewportHeight());
+
+	// refresh the 3D scene
+	g_SceneManager->RenderScene();
+
+	// report the resolution when the dynamic scale has moved it
+	float scale = g_SceneManager->GetResolutionScale();
+	if ((g_SceneManager->GetResolutionMode() == SceneManager::dynamicResolution) && (scale != g_ReportedScale))
+	{
+		std::cout << "Drawing at " << (int)((scale * 100.0f) + 0.5f) << "% of the window resolution (GPU " <<
+			std::fixed << std::setprecision(1) << g_SceneManager->GetGpuFrameTime() << " ms, CPU " <<
+			g_SceneManager->GetCpuFrameTime() << " ms per frame)" << std::defaultfloat << std::endl;
+		g_ReportedScale = scale;
+	}
+
+	// Flips the the back buffer with the front buffer every frame.
+	glfwSwapBuffers(g_Window);
+
+	// query the latest GLFW events
+	glfwPollEvents();
+}
+
+/***********************************************************
+ *	GetLocalLightCount()
+ *
+ *  This function is used to read the number of candles and
+ *  fairy lights on the table from the command line, given
+ *  as --local-lights=<count>.
+ ***********************************************************/
+int GetLocalLightCount(int argc, char* argv[])
+{
+	const char* const LIGHTS_OPTION = "--local-lights=";
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], LIGHTS_OPTION, strlen(LIGHTS_OPTION)) == 0)
+		{
+			return atoi(argv[i] + strlen(LIGHTS_OPTION));
+		}
+	}
+
+	return DEFAULT_LOCAL_LIGHTS;
+}
+
+/***********************************************************
+ *	SetResolutionOptions()
+ *
+ *  This function is used to read the resolution the frames
+ *  are drawn at from the command line.  --native-resolution
+ *  draws them at the window resolution, --resolution-scale=
+ *  <scale> at a fixed scale of it, and otherwise the scale
+ *  keeps them within --frame-target=<ms>, 16.6 by default,
+ *  no lower than --min-resolution-scale=<scale>.
+ ***********************************************************/
+void SetResolutionOptions(int argc, char* argv[])
+{
+	const char* const SCALE_OPTION = "--resolution-scale=";
+	const char* const MIN_SCALE_OPTION = "--min-resolution-scale=";
+	const char* const TARGET_OPTION = "--frame-target=";
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], MIN_SCALE_OPTION, strlen(MIN_SCALE_OPTION)) == 0)
+		{
+			g_SceneManager->SetResolutionScaleBounds((float)atof(argv[i] + strlen(MIN_SCALE_OPTION)), 1.0f);
+		}
+		if (strncmp(argv[i], TARGET_OPTION, strlen(TARGET_OPTION)) == 0)
+		{
+			g_SceneManager->SetFrameTimeTarget(atof(argv[i] + strlen(TARGET_OPTION)));
+		}
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], SCALE_OPTION, strlen(SCALE_OPTION)) == 0)
+		{
+			g_SceneManager->SetResolutionScale((float)atof(argv[i] + strlen(SCALE_OPTION)));
+			if (!g_SceneManager->SetResolutionMode(SceneManager::fixedResolution))
+			{
+				std::cout << "The frames cannot be scaled - drawing at the window resolution" << std::endl;
+			}
+		}
+		if (strcmp(argv[i], "--native-resolution") == 0)
+		{
+			g_SceneManager->SetResolutionMode(SceneManager::nativeResolution);
+		}
+	}
+}
+
+/***********************************************************
+ *	TimeFrames()
+ *
+ *  This function is used to time the frames of one run of
+ *  a benchmark.  The frames are presented as fast as they
+ *  render, after the warm-up frames and any more the run
+ *  needs to be ready, and the callback is called after each
+ *  timed frame.  It returns the average ms per frame.
+ ***********************************************************/
+double TimeFrames(int warmupFrames, std::function<bool()> isReady, std::function<void()> onFrame)
+{
+	glfwSwapInterval(0);
+
+	// the first frames finish building the programs of the run
+	for (int frame = 0; (frame < warmupFrames) || !isReady(); frame++)
+	{
+		RenderFrame();
+	}
+	glFinish();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+	{
+		RenderFrame();
+		if (onFrame)
+		{
+			onFrame();
+		}
+	}
+	glFinish();
+	std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - start;
+
+	// the frames outside the timed runs wait for the display refresh
+	glfwSwapInterval(1);
+
+	return frameTime.count() / BENCHMARK_FRAMES;
+}
+
+/***********************************************************
+ *	RunLightBenchmark()
+ *
+ *  This function is used to time the frames of the scene
+ *  with 5 to 4096 local lights, shaded forward with the
+ *  lights assigned to the clusters by every mode the driver
+ *  supports and with the lights listed per object, and
+ *  shaded deferred.  It prints the average frame time and
+ *  light assignment time.
+ ***********************************************************/
+void RunLightBenchmark()
+{
+	const int LIGHT_COUNTS[] = { 5, 16, 64, 256, 1024, 4096 };
+	const ClusteredLights::AssignMode ASSIGN_MODES[] = {
+		ClusteredLights::computeShader,
+		ClusteredLights::cpuScalar,
+		ClusteredLights::cpuSSE2 };
+	// the forward runs, one per assignment mode and one with the object
+	// light lists, then the deferred run
+	const size_t ASSIGN_MODE_COUNT = sizeof(ASSIGN_MODES) / sizeof(ASSIGN_MODES[0]);
+	const size_t RUN_COUNT = ASSIGN_MODE_COUNT + 2;
+	const int WARMUP_FRAMES = 20;
+
+	SceneManager::RenderPath startPath = g_SceneManager->GetRenderPath();
+	SceneManager::LightListMode startListMode = g_SceneManager->GetLightListMode();
+
+	std::cout << "\n***** LOCAL LIGHTS (average ms per frame): *****\n";
+	std::cout << std::left << std::setw(8) << "lights" << std::setw(18) << "shading" <<
+		std::setw(16) << "assigned by" << std::right << std::setw(10) << "frame" << std::setw(10) << "assign" << "\n";
+	for (size_t i = 0; i < sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0]); i++)
+	{
+		for (size_t run = 0; run < RUN_COUNT; run++)
+		{
+			bool bDeferred = (run == RUN_COUNT - 1);
+			bool bObjectLists = (run == ASSIGN_MODE_COUNT);
+			if (bDeferred)
+			{
+				if (!g_SceneManager->SetRenderPath(SceneManager::deferredShading))
+				{
+					continue;
+				}
+			}
+			else if (bObjectLists)
+			{
+				if (!g_SceneManager->SetLightListMode(SceneManager::objectLightLists) ||
+					!g_SceneManager->SetRenderPath(SceneManager::forwardShading))
+				{
+					continue;
+				}
+			}
+			else if (!g_SceneManager->SetLightAssignMode(ASSIGN_MODES[run]) ||
+				!g_SceneManager->SetLightListMode(SceneManager::clusterLightLists) ||
+				!g_SceneManager->SetRenderPath(SceneManager::forwardShading))
+			{
+				continue;
+			}
+			g_SceneManager->SetLocalLightCount(LIGHT_COUNTS[i]);
+
+			// the GPU timing is only read back a frame or two late, and the
+			// deferred frames do not assign the lights
+			double assignTime = 0.0;
+			double frameTime = TimeFrames(WARMUP_FRAMES,
+				[]() { return g_SceneManager->IsRenderPathReady(); },
+				[&]() { assignTime += bDeferred ? 0.0 : g_SceneManager->GetLightAssignTime(); });
+
+			std::cout << std::left << std::setw(8) << LIGHT_COUNTS[i] <<
+				std::setw(18) << SceneManager::GetRenderPathName(g_SceneManager->GetRenderPath()) <<
+				std::setw(16) << (bDeferred ? "-" : (bObjectLists ? SceneManager::GetLightListModeName(SceneManager::objectLightLists) :
+					ClusteredLights::GetAssignModeName(ASSIGN_MODES[run]))) <<
+				std::right << std::fixed << std::setprecision(3) <<
+				std::setw(10) << frameTime <<
+				std::setw(10) << assignTime / BENCHMARK_FRAMES << "\n";
+		}
+	}
+	std::cout << std::flush;
+
+	g_SceneManager->SetRenderPath(startPath);
+	g_SceneManager->SetLightListMode(startListMode);
+}
+
+/***********************************************************
+ *	RunOcclusionBenchmark()
+ *
+ *  This function is used to time baking the ambient
+ *  occlusion of the vertices of the scene, and of 100
+ *  copies of it.  It prints the vertices baked and the
+ *  bake time.
+ ***********************************************************/
+void RunOcclusionBenchmark()
+{
+	const int COPY_COUNTS[] = { 1, 100 };
+	const int MAX_CAPTURE_FRAMES = 100;
+
+	// the scene is captured once its programs are built
+	g_SceneManager->SetUseLightmaps(false);
+	for (int frame = 0; (frame < MAX_CAPTURE_FRAMES) && !g_SceneManager->IsSceneCaptured(); frame++)
+	{
+		RenderFrame();
+	}
+	if (!g_SceneManager->IsSceneCaptured())
+	{
+		std::cout << "The scene could not be captured for baking the ambient occlusion" << std::endl;
+		return;
+	}
+
+	std::cout << "\n***** AMBIENT OCCLUSION BAKE: *****\n";
+	std::cout << std::left << std::setw(8) << "copies" << std::right << std::setw(12) << "vertices" << std::setw(12) << "ms" << "\n";
+	for (size_t i = 0; i < sizeof(COPY_COUNTS) / sizeof(COPY_COUNTS[0]); i++)
+	{
+		size_t vertexCount = 0;
+		double bakeTime = 0.0;
+		if (!g_SceneManager->TimeOcclusionBake(COPY_COUNTS[i], vertexCount, bakeTime))
+		{
+			continue;
+		}
+		std::cout << std::left << std::setw(8) << COPY_COUNTS[i] << std::right << std::setw(12) << vertexCount <<
+			std::fixed << std::setprecision(3) << std::setw(12) << bakeTime << "\n";
+	}
+	std::cout << std::flush;
+}
+
+/***********************************************************
+ *	RunTransparencyBenchmark()
+ *
+ *  This function is used to time the frames of the scene
+ *  with the transparent objects blended by the weighted
+ *  sums and sorted back to front, and to time sorting 4 to
+ *  262144 objects, as the sort grows with the objects while
+ *  the weighted sums only grow with their pixels.  It prints
+ *  the average frame time and sort time.
+ ***********************************************************/
+void RunTransparencyBenchmark()
+{
+	const SceneManager::TransparencyMode MODES[] = {
+		SceneManager::weightedBlendedTransparency,
+		SceneManager::sortedTransparency };
+	const int SORT_COUNTS[] = { 4, 256, 4096, 65536, 262144 };
+	const int WARMUP_FRAMES = 20;
+	const int TIMED_SORTS = 20;
+
+	SceneManager::TransparencyMode startMode = g_SceneManager->GetTransparencyMode();
+
+	std::cout << "\n***** TRANSPARENCY (average ms per frame): *****\n";
+	std::cout << std::left << std::setw(20) << "blending" << std::right << std::setw(10) << "frame" << std::setw(10) << "sort" << "\n";
+	for (size_t i = 0; i < sizeof(MODES) / sizeof(MODES[0]); i++)
+	{
+		if (!g_SceneManager->SetTransparencyMode(MODES[i]))
+		{
+			continue;
+		}
+
+		double sortTime = 0.0;
+		double frameTime = TimeFrames(WARMUP_FRAMES,
+			[]() { return g_SceneManager->IsTransparencyModeReady(); },
+			[&]() { sortTime += g_SceneManager->GetTransparencySortTime(); });
+
+		std::cout << std::left << std::setw(20) << SceneManager::GetTransparencyModeName(MODES[i]) <<
+			std::right << std::fixed << std::setprecision(3) <<
+			std::setw(10) << frameTime <<
+			std::setw(10) << sortTime / BENCHMARK_FRAMES << "\n";
+	}
+	g_SceneManager->SetTransparencyMode(startMode);
+
+	// the sort of the distances alone, which the weighted sums skip
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<float> distance(0.1f, 100.0f);
+	std::cout << "\n***** BACK TO FRONT SORT (average ms): *****\n";
+	std::cout << std::left << std::setw(10) << "objects" << std::right << std::setw(12) << "ms" << "\n";
+	for (size_t i = 0; i < sizeof(SORT_COUNTS) / sizeof(SORT_COUNTS[0]); i++)
+	{
+		std::vector<float> distances(SORT_COUNTS[i]);
+		std::vector<uint32_t> order;
+		for (size_t j = 0; j < distances.size(); j++)
+		{
+			distances[j] = distance(random);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int sort = 0; sort < TIMED_SORTS; sort++)
+		{
+			TransparencyPass::SortBackToFront(distances, order);
+		}
+		std::chrono::duration<double, std::milli> sortTime = std::chrono::steady_clock::now() - start;
+
+		std::cout << std::left << std::setw(10) << SORT_COUNTS[i] << std::right <<
+			std::fixed << std::setprecision(4) << std::setw(12) << sortTime.count() / TIMED_SORTS << "\n";
+	}
+	std::cout << std::flush;
+}
+
+/***********************************************************
+ *	RunDepthPrepassBenchmark()
+ *
+ *  This function is used to time the forward frames of the
+ *  scene with 16 to 1024 local lights, without the depth
+ *  pre-pass, always with it and with it chosen from the
+ *  measured overdraw and fragment cost, as more lights make
+ *  every lit fragment cost more.  It prints the average
+ *  frame time, the last measured overdraw and fragment
+ *  cost, and the share of the frames that drew the pre-pass.
+ ***********************************************************/
+void RunDepthPrepassBenchmark()
+{
+	const int LIGHT_COUNTS[] = { 16, 256, 1024 };
+	const SceneManager::DepthPrepassMode MODES[] = {
+		SceneManager::noDepthPrepass,
+		SceneManager::alwaysDepthPrepass,
+		SceneManager::automaticDepthPrepass };
+	const int WARMUP_FRAMES = 20;
+
+	SceneManager::RenderPath startPath = g_SceneManager->GetRenderPath();
+	SceneManager::DepthPrepassMode startMode = g_SceneManager->GetDepthPrepassMode();
+	g_SceneManager->SetRenderPath(SceneManager::forwardShading);
+
+	std::cout << "\n***** DEPTH PRE-PASS (average ms per frame): *****\n";
+	std::cout << std::left << std::setw(8) << "lights" << std::setw(12) << "pre-pass" << std::right <<
+		std::setw(10) << "frame" << std::setw(10) << "overdraw" << std::setw(14) << "ns/fragment" <<
+		std::setw(10) << "drawn" << "\n";
+	for (size_t i = 0; i < sizeof(LIGHT_COUNTS) / sizeof(LIGHT_COUNTS[0]); i++)
+	{
+		g_SceneManager->SetLocalLightCount(LIGHT_COUNTS[i]);
+		for (size_t mode = 0; mode < sizeof(MODES) / sizeof(MODES[0]); mode++)
+		{
+			if (!g_SceneManager->SetDepthPrepassMode(MODES[mode]))
+			{
+				continue;
+			}
+
+			int drawnFrames = 0;
+			double frameTime = TimeFrames(WARMUP_FRAMES,
+				[]() { return g_SceneManager->IsDepthPrepassModeReady(); },
+				[&]() { drawnFrames += g_SceneManager->IsDepthPrepassDrawn() ? 1 : 0; });
+
+			std::cout << std::left << std::setw(8) << LIGHT_COUNTS[i] <<
+				std::setw(12) << SceneManager::GetDepthPrepassModeName(MODES[mode]) <<
+				std::right << std::fixed << std::setprecision(3) <<
+				std::setw(10) << frameTime <<
+				std::setw(10) << g_SceneManager->GetOverdrawRatio() <<
+				std::setw(14) << g_SceneManager->GetFragmentCost() <<
+				std::setw(9) << (100 * drawnFrames) / BENCHMARK_FRAMES << "%" << "\n";
+		}
+	}
+	std::cout << std::flush;
+
+	g_SceneManager->SetRenderPath(startPath);
+	g_SceneManager->SetDepthPrepassMode(startMode);
+}
+
+/***********************************************************
+ *	RunResolutionBenchmark()
+ *
+ *  This function is used to time the frames of the scene
+ *  at the window resolution, at three quarters and half of
+ *  it, and at the scale that keeps them within the frame
+ *  time.  It prints the average frame time, the averaged
+ *  GPU and CPU time of the frames, and the scale the last
+ *  frame was drawn at.  The dynamic scale is then started
+ *  low with the frames held to the display refresh, as in
+ *  the interactive loop, and checked to rise while the GPU
+ *  has time left.
+ ***********************************************************/
+void RunResolutionBenchmark()
+{
+	const SceneManager::ResolutionMode MODES[] = {
+		SceneManager::nativeResolution,
+		SceneManager::fixedResolution,
+		SceneManager::fixedResolution,
+		SceneManager::dynamicResolution };
+	const float SCALES[] = { 1.0f, 0.75f, 0.5f, 1.0f };
+	// the dynamic scale is given time to settle before it is timed
+	const int WARMUP_FRAMES[] = { 20, 20, 20, 200 };
+	// the scale the check with the display refresh starts from, the
+	// frames it is given to rise, and the share of the frame time the
+	// GPU time must stay under for it to rise
+	const float VSYNC_START_SCALE = 0.5f;
+	const int VSYNC_FRAMES = 300;
+	const double VSYNC_RAISE_SHARE = 0.8;
+
+	SceneManager::ResolutionMode startMode = g_SceneManager->GetResolutionMode();
+	float startScale = g_SceneManager->GetResolutionScale();
+
+	std::cout << "\n***** RESOLUTION (average ms per frame): *****\n";
+	std::cout << std::left << std::setw(10) << "mode" << std::right << std::setw(10) << "frame" <<
+		std::setw(10) << "GPU" << std::setw(10) << "CPU" << std::setw(10) << "scale" << "\n";
+	for (size_t i = 0; i < sizeof(MODES) / sizeof(MODES[0]); i++)
+	{
+		g_SceneManager->SetResolutionScale(SCALES[i]);
+		if (!g_SceneManager->SetResolutionMode(MODES[i]))
+		{
+			continue;
+		}
+
+		double frameTime = TimeFrames(WARMUP_FRAMES[i],
+			[]() { return g_SceneManager->IsResolutionModeReady(); },
+			nullptr);
+
+		std::cout << std::left << std::setw(10) << SceneManager::GetResolutionModeName(MODES[i]) <<
+			std::right << std::fixed << std::setprecision(3) <<
+			std::setw(10) << frameTime <<
+			std::setw(10) << g_SceneManager->GetGpuFrameTime() <<
+			std::setw(10) << g_SceneManager->GetCpuFrameTime() <<
+			std::setprecision(2) << std::setw(10) << g_SceneManager->GetResolutionScale() << "\n";
+	}
+	std::cout << std::flush;
+
+	// the interactive frames wait for the display refresh, as the frames
+	// outside the timed runs do, which must not hold the dynamic scale
+	// down
+	g_SceneManager->SetResolutionScale(VSYNC_START_SCALE);
+	if (g_SceneManager->SetResolutionMode(SceneManager::dynamicResolution))
+	{
+		while (!g_SceneManager->IsResolutionModeReady())
+		{
+			RenderFrame();
+		}
+		float vsyncStartScale = g_SceneManager->GetResolutionScale();
+		for (int frame = 0; frame < VSYNC_FRAMES; frame++)
+		{
+			RenderFrame();
+		}
+
+		float vsyncScale = g_SceneManager->GetResolutionScale();
+		double gpuTime = g_SceneManager->GetGpuFrameTime();
+		std::cout << "\nWith vsync the dynamic scale moved from " << std::fixed << std::setprecision(2) <<
+			vsyncStartScale << " to " << vsyncScale << " (GPU " << std::setprecision(3) << gpuTime <<
+			" ms, CPU " << g_SceneManager->GetCpuFrameTime() << " ms per frame)" << std::endl;
+		if ((vsyncScale <= vsyncStartScale) && (vsyncScale < 1.0f) && (gpuTime > 0.0) &&
+			(gpuTime < (g_SceneManager->GetFrameTimeTarget() * VSYNC_RAISE_SHARE)))
+		{
+			std::cout << "The dynamic scale did not rise although the GPU time is under the frame time" << std::endl;
+		}
+		std::cout << std::defaultfloat;
+	}
+
+	g_SceneManager->SetResolutionScale(startScale);
+	g_SceneManager->SetResolutionMode(startMode);
+}
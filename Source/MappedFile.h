@@ -0,0 +1,54 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// map a file into memory for reading without copying it
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class contains the code for mapping a whole file
+ *  read-only into the address space, so the operating system
+ *  pages it in on demand instead of it being copied into a
+ *  buffer first.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// a mapping cannot be shared between two objects
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+	// the first byte of the mapped file
+	const unsigned char* m_pData;
+	// the size of the mapped file in bytes
+	size_t m_size;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_fileDescriptor;
+#endif
+
+public:
+	// map the file, closing any file that was already mapped
+	bool Open(const std::string& filename);
+	// unmap the file
+	void Close();
+
+	// get the mapped bytes of the file
+	const unsigned char* GetData() const;
+	// get the size of the mapped file in bytes
+	size_t GetSize() const;
+};
@@ -0,0 +1,529 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcache.cpp
+// ============
+// import mesh files, build their level-of-detail chains in parallel and keep
+// the uploaded levels for drawing
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshCache.h"
+
+#include "AssetFile.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const int g_FloatsPerVertex = 3;
+	const int g_FloatsPerNormal = 3;
+	const int g_FloatsPerUV = 2;
+
+	// per-import work for one mesh file, filled in by a worker
+	struct IMPORT_JOB
+	{
+		std::string filename;
+		bool bLoaded;
+		std::vector<MeshSimplifier::LOD_RESULT> lods;
+		// hash of the file and level ratios, and the levels already
+		// imported from the same content
+		uint64_t contentHash;
+		std::shared_ptr<std::vector<MeshCache::LOD_LEVEL>> shared;
+	};
+
+	// free the GPU memory of a level-of-detail chain
+	void DeleteLevels(std::vector<MeshCache::LOD_LEVEL>* levels)
+	{
+		for (size_t i = 0; i < levels->size(); i++)
+		{
+			glDeleteVertexArrays(1, &(*levels)[i].vao);
+			glDeleteBuffers(2, (*levels)[i].vbos);
+			glDeleteVertexArrays(1, &(*levels)[i].positionVao);
+			glDeleteBuffers(1, &(*levels)[i].positionVbo);
+		}
+	}
+
+	// convert a 1-based or negative relative OBJ index to 0-based
+	int ResolveOBJIndex(const std::string& value, int count)
+	{
+		if (value.empty())
+		{
+			return -1;
+		}
+		int index = atoi(value.c_str());
+		if (index < 0)
+		{
+			index = count + index;
+		}
+		else
+		{
+			index = index - 1;
+		}
+		return ((index >= 0) && (index < count)) ? index : -1;
+	}
+}
+
+/***********************************************************
+ *  MeshCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshCache::MeshCache(ThreadPool* pThreadPool)
+{
+	m_pThreadPool = pThreadPool;
+	m_lodRatios = { 1.0f, 0.5f, 0.25f, 0.125f };
+	m_bPositionOnly = false;
+}
+
+/***********************************************************
+ *  ~MeshCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshCache::~MeshCache()
+{
+	Clear();
+	m_pThreadPool = NULL;
+}
+
+/***********************************************************
+ *  SetLODRatios()
+ *
+ *  This method is used for setting the triangle ratios of
+ *  the levels that are built for the meshes imported after
+ *  this call.
+ ***********************************************************/
+void MeshCache::SetLODRatios(const std::vector<float>& triangleRatios)
+{
+	m_lodRatios = triangleRatios;
+}
+
+/***********************************************************
+ *  LoadOBJFile()
+ *
+ *  This method is used for reading the positions, texture
+ *  coordinates and normals of a Wavefront OBJ file into an
+ *  unindexed triangle list.  Polygon faces are split into a
+ *  triangle fan, and faces without normals get the flat
+ *  normal of the face.
+ ***********************************************************/
+bool MeshCache::LoadOBJFile(const std::string& filename, MESH_DATA& mesh)
+{
+	AssetFile asset;
+	std::string line;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+
+	if (!asset.Open(filename))
+	{
+		std::cout << "Could not open mesh file:" << filename << std::endl;
+		return false;
+	}
+	std::istringstream file(std::string((const char*)asset.GetData(), asset.GetSize()));
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+
+		if (type == "v")
+		{
+			glm::vec3 position(0.0f);
+			stream >> position.x >> position.y >> position.z;
+			positions.push_back(position);
+		}
+		else if (type == "vt")
+		{
+			glm::vec2 uv(0.0f);
+			stream >> uv.x >> uv.y;
+			uvs.push_back(uv);
+		}
+		else if (type == "vn")
+		{
+			glm::vec3 normal(0.0f);
+			stream >> normal.x >> normal.y >> normal.z;
+			normals.push_back(normal);
+		}
+		else if (type == "f")
+		{
+			std::vector<int> facePositions;
+			std::vector<int> faceUVs;
+			std::vector<int> faceNormals;
+			std::string corner;
+
+			// each corner is v, v/vt, v//vn or v/vt/vn
+			while (stream >> corner)
+			{
+				std::string parts[3];
+				int part = 0;
+				for (size_t i = 0; i < corner.size(); i++)
+				{
+					if (corner[i] == '/')
+					{
+						part++;
+						if (part > 2)
+						{
+							break;
+						}
+					}
+					else
+					{
+						parts[part] += corner[i];
+					}
+				}
+
+				int position = ResolveOBJIndex(parts[0], (int)positions.size());
+				if (position < 0)
+				{
+					std::cout << "Invalid face in mesh file:" << filename << std::endl;
+					return false;
+				}
+				facePositions.push_back(position);
+				faceUVs.push_back(ResolveOBJIndex(parts[1], (int)uvs.size()));
+				faceNormals.push_back(ResolveOBJIndex(parts[2], (int)normals.size()));
+			}
+
+			for (size_t i = 1; i + 1 < facePositions.size(); i++)
+			{
+				size_t corners[3] = { 0, i, i + 1 };
+				glm::vec3 p0 = positions[facePositions[corners[0]]];
+				glm::vec3 p1 = positions[facePositions[corners[1]]];
+				glm::vec3 p2 = positions[facePositions[corners[2]]];
+				glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+				if (glm::length(faceNormal) > 0.0f)
+				{
+					faceNormal = glm::normalize(faceNormal);
+				}
+
+				for (int c = 0; c < 3; c++)
+				{
+					size_t k = corners[c];
+					glm::vec3 position = positions[facePositions[k]];
+					glm::vec3 normal = (faceNormals[k] >= 0) ? normals[faceNormals[k]] : faceNormal;
+					glm::vec2 uv = (faceUVs[k] >= 0) ? uvs[faceUVs[k]] : glm::vec2(0.0f);
+
+					mesh.vertices.insert(mesh.vertices.end(), {
+						position.x, position.y, position.z,
+						normal.x, normal.y, normal.z,
+						uv.x, uv.y });
+					mesh.indices.push_back((GLuint)mesh.indices.size());
+				}
+			}
+		}
+	}
+
+	if (mesh.indices.empty())
+	{
+		std::cout << "No triangles in mesh file:" << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  UploadLevel()
+ *
+ *  This method is used for creating the vertex array and
+ *  buffers for one level of a mesh, with the same vertex
+ *  attribute locations as the ShapeMeshes.
+ ***********************************************************/
+void MeshCache::UploadLevel(const MeshSimplifier::LOD_RESULT& lod, LOD_LEVEL& level)
+{
+	level.nIndices = (GLsizei)lod.mesh.indices.size();
+	level.geometricError = lod.geometricError;
+
+	glGenVertexArrays(1, &level.vao);
+	glBindVertexArray(level.vao);
+
+	// Create 2 buffers: first one for the vertex data; second one for the indices
+	glGenBuffers(2, level.vbos);
+	glBindBuffer(GL_ARRAY_BUFFER, level.vbos[0]);
+	glBufferData(GL_ARRAY_BUFFER, lod.mesh.vertices.size() * sizeof(GLfloat), lod.mesh.vertices.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, level.vbos[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, lod.mesh.indices.size() * sizeof(GLuint), lod.mesh.indices.data(), GL_STATIC_DRAW);
+
+	GLint stride = sizeof(GLfloat) * MESH_DATA::FLOATS_PER_VERTEX;
+
+	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * g_FloatsPerVertex));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * (g_FloatsPerVertex + g_FloatsPerNormal)));
+	glEnableVertexAttribArray(2);
+
+	// the positions are also packed on their own for the depth only
+	// passes, which share the indices
+	std::vector<GLfloat> positions;
+	positions.reserve((lod.mesh.vertices.size() / MESH_DATA::FLOATS_PER_VERTEX) * g_FloatsPerVertex);
+	for (size_t vertex = 0; vertex < lod.mesh.vertices.size(); vertex += MESH_DATA::FLOATS_PER_VERTEX)
+	{
+		positions.insert(positions.end(), lod.mesh.vertices.begin() + vertex, lod.mesh.vertices.begin() + vertex + g_FloatsPerVertex);
+	}
+
+	glGenVertexArrays(1, &level.positionVao);
+	glBindVertexArray(level.positionVao);
+
+	glGenBuffers(1, &level.positionVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, level.positionVbo);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, level.vbos[1]);
+
+	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * g_FloatsPerVertex, 0);
+	glEnableVertexAttribArray(0);
+
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  ImportMeshFiles()
+ *
+ *  This method is used for importing a list of mesh files.
+ *  Reading and simplifying run on the worker threads, one
+ *  mesh per job, and the finished levels are uploaded on
+ *  the calling thread, which owns the OpenGL context.  A
+ *  file whose content was already imported with the same
+ *  level ratios shares the uploaded levels.
+ ***********************************************************/
+int MeshCache::ImportMeshFiles(
+	const std::vector<std::string>& filenames,
+	const std::vector<std::string>& tags)
+{
+	std::vector<IMPORT_JOB> jobs(filenames.size());
+	std::vector<float> ratios = m_lodRatios;
+	int imported = 0;
+
+	if (filenames.size() != tags.size())
+	{
+		std::cout << "Mesh import needs one tag per file" << std::endl;
+		return 0;
+	}
+
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		jobs[i].filename = filenames[i];
+		jobs[i].bLoaded = false;
+		jobs[i].contentHash = 0;
+	}
+
+	std::function<void(int)> importJob = [this, &jobs, &ratios](int index)
+	{
+		MESH_DATA source;
+		MeshSimplifier simplifier;
+
+		if (ResourceRegistry::HashFile(jobs[index].filename, jobs[index].contentHash))
+		{
+			jobs[index].contentHash = ResourceRegistry::HashBytes(ratios.data(), ratios.size() * sizeof(float), jobs[index].contentHash);
+			jobs[index].shared = ResourceRegistry::Get().Find<std::vector<LOD_LEVEL>>(ResourceRegistry::mesh, jobs[index].contentHash);
+			if (jobs[index].shared)
+			{
+				jobs[index].bLoaded = true;
+				return;
+			}
+		}
+
+		if (!LoadOBJFile(jobs[index].filename, source))
+		{
+			return;
+		}
+		jobs[index].bLoaded = simplifier.BuildLODChain(source, ratios, jobs[index].lods);
+	};
+
+	if (NULL != m_pThreadPool)
+	{
+		m_pThreadPool->ParallelFor((int)jobs.size(), importJob);
+	}
+	else
+	{
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			importJob((int)i);
+		}
+	}
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (!jobs[i].bLoaded || (!jobs[i].shared && jobs[i].lods.empty()))
+		{
+			std::cout << "Failed to import mesh file:" << jobs[i].filename << std::endl;
+			continue;
+		}
+
+		// replace any mesh that was imported under the same tag
+		int existing = FindMesh(tags[i]);
+		if (existing >= 0)
+		{
+			m_meshes.erase(m_meshes.begin() + existing);
+		}
+
+		CACHED_MESH mesh;
+		mesh.tag = tags[i];
+		mesh.levels = jobs[i].shared;
+		if (!mesh.levels)
+		{
+			std::vector<LOD_LEVEL>* levels = new std::vector<LOD_LEVEL>();
+			for (size_t j = 0; j < jobs[i].lods.size(); j++)
+			{
+				LOD_LEVEL level = {};
+				UploadLevel(jobs[i].lods[j], level);
+				levels->push_back(level);
+
+				std::cout << "Mesh " << mesh.tag << " LOD " << j << ": "
+					<< (level.nIndices / 3) << " triangles, error "
+					<< level.geometricError << std::endl;
+			}
+			mesh.levels = ResourceRegistry::Get().Register<std::vector<LOD_LEVEL>>(
+				ResourceRegistry::mesh, jobs[i].contentHash, jobs[i].filename, levels, DeleteLevels);
+		}
+		m_meshes.push_back(mesh);
+		imported++;
+	}
+
+	return imported;
+}
+
+/***********************************************************
+ *  FindMesh()
+ *
+ *  This method is used for getting the index of an imported
+ *  mesh by its tag, or -1 when it was not imported.
+ ***********************************************************/
+int MeshCache::FindMesh(std::string tag)
+{
+	for (size_t i = 0; i < m_meshes.size(); i++)
+	{
+		if (m_meshes[i].tag.compare(tag) == 0)
+		{
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+/***********************************************************
+ *  HasMesh()
+ *
+ *  This method is used for checking if a mesh has been
+ *  imported under the passed in tag.
+ ***********************************************************/
+bool MeshCache::HasMesh(std::string tag)
+{
+	return FindMesh(tag) >= 0;
+}
+
+/***********************************************************
+ *  GetLODCount()
+ *
+ *  This method is used for getting the number of levels of
+ *  an imported mesh.
+ ***********************************************************/
+int MeshCache::GetLODCount(std::string tag)
+{
+	int index = FindMesh(tag);
+	if (index < 0)
+	{
+		return 0;
+	}
+
+	return (int)m_meshes[index].levels->size();
+}
+
+/***********************************************************
+ *  SelectLODLevel()
+ *
+ *  This method is used for selecting the coarsest level of
+ *  a mesh whose geometric error, scaled into world units and
+ *  projected at the object distance, covers no more than the
+ *  allowed number of pixels.  The projection scale is the
+ *  [1][1] element of the projection matrix.
+ ***********************************************************/
+int MeshCache::SelectLODLevel(
+	std::string tag,
+	float objectScale,
+	float distance,
+	float projectionScale,
+	int viewportHeight,
+	float maxPixelError)
+{
+	int index = FindMesh(tag);
+	if (index < 0)
+	{
+		return 0;
+	}
+
+	// pixels covered by one world unit at the object distance
+	float pixelsPerUnit = (projectionScale * (float)viewportHeight * 0.5f) / glm::max(distance, 0.001f);
+
+	const std::vector<LOD_LEVEL>& levels = *m_meshes[index].levels;
+	int selected = 0;
+	for (int i = 1; i < (int)levels.size(); i++)
+	{
+		float pixelError = levels[i].geometricError * objectScale * pixelsPerUnit;
+		if (pixelError > maxPixelError)
+		{
+			break;
+		}
+		selected = i;
+	}
+
+	return selected;
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one level of an imported
+ *  mesh.  An out of range level draws the closest level.
+ ***********************************************************/
+void MeshCache::DrawMesh(std::string tag, int level)
+{
+	int index = FindMesh(tag);
+	if ((index < 0) || m_meshes[index].levels->empty())
+	{
+		return;
+	}
+
+	const std::vector<LOD_LEVEL>& levels = *m_meshes[index].levels;
+	level = glm::clamp(level, 0, (int)levels.size() - 1);
+
+	glBindVertexArray(m_bPositionOnly ? levels[level].positionVao : levels[level].vao);
+
+	glDrawElements(GL_TRIANGLES, levels[level].nIndices, GL_UNSIGNED_INT, (void*)0);
+
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  SetPositionOnly()
+ *
+ *  This method is used for drawing the levels from their
+ *  packed positions, which is all the depth only passes
+ *  read, or from their full vertices again.
+ ***********************************************************/
+void MeshCache::SetPositionOnly(bool bPositionOnly)
+{
+	m_bPositionOnly = bPositionOnly;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for releasing all of the imported
+ *  meshes.  The GPU memory of the levels is freed with the
+ *  last mesh cache that shares them.
+ ***********************************************************/
+void MeshCache::Clear()
+{
+	m_meshes.clear();
+}
@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcache.h
+// ============
+// import mesh files, build their level-of-detail chains in parallel and keep
+// the uploaded levels for drawing
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshSimplifier.h"
+#include "ResourceRegistry.h"
+#include "ThreadPool.h"
+
+#include <GL/glew.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  MeshCache
+ *
+ *  This class contains the code for importing mesh files,
+ *  simplifying every imported mesh into a level-of-detail
+ *  chain on the worker threads, and selecting the level to
+ *  draw from its projected screen-space error.
+ ***********************************************************/
+class MeshCache
+{
+public:
+	// constructor
+	MeshCache(ThreadPool* pThreadPool);
+	// destructor
+	~MeshCache();
+
+	// one uploaded level of a level-of-detail chain
+	struct LOD_LEVEL
+	{
+		GLuint vao;
+		GLuint vbos[2];
+		// the positions alone, for the passes that only write the depth
+		GLuint positionVao;
+		GLuint positionVbo;
+		GLsizei nIndices;
+		// largest distance to the source surface, in mesh units
+		float geometricError;
+	};
+
+	struct CACHED_MESH
+	{
+		std::string tag;
+		// levels from the full detail mesh to the coarsest, shared with
+		// every import of the same file and level ratios
+		std::shared_ptr<std::vector<LOD_LEVEL>> levels;
+	};
+
+private:
+	// pointer to the worker threads used for importing
+	ThreadPool* m_pThreadPool;
+	// the imported meshes
+	std::vector<CACHED_MESH> m_meshes;
+	// the triangle ratio of every level built at import time
+	std::vector<float> m_lodRatios;
+	// true when the levels are drawn from their positions alone
+	bool m_bPositionOnly;
+
+	// read a Wavefront OBJ file into a triangle list
+	bool LoadOBJFile(const std::string& filename, MESH_DATA& mesh);
+	// upload one simplified level into GPU memory
+	void UploadLevel(const MeshSimplifier::LOD_RESULT& lod, LOD_LEVEL& level);
+	// find an imported mesh by tag
+	int FindMesh(std::string tag);
+
+public:
+	// set the triangle ratios of the levels built by later imports -
+	// descending values between 0 and 1, the first should be 1
+	void SetLODRatios(const std::vector<float>& triangleRatios);
+	// import the mesh files and build their level-of-detail chains,
+	// returns the number of meshes that were imported
+	int ImportMeshFiles(
+		const std::vector<std::string>& filenames,
+		const std::vector<std::string>& tags);
+
+	// check if a mesh has been imported under the tag
+	bool HasMesh(std::string tag);
+	// get the number of levels of an imported mesh
+	int GetLODCount(std::string tag);
+	// select the coarsest level whose geometric error projects to
+	// no more than the allowed number of pixels on screen
+	int SelectLODLevel(
+		std::string tag,
+		float objectScale,
+		float distance,
+		float projectionScale,
+		int viewportHeight,
+		float maxPixelError = 1.0f);
+	// draw one level of an imported mesh
+	void DrawMesh(std::string tag, int level);
+	// draw the levels from their positions alone, for the passes that
+	// only write the depth
+	void SetPositionOnly(bool bPositionOnly);
+
+	// free all of the imported meshes
+	void Clear();
+};
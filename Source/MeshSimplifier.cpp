@@ -0,0 +1,799 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshsimplifier.cpp
+// ============
+// reduce the triangle count of imported meshes with the quadric error metric
+// and build level-of-detail chains from the simplified results
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+	// weight of the constraint planes that keep border and seam
+	// edges in place, relative to the triangle planes
+	const double g_BorderWeight = 1000.0;
+	// reject collapses that rotate a triangle normal further than this
+	const float g_MinNormalDot = 0.2f;
+
+	// ordering of the candidate queue - lowest cost on top
+	struct CandidateGreater
+	{
+		template <typename T>
+		bool operator()(const T& a, const T& b) const
+		{
+			return a.cost > b.cost;
+		}
+	};
+
+	// hash the raw bytes of a run of floats for vertex welding
+	struct FloatKeyHash
+	{
+		size_t operator()(const std::vector<GLfloat>& key) const
+		{
+			uint64_t hash = 14695981039346656037ULL;
+			const unsigned char* bytes = (const unsigned char*)key.data();
+			for (size_t i = 0; i < key.size() * sizeof(GLfloat); i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+			return (size_t)hash;
+		}
+	};
+}
+
+/***********************************************************
+ *  MeshSimplifier()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshSimplifier::MeshSimplifier()
+{
+	m_liveTriangles = 0;
+}
+
+/***********************************************************
+ *  BuildWorkingMesh()
+ *
+ *  This method is used for welding identical vertices of
+ *  the source mesh into attribute vertices, and grouping
+ *  the attribute vertices that share a position.  A group
+ *  with more than one attribute vertex sits on a seam.
+ ***********************************************************/
+void MeshSimplifier::BuildWorkingMesh(const MESH_DATA& source)
+{
+	const int stride = MESH_DATA::FLOATS_PER_VERTEX;
+	std::unordered_map<std::vector<GLfloat>, int, FloatKeyHash> attributeLookup;
+	std::unordered_map<std::vector<GLfloat>, int, FloatKeyHash> positionLookup;
+	std::vector<int> sourceToAttribute;
+	int sourceVertexCount = (int)(source.vertices.size() / stride);
+
+	m_attributes.clear();
+	m_attributeGroup.clear();
+	m_triangles.clear();
+	m_triangleAlive.clear();
+	m_groupPositions.clear();
+
+	// weld the identical vertices
+	sourceToAttribute.resize(sourceVertexCount);
+	for (int i = 0; i < sourceVertexCount; i++)
+	{
+		std::vector<GLfloat> key(source.vertices.begin() + (i * stride), source.vertices.begin() + ((i + 1) * stride));
+		std::unordered_map<std::vector<GLfloat>, int, FloatKeyHash>::iterator found = attributeLookup.find(key);
+		if (found != attributeLookup.end())
+		{
+			sourceToAttribute[i] = found->second;
+			continue;
+		}
+
+		int attribute = (int)(m_attributes.size() / stride);
+		attributeLookup[key] = attribute;
+		sourceToAttribute[i] = attribute;
+		m_attributes.insert(m_attributes.end(), key.begin(), key.end());
+
+		// group the attribute vertices by their position
+		std::vector<GLfloat> positionKey(key.begin(), key.begin() + 3);
+		std::unordered_map<std::vector<GLfloat>, int, FloatKeyHash>::iterator group = positionLookup.find(positionKey);
+		if (group != positionLookup.end())
+		{
+			m_attributeGroup.push_back(group->second);
+		}
+		else
+		{
+			int newGroup = (int)m_groupPositions.size();
+			positionLookup[positionKey] = newGroup;
+			m_groupPositions.push_back(glm::vec3(key[0], key[1], key[2]));
+			m_attributeGroup.push_back(newGroup);
+		}
+	}
+
+	// a mesh without indices is drawn as a plain triangle list
+	std::vector<GLuint> indices = source.indices;
+	if (indices.empty())
+	{
+		for (int i = 0; i < sourceVertexCount; i++)
+		{
+			indices.push_back((GLuint)i);
+		}
+	}
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		int a = sourceToAttribute[indices[i]];
+		int b = sourceToAttribute[indices[i + 1]];
+		int c = sourceToAttribute[indices[i + 2]];
+
+		// skip the triangles that are already degenerate
+		if ((m_attributeGroup[a] == m_attributeGroup[b]) ||
+			(m_attributeGroup[b] == m_attributeGroup[c]) ||
+			(m_attributeGroup[a] == m_attributeGroup[c]))
+		{
+			continue;
+		}
+		m_triangles.push_back(a);
+		m_triangles.push_back(b);
+		m_triangles.push_back(c);
+	}
+
+	int groupCount = (int)m_groupPositions.size();
+	int triangleCount = (int)(m_triangles.size() / 3);
+
+	m_triangleAlive.assign(triangleCount, true);
+	m_liveTriangles = triangleCount;
+
+	m_groupQuadrics.assign(groupCount, QUADRIC());
+	m_groupSurfaceQuadrics.assign(groupCount, QUADRIC());
+	for (int i = 0; i < groupCount; i++)
+	{
+		memset(&m_groupQuadrics[i], 0, sizeof(QUADRIC));
+		memset(&m_groupSurfaceQuadrics[i], 0, sizeof(QUADRIC));
+	}
+	m_groupTriangles.assign(groupCount, std::vector<int>());
+	m_groupAttributes.assign(groupCount, std::vector<int>());
+	m_groupBorderNeighbors.assign(groupCount, std::vector<int>());
+	m_groupStamps.assign(groupCount, 0);
+	m_groupAlive.assign(groupCount, true);
+
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			m_groupTriangles[m_attributeGroup[m_triangles[(t * 3) + corner]]].push_back(t);
+		}
+	}
+	for (int attribute = 0; attribute < (int)m_attributeGroup.size(); attribute++)
+	{
+		m_groupAttributes[m_attributeGroup[attribute]].push_back(attribute);
+	}
+}
+
+/***********************************************************
+ *  AddPlane()
+ *
+ *  This method is used for adding the squared distance
+ *  error of a weighted plane into a quadric.
+ ***********************************************************/
+void MeshSimplifier::AddPlane(QUADRIC& quadric, glm::vec3 normal, float distance, double weight)
+{
+	double a = normal.x;
+	double b = normal.y;
+	double c = normal.z;
+	double d = distance;
+
+	quadric.a[0] += weight * a * a;
+	quadric.a[1] += weight * a * b;
+	quadric.a[2] += weight * a * c;
+	quadric.a[3] += weight * a * d;
+	quadric.a[4] += weight * b * b;
+	quadric.a[5] += weight * b * c;
+	quadric.a[6] += weight * b * d;
+	quadric.a[7] += weight * c * c;
+	quadric.a[8] += weight * c * d;
+	quadric.a[9] += weight * d * d;
+}
+
+/***********************************************************
+ *  EvaluateQuadric()
+ *
+ *  This method is used for calculating the weighted sum of
+ *  squared plane distances stored in a quadric for the
+ *  passed in position.
+ ***********************************************************/
+double MeshSimplifier::EvaluateQuadric(const QUADRIC& quadric, glm::vec3 position)
+{
+	double x = position.x;
+	double y = position.y;
+	double z = position.z;
+
+	return (quadric.a[0] * x * x) + (2.0 * quadric.a[1] * x * y) + (2.0 * quadric.a[2] * x * z) + (2.0 * quadric.a[3] * x)
+		+ (quadric.a[4] * y * y) + (2.0 * quadric.a[5] * y * z) + (2.0 * quadric.a[6] * y)
+		+ (quadric.a[7] * z * z) + (2.0 * quadric.a[8] * z)
+		+ quadric.a[9];
+}
+
+/***********************************************************
+ *  FindBorderEdges()
+ *
+ *  This method is used for finding the edges that must stay
+ *  in place - open boundary edges used by one triangle,
+ *  non-manifold edges, and texture seam edges where the
+ *  triangles on either side use different attribute
+ *  vertices.  Constraint planes through those edges are
+ *  added to the quadrics so they resist being moved.
+ ***********************************************************/
+void MeshSimplifier::FindBorderEdges()
+{
+	struct EDGE_USE
+	{
+		int triangle;
+		int attributeA;
+		int attributeB;
+	};
+	std::unordered_map<uint64_t, std::vector<EDGE_USE>> edges;
+	int triangleCount = (int)(m_triangles.size() / 3);
+
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int attributeA = m_triangles[(t * 3) + corner];
+			int attributeB = m_triangles[(t * 3) + ((corner + 1) % 3)];
+			int groupA = m_attributeGroup[attributeA];
+			int groupB = m_attributeGroup[attributeB];
+
+			// store the edge uses with the lower group first
+			if (groupA > groupB)
+			{
+				std::swap(groupA, groupB);
+				std::swap(attributeA, attributeB);
+			}
+			uint64_t key = ((uint64_t)groupA << 32) | (uint32_t)groupB;
+			edges[key].push_back({ t, attributeA, attributeB });
+		}
+	}
+
+	for (std::unordered_map<uint64_t, std::vector<EDGE_USE>>::iterator it = edges.begin(); it != edges.end(); ++it)
+	{
+		const std::vector<EDGE_USE>& uses = it->second;
+		bool bBorder = (uses.size() != 2);
+		if (!bBorder)
+		{
+			bBorder = (uses[0].attributeA != uses[1].attributeA) || (uses[0].attributeB != uses[1].attributeB);
+		}
+		if (!bBorder)
+		{
+			continue;
+		}
+
+		int groupA = (int)(it->first >> 32);
+		int groupB = (int)(it->first & 0xFFFFFFFF);
+		m_groupBorderNeighbors[groupA].push_back(groupB);
+		m_groupBorderNeighbors[groupB].push_back(groupA);
+
+		// add a plane through the edge, perpendicular to every
+		// triangle using it, so sliding off the edge costs error
+		glm::vec3 p0 = m_groupPositions[groupA];
+		glm::vec3 p1 = m_groupPositions[groupB];
+		glm::vec3 edge = p1 - p0;
+		double edgeLengthSquared = glm::dot(edge, edge);
+		for (size_t i = 0; i < uses.size(); i++)
+		{
+			int t = uses[i].triangle;
+			glm::vec3 v0 = m_groupPositions[m_attributeGroup[m_triangles[t * 3]]];
+			glm::vec3 v1 = m_groupPositions[m_attributeGroup[m_triangles[(t * 3) + 1]]];
+			glm::vec3 v2 = m_groupPositions[m_attributeGroup[m_triangles[(t * 3) + 2]]];
+			glm::vec3 faceNormal = glm::cross(v1 - v0, v2 - v0);
+			glm::vec3 planeNormal = glm::cross(edge, faceNormal);
+			float planeLength = glm::length(planeNormal);
+			if (planeLength <= 0.0f)
+			{
+				continue;
+			}
+			planeNormal /= planeLength;
+
+			double weight = g_BorderWeight * edgeLengthSquared;
+			AddPlane(m_groupQuadrics[groupA], planeNormal, -glm::dot(planeNormal, p0), weight);
+			AddPlane(m_groupQuadrics[groupB], planeNormal, -glm::dot(planeNormal, p0), weight);
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildQuadrics()
+ *
+ *  This method is used for accumulating the area weighted
+ *  plane of every triangle into the quadrics of its corners.
+ ***********************************************************/
+void MeshSimplifier::BuildQuadrics()
+{
+	int triangleCount = (int)(m_triangles.size() / 3);
+
+	for (int t = 0; t < triangleCount; t++)
+	{
+		int groups[3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			groups[corner] = m_attributeGroup[m_triangles[(t * 3) + corner]];
+		}
+
+		glm::vec3 p0 = m_groupPositions[groups[0]];
+		glm::vec3 p1 = m_groupPositions[groups[1]];
+		glm::vec3 p2 = m_groupPositions[groups[2]];
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float doubleArea = glm::length(normal);
+		if (doubleArea <= 0.0f)
+		{
+			continue;
+		}
+		normal /= doubleArea;
+
+		double area = doubleArea * 0.5;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			AddPlane(m_groupQuadrics[groups[corner]], normal, -glm::dot(normal, p0), area);
+			AddPlane(m_groupSurfaceQuadrics[groups[corner]], normal, -glm::dot(normal, p0), area);
+			m_groupSurfaceQuadrics[groups[corner]].area += area;
+		}
+	}
+
+	FindBorderEdges();
+}
+
+/***********************************************************
+ *  IsBorderGroup()
+ *
+ *  This method is used for checking if a group lies on an
+ *  open boundary or a texture seam.
+ ***********************************************************/
+bool MeshSimplifier::IsBorderGroup(int group)
+{
+	return !m_groupBorderNeighbors[group].empty();
+}
+
+/***********************************************************
+ *  IsBorderEdge()
+ *
+ *  This method is used for checking if the edge between two
+ *  groups is an open boundary or a texture seam edge.
+ ***********************************************************/
+bool MeshSimplifier::IsBorderEdge(int fromGroup, int toGroup)
+{
+	const std::vector<int>& neighbors = m_groupBorderNeighbors[fromGroup];
+	return std::find(neighbors.begin(), neighbors.end(), toGroup) != neighbors.end();
+}
+
+/***********************************************************
+ *  IsLockedGroup()
+ *
+ *  This method is used for checking if a group is a border
+ *  corner - anything other than exactly two border edges -
+ *  which is never moved so the border outline is kept.
+ ***********************************************************/
+bool MeshSimplifier::IsLockedGroup(int group)
+{
+	size_t borderEdges = m_groupBorderNeighbors[group].size();
+	return (borderEdges != 0) && (borderEdges != 2);
+}
+
+/***********************************************************
+ *  GetNeighborGroups()
+ *
+ *  This method is used for collecting the unique groups that
+ *  share a live triangle with the passed in group.
+ ***********************************************************/
+void MeshSimplifier::GetNeighborGroups(int group, std::vector<int>& neighbors)
+{
+	neighbors.clear();
+	const std::vector<int>& triangles = m_groupTriangles[group];
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		int t = triangles[i];
+		if (!m_triangleAlive[t])
+		{
+			continue;
+		}
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int other = m_attributeGroup[m_triangles[(t * 3) + corner]];
+			if ((other != group) && (std::find(neighbors.begin(), neighbors.end(), other) == neighbors.end()))
+			{
+				neighbors.push_back(other);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  ComputeCollapseCost()
+ *
+ *  This method is used for calculating the quadric error of
+ *  moving a group onto the position of a neighbor group.
+ *  Border groups may only slide along their border edges.
+ ***********************************************************/
+bool MeshSimplifier::ComputeCollapseCost(int fromGroup, int toGroup, COLLAPSE_CANDIDATE& candidate)
+{
+	if (IsLockedGroup(fromGroup))
+	{
+		return false;
+	}
+	if (IsBorderGroup(fromGroup) && !IsBorderEdge(fromGroup, toGroup))
+	{
+		return false;
+	}
+
+	QUADRIC combined = m_groupQuadrics[fromGroup];
+	for (int i = 0; i < 10; i++)
+	{
+		combined.a[i] += m_groupQuadrics[toGroup].a[i];
+	}
+
+	candidate.cost = std::max(0.0, EvaluateQuadric(combined, m_groupPositions[toGroup]));
+	candidate.fromGroup = fromGroup;
+	candidate.toGroup = toGroup;
+	candidate.fromStamp = m_groupStamps[fromGroup];
+	candidate.toStamp = m_groupStamps[toGroup];
+
+	return true;
+}
+
+/***********************************************************
+ *  ValidateCollapse()
+ *
+ *  This method is used for checking that a collapse keeps
+ *  the mesh manifold and does not flip any triangle, and
+ *  for mapping every attribute vertex of the moved group to
+ *  the attribute vertex of the target group on the same side
+ *  of any texture seam.
+ ***********************************************************/
+bool MeshSimplifier::ValidateCollapse(int fromGroup, int toGroup, std::vector<int>& attributeMap)
+{
+	const std::vector<int>& triangles = m_groupTriangles[fromGroup];
+	std::vector<int> fromNeighbors;
+	std::vector<int> toNeighbors;
+	int sharedTriangles = 0;
+
+	// map each attribute vertex through a triangle that uses it
+	// together with an attribute vertex of the target group
+	const std::vector<int>& attributes = m_groupAttributes[fromGroup];
+	for (size_t i = 0; i < attributes.size(); i++)
+	{
+		int fromAttribute = attributes[i];
+		int toAttribute = -1;
+		bool bUsed = false;
+
+		for (size_t j = 0; (j < triangles.size()) && (toAttribute < 0); j++)
+		{
+			int t = triangles[j];
+			if (!m_triangleAlive[t])
+			{
+				continue;
+			}
+			int* corners = &m_triangles[t * 3];
+			if ((corners[0] != fromAttribute) && (corners[1] != fromAttribute) && (corners[2] != fromAttribute))
+			{
+				continue;
+			}
+			bUsed = true;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				if (m_attributeGroup[corners[corner]] == toGroup)
+				{
+					toAttribute = corners[corner];
+				}
+			}
+		}
+
+		// an attribute vertex on the far side of a seam from the
+		// target cannot be mapped without stretching the texture
+		if (bUsed && (toAttribute < 0))
+		{
+			return false;
+		}
+		attributeMap[fromAttribute] = toAttribute;
+	}
+
+	// the link condition - the groups may only share the neighbors
+	// opposite the edge, otherwise the collapse pinches the surface
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		int t = triangles[i];
+		if (!m_triangleAlive[t])
+		{
+			continue;
+		}
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (m_attributeGroup[m_triangles[(t * 3) + corner]] == toGroup)
+			{
+				sharedTriangles++;
+			}
+		}
+	}
+	GetNeighborGroups(fromGroup, fromNeighbors);
+	GetNeighborGroups(toGroup, toNeighbors);
+	int sharedNeighbors = 0;
+	for (size_t i = 0; i < fromNeighbors.size(); i++)
+	{
+		if (std::find(toNeighbors.begin(), toNeighbors.end(), fromNeighbors[i]) != toNeighbors.end())
+		{
+			sharedNeighbors++;
+		}
+	}
+	if ((sharedTriangles == 0) || (sharedNeighbors > sharedTriangles))
+	{
+		return false;
+	}
+
+	// the remaining triangles must not flip or become slivers
+	glm::vec3 target = m_groupPositions[toGroup];
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		int t = triangles[i];
+		if (!m_triangleAlive[t])
+		{
+			continue;
+		}
+
+		glm::vec3 before[3];
+		glm::vec3 after[3];
+		bool bRemoved = false;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int group = m_attributeGroup[m_triangles[(t * 3) + corner]];
+			bRemoved = bRemoved || (group == toGroup);
+			before[corner] = m_groupPositions[group];
+			after[corner] = (group == fromGroup) ? target : before[corner];
+		}
+		if (bRemoved)
+		{
+			continue;
+		}
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		float lengthBefore = glm::length(normalBefore);
+		float lengthAfter = glm::length(normalAfter);
+		if ((lengthBefore <= 0.0f) || (lengthAfter <= 0.0f))
+		{
+			return false;
+		}
+		if (glm::dot(normalBefore, normalAfter) < (g_MinNormalDot * lengthBefore * lengthAfter))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  ApplyCollapse()
+ *
+ *  This method is used for moving a group onto its target,
+ *  removing the triangles that become degenerate, and
+ *  merging the quadric and border data into the target.
+ ***********************************************************/
+void MeshSimplifier::ApplyCollapse(int fromGroup, int toGroup, const std::vector<int>& attributeMap)
+{
+	std::vector<int>& triangles = m_groupTriangles[fromGroup];
+
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		int t = triangles[i];
+		if (!m_triangleAlive[t])
+		{
+			continue;
+		}
+
+		bool bRemoved = false;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			bRemoved = bRemoved || (m_attributeGroup[m_triangles[(t * 3) + corner]] == toGroup);
+		}
+		if (bRemoved)
+		{
+			m_triangleAlive[t] = false;
+			m_liveTriangles--;
+			continue;
+		}
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int& attribute = m_triangles[(t * 3) + corner];
+			if (m_attributeGroup[attribute] == fromGroup)
+			{
+				attribute = attributeMap[attribute];
+			}
+		}
+		m_groupTriangles[toGroup].push_back(t);
+	}
+	triangles.clear();
+
+	for (int i = 0; i < 10; i++)
+	{
+		m_groupQuadrics[toGroup].a[i] += m_groupQuadrics[fromGroup].a[i];
+		m_groupSurfaceQuadrics[toGroup].a[i] += m_groupSurfaceQuadrics[fromGroup].a[i];
+	}
+	m_groupSurfaceQuadrics[toGroup].area += m_groupSurfaceQuadrics[fromGroup].area;
+
+	// the border edges of the moved group now end at the target
+	std::vector<int>& fromBorder = m_groupBorderNeighbors[fromGroup];
+	std::vector<int>& toBorder = m_groupBorderNeighbors[toGroup];
+	toBorder.erase(std::remove(toBorder.begin(), toBorder.end(), fromGroup), toBorder.end());
+	for (size_t i = 0; i < fromBorder.size(); i++)
+	{
+		int other = fromBorder[i];
+		if (other == toGroup)
+		{
+			continue;
+		}
+		std::vector<int>& otherBorder = m_groupBorderNeighbors[other];
+		otherBorder.erase(std::remove(otherBorder.begin(), otherBorder.end(), fromGroup), otherBorder.end());
+		if (std::find(otherBorder.begin(), otherBorder.end(), toGroup) == otherBorder.end())
+		{
+			otherBorder.push_back(toGroup);
+			toBorder.push_back(other);
+		}
+	}
+	fromBorder.clear();
+
+	m_groupAlive[fromGroup] = false;
+	m_groupStamps[fromGroup]++;
+	m_groupStamps[toGroup]++;
+}
+
+/***********************************************************
+ *  Snapshot()
+ *
+ *  This method is used for copying the live triangles and
+ *  the attribute vertices they use into a compact mesh.
+ ***********************************************************/
+void MeshSimplifier::Snapshot(MESH_DATA& mesh)
+{
+	const int stride = MESH_DATA::FLOATS_PER_VERTEX;
+	std::vector<int> remap(m_attributeGroup.size(), -1);
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	for (size_t t = 0; t < m_triangleAlive.size(); t++)
+	{
+		if (!m_triangleAlive[t])
+		{
+			continue;
+		}
+		for (int corner = 0; corner < 3; corner++)
+		{
+			int attribute = m_triangles[(t * 3) + corner];
+			if (remap[attribute] < 0)
+			{
+				remap[attribute] = (int)(mesh.vertices.size() / stride);
+				mesh.vertices.insert(
+					mesh.vertices.end(),
+					m_attributes.begin() + (attribute * stride),
+					m_attributes.begin() + ((attribute + 1) * stride));
+			}
+			mesh.indices.push_back((GLuint)remap[attribute]);
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildLODChain()
+ *
+ *  This method is used for simplifying the source mesh in a
+ *  single pass, snapshotting a level whenever the triangle
+ *  count reaches the next requested ratio.  Every level
+ *  reports the largest estimated geometric error of the
+ *  collapses made so far, as the RMS distance to the planes
+ *  of the source triangles merged into the collapsed vertex.
+ ***********************************************************/
+bool MeshSimplifier::BuildLODChain(
+	const MESH_DATA& source,
+	const std::vector<float>& triangleRatios,
+	std::vector<LOD_RESULT>& lods)
+{
+	std::priority_queue<COLLAPSE_CANDIDATE, std::vector<COLLAPSE_CANDIDATE>, CandidateGreater> candidates;
+	std::vector<int> attributeMap;
+	std::vector<int> neighbors;
+	COLLAPSE_CANDIDATE candidate;
+	float maxError = 0.0f;
+	size_t nextLevel = 0;
+
+	lods.clear();
+
+	BuildWorkingMesh(source);
+	if (m_liveTriangles == 0)
+	{
+		return false;
+	}
+	BuildQuadrics();
+
+	int sourceTriangles = m_liveTriangles;
+	attributeMap.assign(m_attributeGroup.size(), -1);
+
+	// queue both directions of every edge
+	for (int group = 0; group < (int)m_groupPositions.size(); group++)
+	{
+		GetNeighborGroups(group, neighbors);
+		for (size_t i = 0; i < neighbors.size(); i++)
+		{
+			if (ComputeCollapseCost(group, neighbors[i], candidate))
+			{
+				candidates.push(candidate);
+			}
+		}
+	}
+
+	while (nextLevel < triangleRatios.size())
+	{
+		int targetTriangles = std::max(1, (int)std::ceil(triangleRatios[nextLevel] * sourceTriangles));
+
+		// snapshot every level whose target has been reached, or
+		// the final state once nothing else can be collapsed
+		if ((m_liveTriangles <= targetTriangles) || candidates.empty())
+		{
+			LOD_RESULT lod;
+			Snapshot(lod.mesh);
+			lod.triangleRatio = triangleRatios[nextLevel];
+			lod.geometricError = maxError;
+			lods.push_back(lod);
+			nextLevel++;
+			continue;
+		}
+
+		candidate = candidates.top();
+		candidates.pop();
+
+		// skip the candidates made stale by an earlier collapse
+		if (!m_groupAlive[candidate.fromGroup] || !m_groupAlive[candidate.toGroup] ||
+			(candidate.fromStamp != m_groupStamps[candidate.fromGroup]) ||
+			(candidate.toStamp != m_groupStamps[candidate.toGroup]))
+		{
+			continue;
+		}
+		if (!ValidateCollapse(candidate.fromGroup, candidate.toGroup, attributeMap))
+		{
+			continue;
+		}
+
+		// the border constraints only order the collapses, so the error
+		// of the surface is measured from its triangle planes alone
+		QUADRIC surface = m_groupSurfaceQuadrics[candidate.fromGroup];
+		for (int i = 0; i < 10; i++)
+		{
+			surface.a[i] += m_groupSurfaceQuadrics[candidate.toGroup].a[i];
+		}
+		surface.area += m_groupSurfaceQuadrics[candidate.toGroup].area;
+		if (surface.area > 0.0)
+		{
+			double surfaceCost = std::max(0.0, EvaluateQuadric(surface, m_groupPositions[candidate.toGroup]));
+			maxError = std::max(maxError, (float)std::sqrt(surfaceCost / surface.area));
+		}
+
+		ApplyCollapse(candidate.fromGroup, candidate.toGroup, attributeMap);
+
+		// the target quadric changed, so requeue its edges
+		int toGroup = candidate.toGroup;
+		GetNeighborGroups(toGroup, neighbors);
+		for (size_t i = 0; i < neighbors.size(); i++)
+		{
+			if (ComputeCollapseCost(toGroup, neighbors[i], candidate))
+			{
+				candidates.push(candidate);
+			}
+			if (ComputeCollapseCost(neighbors[i], toGroup, candidate))
+			{
+				candidates.push(candidate);
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshsimplifier.h
+// ============
+// reduce the triangle count of imported meshes with the quadric error metric
+// and build level-of-detail chains from the simplified results
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  MESH_DATA
+ *
+ *  Triangle list mesh data in the same interleaved layout
+ *  as the ShapeMeshes - position, normal, texture coords.
+ ***********************************************************/
+struct MESH_DATA
+{
+	// interleaved vertex data - FLOATS_PER_VERTEX per vertex
+	std::vector<GLfloat> vertices;
+	// triangle list indices into the vertex data
+	std::vector<GLuint> indices;
+
+	// number of floats stored for every vertex
+	static const int FLOATS_PER_VERTEX = 8;
+};
+
+/***********************************************************
+ *  MeshSimplifier
+ *
+ *  This class contains the code for simplifying a mesh by
+ *  collapsing the edges with the lowest quadric error, while
+ *  keeping open boundaries and texture coordinate seams in
+ *  place, and for snapshotting the result at several
+ *  triangle ratios to build a level-of-detail chain.
+ ***********************************************************/
+class MeshSimplifier
+{
+public:
+	// constructor
+	MeshSimplifier();
+
+	// one simplified level of a level-of-detail chain
+	struct LOD_RESULT
+	{
+		MESH_DATA mesh;
+		// the triangle ratio this level was built for
+		float triangleRatio;
+		// largest estimated distance between the simplified and
+		// the source surface, in the mesh coordinate units
+		float geometricError;
+	};
+
+private:
+
+	// symmetric 4x4 quadric error matrix, stored as its 10 unique values
+	struct QUADRIC
+	{
+		double a[10];
+		// total area of the triangle planes that were added
+		double area;
+	};
+
+	// a candidate collapse of one vertex group onto another
+	struct COLLAPSE_CANDIDATE
+	{
+		double cost;
+		int fromGroup;
+		int toGroup;
+		uint32_t fromStamp;
+		uint32_t toStamp;
+	};
+
+	// per attribute vertex data - one entry per unique vertex
+	std::vector<GLfloat> m_attributes;
+	// the position group of every attribute vertex
+	std::vector<int> m_attributeGroup;
+	// the attribute vertices of every triangle
+	std::vector<int> m_triangles;
+	// false once a triangle has been removed by a collapse
+	std::vector<bool> m_triangleAlive;
+	// number of triangles that have not been removed
+	int m_liveTriangles;
+
+	// per position group data - one entry per unique position
+	std::vector<glm::vec3> m_groupPositions;
+	std::vector<QUADRIC> m_groupQuadrics;
+	// the triangle planes alone, without the border constraints, that
+	// the geometric error of a level is measured from
+	std::vector<QUADRIC> m_groupSurfaceQuadrics;
+	std::vector<std::vector<int>> m_groupTriangles;
+	std::vector<std::vector<int>> m_groupAttributes;
+	std::vector<std::vector<int>> m_groupBorderNeighbors;
+	std::vector<uint32_t> m_groupStamps;
+	std::vector<bool> m_groupAlive;
+
+	// clear the working data and weld the source mesh vertices
+	void BuildWorkingMesh(const MESH_DATA& source);
+	// accumulate the triangle plane and border constraint quadrics
+	void BuildQuadrics();
+	// find the open boundary and texture seam edges
+	void FindBorderEdges();
+
+	// add a weighted plane into a quadric
+	void AddPlane(QUADRIC& quadric, glm::vec3 normal, float distance, double weight);
+	// evaluate the quadric error of a position
+	double EvaluateQuadric(const QUADRIC& quadric, glm::vec3 position);
+
+	// check if a group is on the border and if a border edge joins two groups
+	bool IsBorderGroup(int group);
+	bool IsBorderEdge(int fromGroup, int toGroup);
+	// check if a group can never be moved - a corner of the border
+	bool IsLockedGroup(int group);
+	// collect the groups sharing a live triangle with a group
+	void GetNeighborGroups(int group, std::vector<int>& neighbors);
+
+	// calculate the cost of a candidate collapse - returns false
+	// when the collapse would tear a border or seam
+	bool ComputeCollapseCost(int fromGroup, int toGroup, COLLAPSE_CANDIDATE& candidate);
+	// check the collapse against the current mesh and find the
+	// attribute vertex that every moved attribute vertex maps onto
+	bool ValidateCollapse(int fromGroup, int toGroup, std::vector<int>& attributeMap);
+	// collapse one group onto another, updating the mesh data
+	void ApplyCollapse(int fromGroup, int toGroup, const std::vector<int>& attributeMap);
+
+	// copy the live triangles into a compact mesh
+	void Snapshot(MESH_DATA& mesh);
+
+public:
+	// build one simplified mesh for every triangle ratio - the ratios
+	// should be in descending order between 0 and 1
+	bool BuildLODChain(
+		const MESH_DATA& source,
+		const std::vector<float>& triangleRatios,
+		std::vector<LOD_RESULT>& lods);
+};
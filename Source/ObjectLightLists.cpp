@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////
+// objectlightlists.cpp
+// ============
+// list the lights that reach each drawn object for forward shading
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ObjectLightLists.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// number of point lights, as TOTAL_POINT_LIGHTS in the fragment shader
+	const int g_TotalPointLights = 5;
+	// the bit of the spot light in the scene light mask
+	const uint32_t g_SpotLightBit = 1u << g_TotalPointLights;
+	// the storage buffer binding points of the local lights, as in the
+	// clustered lights, and of the light lists
+	const GLuint g_LightBufferBinding = 0;
+	const GLuint g_IndexBufferBinding = 3;
+	// indices the index buffer starts with room for
+	const size_t g_InitialIndexCapacity = 4096;
+	const float g_Pi = 3.14159265f;
+}
+
+/***********************************************************
+ *  ObjectLightLists()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ObjectLightLists::ObjectLightLists()
+{
+	m_indexBuffer = 0;
+	m_indexCapacity = 0;
+	m_pointLightMask = 0;
+	m_bSpotLightActive = false;
+	m_spotLightPosition = glm::vec3(0.0f);
+	m_spotLightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+	m_spotLightOuterCutOff = -1.0f;
+	m_lightsVersion = 0;
+	m_currentObject = -1;
+	m_frameIndexCount = 0;
+	m_assignMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~ObjectLightLists()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ObjectLightLists::~ObjectLightLists()
+{
+	if (m_indexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_indexBuffer);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the buffer the local
+ *  light lists are uploaded to.
+ ***********************************************************/
+bool ObjectLightLists::Initialize()
+{
+	glGenBuffers(1, &m_indexBuffer);
+	ReserveIndices(g_InitialIndexCapacity);
+
+	return (m_indexBuffer != 0);
+}
+
+/***********************************************************
+ *  ReserveIndices()
+ *
+ *  This method is used for making room for a number of
+ *  indices in the index buffer.  A larger buffer replaces
+ *  the lists uploaded before, so every list is marked for
+ *  uploading again.
+ ***********************************************************/
+void ObjectLightLists::ReserveIndices(size_t count)
+{
+	if (count <= m_indexCapacity)
+	{
+		return;
+	}
+
+	m_indexCapacity = std::max(count, m_indexCapacity * 2);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_indexBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_indexCapacity * sizeof(uint32_t), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_IndexBufferBinding, m_indexBuffer);
+
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		m_objects[i].uploadedOffset = -1;
+	}
+}
+
+/***********************************************************
+ *  SetLocalLights()
+ *
+ *  This method is used for replacing the local lights.
+ ***********************************************************/
+void ObjectLightLists::SetLocalLights(const std::vector<ClusteredLights::LOCAL_LIGHT>& lights)
+{
+	m_localLights = lights;
+	m_lightsVersion++;
+}
+
+/***********************************************************
+ *  SetSceneLights()
+ *
+ *  This method is used for setting the scene lights that
+ *  the objects are tested against.
+ ***********************************************************/
+void ObjectLightLists::SetSceneLights(
+	uint32_t pointLightMask,
+	bool bSpotLightActive,
+	const glm::vec3& spotLightPosition,
+	const glm::vec3& spotLightDirection,
+	float spotLightOuterCutOff)
+{
+	m_pointLightMask = pointLightMask;
+	m_bSpotLightActive = bSpotLightActive;
+	m_spotLightPosition = spotLightPosition;
+	m_spotLightDirection = spotLightDirection;
+	m_spotLightOuterCutOff = spotLightOuterCutOff;
+	m_lightsVersion++;
+}
+
+/***********************************************************
+ *  ComputeLists()
+ *
+ *  This method is used for computing the lights that reach
+ *  the bounding sphere of an object.  The point lights of
+ *  the scene are not attenuated, so every active one is
+ *  kept, and the spot light is kept when its outer cone
+ *  widened by the angle the sphere covers takes in the
+ *  center of the sphere.  A local light is kept when its
+ *  sphere touches the one of the object.
+ ***********************************************************/
+void ObjectLightLists::ComputeLists(OBJECT_LIST& object) const
+{
+	object.sceneLights = m_pointLightMask & ((1u << g_TotalPointLights) - 1);
+
+	if (m_bSpotLightActive)
+	{
+		glm::vec3 toObject = object.center - m_spotLightPosition;
+		float distance = glm::length(toObject);
+		bool bReached = (distance <= object.radius);
+		if (!bReached)
+		{
+			float coneAngle = std::acos(glm::clamp(m_spotLightOuterCutOff, -1.0f, 1.0f));
+			float sphereAngle = std::asin(object.radius / distance);
+			float angle = std::acos(glm::clamp(glm::dot(toObject / distance, glm::normalize(m_spotLightDirection)), -1.0f, 1.0f));
+			bReached = (coneAngle + sphereAngle >= g_Pi) || (angle <= coneAngle + sphereAngle);
+		}
+		if (bReached)
+		{
+			object.sceneLights |= g_SpotLightBit;
+		}
+	}
+
+	object.localLights.clear();
+	for (size_t i = 0; i < m_localLights.size(); i++)
+	{
+		const ClusteredLights::LOCAL_LIGHT& light = m_localLights[i];
+		float reach = light.radius + object.radius;
+		glm::vec3 offset = light.position - object.center;
+		if (glm::dot(offset, offset) < reach * reach)
+		{
+			object.localLights.push_back((uint32_t)i);
+		}
+	}
+
+	object.lightsVersion = m_lightsVersion;
+	object.uploadedOffset = -1;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a frame.  The objects
+ *  are matched to their lists by their drawing order, and
+ *  the lists of the frame are laid out one after the other
+ *  in the index buffer.
+ ***********************************************************/
+void ObjectLightLists::BeginFrame(GLuint lightBuffer)
+{
+	m_currentObject = -1;
+	m_frameIndexCount = 0;
+	m_assignMilliseconds = 0.0;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_LightBufferBinding, lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_IndexBufferBinding, m_indexBuffer);
+}
+
+/***********************************************************
+ *  SetObject()
+ *
+ *  This method is used for selecting the lists of the next
+ *  drawn object.  The lists of the object drawn at the same
+ *  place of the previous frame are kept when its sphere and
+ *  the lights are unchanged, and its local light list is
+ *  only uploaded when it is not already at its place in the
+ *  index buffer.
+ ***********************************************************/
+void ObjectLightLists::SetObject(const glm::vec3& center, float radius)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	m_currentObject++;
+	if (m_currentObject >= (int)m_objects.size())
+	{
+		OBJECT_LIST object;
+		object.center = center;
+		object.radius = radius;
+		object.lightsVersion = m_lightsVersion;
+		object.sceneLights = 0;
+		object.uploadedOffset = -1;
+		ComputeLists(object);
+		m_objects.push_back(object);
+	}
+
+	OBJECT_LIST& object = m_objects[m_currentObject];
+	if ((object.center != center) || (object.radius != radius) || (object.lightsVersion != m_lightsVersion))
+	{
+		object.center = center;
+		object.radius = radius;
+		ComputeLists(object);
+	}
+
+	size_t count = object.localLights.size();
+	if ((count > 0) && (object.uploadedOffset != (GLintptr)m_frameIndexCount))
+	{
+		ReserveIndices(m_frameIndexCount + count);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_indexBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, m_frameIndexCount * sizeof(uint32_t), count * sizeof(uint32_t), object.localLights.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	object.uploadedOffset = (GLintptr)m_frameIndexCount;
+	m_frameIndexCount += count;
+
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+	m_assignMilliseconds += time.count();
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for setting the lists of the current
+ *  object on a program that draws with them.
+ ***********************************************************/
+void ObjectLightLists::SetShaderValues(GLuint program) const
+{
+	if ((m_currentObject < 0) || (m_currentObject >= (int)m_objects.size()))
+	{
+		return;
+	}
+
+	const OBJECT_LIST& object = m_objects[m_currentObject];
+	glUniform2ui(glGetUniformLocation(program, "objectLightList"), (GLuint)object.uploadedOffset, (GLuint)object.localLights.size());
+	glUniform1ui(glGetUniformLocation(program, "objectSceneLights"), object.sceneLights);
+}
+
+/***********************************************************
+ *  GetAssignTime()
+ *
+ *  This method is used for getting the time spent on the
+ *  lists in the current frame in milliseconds.
+ ***********************************************************/
+double ObjectLightLists::GetAssignTime() const
+{
+	return m_assignMilliseconds;
+}
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// objectlightlists.h
+// ============
+// list the lights that reach each drawn object for forward shading
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ClusteredLights.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  ObjectLightLists
+ *
+ *  This class contains the code for lighting every object
+ *  with only the lights that can reach it.  Each object is
+ *  bounded by a sphere, and gets a mask of the scene lights
+ *  whose range or cone reaches the sphere and the list of
+ *  the local lights whose sphere touches it.  The lists are
+ *  kept for the objects in the order they are drawn, and are
+ *  only computed again when an object or the lights move.
+ *  The local light lists are uploaded to a shader storage
+ *  buffer, the fragment shader reading the list of its
+ *  object from an offset and a count.
+ ***********************************************************/
+class ObjectLightLists
+{
+public:
+	// constructor
+	ObjectLightLists();
+	// destructor
+	~ObjectLightLists();
+
+	// the buffer cannot be shared between two objects
+	ObjectLightLists(const ObjectLightLists&) = delete;
+	ObjectLightLists& operator=(const ObjectLightLists&) = delete;
+
+private:
+	struct OBJECT_LIST
+	{
+		// the bounding sphere the lists were computed for
+		glm::vec3 center;
+		float radius;
+		// the lights the lists were computed for
+		unsigned int lightsVersion;
+		// bit i for point light i, then a bit for the spot light
+		uint32_t sceneLights;
+		std::vector<uint32_t> localLights;
+		// where the local light list is in the index buffer, -1 when it
+		// has to be uploaded
+		GLintptr uploadedOffset;
+	};
+
+	GLuint m_indexBuffer;
+	// capacity of the index buffer in indices
+	size_t m_indexCapacity;
+	std::vector<ClusteredLights::LOCAL_LIGHT> m_localLights;
+	// the active point lights, and the spot light cone
+	uint32_t m_pointLightMask;
+	bool m_bSpotLightActive;
+	glm::vec3 m_spotLightPosition;
+	glm::vec3 m_spotLightDirection;
+	float m_spotLightOuterCutOff;
+	// changed whenever the lights change, so every list is computed again
+	unsigned int m_lightsVersion;
+	// the lists of the objects by their drawing order
+	std::vector<OBJECT_LIST> m_objects;
+	// the object being drawn, and the end of the lists uploaded so far
+	// in this frame
+	int m_currentObject;
+	size_t m_frameIndexCount;
+	// time spent computing and uploading the lists in this frame
+	double m_assignMilliseconds;
+
+	// compute the lists of an object for its bounding sphere
+	void ComputeLists(OBJECT_LIST& object) const;
+	// make room for a number of indices in the index buffer
+	void ReserveIndices(size_t count);
+
+public:
+	// create the index buffer - needs the OpenGL context to be current
+	// and shader storage buffers
+	bool Initialize();
+
+	// replace the local lights
+	void SetLocalLights(const std::vector<ClusteredLights::LOCAL_LIGHT>& lights);
+	// set the scene lights - the active point lights, and the spot
+	// light with the cosine of its outer cone angle
+	void SetSceneLights(
+		uint32_t pointLightMask,
+		bool bSpotLightActive,
+		const glm::vec3& spotLightPosition,
+		const glm::vec3& spotLightDirection,
+		float spotLightOuterCutOff);
+
+	// start a frame, binding the light buffer the lists index into -
+	// call once per frame before the objects are drawn
+	void BeginFrame(GLuint lightBuffer);
+	// select the lists of the next drawn object, computing them again
+	// when its bounding sphere has changed
+	void SetObject(const glm::vec3& center, float radius);
+	// set the lists of the current object on a program that draws with
+	// them
+	void SetShaderValues(GLuint program) const;
+	// get the time spent on the lists in the current frame in
+	// milliseconds
+	double GetAssignTime() const;
+};
@@ -0,0 +1,379 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionbaker.cpp
+// ============
+// bake the ambient occlusion of the vertices of the placed objects, for
+// darkening the ambient light where surfaces meet
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionBaker.h"
+
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+	// the texture unit of the occlusion, after the lightmap atlas
+	const int g_OcclusionTextureUnit = 24;
+	// rays cast from every vertex, four to a packet
+	const int g_OcclusionRays = 32;
+	// world distance within which a surface occludes a vertex, fading
+	// out towards it
+	const float g_OcclusionDistance = 1.5f;
+	// distance a ray starts off its surface
+	const float g_RayOffset = 0.01f;
+	// vertices a bake job casts the rays of
+	const size_t g_VerticesPerJob = 512;
+}
+
+/***********************************************************
+ *  OcclusionBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionBaker::OcclusionBaker()
+{
+	m_bSupported = false;
+	m_buffer = 0;
+	m_texture = 0;
+	m_bReady = false;
+	m_currentObject = -1;
+	m_bObjectBaked = false;
+}
+
+/***********************************************************
+ *  ~OcclusionBaker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionBaker::~OcclusionBaker()
+{
+	if (m_texture != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+	if (m_buffer != 0)
+	{
+		glDeleteBuffers(1, &m_buffer);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the buffer the baked
+ *  values are uploaded into, and the texture the vertex
+ *  shader reads it through.
+ ***********************************************************/
+bool OcclusionBaker::Initialize()
+{
+	glGenBuffers(1, &m_buffer);
+	glGenTextures(1, &m_texture);
+	m_bSupported = (m_buffer != 0) && (m_texture != 0);
+
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the occlusion can be
+ *  baked.
+ ***********************************************************/
+bool OcclusionBaker::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  SetScene()
+ *
+ *  This method is used for baking the occlusion of the
+ *  captured scene and uploading it, replacing the occlusion
+ *  of an earlier capture.
+ ***********************************************************/
+double OcclusionBaker::SetScene(const SceneCapture& capture, ThreadPool* threadPool)
+{
+	if (!m_bSupported)
+	{
+		return 0.0;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<unsigned char> values;
+	BakeOcclusion(capture.GetObjects(), capture.GetVertices(), threadPool, m_objects, values);
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxSize);
+	if (values.empty() || (values.size() > (size_t)maxSize))
+	{
+		std::cout << "The ambient occlusion of the scene does not fit a buffer texture" << std::endl;
+		m_bReady = false;
+		return time.count();
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, values.size(), values.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R8, m_buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	m_bReady = true;
+
+	std::cout << "Baked the ambient occlusion of " << values.size() << " vertices in " << time.count() << " ms" << std::endl;
+
+	return time.count();
+}
+
+/***********************************************************
+ *  IsReady()
+ *
+ *  This method is used for checking if the occlusion of the
+ *  scene is baked.
+ ***********************************************************/
+bool OcclusionBaker::IsReady() const
+{
+	return m_bReady;
+}
+
+/***********************************************************
+ *  BakeOcclusion()
+ *
+ *  This method is used for baking the occlusion of every
+ *  vertex of a set of objects.  The vertices of an object
+ *  are found by the IDs the capture recorded, and a vertex
+ *  shared by several triangles is baked once.  Its rays
+ *  leave over the hemisphere of its normal and are traced
+ *  four at a time - a ray blocked close to the vertex
+ *  occludes it fully, one blocked at the edge of the reach
+ *  hardly at all, so the darkening fades out smoothly.
+ ***********************************************************/
+void OcclusionBaker::BakeOcclusion(
+	const std::vector<SceneCapture::CAPTURED_OBJECT>& objects,
+	const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices,
+	ThreadPool* threadPool,
+	std::vector<OBJECT_VERTICES>& objectVertices,
+	std::vector<unsigned char>& values)
+{
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		positions[i] = vertices[i].position;
+	}
+	SceneBVH bvh;
+	bvh.Build(positions);
+
+	// the range of vertex IDs of every object, and a captured vertex for
+	// every ID it draws
+	objectVertices.resize(objects.size());
+	std::vector<int64_t> sources;
+	for (size_t object = 0; object < objects.size(); object++)
+	{
+		const SceneCapture::CAPTURED_OBJECT& captured = objects[object];
+		OBJECT_VERTICES& range = objectVertices[object];
+		range.transformHash = captured.transformHash;
+		range.firstEntry = (int)sources.size();
+		range.firstVertex = 0;
+		range.vertexCount = 0;
+
+		size_t first = captured.firstTriangle * 3;
+		size_t last = (captured.firstTriangle + captured.triangleCount) * 3;
+		if (first == last)
+		{
+			continue;
+		}
+		int minVertex = std::numeric_limits<int>::max();
+		int maxVertex = std::numeric_limits<int>::min();
+		for (size_t i = first; i < last; i++)
+		{
+			minVertex = std::min(minVertex, (int)vertices[i].vertexID);
+			maxVertex = std::max(maxVertex, (int)vertices[i].vertexID);
+		}
+		range.firstVertex = minVertex;
+		range.vertexCount = maxVertex - minVertex + 1;
+		sources.resize(sources.size() + range.vertexCount, -1);
+		for (size_t i = first; i < last; i++)
+		{
+			int64_t& source = sources[range.firstEntry + vertices[i].vertexID - minVertex];
+			if (source < 0)
+			{
+				source = (int64_t)i;
+			}
+		}
+	}
+
+	// IDs no triangle uses stay open
+	values.assign(sources.size(), 255);
+	int jobCount = (int)((sources.size() + g_VerticesPerJob - 1) / g_VerticesPerJob);
+	threadPool->ParallelFor(jobCount, [&](int job)
+	{
+		size_t first = (size_t)job * g_VerticesPerJob;
+		size_t last = std::min(first + g_VerticesPerJob, sources.size());
+		for (size_t entry = first; entry < last; entry++)
+		{
+			if (sources[entry] < 0)
+			{
+				continue;
+			}
+			const SceneCapture::CAPTURED_VERTEX& vertex = vertices[(size_t)sources[entry]];
+			if (glm::dot(vertex.normal, vertex.normal) < 1.0e-12f)
+			{
+				continue;
+			}
+
+			glm::vec3 normal = glm::normalize(vertex.normal);
+			glm::vec3 origin = vertex.position + (normal * g_RayOffset);
+			uint32_t seed = (uint32_t)(entry * 2654435761u) | 1u;
+			float occlusion = 0.0f;
+			for (int packet = 0; packet < g_OcclusionRays / 4; packet++)
+			{
+				// a ray also starts back along itself, so a surface the
+				// vertex rests on is hit instead of starting in its plane -
+				// the rays that start behind such a surface only hit its
+				// back, which does not occlude
+				glm::vec3 origins[4];
+				glm::vec3 directions[4];
+				for (int lane = 0; lane < 4; lane++)
+				{
+					directions[lane] = SceneBVH::GetHemisphereRay(normal, (packet * 4) + lane, g_OcclusionRays, seed);
+					origins[lane] = origin - (directions[lane] * (g_RayOffset * 0.5f));
+				}
+
+				SceneBVH::RAY_HIT hits[4];
+				bvh.IntersectPacket(origins, directions, g_OcclusionDistance, hits);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					if (hits[lane].triangle < 0)
+					{
+						continue;
+					}
+					const SceneCapture::CAPTURED_VERTEX* corners = &vertices[(size_t)hits[lane].triangle * 3];
+					glm::vec3 facing = corners[0].normal + corners[1].normal + corners[2].normal;
+					if (glm::dot(facing, directions[lane]) < 0.0f)
+					{
+						occlusion += GetHitOcclusion(hits[lane].distance);
+					}
+				}
+			}
+
+			float open = 1.0f - (occlusion / (float)g_OcclusionRays);
+			values[entry] = (unsigned char)std::lround(glm::clamp(open, 0.0f, 1.0f) * 255.0f);
+		}
+	});
+}
+
+/***********************************************************
+ *  GetRayLength()
+ *
+ *  This method is used for getting the distance within
+ *  which a surface occludes a point.
+ ***********************************************************/
+float OcclusionBaker::GetRayLength()
+{
+	return g_OcclusionDistance;
+}
+
+/***********************************************************
+ *  GetHitOcclusion()
+ *
+ *  This method is used for getting how much a ray that is
+ *  blocked at a distance occludes the point it left, from
+ *  1 at the point to 0 at the reach of the rays.
+ ***********************************************************/
+float OcclusionBaker::GetHitOcclusion(float distance)
+{
+	return glm::clamp(1.0f - (distance / g_OcclusionDistance), 0.0f, 1.0f);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a frame, whose objects
+ *  are matched to their baked vertices in drawing order.
+ ***********************************************************/
+void OcclusionBaker::BeginFrame()
+{
+	m_currentObject = -1;
+	m_bObjectBaked = false;
+}
+
+/***********************************************************
+ *  SetObject()
+ *
+ *  This method is used for selecting the vertices of the
+ *  next drawn object.  An object drawn with another
+ *  transform than the one it was baked at is left open.
+ ***********************************************************/
+void OcclusionBaker::SetObject(uint64_t transformHash)
+{
+	SelectObject(m_currentObject + 1, transformHash);
+}
+
+/***********************************************************
+ *  GetCurrentObject()
+ *
+ *  This method is used for getting the drawing order of the
+ *  current object in the frame.
+ ***********************************************************/
+int OcclusionBaker::GetCurrentObject() const
+{
+	return m_currentObject;
+}
+
+/***********************************************************
+ *  SelectObject()
+ *
+ *  This method is used for selecting the vertices of an
+ *  object by its drawing order, for an object that is drawn
+ *  again after the others.
+ ***********************************************************/
+void OcclusionBaker::SelectObject(int object, uint64_t transformHash)
+{
+	m_currentObject = object;
+	m_bObjectBaked = m_bReady && (m_currentObject >= 0) && (m_currentObject < (int)m_objects.size()) &&
+		(m_objects[m_currentObject].transformHash == transformHash) && (m_objects[m_currentObject].vertexCount > 0);
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding the buffer texture to
+ *  its texture unit.
+ ***********************************************************/
+void OcclusionBaker::BindTexture() const
+{
+	if (!m_bReady)
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + g_OcclusionTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for setting the buffer texture and
+ *  the vertices of the current object on a program that
+ *  draws with the occlusion - no vertices for an object
+ *  that was not baked.
+ ***********************************************************/
+void OcclusionBaker::SetShaderValues(GLuint program) const
+{
+	glUniform1i(glGetUniformLocation(program, "occlusionBuffer"), g_OcclusionTextureUnit);
+	if (!m_bObjectBaked)
+	{
+		glUniform3i(glGetUniformLocation(program, "occlusionVertices"), 0, 0, 0);
+		return;
+	}
+
+	const OBJECT_VERTICES& object = m_objects[m_currentObject];
+	glUniform3i(glGetUniformLocation(program, "occlusionVertices"), object.firstEntry, object.firstVertex, object.vertexCount);
+}
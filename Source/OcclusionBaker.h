@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionbaker.h
+// ============
+// bake the ambient occlusion of the vertices of the placed objects, for
+// darkening the ambient light where surfaces meet
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneCapture.h"
+#include "ThreadPool.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  OcclusionBaker
+ *
+ *  This class contains the code for baking the ambient
+ *  occlusion of the scene.  Rays are cast over the
+ *  hemisphere of every vertex of every captured object, on
+ *  the worker threads and through the BVH of the whole
+ *  scene, and the share of them that is blocked nearby is
+ *  kept for the vertex.  The values of an object are laid
+ *  out by the IDs its draw gives its vertices, in one
+ *  buffer texture the vertex shader reads with its own
+ *  vertex ID, so the meshes keep their vertex buffers and
+ *  the frames only fetch one value per vertex.
+ ***********************************************************/
+class OcclusionBaker
+{
+public:
+	// constructor
+	OcclusionBaker();
+	// destructor
+	~OcclusionBaker();
+
+	// the buffer cannot be shared between two objects
+	OcclusionBaker(const OcclusionBaker&) = delete;
+	OcclusionBaker& operator=(const OcclusionBaker&) = delete;
+
+	// the baked vertices of an object - the entry of its first vertex,
+	// the ID of its first vertex and the number of IDs it spans
+	struct OBJECT_VERTICES
+	{
+		uint64_t transformHash;
+		int firstEntry;
+		int firstVertex;
+		int vertexCount;
+	};
+
+private:
+	bool m_bSupported;
+	GLuint m_buffer;
+	GLuint m_texture;
+	// the vertices of the objects in their drawing order
+	std::vector<OBJECT_VERTICES> m_objects;
+	bool m_bReady;
+	// the object being drawn
+	int m_currentObject;
+	bool m_bObjectBaked;
+
+public:
+	// create the buffer texture - needs the OpenGL context to be current
+	bool Initialize();
+	// check if the occlusion can be baked
+	bool IsSupported() const;
+
+	// bake the occlusion of a captured scene and upload it, returns the
+	// time the bake took in milliseconds
+	double SetScene(const SceneCapture& capture, ThreadPool* threadPool);
+	// check if the occlusion of the scene is baked
+	bool IsReady() const;
+
+	// start a frame - the objects are matched to their vertices by their
+	// drawing order and transforms
+	void BeginFrame();
+	// select the vertices of the next drawn object
+	void SetObject(uint64_t transformHash);
+	// get the drawing order of the current object, and select the
+	// vertices of an object drawn earlier in the frame again
+	int GetCurrentObject() const;
+	void SelectObject(int object, uint64_t transformHash);
+	// bind the buffer texture for the lit programs - call once per frame
+	void BindTexture() const;
+	// set the vertices of the current object on a program that draws
+	// with the occlusion
+	void SetShaderValues(GLuint program) const;
+
+	// bake the occlusion of every vertex of a set of objects, one value
+	// from 0 for fully occluded to 255 for open per vertex ID
+	static void BakeOcclusion(
+		const std::vector<SceneCapture::CAPTURED_OBJECT>& objects,
+		const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices,
+		ThreadPool* threadPool,
+		std::vector<OBJECT_VERTICES>& objectVertices,
+		std::vector<unsigned char>& values);
+	// get the distance the occlusion rays reach, and how much a ray
+	// blocked at a distance occludes
+	static float GetRayLength();
+	static float GetHitOcclusion(float distance);
+};
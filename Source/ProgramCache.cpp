@@ -0,0 +1,344 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.cpp
+// ============
+// store linked shader program binaries on disk for fast startup
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ProgramCache.h"
+
+#include "MappedFile.h"
+#include "ResourceRegistry.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// the cache file identifier and version
+	const unsigned char g_CacheIdentifier[8] = { 'G', 'L', 'P', 'R', 'O', 'G', 'R', 'M' };
+	const uint32_t g_CacheVersion = 1;
+	// size of the fixed header, which the program binary follows
+	const size_t g_CacheHeaderSize = 48;
+
+	// the cache opened for the process
+	ProgramCache g_OpenedCache;
+	bool g_bCacheOpened = false;
+
+	uint32_t ReadUInt32(const unsigned char* data, size_t offset)
+	{
+		uint32_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadUInt64(const unsigned char* data, size_t offset)
+	{
+		uint64_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	void WriteUInt32(std::vector<unsigned char>& data, size_t offset, uint32_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	void WriteUInt64(std::vector<unsigned char>& data, size_t offset, uint64_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	// get an OpenGL string, which is NULL on a failed query
+	std::string GetGLString(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return (value != NULL) ? std::string((const char*)value) : std::string();
+	}
+}
+
+/***********************************************************
+ *  ProgramCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ProgramCache::ProgramCache()
+{
+	m_driverHash = 0;
+	m_loadedPrograms = 0;
+	m_savedPrograms = 0;
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for checking that the driver can
+ *  hand out and take back program binaries, and for hashing
+ *  the strings that identify the driver.  A binary is only
+ *  valid for the driver that saved it, so an updated driver
+ *  or a different GPU does not match the cache files.
+ ***********************************************************/
+bool ProgramCache::Initialize(const std::string& cacheFolder)
+{
+	if (GLEW_ARB_get_program_binary == GL_FALSE)
+	{
+		return false;
+	}
+
+	// a driver may support the calls without any binary format
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats <= 0)
+	{
+		return false;
+	}
+
+	std::string driver = GetGLString(GL_VENDOR) + "\n" + GetGLString(GL_RENDERER) + "\n" + GetGLString(GL_VERSION);
+	m_driverHash = ResourceRegistry::HashBytes(driver.data(), driver.size());
+	m_cacheFolder = cacheFolder;
+
+	return true;
+}
+
+/***********************************************************
+ *  GetCacheFile()
+ *
+ *  This method is used for getting the path of the cache
+ *  file of a program key.
+ ***********************************************************/
+std::string ProgramCache::GetCacheFile(uint64_t key) const
+{
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+
+	return (std::filesystem::path(m_cacheFolder) / name.str()).string();
+}
+
+/***********************************************************
+ *  LoadProgram()
+ *
+ *  This method is used for loading a program from its cache
+ *  file.  The file is checked against the key, the driver
+ *  and the hash of its binary, and the driver may still
+ *  reject the binary - in every case the file is deleted and
+ *  0 is returned, so the program is built again.
+ ***********************************************************/
+GLuint ProgramCache::LoadProgram(uint64_t key)
+{
+	std::string cacheFile = GetCacheFile(key);
+	std::error_code error;
+
+	if (!std::filesystem::is_regular_file(cacheFile, error))
+	{
+		return 0;
+	}
+
+	bool bValid = false;
+	GLuint program = 0;
+	{
+		MappedFile file;
+		if (file.Open(cacheFile) && (file.GetSize() >= g_CacheHeaderSize))
+		{
+			const unsigned char* data = file.GetData();
+			uint64_t binaryLength = ReadUInt64(data, 40);
+
+			bValid = (memcmp(data, g_CacheIdentifier, sizeof(g_CacheIdentifier)) == 0) &&
+				(ReadUInt32(data, 8) == g_CacheVersion) &&
+				(ReadUInt64(data, 16) == key) &&
+				(ReadUInt64(data, 24) == m_driverHash) &&
+				(binaryLength == (file.GetSize() - g_CacheHeaderSize)) &&
+				(ResourceRegistry::HashBytes(data + g_CacheHeaderSize, (size_t)binaryLength) == ReadUInt64(data, 32));
+
+			if (bValid)
+			{
+				program = glCreateProgram();
+				glProgramBinary(program, (GLenum)ReadUInt32(data, 12), data + g_CacheHeaderSize, (GLsizei)binaryLength);
+
+				GLint bLinked = GL_FALSE;
+				glGetProgramiv(program, GL_LINK_STATUS, &bLinked);
+				if (bLinked == GL_FALSE)
+				{
+					glDeleteProgram(program);
+					program = 0;
+					bValid = false;
+				}
+			}
+		}
+	}
+
+	if (!bValid)
+	{
+		std::cout << "Rebuilding stale program cache file:" << cacheFile << std::endl;
+		std::filesystem::remove(cacheFile, error);
+		return 0;
+	}
+
+	m_loadedPrograms++;
+	return program;
+}
+
+/***********************************************************
+ *  SaveProgram()
+ *
+ *  This method is used for writing the binary of a linked
+ *  program to its cache file.  The program must have been
+ *  linked with the retrievable hint set.  The file is
+ *  written under a temporary name and renamed, so a reader
+ *  never sees half of it.
+ ***********************************************************/
+bool ProgramCache::SaveProgram(uint64_t key, GLuint program)
+{
+	GLint binaryLength = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> data(g_CacheHeaderSize + binaryLength, 0);
+	GLenum format = 0;
+	GLsizei length = 0;
+	glGetProgramBinary(program, binaryLength, &length, &format, &data[g_CacheHeaderSize]);
+	if (length <= 0)
+	{
+		return false;
+	}
+	data.resize(g_CacheHeaderSize + length);
+
+	memcpy(&data[0], g_CacheIdentifier, sizeof(g_CacheIdentifier));
+	WriteUInt32(data, 8, g_CacheVersion);
+	WriteUInt32(data, 12, (uint32_t)format);
+	WriteUInt64(data, 16, key);
+	WriteUInt64(data, 24, m_driverHash);
+	WriteUInt64(data, 32, ResourceRegistry::HashBytes(&data[g_CacheHeaderSize], (size_t)length));
+	WriteUInt64(data, 40, (uint64_t)length);
+
+	std::string cacheFile = GetCacheFile(key);
+	std::string tempFile = cacheFile + ".tmp";
+	std::error_code error;
+	std::filesystem::create_directories(m_cacheFolder, error);
+	{
+		std::ofstream output(tempFile, std::ios::binary | std::ios::trunc);
+		output.write((const char*)data.data(), (std::streamsize)data.size());
+		if (!output.good())
+		{
+			std::cout << "Could not write program cache file:" << cacheFile << std::endl;
+			return false;
+		}
+	}
+	std::filesystem::rename(tempFile, cacheFile, error);
+	if (error)
+	{
+		std::cout << "Could not write program cache file:" << cacheFile << std::endl;
+		std::filesystem::remove(tempFile, error);
+		return false;
+	}
+
+	m_savedPrograms++;
+	return true;
+}
+
+/***********************************************************
+ *  PrintStatistics()
+ *
+ *  This method is used for printing how many programs were
+ *  loaded from the cache and how many had to be built.
+ ***********************************************************/
+void ProgramCache::PrintStatistics() const
+{
+	std::cout << "Program cache: " << m_loadedPrograms << " loaded, " << m_savedPrograms << " built and saved" << std::endl;
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method is used for getting the key of a program,
+ *  which hashes its final sources and the key of the
+ *  permutation they were specialized for.
+ ***********************************************************/
+uint64_t ProgramCache::MakeKey(
+	const std::string& vertexSource,
+	const std::string& fragmentSource,
+	uint64_t permutationKey)
+{
+	uint64_t key = ResourceRegistry::HashBytes(vertexSource.data(), vertexSource.size());
+	key = ResourceRegistry::HashBytes(fragmentSource.data(), fragmentSource.size(), key);
+	return ResourceRegistry::HashBytes(&permutationKey, sizeof(permutationKey), key);
+}
+
+/***********************************************************
+ *  GetExecutableFolder()
+ *
+ *  This method is used for getting the folder the running
+ *  executable file is in, or the working folder when it
+ *  cannot be found.
+ ***********************************************************/
+std::string ProgramCache::GetExecutableFolder()
+{
+	std::filesystem::path executable;
+
+#ifdef _WIN32
+	char path[MAX_PATH];
+	DWORD length = GetModuleFileNameA(NULL, path, MAX_PATH);
+	if ((length > 0) && (length < MAX_PATH))
+	{
+		executable = std::string(path, length);
+	}
+#else
+	char path[4096];
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+	if ((length > 0) && ((size_t)length < sizeof(path)))
+	{
+		executable = std::string(path, (size_t)length);
+	}
+#endif
+
+	if (executable.empty())
+	{
+		return ".";
+	}
+	return executable.parent_path().string();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for opening the cache that the
+ *  shader builds of the process load and save their
+ *  programs in.  It fails when the driver cannot hand out
+ *  program binaries.
+ ***********************************************************/
+bool ProgramCache::Open(const std::string& folderName)
+{
+	std::string cacheFolder = (std::filesystem::path(GetExecutableFolder()) / folderName).string();
+
+	g_bCacheOpened = g_OpenedCache.Initialize(cacheFolder);
+	return g_bCacheOpened;
+}
+
+/***********************************************************
+ *  GetOpened()
+ *
+ *  This method is used for getting the opened cache, or NULL
+ *  when no cache is opened.
+ ***********************************************************/
+ProgramCache* ProgramCache::GetOpened()
+{
+	return g_bCacheOpened ? &g_OpenedCache : NULL;
+}
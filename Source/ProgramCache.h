@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.h
+// ============
+// store linked shader program binaries on disk for fast startup
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  ProgramCache
+ *
+ *  This class contains the code for caching linked shader
+ *  programs.  After a program is built from source its
+ *  driver binary is written to a cache file named by the key
+ *  of its sources, and later builds of the same sources load
+ *  the binary instead of compiling.  A cache file is only
+ *  used when it was saved by the same driver and its data is
+ *  intact - otherwise the program is built and saved again.
+ ***********************************************************/
+class ProgramCache
+{
+public:
+	// constructor
+	ProgramCache();
+
+private:
+	// folder the cache files are written to
+	std::string m_cacheFolder;
+	// hash of the vendor, renderer and version of the driver
+	uint64_t m_driverHash;
+	// number of programs loaded from and saved to the cache
+	int m_loadedPrograms;
+	int m_savedPrograms;
+
+	// get the path of the cache file of a program key
+	std::string GetCacheFile(uint64_t key) const;
+
+public:
+	// check that the driver can hand out program binaries and note
+	// its identity - needs the OpenGL context to be current
+	bool Initialize(const std::string& cacheFolder);
+	// load a program from its cache file, or get 0 when it is not
+	// cached or the cache file does not match
+	GLuint LoadProgram(uint64_t key);
+	// write the binary of a linked program to its cache file
+	bool SaveProgram(uint64_t key, GLuint program);
+	// print the number of programs loaded from and saved to the cache
+	void PrintStatistics() const;
+
+	// get the key of a program from its sources and permutation key
+	static uint64_t MakeKey(
+		const std::string& vertexSource,
+		const std::string& fragmentSource,
+		uint64_t permutationKey);
+	// get the folder the executable file is in
+	static std::string GetExecutableFolder();
+	// open the cache used by every shader build of the process, in a
+	// folder next to the executable
+	static bool Open(const std::string& folderName);
+	// get the opened cache, or NULL when programs are not cached
+	static ProgramCache* GetOpened();
+};
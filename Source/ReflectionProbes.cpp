@@ -0,0 +1,839 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionprobes.cpp
+// ============
+// render the static scene into prefiltered cube maps around the table, for
+// the reflections of the gold and glass materials
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ReflectionProbes.h"
+
+#include "MappedFile.h"
+#include "ResourceRegistry.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+	// the cache file identifier and version
+	const unsigned char g_CacheIdentifier[8] = { 'R', 'E', 'F', 'L', 'E', 'C', 'T', 'S' };
+	const uint32_t g_CacheVersion = 1;
+	// size of the fixed header of the cache file
+	const size_t g_CacheHeaderSize = 48;
+
+	// the texture unit of the probes, after the irradiance probes
+	const int g_ProbeTextureUnit = 26;
+	// pixels across a face of the finest level, and the levels of the
+	// chain, as REFLECTION_LEVELS in the fragment shader - the last one
+	// is blurred over the whole hemisphere for the roughest materials
+	const int g_FaceSize = 128;
+	const int g_ProbeLevels = 6;
+	// directions a texel of a blurred level is filtered from
+	const int g_FilterSamples = 64;
+	// height of the probes over the bottom of the scene, as a share of
+	// its height, and the least distance they keep from it
+	const float g_ProbeHeightShare = 0.5f;
+	const float g_MinProbeHeight = 1.0f;
+	const float g_NearDepth = 0.05f;
+	const float g_Pi = 3.14159265358979f;
+
+	// the view direction and up vector of each cube map face, in the
+	// order of the OpenGL cube map layers
+	const glm::vec3 g_CubeFaceDirections[6] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+	const glm::vec3 g_CubeFaceUps[6] = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+
+	uint32_t ReadUInt32(const unsigned char* data, size_t offset)
+	{
+		uint32_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadUInt64(const unsigned char* data, size_t offset)
+	{
+		uint64_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	void WriteUInt32(std::vector<unsigned char>& data, size_t offset, uint32_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	void WriteUInt64(std::vector<unsigned char>& data, size_t offset, uint64_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	// the texels of one level of every probe, six faces to a probe
+	size_t GetLevelTexels(int probeCount, int level)
+	{
+		size_t size = (size_t)(g_FaceSize >> level);
+		return (size_t)probeCount * 6 * size * size;
+	}
+
+	// the direction through the center of a texel of a cube map face,
+	// with the rows going up the face as OpenGL reads them
+	glm::vec3 GetTexelDirection(int face, int x, int y, int size)
+	{
+		float u = ((2.0f * ((float)x + 0.5f)) / (float)size) - 1.0f;
+		float v = ((2.0f * ((float)y + 0.5f)) / (float)size) - 1.0f;
+		switch (face)
+		{
+		case 0:
+			return glm::normalize(glm::vec3(1.0f, -v, -u));
+		case 1:
+			return glm::normalize(glm::vec3(-1.0f, -v, u));
+		case 2:
+			return glm::normalize(glm::vec3(u, 1.0f, v));
+		case 3:
+			return glm::normalize(glm::vec3(u, -1.0f, -v));
+		case 4:
+			return glm::normalize(glm::vec3(u, -v, 1.0f));
+		default:
+			return glm::normalize(glm::vec3(-u, -v, -1.0f));
+		}
+	}
+
+	// the texel of a probe a direction points at, in a level of faces
+	// laid out like the texture
+	const glm::vec3& SampleFaces(const std::vector<glm::vec3>& faces, int size, int probe, const glm::vec3& direction)
+	{
+		glm::vec3 absolute = glm::abs(direction);
+		int face = 0;
+		float major = 1.0f;
+		float s = 0.0f;
+		float t = 0.0f;
+		if ((absolute.x >= absolute.y) && (absolute.x >= absolute.z))
+		{
+			face = (direction.x > 0.0f) ? 0 : 1;
+			major = absolute.x;
+			s = (direction.x > 0.0f) ? -direction.z : direction.z;
+			t = -direction.y;
+		}
+		else if (absolute.y >= absolute.z)
+		{
+			face = (direction.y > 0.0f) ? 2 : 3;
+			major = absolute.y;
+			s = direction.x;
+			t = (direction.y > 0.0f) ? direction.z : -direction.z;
+		}
+		else
+		{
+			face = (direction.z > 0.0f) ? 4 : 5;
+			major = absolute.z;
+			s = (direction.z > 0.0f) ? direction.x : -direction.x;
+			t = -direction.y;
+		}
+
+		int x = glm::clamp((int)((((s / major) + 1.0f) * 0.5f) * (float)size), 0, size - 1);
+		int y = glm::clamp((int)((((t / major) + 1.0f) * 0.5f) * (float)size), 0, size - 1);
+		return faces[((((size_t)probe * 6) + face) * size + y) * size + x];
+	}
+
+	// the second coordinate of a filter sample, spread evenly by
+	// reversing the bits of its number
+	float RadicalInverse(uint32_t bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return (float)bits * 2.3283064365386963e-10f;
+	}
+}
+
+/***********************************************************
+ *  ReflectionProbes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ReflectionProbes::ReflectionProbes()
+{
+	m_bSupported = false;
+	m_texture = 0;
+	m_framebuffer = 0;
+	m_faceTexture = 0;
+	m_depthBuffer = 0;
+	m_probeCount = 0;
+	for (int i = 0; i < MAX_PROBES; i++)
+	{
+		m_probePositions[i] = glm::vec3(0.0f);
+	}
+	m_boxMin = glm::vec3(0.0f);
+	m_boxMax = glm::vec3(0.0f);
+	m_farDistance = 1.0f;
+	m_sceneHash = 0;
+	m_lightHash = 0;
+	m_probeSceneHash = 0;
+	m_probeLightHash = 0;
+	m_bSceneSet = false;
+	m_bLightsSet = false;
+	m_bReady = false;
+	m_bCacheChecked = false;
+	m_updateProbe = 0;
+	m_updateFace = 0;
+	m_savedFramebuffer = 0;
+	m_savedViewport[0] = 0;
+	m_savedViewport[1] = 0;
+	m_savedViewport[2] = 0;
+	m_savedViewport[3] = 0;
+	m_renderMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~ReflectionProbes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ReflectionProbes::~ReflectionProbes()
+{
+	if (m_texture != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteTextures(1, &m_faceTexture);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the target the faces
+ *  of the probes are drawn into, and setting the cache file
+ *  the probes are kept in.  The probes are the layers of a
+ *  cube map array, which needs OpenGL 4.0.
+ ***********************************************************/
+bool ReflectionProbes::Initialize(const std::string& cacheFile)
+{
+	m_cacheFile = cacheFile;
+	if ((GLEW_VERSION_4_0 == GL_FALSE) && (GLEW_ARB_texture_cube_map_array == GL_FALSE))
+	{
+		std::cout << "Reflection probes need cube map arrays, the metals and glass are drawn without reflections" << std::endl;
+		return false;
+	}
+
+	// the faces are drawn with the lit programs, whose colors can
+	// go over 1 before they are filtered
+	glGenTextures(1, &m_faceTexture);
+	glBindTexture(GL_TEXTURE_2D, m_faceTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, g_FaceSize, g_FaceSize, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, g_FaceSize, g_FaceSize);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_faceTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	m_bSupported = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!m_bSupported)
+	{
+		std::cout << "The reflection probes cannot be drawn to, the metals and glass are drawn without reflections" << std::endl;
+		return false;
+	}
+
+	// a blurred level is read across the edges of its faces
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+	glGenTextures(1, &m_texture);
+
+	return true;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the probes can be
+ *  drawn.
+ ***********************************************************/
+bool ReflectionProbes::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for setting the scene lights the
+ *  probes are drawn with.
+ ***********************************************************/
+void ReflectionProbes::SetLights(const std::vector<LightmapBaker::BAKED_LIGHT>& lights)
+{
+	uint64_t lightHash = LightmapBaker::HashLights(lights);
+	if (!m_bLightsSet || (lightHash != m_lightHash))
+	{
+		m_bCacheChecked = false;
+	}
+	m_lightHash = lightHash;
+	m_bLightsSet = true;
+}
+
+/***********************************************************
+ *  SetScene()
+ *
+ *  This method is used for placing the probes over a
+ *  captured scene.  The scene is split into a grid over the
+ *  table, with a probe over the middle of every cell, and
+ *  the box the reflections are corrected for is the bounds
+ *  of the scene raised to half its width, as nothing above
+ *  the objects is drawn that would give it a ceiling.
+ ***********************************************************/
+void ReflectionProbes::SetScene(const SceneCapture& capture)
+{
+	const std::vector<SceneCapture::CAPTURED_VERTEX>& vertices = capture.GetVertices();
+	if (vertices.empty())
+	{
+		return;
+	}
+
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+	glm::vec3 extent = boundsMax - boundsMin;
+
+	float height = std::max(extent.y * g_ProbeHeightShare, g_MinProbeHeight);
+	m_probeCount = 0;
+	for (int z = 0; z < PROBE_GRID; z++)
+	{
+		for (int x = 0; x < PROBE_GRID; x++)
+		{
+			glm::vec3 cell(((float)x + 0.5f) / (float)PROBE_GRID, 0.0f, ((float)z + 0.5f) / (float)PROBE_GRID);
+			m_probePositions[m_probeCount] = boundsMin + (extent * cell) + glm::vec3(0.0f, height, 0.0f);
+			m_probeCount++;
+		}
+	}
+
+	m_boxMin = boundsMin;
+	m_boxMax = boundsMax;
+	m_boxMax.y = std::max(boundsMax.y, boundsMin.y + (0.5f * std::max(extent.x, extent.z)));
+	m_boxMax.y = std::max(m_boxMax.y, boundsMin.y + height + g_MinProbeHeight);
+	m_farDistance = std::max(glm::length(m_boxMax - m_boxMin), g_MinProbeHeight);
+
+	uint64_t sceneHash = capture.GetSceneHash();
+	if (!m_bSceneSet || (sceneHash != m_sceneHash))
+	{
+		m_bCacheChecked = false;
+	}
+	m_sceneHash = sceneHash;
+	m_bSceneSet = true;
+}
+
+/***********************************************************
+ *  NeedsUpdate()
+ *
+ *  This method is used for checking if the probes have to
+ *  be drawn for the current scene and lights.  The cache
+ *  file is read once for them first, and the probes it
+ *  holds are used when it was written for the same ones.
+ ***********************************************************/
+bool ReflectionProbes::NeedsUpdate()
+{
+	if (!m_bSupported || !m_bSceneSet || !m_bLightsSet)
+	{
+		return false;
+	}
+	if (m_bReady && (m_probeSceneHash == m_sceneHash) && (m_probeLightHash == m_lightHash))
+	{
+		return false;
+	}
+	if (!m_bCacheChecked)
+	{
+		m_bCacheChecked = true;
+		if (LoadCache())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  IsReady()
+ *
+ *  This method is used for checking if the probes hold a
+ *  drawn scene.
+ ***********************************************************/
+bool ReflectionProbes::IsReady() const
+{
+	return m_bReady;
+}
+
+/***********************************************************
+ *  BeginUpdate()
+ *
+ *  This method is used for starting to draw the faces of
+ *  every probe into the face target.
+ ***********************************************************/
+bool ReflectionProbes::BeginUpdate()
+{
+	if (!m_bSupported || (m_probeCount == 0))
+	{
+		return false;
+	}
+
+	m_updateStart = std::chrono::steady_clock::now();
+	m_faces.assign(GetLevelTexels(m_probeCount, 0), glm::vec3(0.0f));
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, g_FaceSize, g_FaceSize);
+	glEnable(GL_DEPTH_TEST);
+
+	return true;
+}
+
+/***********************************************************
+ *  GetProbeCount()
+ *
+ *  This method is used for getting the number of probes.
+ ***********************************************************/
+int ReflectionProbes::GetProbeCount() const
+{
+	return m_probeCount;
+}
+
+/***********************************************************
+ *  GetFaceCount()
+ *
+ *  This method is used for getting the number of faces of
+ *  a probe.
+ ***********************************************************/
+int ReflectionProbes::GetFaceCount() const
+{
+	return 6;
+}
+
+/***********************************************************
+ *  BeginFace()
+ *
+ *  This method is used for drawing the following objects
+ *  into a face of a probe, over the clear color of the
+ *  frames.
+ ***********************************************************/
+void ReflectionProbes::BeginFace(int probe, int face)
+{
+	m_updateProbe = probe;
+	m_updateFace = face;
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/***********************************************************
+ *  EndFace()
+ *
+ *  This method is used for reading back the face that was
+ *  drawn into its place among the faces of the probes.
+ ***********************************************************/
+void ReflectionProbes::EndFace()
+{
+	size_t first = (((size_t)m_updateProbe * 6) + m_updateFace) * g_FaceSize * g_FaceSize;
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, g_FaceSize, g_FaceSize, GL_RGB, GL_FLOAT, &m_faces[first]);
+}
+
+/***********************************************************
+ *  EndUpdate()
+ *
+ *  This method is used for finishing the probes - the
+ *  framebuffer and viewport of the frame are restored, and
+ *  the faces read back are filtered into the probe texture
+ *  and written to the cache file.
+ ***********************************************************/
+void ReflectionProbes::EndUpdate(ThreadPool* threadPool)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+
+	std::vector<std::vector<uint32_t>> levels;
+	PrefilterFaces(threadPool, levels);
+	m_faces.clear();
+	m_faces.shrink_to_fit();
+
+	m_bReady = UploadLevels(levels);
+	m_probeSceneHash = m_sceneHash;
+	m_probeLightHash = m_lightHash;
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - m_updateStart;
+	m_renderMilliseconds = time.count();
+	if (!m_bReady)
+	{
+		return;
+	}
+
+	std::cout << "Drew " << m_probeCount << " reflection probes in " << m_renderMilliseconds << " ms" << std::endl;
+	SaveCache(levels);
+}
+
+/***********************************************************
+ *  PrefilterFaces()
+ *
+ *  This method is used for filtering the faces read back
+ *  into the levels of the probes.  The finest level is the
+ *  mirror reflection, and every following one is the
+ *  Phong lobe of a rougher material - the roughness grows
+ *  evenly down the chain, and the lobe of a roughness is
+ *  the one of the shininess the fragment shader maps to
+ *  it.  The directions of a texel are spread over its lobe
+ *  by their chance, and each one reads the box filtered
+ *  level whose texels are about as wide as its share of the
+ *  lobe, so few of them are enough without speckles.
+ ***********************************************************/
+void ReflectionProbes::PrefilterFaces(ThreadPool* threadPool, std::vector<std::vector<uint32_t>>& levels) const
+{
+	// the faces box filtered down the chain, which the directions of
+	// the blurred levels are read from
+	std::vector<std::vector<glm::vec3>> sources(g_ProbeLevels);
+	sources[0] = m_faces;
+	for (int level = 1; level < g_ProbeLevels; level++)
+	{
+		int size = g_FaceSize >> level;
+		const std::vector<glm::vec3>& finer = sources[level - 1];
+		std::vector<glm::vec3>& coarser = sources[level];
+		coarser.resize(GetLevelTexels(m_probeCount, level));
+		for (size_t layer = 0; layer < (size_t)m_probeCount * 6; layer++)
+		{
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					size_t row = ((layer * size * 2) + (y * 2)) * size * 2;
+					glm::vec3 sum = finer[row + (x * 2)] + finer[row + (x * 2) + 1] +
+						finer[row + (size * 2) + (x * 2)] + finer[row + (size * 2) + (x * 2) + 1];
+					coarser[((layer * size) + y) * size + x] = sum * 0.25f;
+				}
+			}
+		}
+	}
+
+	levels.assign(g_ProbeLevels, std::vector<uint32_t>());
+	for (int level = 0; level < g_ProbeLevels; level++)
+	{
+		levels[level].resize(GetLevelTexels(m_probeCount, level));
+	}
+	for (size_t i = 0; i < m_faces.size(); i++)
+	{
+		levels[0][i] = LightmapBaker::PackSharedExponent(m_faces[i]);
+	}
+
+	// the solid angle of a texel of the finest level
+	float texelAngle = (4.0f * g_Pi) / (6.0f * (float)g_FaceSize * (float)g_FaceSize);
+	int layerCount = m_probeCount * 6;
+	threadPool->ParallelFor(layerCount * (g_ProbeLevels - 1), [&](int job)
+	{
+		int level = 1 + (job / layerCount);
+		int layer = job % layerCount;
+		int probe = layer / 6;
+		int face = layer % 6;
+		int size = g_FaceSize >> level;
+		// the shininess of the level, the inverse of the roughness the
+		// shader reads its level with
+		float roughness = (float)level / (float)(g_ProbeLevels - 1);
+		float exponent = (2.0f / std::pow(roughness, 4.0f)) - 2.0f;
+
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				glm::vec3 normal = GetTexelDirection(face, x, y, size);
+				glm::vec3 up = (std::abs(normal.y) < 0.99f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+				glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+				glm::vec3 bitangent = glm::cross(normal, tangent);
+
+				glm::vec3 sum(0.0f);
+				for (int sample = 0; sample < g_FilterSamples; sample++)
+				{
+					float cosine = std::pow(((float)sample + 0.5f) / (float)g_FilterSamples, 1.0f / (exponent + 1.0f));
+					float sine = std::sqrt(std::max(0.0f, 1.0f - (cosine * cosine)));
+					float angle = 2.0f * g_Pi * RadicalInverse((uint32_t)sample);
+					glm::vec3 direction = (tangent * (sine * std::cos(angle))) + (bitangent * (sine * std::sin(angle))) + (normal * cosine);
+
+					float chance = ((exponent + 1.0f) / (2.0f * g_Pi)) * std::pow(cosine, exponent);
+					float sampleAngle = 1.0f / ((float)g_FilterSamples * std::max(chance, 1.0e-6f));
+					float source = (0.5f * std::log2(sampleAngle / texelAngle)) + 1.0f;
+					int sourceLevel = glm::clamp((int)std::lround(source), 0, g_ProbeLevels - 1);
+					sum += SampleFaces(sources[sourceLevel], g_FaceSize >> sourceLevel, probe, direction);
+				}
+
+				size_t texel = (((size_t)layer * size) + y) * size + x;
+				levels[level][texel] = LightmapBaker::PackSharedExponent(sum / (float)g_FilterSamples);
+			}
+		}
+	});
+}
+
+/***********************************************************
+ *  UploadLevels()
+ *
+ *  This method is used for creating the probe texture from
+ *  the packed levels of every probe.
+ ***********************************************************/
+bool ReflectionProbes::UploadLevels(const std::vector<std::vector<uint32_t>>& levels)
+{
+	if ((m_texture == 0) || ((int)levels.size() != g_ProbeLevels))
+	{
+		return false;
+	}
+
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (int level = 0; level < g_ProbeLevels; level++)
+	{
+		int size = g_FaceSize >> level;
+		glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, level, GL_RGB9_E5, size, size, m_probeCount * 6, 0,
+			GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, levels[level].data());
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, g_ProbeLevels - 1);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+	return true;
+}
+
+/***********************************************************
+ *  LoadCache()
+ *
+ *  This method is used for loading the probes from the
+ *  cache file when they were drawn for the current scene
+ *  and lights.
+ ***********************************************************/
+bool ReflectionProbes::LoadCache()
+{
+	std::error_code error;
+	if (m_cacheFile.empty() || !std::filesystem::is_regular_file(m_cacheFile, error))
+	{
+		return false;
+	}
+
+	MappedFile file;
+	if (!file.Open(m_cacheFile) || (file.GetSize() < g_CacheHeaderSize))
+	{
+		return false;
+	}
+
+	size_t texelBytes = 0;
+	for (int level = 0; level < g_ProbeLevels; level++)
+	{
+		texelBytes += GetLevelTexels(m_probeCount, level) * sizeof(uint32_t);
+	}
+	const unsigned char* data = file.GetData();
+	if ((memcmp(data, g_CacheIdentifier, sizeof(g_CacheIdentifier)) != 0) ||
+		(ReadUInt32(data, 8) != g_CacheVersion) ||
+		(ReadUInt32(data, 12) != (uint32_t)m_probeCount) ||
+		(ReadUInt64(data, 16) != m_sceneHash) ||
+		(ReadUInt64(data, 24) != m_lightHash) ||
+		(ReadUInt32(data, 32) != (uint32_t)g_FaceSize) ||
+		(ReadUInt32(data, 36) != (uint32_t)g_ProbeLevels) ||
+		(file.GetSize() != g_CacheHeaderSize + texelBytes) ||
+		(ResourceRegistry::HashBytes(data + g_CacheHeaderSize, texelBytes) != ReadUInt64(data, 40)))
+	{
+		return false;
+	}
+
+	std::vector<std::vector<uint32_t>> levels(g_ProbeLevels);
+	size_t offset = g_CacheHeaderSize;
+	for (int level = 0; level < g_ProbeLevels; level++)
+	{
+		levels[level].resize(GetLevelTexels(m_probeCount, level));
+		memcpy(levels[level].data(), data + offset, levels[level].size() * sizeof(uint32_t));
+		offset += levels[level].size() * sizeof(uint32_t);
+	}
+
+	if (!UploadLevels(levels))
+	{
+		return false;
+	}
+	m_bReady = true;
+	m_probeSceneHash = m_sceneHash;
+	m_probeLightHash = m_lightHash;
+	m_renderMilliseconds = 0.0;
+	std::cout << "Loaded the reflection probes from the cache file:" << m_cacheFile << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  SaveCache()
+ *
+ *  This method is used for writing the levels of the probes
+ *  to the cache file, under a temporary name that is then
+ *  renamed so a reader never sees half of it.
+ ***********************************************************/
+void ReflectionProbes::SaveCache(const std::vector<std::vector<uint32_t>>& levels) const
+{
+	if (m_cacheFile.empty())
+	{
+		return;
+	}
+
+	size_t texelBytes = 0;
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		texelBytes += levels[level].size() * sizeof(uint32_t);
+	}
+	std::vector<unsigned char> data(g_CacheHeaderSize + texelBytes, 0);
+	size_t offset = g_CacheHeaderSize;
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		memcpy(&data[offset], levels[level].data(), levels[level].size() * sizeof(uint32_t));
+		offset += levels[level].size() * sizeof(uint32_t);
+	}
+
+	memcpy(&data[0], g_CacheIdentifier, sizeof(g_CacheIdentifier));
+	WriteUInt32(data, 8, g_CacheVersion);
+	WriteUInt32(data, 12, (uint32_t)m_probeCount);
+	WriteUInt64(data, 16, m_probeSceneHash);
+	WriteUInt64(data, 24, m_probeLightHash);
+	WriteUInt32(data, 32, (uint32_t)g_FaceSize);
+	WriteUInt32(data, 36, (uint32_t)g_ProbeLevels);
+	WriteUInt64(data, 40, ResourceRegistry::HashBytes(&data[g_CacheHeaderSize], texelBytes));
+
+	std::string tempFile = m_cacheFile + ".tmp";
+	std::error_code error;
+	std::filesystem::path folder = std::filesystem::path(m_cacheFile).parent_path();
+	if (!folder.empty())
+	{
+		std::filesystem::create_directories(folder, error);
+	}
+	{
+		std::ofstream output(tempFile, std::ios::binary | std::ios::trunc);
+		output.write((const char*)data.data(), (std::streamsize)data.size());
+		if (!output.good())
+		{
+			std::cout << "Could not write reflection probe cache file:" << m_cacheFile << std::endl;
+			return;
+		}
+	}
+	std::filesystem::rename(tempFile, m_cacheFile, error);
+	if (error)
+	{
+		std::cout << "Could not write reflection probe cache file:" << m_cacheFile << std::endl;
+		std::filesystem::remove(tempFile, error);
+	}
+}
+
+/***********************************************************
+ *  GetProbePosition()
+ *
+ *  This method is used for getting the position a probe is
+ *  drawn from.
+ ***********************************************************/
+glm::vec3 ReflectionProbes::GetProbePosition(int probe) const
+{
+	return m_probePositions[probe];
+}
+
+/***********************************************************
+ *  GetFaceView()
+ *
+ *  This method is used for getting the view matrix of a
+ *  face of a probe.
+ ***********************************************************/
+glm::mat4 ReflectionProbes::GetFaceView(int probe, int face) const
+{
+	const glm::vec3& position = m_probePositions[probe];
+	return glm::lookAt(position, position + g_CubeFaceDirections[face], g_CubeFaceUps[face]);
+}
+
+/***********************************************************
+ *  GetFaceProjection()
+ *
+ *  This method is used for getting the projection matrix of
+ *  the faces, which reaches across the whole scene.
+ ***********************************************************/
+glm::mat4 ReflectionProbes::GetFaceProjection() const
+{
+	return glm::perspective(glm::radians(90.0f), 1.0f, g_NearDepth, m_farDistance);
+}
+
+/***********************************************************
+ *  GetFaceSize()
+ *
+ *  This method is used for getting the pixels across a
+ *  face that is drawn.
+ ***********************************************************/
+int ReflectionProbes::GetFaceSize() const
+{
+	return g_FaceSize;
+}
+
+/***********************************************************
+ *  GetRenderTime()
+ *
+ *  This method is used for getting the time the last update
+ *  of the probes took in milliseconds, 0 when they were
+ *  loaded from the cache file.
+ ***********************************************************/
+double ReflectionProbes::GetRenderTime() const
+{
+	return m_renderMilliseconds;
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding the probe texture to its
+ *  texture unit.
+ ***********************************************************/
+void ReflectionProbes::BindTexture() const
+{
+	if (!m_bReady)
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + g_ProbeTextureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for setting the probe texture, the
+ *  probes and the box they are corrected for on a program
+ *  that draws with them.
+ ***********************************************************/
+void ReflectionProbes::SetShaderValues(GLuint program) const
+{
+	glUniform1i(glGetUniformLocation(program, "reflectionProbes"), g_ProbeTextureUnit);
+	glUniform1i(glGetUniformLocation(program, "reflectionProbeCount"), m_probeCount);
+	glUniform3fv(glGetUniformLocation(program, "reflectionProbePositions"), MAX_PROBES, glm::value_ptr(m_probePositions[0]));
+	glUniform3fv(glGetUniformLocation(program, "reflectionBoxMin"), 1, glm::value_ptr(m_boxMin));
+	glUniform3fv(glGetUniformLocation(program, "reflectionBoxMax"), 1, glm::value_ptr(m_boxMax));
+}
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionprobes.h
+// ============
+// render the static scene into prefiltered cube maps around the table, for
+// the reflections of the gold and glass materials
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LightmapBaker.h"
+#include "SceneCapture.h"
+#include "ThreadPool.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ReflectionProbes
+ *
+ *  This class contains the code for the reflection probes
+ *  of the scene.  A few probes are spread over the captured
+ *  scene, and the scene is drawn once into the six faces of
+ *  each one by the lit programs.  The faces are read back
+ *  and prefiltered on the worker threads into a mip chain,
+ *  every level blurred for a rougher material, and kept in
+ *  a cube map array and in a cache file, so the probes are
+ *  only drawn again when the captured scene or the scene
+ *  lights change.  A reflective fragment reads its nearest
+ *  probe along its reflected view, corrected for the box
+ *  around the scene so the reflection lines up with the
+ *  objects it shows.
+ ***********************************************************/
+class ReflectionProbes
+{
+public:
+	// constructor
+	ReflectionProbes();
+	// destructor
+	~ReflectionProbes();
+
+	// the textures cannot be shared between two objects
+	ReflectionProbes(const ReflectionProbes&) = delete;
+	ReflectionProbes& operator=(const ReflectionProbes&) = delete;
+
+	// the probes along each horizontal axis of the scene, as
+	// MAX_REFLECTION_PROBES in the fragment shader
+	static const int PROBE_GRID = 2;
+	static const int MAX_PROBES = PROBE_GRID * PROBE_GRID;
+
+private:
+	bool m_bSupported;
+	// the prefiltered probes, and the target a face is drawn into
+	GLuint m_texture;
+	GLuint m_framebuffer;
+	GLuint m_faceTexture;
+	GLuint m_depthBuffer;
+	std::string m_cacheFile;
+	// the probes and the box they are corrected for
+	int m_probeCount;
+	glm::vec3 m_probePositions[MAX_PROBES];
+	glm::vec3 m_boxMin;
+	glm::vec3 m_boxMax;
+	float m_farDistance;
+	// the scene and lights to draw, and the ones the probes show
+	uint64_t m_sceneHash;
+	uint64_t m_lightHash;
+	uint64_t m_probeSceneHash;
+	uint64_t m_probeLightHash;
+	bool m_bSceneSet;
+	bool m_bLightsSet;
+	bool m_bReady;
+	// the cache file has been read for the current scene and lights
+	bool m_bCacheChecked;
+	// the faces read back during an update, and the frame state they
+	// replace
+	std::vector<glm::vec3> m_faces;
+	int m_updateProbe;
+	int m_updateFace;
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	std::chrono::steady_clock::time_point m_updateStart;
+	double m_renderMilliseconds;
+
+	// filter the faces read back into the levels of every probe, packed
+	// in the layout of the texture
+	void PrefilterFaces(ThreadPool* threadPool, std::vector<std::vector<uint32_t>>& levels) const;
+	// create the texture from packed levels
+	bool UploadLevels(const std::vector<std::vector<uint32_t>>& levels);
+	// read the levels from the cache file, or write them there
+	bool LoadCache();
+	void SaveCache(const std::vector<std::vector<uint32_t>>& levels) const;
+
+public:
+	// create the face target - needs the OpenGL context to be current
+	bool Initialize(const std::string& cacheFile);
+	// check if the probes can be drawn
+	bool IsSupported() const;
+
+	// set the scene lights the probes are drawn with
+	void SetLights(const std::vector<LightmapBaker::BAKED_LIGHT>& lights);
+	// set the captured scene, placing the probes over it
+	void SetScene(const SceneCapture& capture);
+	// check if the probes do not show the current scene and lights - the
+	// probes are loaded from the cache file instead when it matches
+	bool NeedsUpdate();
+	// check if the probes hold a drawn scene
+	bool IsReady() const;
+
+	// start drawing the probes, returns false when there are none
+	bool BeginUpdate();
+	// get the number of probes, and the faces of each one
+	int GetProbeCount() const;
+	int GetFaceCount() const;
+	// draw the following objects into a face of a probe
+	void BeginFace(int probe, int face);
+	// read back the face that was drawn
+	void EndFace();
+	// filter the faces into the probe texture and the cache file, and
+	// restore the viewport
+	void EndUpdate(ThreadPool* threadPool);
+	// get the view of a face, which the lit programs are given as the
+	// camera while it is drawn
+	glm::vec3 GetProbePosition(int probe) const;
+	glm::mat4 GetFaceView(int probe, int face) const;
+	glm::mat4 GetFaceProjection() const;
+	int GetFaceSize() const;
+	// get the time the last update took in milliseconds
+	double GetRenderTime() const;
+
+	// bind the probe texture for the lit programs - call once per frame
+	void BindTexture() const;
+	// set the probes on a program that draws with them
+	void SetShaderValues(GLuint program) const;
+};
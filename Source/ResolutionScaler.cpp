@@ -0,0 +1,550 @@
+///////////////////////////////////////////////////////////////////////////////
+// resolutionscaler.cpp
+// ============
+// draw the frames at the resolution that keeps them within a frame time,
+// and filter them up to the display window
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ResolutionScaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// the scaled frame is bound to the texture unit after the weighted
+	// sums of the transparent objects
+	const int g_FrameTextureUnit = 29;
+	const char* g_FrameSamplerName = "scaledFrame";
+	// the widest bounds of the scale, and the steps it moves in, so the
+	// targets sized to the viewport are only created again when it
+	// settles on another step
+	const float g_LowestScale = 0.25f;
+	const float g_ScaleStep = 0.05f;
+	// the scale is lowered once the frames take longer than this share
+	// of the target, and raised once they take less than this one, and
+	// a new scale aims between the two so the choice does not flip on
+	// the noise of the timings or a frame held to the display refresh
+	const double g_LowerMargin = 1.05;
+	const double g_RaiseMargin = 0.8;
+	const double g_AimMargin = 0.9;
+	// the measured frames at one scale the next is chosen from by their
+	// median, so a single slow frame does not move it, and the weight of
+	// a new measurement in the reported averages
+	const int g_MeasuredFrames = 9;
+	const double g_MeasurementWeight = 0.2;
+	// the scale the sharpening reaches its full strength at - the less
+	// the frame is scaled the less the filter softens it
+	const float g_FullSharpnessScale = 0.5f;
+	// the frame time aimed for by default, 60 frames per second
+	const double g_DefaultTargetMilliseconds = 16.6;
+
+	// move an average towards a new measurement
+	void Average(double& average, double measurement, bool bFirst)
+	{
+		average = bFirst ? measurement : average + ((measurement - average) * g_MeasurementWeight);
+	}
+}
+
+/***********************************************************
+ *  ResolutionScaler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ResolutionScaler::ResolutionScaler()
+{
+	m_bSupported = false;
+	m_framebuffer = 0;
+	m_colorTexture = 0;
+	m_depthBuffer = 0;
+	m_depthFormat = GL_DEPTH24_STENCIL8;
+	m_width = 0;
+	m_height = 0;
+	m_windowWidth = 1;
+	m_windowHeight = 1;
+	m_drawnWidth = 1;
+	m_drawnHeight = 1;
+	m_screenVertexArray = 0;
+	m_bFrameScaled = false;
+	m_scale = 1.0f;
+	m_minScale = 0.5f;
+	m_maxScale = 1.0f;
+	m_bDynamic = true;
+	m_targetMilliseconds = g_DefaultTargetMilliseconds;
+	m_bTimed = false;
+	for (int i = 0; i < frameQueryCount; i++)
+	{
+		m_queries[i] = 0;
+	}
+	m_bMeasuring = false;
+	m_bPending = false;
+	m_pendingScale = 1.0f;
+	m_gpuMilliseconds = 0.0;
+	m_cpuMilliseconds = 0.0;
+	m_bGpuMeasured = false;
+	m_bCpuMeasured = false;
+	m_frameTimes.reserve(g_MeasuredFrames);
+}
+
+/***********************************************************
+ *  ~ResolutionScaler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ResolutionScaler::~ResolutionScaler()
+{
+	DeleteTarget();
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+	}
+	if (m_screenVertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_screenVertexArray);
+	}
+	if (m_queries[0] != 0)
+	{
+		glDeleteQueries(frameQueryCount, m_queries);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the target at the size
+ *  of the viewport.  The passes that copy the depth of the
+ *  frame expect the format of the display window, so the
+ *  target is given the same one.  The GPU time needs timer
+ *  queries, without them the scale follows the CPU time.
+ ***********************************************************/
+bool ResolutionScaler::Initialize()
+{
+	GLint depthBits = 0;
+	GLint stencilBits = 0;
+	glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthBits);
+	glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+	if (stencilBits > 0)
+	{
+		m_depthFormat = (depthBits > 24) ? GL_DEPTH32F_STENCIL8 : GL_DEPTH24_STENCIL8;
+	}
+	else
+	{
+		m_depthFormat = (depthBits > 24) ? GL_DEPTH_COMPONENT32 : ((depthBits > 16) ? GL_DEPTH_COMPONENT24 : GL_DEPTH_COMPONENT16);
+	}
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glGenVertexArrays(1, &m_screenVertexArray);
+
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	m_windowWidth = std::max(viewport[2], 1);
+	m_windowHeight = std::max(viewport[3], 1);
+	m_drawnWidth = m_windowWidth;
+	m_drawnHeight = m_windowHeight;
+	m_bSupported = CreateTarget(m_windowWidth, m_windowHeight);
+	if (!m_bSupported)
+	{
+		std::cout << "The scaled frames cannot be drawn to - the frames are drawn at the window resolution" << std::endl;
+		return false;
+	}
+
+	m_bTimed = (GLEW_VERSION_3_3 != GL_FALSE) || (GLEW_ARB_timer_query != GL_FALSE);
+	if (m_bTimed)
+	{
+		glGenQueries(frameQueryCount, m_queries);
+	}
+	else
+	{
+		std::cout << "Timer queries are not supported - the resolution follows the CPU time of the frames" << std::endl;
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the frames can be
+ *  drawn into the target.
+ ***********************************************************/
+bool ResolutionScaler::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  CreateTarget()
+ *
+ *  This method is used for creating the target at a size
+ *  and attaching it to the framebuffer.  The color is
+ *  filtered when it is read, so a window pixel between the
+ *  scaled ones blends them.
+ ***********************************************************/
+bool ResolutionScaler::CreateTarget(int width, int height)
+{
+	DeleteTarget();
+
+	GLint boundFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &boundFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glGenTextures(1, &m_colorTexture);
+	glBindTexture(GL_TEXTURE_2D, m_colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, m_depthFormat, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	bool bStencil = (m_depthFormat == GL_DEPTH24_STENCIL8) || (m_depthFormat == GL_DEPTH32F_STENCIL8);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, bStencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, boundFramebuffer);
+
+	m_width = width;
+	m_height = height;
+	return (status == GL_FRAMEBUFFER_COMPLETE);
+}
+
+/***********************************************************
+ *  DeleteTarget()
+ *
+ *  This method is used for deleting the target.
+ ***********************************************************/
+void ResolutionScaler::DeleteTarget()
+{
+	if (m_depthBuffer != 0)
+	{
+		glDeleteTextures(1, &m_colorTexture);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_colorTexture = 0;
+		m_depthBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  SetTargetFrameTime()
+ *
+ *  This method is used for setting the frame time the
+ *  scale aims for in milliseconds.
+ ***********************************************************/
+void ResolutionScaler::SetTargetFrameTime(double milliseconds)
+{
+	if (milliseconds > 0.0)
+	{
+		m_targetMilliseconds = milliseconds;
+	}
+}
+
+/***********************************************************
+ *  GetTargetFrameTime()
+ *
+ *  This method is used for getting the frame time the scale
+ *  aims for in milliseconds.
+ ***********************************************************/
+double ResolutionScaler::GetTargetFrameTime() const
+{
+	return m_targetMilliseconds;
+}
+
+/***********************************************************
+ *  SetScaleBounds()
+ *
+ *  This method is used for setting the lowest and highest
+ *  scale of the width and height, and moving the scale
+ *  inside them.
+ ***********************************************************/
+void ResolutionScaler::SetScaleBounds(float minScale, float maxScale)
+{
+	m_maxScale = std::min(std::max(maxScale, g_LowestScale), 1.0f);
+	m_minScale = std::min(std::max(minScale, g_LowestScale), m_maxScale);
+	SetScale(m_scale);
+}
+
+/***********************************************************
+ *  SetScale()
+ *
+ *  This method is used for setting the scale of the width
+ *  and height.  The frames measured at the previous scale
+ *  are forgotten.
+ ***********************************************************/
+void ResolutionScaler::SetScale(float scale)
+{
+	scale = LimitScale(scale);
+	if (scale != m_scale)
+	{
+		m_scale = scale;
+		m_bGpuMeasured = false;
+		m_bCpuMeasured = false;
+		m_frameTimes.clear();
+	}
+}
+
+/***********************************************************
+ *  GetScale()
+ *
+ *  This method is used for getting the scale of the width
+ *  and height the frames are drawn at once they can be
+ *  filtered up.
+ ***********************************************************/
+float ResolutionScaler::GetScale() const
+{
+	return m_scale;
+}
+
+/***********************************************************
+ *  SetDynamic()
+ *
+ *  This method is used for choosing whether the scale
+ *  follows the frame time, or stays where it was set.
+ ***********************************************************/
+void ResolutionScaler::SetDynamic(bool bDynamic)
+{
+	m_bDynamic = bDynamic;
+}
+
+/***********************************************************
+ *  IsDynamic()
+ *
+ *  This method is used for checking if the scale follows
+ *  the frame time.
+ ***********************************************************/
+bool ResolutionScaler::IsDynamic() const
+{
+	return m_bDynamic;
+}
+
+/***********************************************************
+ *  LimitScale()
+ *
+ *  This method is used for keeping a scale inside its
+ *  bounds and on its steps.  A scale between two steps is
+ *  rounded down, so a lowered scale does not fall short of
+ *  the frame time.
+ ***********************************************************/
+float ResolutionScaler::LimitScale(float scale) const
+{
+	scale = std::floor((scale / g_ScaleStep) + 0.001f) * g_ScaleStep;
+	return std::min(std::max(scale, m_minScale), m_maxScale);
+}
+
+/***********************************************************
+ *  UpdateScale()
+ *
+ *  This method is used for moving the scale towards the
+ *  frame time.  The frames are timed on the GPU, which only
+ *  counts the drawing and not the wait for the display, so
+ *  the frames held to its refresh do not hold the scale
+ *  down.  The time of the pixels grows with their count,
+ *  the square of the scale, which gives the scale that
+ *  meets the frame time in one move.  A raised scale moves
+ *  up at least one step, as the rounding down to the steps
+ *  would otherwise take a small raise back.  The frames at
+ *  the previous scale are forgotten when it moves, so the
+ *  next move waits for a full set at the new one.
+ ***********************************************************/
+void ResolutionScaler::UpdateScale()
+{
+	if ((int)m_frameTimes.size() < g_MeasuredFrames)
+	{
+		return;
+	}
+
+	double sortedTimes[g_MeasuredFrames];
+	std::copy(m_frameTimes.begin(), m_frameTimes.end(), sortedTimes);
+	std::nth_element(sortedTimes, sortedTimes + (g_MeasuredFrames / 2), sortedTimes + g_MeasuredFrames);
+	double frameTime = sortedTimes[g_MeasuredFrames / 2];
+	m_frameTimes.erase(m_frameTimes.begin());
+
+	bool bOverTarget = (frameTime > (m_targetMilliseconds * g_LowerMargin));
+	bool bUnderTarget = (frameTime < (m_targetMilliseconds * g_RaiseMargin));
+	if (m_bDynamic && ((bOverTarget && (m_scale > m_minScale)) || (bUnderTarget && (m_scale < m_maxScale))))
+	{
+		double ratio = (m_targetMilliseconds * g_AimMargin) / std::max(frameTime, 0.001);
+		float scale = (float)(m_scale * std::sqrt(ratio));
+		if (bUnderTarget)
+		{
+			scale = std::max(scale, m_scale + g_ScaleStep);
+		}
+		SetScale(scale);
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for reading the measurements of an
+ *  earlier frame once they are ready, moving the scale, and
+ *  binding the framebuffer and viewport of the frame.  Only
+ *  the frames drawn at the current scale are measured, and
+ *  only one at a time on the GPU, so the queries are not
+ *  read before it has finished with them.  A frame is
+ *  drawn into the window when it is not scaled, or cannot
+ *  be filtered up to it yet.
+ ***********************************************************/
+void ResolutionScaler::BeginFrame(int windowWidth, int windowHeight, bool bCanUpscale)
+{
+	if ((windowWidth > 0) && (windowHeight > 0))
+	{
+		m_windowWidth = windowWidth;
+		m_windowHeight = windowHeight;
+	}
+
+	if (m_bPending)
+	{
+		GLint bAvailable = GL_FALSE;
+		glGetQueryObjectiv(m_queries[frameEnd], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+		if (bAvailable != GL_FALSE)
+		{
+			GLuint64 start = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(m_queries[frameStart], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(m_queries[frameEnd], GL_QUERY_RESULT, &end);
+			m_bPending = false;
+			if ((m_pendingScale == m_scale) && (end >= start))
+			{
+				double gpuTime = (end - start) / 1000000.0;
+				Average(m_gpuMilliseconds, gpuTime, !m_bGpuMeasured);
+				m_bGpuMeasured = true;
+				m_frameTimes.push_back(gpuTime);
+				UpdateScale();
+			}
+		}
+	}
+
+	m_bFrameScaled = m_bSupported && bCanUpscale && (m_scale < 1.0f);
+	if (m_bFrameScaled && ((m_width < m_windowWidth) || (m_height < m_windowHeight)))
+	{
+		m_bFrameScaled = CreateTarget(std::max(m_width, m_windowWidth), std::max(m_height, m_windowHeight));
+	}
+	if (m_bFrameScaled)
+	{
+		m_drawnWidth = std::max((int)((m_windowWidth * m_scale) + 0.5f), 1);
+		m_drawnHeight = std::max((int)((m_windowHeight * m_scale) + 0.5f), 1);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	}
+	else
+	{
+		m_drawnWidth = m_windowWidth;
+		m_drawnHeight = m_windowHeight;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	glViewport(0, 0, m_drawnWidth, m_drawnHeight);
+
+	m_bMeasuring = m_bTimed && !m_bPending;
+	if (m_bMeasuring)
+	{
+		m_pendingScale = GetFrameScale();
+		glQueryCounter(m_queries[frameStart], GL_TIMESTAMP);
+	}
+	m_frameStart = std::chrono::steady_clock::now();
+}
+
+/***********************************************************
+ *  IsFrameScaled()
+ *
+ *  This method is used for checking if the current frame
+ *  is drawn into the target.
+ ***********************************************************/
+bool ResolutionScaler::IsFrameScaled() const
+{
+	return m_bFrameScaled;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for filtering the scaled frame up to
+ *  the window, with one triangle that covers the screen,
+ *  and finishing the measurement of the frame.  The program
+ *  sharpens the filtered pixels, more the lower the scale.
+ ***********************************************************/
+void ResolutionScaler::EndFrame(GLuint program)
+{
+	if (m_bFrameScaled)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, m_windowWidth, m_windowHeight);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+
+		glActiveTexture(GL_TEXTURE0 + g_FrameTextureUnit);
+		glBindTexture(GL_TEXTURE_2D, m_colorTexture);
+		glActiveTexture(GL_TEXTURE0);
+		float sharpness = std::min((1.0f - GetFrameScale()) / (1.0f - g_FullSharpnessScale), 1.0f);
+		glUniform1i(glGetUniformLocation(program, g_FrameSamplerName), g_FrameTextureUnit);
+		glUniform2f(glGetUniformLocation(program, "scaledFrameSize"), (float)m_drawnWidth, (float)m_drawnHeight);
+		glUniform2f(glGetUniformLocation(program, "windowSize"), (float)m_windowWidth, (float)m_windowHeight);
+		glUniform1f(glGetUniformLocation(program, "upscaleSharpness"), sharpness);
+
+		glBindVertexArray(m_screenVertexArray);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_BLEND);
+	}
+
+	if (m_bMeasuring)
+	{
+		glQueryCounter(m_queries[frameEnd], GL_TIMESTAMP);
+		m_bMeasuring = false;
+		m_bPending = true;
+	}
+
+	// the CPU time leaves out the wait for the swap of the buffers, which
+	// is held to the refresh of the display
+	std::chrono::duration<double, std::milli> cpuTime = std::chrono::steady_clock::now() - m_frameStart;
+	if (GetFrameScale() == m_scale)
+	{
+		Average(m_cpuMilliseconds, cpuTime.count(), !m_bCpuMeasured);
+		m_bCpuMeasured = true;
+		if (!m_bTimed)
+		{
+			m_frameTimes.push_back(cpuTime.count());
+			UpdateScale();
+		}
+	}
+}
+
+/***********************************************************
+ *  GetFrameScale()
+ *
+ *  This method is used for getting the scale the current
+ *  frame is drawn at, 1 when it is drawn into the window.
+ ***********************************************************/
+float ResolutionScaler::GetFrameScale() const
+{
+	return m_bFrameScaled ? m_scale : 1.0f;
+}
+
+/***********************************************************
+ *  GetGpuFrameTime()
+ *
+ *  This method is used for getting the averaged GPU time of
+ *  the frames at the current scale in milliseconds, 0
+ *  without timer queries.
+ ***********************************************************/
+double ResolutionScaler::GetGpuFrameTime() const
+{
+	return m_bGpuMeasured ? m_gpuMilliseconds : 0.0;
+}
+
+/***********************************************************
+ *  GetCpuFrameTime()
+ *
+ *  This method is used for getting the averaged CPU time of
+ *  the frames at the current scale in milliseconds, up to
+ *  the swap of the buffers.
+ ***********************************************************/
+double ResolutionScaler::GetCpuFrameTime() const
+{
+	return m_bCpuMeasured ? m_cpuMilliseconds : 0.0;
+}
@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////////
+// resolutionscaler.h
+// ============
+// draw the frames at the resolution that keeps them within a frame time,
+// and filter them up to the display window
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <vector>
+
+/***********************************************************
+ *  ResolutionScaler
+ *
+ *  This class contains the code for the dynamic resolution
+ *  of the frames.  A frame is drawn into the corner of a
+ *  target the size of the window, scaled down in width and
+ *  height, and then filtered up to the window and sharpened
+ *  by one triangle that covers the screen.  The GPU time
+ *  of the frames is measured, and the scale is moved
+ *  towards the one that keeps it within the target time -
+ *  in steps, inside its bounds, and only once the frames
+ *  leave a band around the target.  Without timer queries
+ *  the CPU time of the frames up to the swap of the buffers
+ *  is followed instead.  At the full scale the frames are
+ *  drawn straight into the window.
+ ***********************************************************/
+class ResolutionScaler
+{
+public:
+	// constructor
+	ResolutionScaler();
+	// destructor
+	~ResolutionScaler();
+
+	// the target and the queries cannot be shared between two objects
+	ResolutionScaler(const ResolutionScaler&) = delete;
+	ResolutionScaler& operator=(const ResolutionScaler&) = delete;
+
+private:
+	// the timestamps at the start and the end of a measured frame
+	enum FrameQuery
+	{
+		frameStart,
+		frameEnd,
+		frameQueryCount
+	};
+
+	bool m_bSupported;
+	GLuint m_framebuffer;
+	GLuint m_colorTexture;
+	GLuint m_depthBuffer;
+	GLenum m_depthFormat;
+	// the size of the target, and of the window and the part of the
+	// target drawn in the current frame
+	int m_width;
+	int m_height;
+	int m_windowWidth;
+	int m_windowHeight;
+	int m_drawnWidth;
+	int m_drawnHeight;
+	GLuint m_screenVertexArray;
+	// whether the current frame is drawn into the target
+	bool m_bFrameScaled;
+	// the scale of the width and height, its bounds, whether it follows
+	// the frame time, and the frame time it aims for in milliseconds
+	float m_scale;
+	float m_minScale;
+	float m_maxScale;
+	bool m_bDynamic;
+	double m_targetMilliseconds;
+	// the timestamps, whether the current frame is measured and a
+	// measured frame has not been read back yet, and the scale it was
+	// drawn at
+	bool m_bTimed;
+	GLuint m_queries[frameQueryCount];
+	bool m_bMeasuring;
+	bool m_bPending;
+	float m_pendingScale;
+	// when the CPU started the current frame, the averaged GPU and CPU
+	// times of the frames at the current scale, and the times of the
+	// last frames the scale is chosen from
+	std::chrono::steady_clock::time_point m_frameStart;
+	double m_gpuMilliseconds;
+	double m_cpuMilliseconds;
+	bool m_bGpuMeasured;
+	bool m_bCpuMeasured;
+	std::vector<double> m_frameTimes;
+
+	// create the target at a size
+	bool CreateTarget(int width, int height);
+	// delete the target
+	void DeleteTarget();
+	// move the scale towards the frame time from the last frames
+	void UpdateScale();
+	// limit a scale to its bounds and its steps
+	float LimitScale(float scale) const;
+
+public:
+	// create the target and the queries - needs the OpenGL context to
+	// be current with the window framebuffer bound
+	bool Initialize();
+	// check if the frames can be drawn into the target
+	bool IsSupported() const;
+
+	// set the frame time the scale aims for in milliseconds
+	void SetTargetFrameTime(double milliseconds);
+	double GetTargetFrameTime() const;
+	// set the bounds of the scale, within 0.25 to 1
+	void SetScaleBounds(float minScale, float maxScale);
+	// set the scale, which stays there while it does not follow the
+	// frame time
+	void SetScale(float scale);
+	float GetScale() const;
+	// choose whether the scale follows the frame time
+	void SetDynamic(bool bDynamic);
+	bool IsDynamic() const;
+
+	// read the measurements of an earlier frame once they are ready and
+	// move the scale, then bind the framebuffer and viewport the frame
+	// is drawn into - the target when it is scaled and can be filtered
+	// up, the window otherwise
+	void BeginFrame(int windowWidth, int windowHeight, bool bCanUpscale);
+	// check if the current frame is drawn into the target
+	bool IsFrameScaled() const;
+	// filter the frame up to the window with a program when it was
+	// scaled, and finish its measurement
+	void EndFrame(GLuint program);
+
+	// get the scale the current frame is drawn at, 1 when it is drawn
+	// into the window
+	float GetFrameScale() const;
+	// get the averaged GPU and CPU time of the frames in milliseconds,
+	// the CPU time leaving out the wait for the swap of the buffers
+	double GetGpuFrameTime() const;
+	double GetCpuFrameTime() const;
+};
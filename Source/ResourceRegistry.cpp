@@ -0,0 +1,215 @@
+///////////////////////////////////////////////////////////////////////////////
+// resourceregistry.cpp
+// ============
+// share GPU resources by the hash of their content, and free each one when
+// the last handle to it is released
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ResourceRegistry.h"
+
+#include "AssetFile.h"
+
+#include <iostream>
+
+namespace
+{
+	// FNV-1a prime for 64 bit hashes
+	const uint64_t g_HashPrime = 1099511628211ULL;
+
+	const char* g_ResourceTypeNames[ResourceRegistry::RESOURCE_TYPE_COUNT] =
+	{
+		"texture",
+		"mesh",
+		"shader program"
+	};
+}
+
+/***********************************************************
+ *  ResourceRegistry()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ResourceRegistry::ResourceRegistry()
+{
+	for (int i = 0; i < RESOURCE_TYPE_COUNT; i++)
+	{
+		m_liveCounts[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  Get()
+ *
+ *  This method is used for getting the registry shared by
+ *  every scene in the process.
+ ***********************************************************/
+ResourceRegistry& ResourceRegistry::Get()
+{
+	static ResourceRegistry registry;
+	return registry;
+}
+
+/***********************************************************
+ *  HashBytes()
+ *
+ *  This method is used for hashing a block of bytes with the
+ *  FNV-1a hash.  Passing in the hash of a previous block
+ *  hashes the two blocks as one.
+ ***********************************************************/
+uint64_t ResourceRegistry::HashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= g_HashPrime;
+	}
+
+	return hash;
+}
+
+/***********************************************************
+ *  HashFile()
+ *
+ *  This method is used for hashing the contents of a file,
+ *  mapped into memory so it is not copied.  A file in the
+ *  asset pack has its hash in the pack index.
+ ***********************************************************/
+bool ResourceRegistry::HashFile(const std::string& filename, uint64_t& hash)
+{
+	AssetFile file;
+
+	if (!file.Open(filename))
+	{
+		return false;
+	}
+
+	hash = file.GetHash();
+	return true;
+}
+
+/***********************************************************
+ *  FindResource()
+ *
+ *  This method is used for finding a live resource by its
+ *  type and content hash.  An entry whose resource has been
+ *  freed is removed.
+ ***********************************************************/
+std::shared_ptr<void> ResourceRegistry::FindResource(ResourceType type, uint64_t hash)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::map<std::pair<int, uint64_t>, REGISTERED_RESOURCE>::iterator entry = m_resources.find(std::make_pair((int)type, hash));
+	if (entry == m_resources.end())
+	{
+		return NULL;
+	}
+
+	std::shared_ptr<void> resource = entry->second.resource.lock();
+	if (!resource)
+	{
+		m_resources.erase(entry);
+	}
+
+	return resource;
+}
+
+/***********************************************************
+ *  AddResource()
+ *
+ *  This method is used for adding a resource under its type
+ *  and content hash.  If a live resource is already there,
+ *  it is returned instead and the passed in one is released
+ *  by the caller dropping its handle.
+ ***********************************************************/
+std::shared_ptr<void> ResourceRegistry::AddResource(ResourceType type, uint64_t hash, std::string name, std::shared_ptr<void> resource, bool* pbRegistered)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	REGISTERED_RESOURCE& entry = m_resources[std::make_pair((int)type, hash)];
+	std::shared_ptr<void> existing = entry.resource.lock();
+	if (pbRegistered != NULL)
+	{
+		*pbRegistered = !existing;
+	}
+	if (existing)
+	{
+		return existing;
+	}
+
+	entry.name = name;
+	entry.resource = resource;
+
+	return resource;
+}
+
+/***********************************************************
+ *  OnResourceFreed()
+ *
+ *  This method is used for counting a freed resource.  The
+ *  expired entry is removed by the next lookup.
+ ***********************************************************/
+void ResourceRegistry::OnResourceFreed(ResourceType type)
+{
+	m_liveCounts[type]--;
+}
+
+/***********************************************************
+ *  RegisterTexture()
+ *
+ *  This method is used for registering a texture object.  A
+ *  texture whose object is created later, like a streamed
+ *  texture, is registered with the ID 0.
+ ***********************************************************/
+std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> ResourceRegistry::RegisterTexture(uint64_t hash, std::string name, GLuint textureID, bool* pbRegistered)
+{
+	TEXTURE_RESOURCE* resource = new TEXTURE_RESOURCE();
+	resource->textureID = textureID;
+
+	return Register<TEXTURE_RESOURCE>(texture, hash, name, resource, [](TEXTURE_RESOURCE* freed)
+	{
+		if (freed->textureID != 0)
+		{
+			glDeleteTextures(1, &freed->textureID);
+		}
+	}, pbRegistered);
+}
+
+/***********************************************************
+ *  GetLiveCount()
+ *
+ *  This method is used for getting the number of resources
+ *  of a type that have not been freed yet.
+ ***********************************************************/
+int ResourceRegistry::GetLiveCount(ResourceType type)
+{
+	return m_liveCounts[type];
+}
+
+/***********************************************************
+ *  PrintLiveResources()
+ *
+ *  This method is used for printing the live resources and
+ *  their number of handles to the console.
+ ***********************************************************/
+void ResourceRegistry::PrintLiveResources()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::cout << "\n***** LIVE RESOURCES: *****\n";
+	for (int i = 0; i < RESOURCE_TYPE_COUNT; i++)
+	{
+		std::cout << g_ResourceTypeNames[i] << " - " << m_liveCounts[i] << " live\n";
+	}
+
+	for (std::map<std::pair<int, uint64_t>, REGISTERED_RESOURCE>::iterator entry = m_resources.begin(); entry != m_resources.end(); ++entry)
+	{
+		long handles = entry->second.resource.use_count();
+		if (handles > 0)
+		{
+			std::cout << g_ResourceTypeNames[entry->first.first] << " " << entry->second.name << " - " << handles << " handles\n";
+		}
+	}
+	std::cout << std::flush;
+}
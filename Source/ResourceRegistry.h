@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// resourceregistry.h
+// ============
+// share GPU resources by the hash of their content, and free each one when
+// the last handle to it is released
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/***********************************************************
+ *  ResourceRegistry
+ *
+ *  This class contains the code for the process-wide list of
+ *  loaded GPU resources.  Each resource is registered under
+ *  its type and the hash of the content it was made from, so
+ *  a second load of the same content finds the first one
+ *  instead of creating a copy.  The handles are shared
+ *  pointers - the resource is freed with its last handle, so
+ *  handles must be released on a thread with a current
+ *  OpenGL context.  The live resources of each type can be
+ *  counted to catch leaks.
+ ***********************************************************/
+class ResourceRegistry
+{
+public:
+	enum ResourceType
+	{
+		texture,
+		mesh,
+		shaderProgram
+	};
+	// total number of resource types
+	static const int RESOURCE_TYPE_COUNT = 3;
+
+	// a texture shared through the registry - the owner may replace
+	// the texture object, so users read the ID when binding
+	struct TEXTURE_RESOURCE
+	{
+		GLuint textureID;
+	};
+
+	// get the registry of the process
+	static ResourceRegistry& Get();
+
+	// hash a block of bytes, continuing from a previous hash
+	static uint64_t HashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL);
+	// hash the contents of a file or packed asset, returns false if it
+	// cannot be read
+	static bool HashFile(const std::string& filename, uint64_t& hash);
+
+private:
+	ResourceRegistry();
+
+	struct REGISTERED_RESOURCE
+	{
+		std::string name;
+		std::weak_ptr<void> resource;
+	};
+
+	std::mutex m_mutex;
+	std::map<std::pair<int, uint64_t>, REGISTERED_RESOURCE> m_resources;
+	std::atomic<int> m_liveCounts[RESOURCE_TYPE_COUNT];
+
+	// find a live resource, pruning the entry if it has been freed
+	std::shared_ptr<void> FindResource(ResourceType type, uint64_t hash);
+	// add a resource, or return the live one registered under the key
+	std::shared_ptr<void> AddResource(ResourceType type, uint64_t hash, std::string name, std::shared_ptr<void> resource, bool* pbRegistered);
+	// called when the last handle of a resource is released
+	void OnResourceFreed(ResourceType type);
+
+public:
+	ResourceRegistry(const ResourceRegistry&) = delete;
+	ResourceRegistry& operator=(const ResourceRegistry&) = delete;
+
+	// find a live resource by its content hash, or NULL
+	template<class T>
+	std::shared_ptr<T> Find(ResourceType type, uint64_t hash)
+	{
+		return std::static_pointer_cast<T>(FindResource(type, hash));
+	}
+
+	// take ownership of a new resource, which is released by the passed
+	// in function with its last handle.  When the same content has been
+	// registered meanwhile, the new resource is released at once and
+	// the one already registered is returned.
+	template<class T>
+	std::shared_ptr<T> Register(
+		ResourceType type,
+		uint64_t hash,
+		std::string name,
+		T* resource,
+		std::function<void(T*)> release,
+		bool* pbRegistered = NULL)
+	{
+		m_liveCounts[type]++;
+		std::shared_ptr<T> handle(resource, [this, type, release](T* freed)
+		{
+			release(freed);
+			delete freed;
+			OnResourceFreed(type);
+		});
+
+		return std::static_pointer_cast<T>(AddResource(type, hash, name, handle, pbRegistered));
+	}
+
+	// take ownership of a texture object, deleted with the last handle
+	std::shared_ptr<TEXTURE_RESOURCE> RegisterTexture(uint64_t hash, std::string name, GLuint textureID, bool* pbRegistered = NULL);
+
+	// get the number of live resources of a type
+	int GetLiveCount(ResourceType type);
+	// print the live resources to the console
+	void PrintLiveResources();
+};
@@ -0,0 +1,624 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.cpp
+// ============
+// trace rays against the triangles of the scene through a bounding volume
+// hierarchy, one at a time or in packets of four
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+// the packets are traced with SSE2 whenever the target guarantees it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SCENE_BVH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// triangles a leaf is made of once splitting it costs more
+	const int g_MaxLeafTriangles = 4;
+	// boxes the centers are sorted into when searching for a split
+	const int g_SplitBins = 16;
+	// deepest the tree is built, which the traversal stacks hold
+	const int g_MaxDepth = 60;
+	const int g_StackSize = g_MaxDepth + 4;
+	// closest distance a hit is counted at, so a ray leaving a surface
+	// does not hit the surface itself
+	const float g_MinHitDistance = 1.0e-4f;
+	// smallest determinant of a ray and a triangle that is not parallel
+	const float g_MinDeterminant = 1.0e-12f;
+	// strata of the hemisphere rays around the normal
+	const int g_HemisphereAngles = 8;
+	const float g_Pi = 3.14159265f;
+
+	// half the surface area of a box
+	float GetHalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return (size.x * size.y) + (size.y * size.z) + (size.z * size.x);
+	}
+
+	// the inverse of a ray direction - a direction along an axis has a
+	// huge but finite inverse, so the box tests never multiply 0 by an
+	// infinity
+	glm::vec3 GetInverseDirection(const glm::vec3& direction)
+	{
+		glm::vec3 inverse;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float value = direction[axis];
+			if (std::fabs(value) < 1.0e-30f)
+			{
+				value = (value < 0.0f) ? -1.0e-30f : 1.0e-30f;
+			}
+			inverse[axis] = 1.0f / value;
+		}
+		return inverse;
+	}
+
+#ifdef SCENE_BVH_SSE2
+	// the lanes of a where the mask is set, and of b elsewhere
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+#endif
+}
+
+/***********************************************************
+ *  SceneBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBVH::SceneBVH()
+{
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the tree over a list of
+ *  triangles.  A node is split where the triangle counts
+ *  times the surface areas of its two halves are the
+ *  smallest, the centers of its triangles being sorted into
+ *  bins along each axis, and is kept as a leaf when no split
+ *  is cheaper than testing all of its triangles.
+ ***********************************************************/
+void SceneBVH::Build(const std::vector<glm::vec3>& vertices)
+{
+	size_t triangleCount = vertices.size() / 3;
+
+	m_nodes.clear();
+	m_vertices.clear();
+	m_edges1.clear();
+	m_edges2.clear();
+	m_triangles.clear();
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> boxesMin(triangleCount);
+	std::vector<glm::vec3> boxesMax(triangleCount);
+	std::vector<glm::vec3> centers(triangleCount);
+	std::vector<int> order(triangleCount);
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		const glm::vec3* triangle = &vertices[i * 3];
+		boxesMin[i] = glm::min(triangle[0], glm::min(triangle[1], triangle[2]));
+		boxesMax[i] = glm::max(triangle[0], glm::max(triangle[1], triangle[2]));
+		centers[i] = (boxesMin[i] + boxesMax[i]) * 0.5f;
+		order[i] = (int)i;
+	}
+
+	NODE root;
+	root.first = 0;
+	root.count = (int)triangleCount;
+	root.axis = 0;
+	m_nodes.reserve(triangleCount * 2);
+	m_nodes.push_back(root);
+
+	// nodes waiting to be split, with their depth
+	std::vector<std::pair<int, int>> pending;
+	pending.push_back(std::make_pair(0, 0));
+	while (!pending.empty())
+	{
+		int nodeIndex = pending.back().first;
+		int depth = pending.back().second;
+		pending.pop_back();
+
+		int first = m_nodes[nodeIndex].first;
+		int count = m_nodes[nodeIndex].count;
+		glm::vec3 boundsMin(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+		glm::vec3 centersMin = boundsMin;
+		glm::vec3 centersMax = boundsMax;
+		for (int i = first; i < first + count; i++)
+		{
+			boundsMin = glm::min(boundsMin, boxesMin[order[i]]);
+			boundsMax = glm::max(boundsMax, boxesMax[order[i]]);
+			centersMin = glm::min(centersMin, centers[order[i]]);
+			centersMax = glm::max(centersMax, centers[order[i]]);
+		}
+		m_nodes[nodeIndex].boundsMin = boundsMin;
+		m_nodes[nodeIndex].boundsMax = boundsMax;
+
+		if ((count <= g_MaxLeafTriangles) || (depth >= g_MaxDepth))
+		{
+			continue;
+		}
+
+		// the cheapest split over the bins of every axis
+		float bestCost = (float)count * GetHalfArea(boundsMin, boundsMax);
+		int bestAxis = -1;
+		int bestBin = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float extent = centersMax[axis] - centersMin[axis];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+
+			int binCounts[g_SplitBins] = { 0 };
+			glm::vec3 binsMin[g_SplitBins];
+			glm::vec3 binsMax[g_SplitBins];
+			for (int bin = 0; bin < g_SplitBins; bin++)
+			{
+				binsMin[bin] = glm::vec3(std::numeric_limits<float>::max());
+				binsMax[bin] = glm::vec3(-std::numeric_limits<float>::max());
+			}
+			float binScale = (float)g_SplitBins / extent;
+			for (int i = first; i < first + count; i++)
+			{
+				int bin = std::min((int)((centers[order[i]][axis] - centersMin[axis]) * binScale), g_SplitBins - 1);
+				binCounts[bin]++;
+				binsMin[bin] = glm::min(binsMin[bin], boxesMin[order[i]]);
+				binsMax[bin] = glm::max(binsMax[bin], boxesMax[order[i]]);
+			}
+
+			// the costs of the right halves, then swept from the left
+			float rightCosts[g_SplitBins];
+			glm::vec3 sideMin(std::numeric_limits<float>::max());
+			glm::vec3 sideMax(-std::numeric_limits<float>::max());
+			int sideCount = 0;
+			for (int bin = g_SplitBins - 1; bin > 0; bin--)
+			{
+				sideCount += binCounts[bin];
+				sideMin = glm::min(sideMin, binsMin[bin]);
+				sideMax = glm::max(sideMax, binsMax[bin]);
+				rightCosts[bin] = (sideCount > 0) ? (float)sideCount * GetHalfArea(sideMin, sideMax) : 0.0f;
+			}
+			sideMin = glm::vec3(std::numeric_limits<float>::max());
+			sideMax = glm::vec3(-std::numeric_limits<float>::max());
+			sideCount = 0;
+			for (int bin = 0; bin < g_SplitBins - 1; bin++)
+			{
+				sideCount += binCounts[bin];
+				sideMin = glm::min(sideMin, binsMin[bin]);
+				sideMax = glm::max(sideMax, binsMax[bin]);
+				if ((sideCount == 0) || (sideCount == count))
+				{
+					continue;
+				}
+				float cost = ((float)sideCount * GetHalfArea(sideMin, sideMax)) + rightCosts[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		if (bestAxis < 0)
+		{
+			continue;
+		}
+
+		float splitScale = (float)g_SplitBins / (centersMax[bestAxis] - centersMin[bestAxis]);
+		float splitMin = centersMin[bestAxis];
+		int* middle = std::partition(&order[first], &order[first] + count, [&](int triangle)
+		{
+			int bin = std::min((int)((centers[triangle][bestAxis] - splitMin) * splitScale), g_SplitBins - 1);
+			return bin <= bestBin;
+		});
+		int leftCount = (int)(middle - &order[first]);
+		if ((leftCount == 0) || (leftCount == count))
+		{
+			continue;
+		}
+
+		NODE left;
+		left.first = first;
+		left.count = leftCount;
+		left.axis = 0;
+		NODE right;
+		right.first = first + leftCount;
+		right.count = count - leftCount;
+		right.axis = 0;
+
+		int childIndex = (int)m_nodes.size();
+		m_nodes.push_back(left);
+		m_nodes.push_back(right);
+		m_nodes[nodeIndex].first = childIndex;
+		m_nodes[nodeIndex].count = 0;
+		m_nodes[nodeIndex].axis = bestAxis;
+		pending.push_back(std::make_pair(childIndex, depth + 1));
+		pending.push_back(std::make_pair(childIndex + 1, depth + 1));
+	}
+
+	// the triangles are stored in the order of the leaves
+	m_vertices.resize(triangleCount);
+	m_edges1.resize(triangleCount);
+	m_edges2.resize(triangleCount);
+	m_triangles.resize(triangleCount);
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		const glm::vec3* triangle = &vertices[(size_t)order[i] * 3];
+		m_vertices[i] = triangle[0];
+		m_edges1[i] = triangle[1] - triangle[0];
+		m_edges2[i] = triangle[2] - triangle[0];
+		m_triangles[i] = order[i];
+	}
+}
+
+/***********************************************************
+ *  GetTriangleCount()
+ *
+ *  This method is used for getting the number of triangles
+ *  the tree was built over.
+ ***********************************************************/
+size_t SceneBVH::GetTriangleCount() const
+{
+	return m_triangles.size();
+}
+
+/***********************************************************
+ *  Intersect()
+ *
+ *  This method is used for finding the closest triangle a
+ *  ray hits.  The nearer child of a node along the ray is
+ *  visited first, so the farther one is mostly skipped once
+ *  a hit is found.  Triangles are hit from either side.
+ ***********************************************************/
+bool SceneBVH::Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RAY_HIT& hit) const
+{
+	hit.distance = maxDistance;
+	hit.triangle = -1;
+	hit.u = 0.0f;
+	hit.v = 0.0f;
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	glm::vec3 inverse = GetInverseDirection(direction);
+	int stack[g_StackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const NODE& node = m_nodes[stack[--stackSize]];
+
+		glm::vec3 slabNear = (node.boundsMin - origin) * inverse;
+		glm::vec3 slabFar = (node.boundsMax - origin) * inverse;
+		glm::vec3 entry = glm::min(slabNear, slabFar);
+		glm::vec3 exit = glm::max(slabNear, slabFar);
+		float enter = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+		float leave = std::min(std::min(exit.x, exit.y), std::min(exit.z, hit.distance));
+		if (enter > leave)
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			bool bLeftFirst = (direction[node.axis] >= 0.0f);
+			stack[stackSize++] = bLeftFirst ? node.first + 1 : node.first;
+			stack[stackSize++] = bLeftFirst ? node.first : node.first + 1;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			glm::vec3 p = glm::cross(direction, m_edges2[i]);
+			float determinant = glm::dot(m_edges1[i], p);
+			if (std::fabs(determinant) < g_MinDeterminant)
+			{
+				continue;
+			}
+			float inverseDeterminant = 1.0f / determinant;
+			glm::vec3 toOrigin = origin - m_vertices[i];
+			float u = glm::dot(toOrigin, p) * inverseDeterminant;
+			if ((u < 0.0f) || (u > 1.0f))
+			{
+				continue;
+			}
+			glm::vec3 q = glm::cross(toOrigin, m_edges1[i]);
+			float v = glm::dot(direction, q) * inverseDeterminant;
+			if ((v < 0.0f) || ((u + v) > 1.0f))
+			{
+				continue;
+			}
+			float distance = glm::dot(m_edges2[i], q) * inverseDeterminant;
+			if ((distance > g_MinHitDistance) && (distance < hit.distance))
+			{
+				hit.distance = distance;
+				hit.triangle = m_triangles[i];
+				hit.u = u;
+				hit.v = v;
+			}
+		}
+	}
+
+	return (hit.triangle >= 0);
+}
+
+/***********************************************************
+ *  IsOccluded()
+ *
+ *  This method is used for checking if a ray hits any
+ *  triangle before a distance, for the shadow rays towards
+ *  the lights.  It stops at the first triangle hit.
+ ***********************************************************/
+bool SceneBVH::IsOccluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	glm::vec3 inverse = GetInverseDirection(direction);
+	int stack[g_StackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const NODE& node = m_nodes[stack[--stackSize]];
+
+		glm::vec3 slabNear = (node.boundsMin - origin) * inverse;
+		glm::vec3 slabFar = (node.boundsMax - origin) * inverse;
+		glm::vec3 entry = glm::min(slabNear, slabFar);
+		glm::vec3 exit = glm::max(slabNear, slabFar);
+		float enter = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+		float leave = std::min(std::min(exit.x, exit.y), std::min(exit.z, maxDistance));
+		if (enter > leave)
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			stack[stackSize++] = node.first + 1;
+			stack[stackSize++] = node.first;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			glm::vec3 p = glm::cross(direction, m_edges2[i]);
+			float determinant = glm::dot(m_edges1[i], p);
+			if (std::fabs(determinant) < g_MinDeterminant)
+			{
+				continue;
+			}
+			float inverseDeterminant = 1.0f / determinant;
+			glm::vec3 toOrigin = origin - m_vertices[i];
+			float u = glm::dot(toOrigin, p) * inverseDeterminant;
+			if ((u < 0.0f) || (u > 1.0f))
+			{
+				continue;
+			}
+			glm::vec3 q = glm::cross(toOrigin, m_edges1[i]);
+			float v = glm::dot(direction, q) * inverseDeterminant;
+			if ((v < 0.0f) || ((u + v) > 1.0f))
+			{
+				continue;
+			}
+			float distance = glm::dot(m_edges2[i], q) * inverseDeterminant;
+			if ((distance > g_MinHitDistance) && (distance < maxDistance))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/***********************************************************
+ *  IntersectPacket()
+ *
+ *  This method is used for finding the closest triangles
+ *  that four rays hit.  With SSE2 the rays are traced down
+ *  the tree together - a node is entered when any of them
+ *  reaches its box, and every triangle of a leaf is tested
+ *  against the four at once.  The children are visited in
+ *  the order of the first ray.  Without SSE2 the rays are
+ *  traced one at a time.
+ ***********************************************************/
+void SceneBVH::IntersectPacket(const glm::vec3 origins[4], const glm::vec3 directions[4], float maxDistance, RAY_HIT hits[4]) const
+{
+#ifdef SCENE_BVH_SSE2
+	for (int lane = 0; lane < 4; lane++)
+	{
+		hits[lane].distance = maxDistance;
+		hits[lane].triangle = -1;
+		hits[lane].u = 0.0f;
+		hits[lane].v = 0.0f;
+	}
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	glm::vec3 inverses[4];
+	for (int lane = 0; lane < 4; lane++)
+	{
+		inverses[lane] = GetInverseDirection(directions[lane]);
+	}
+	const __m128 originX = _mm_setr_ps(origins[0].x, origins[1].x, origins[2].x, origins[3].x);
+	const __m128 originY = _mm_setr_ps(origins[0].y, origins[1].y, origins[2].y, origins[3].y);
+	const __m128 originZ = _mm_setr_ps(origins[0].z, origins[1].z, origins[2].z, origins[3].z);
+	const __m128 directionX = _mm_setr_ps(directions[0].x, directions[1].x, directions[2].x, directions[3].x);
+	const __m128 directionY = _mm_setr_ps(directions[0].y, directions[1].y, directions[2].y, directions[3].y);
+	const __m128 directionZ = _mm_setr_ps(directions[0].z, directions[1].z, directions[2].z, directions[3].z);
+	const __m128 inverseX = _mm_setr_ps(inverses[0].x, inverses[1].x, inverses[2].x, inverses[3].x);
+	const __m128 inverseY = _mm_setr_ps(inverses[0].y, inverses[1].y, inverses[2].y, inverses[3].y);
+	const __m128 inverseZ = _mm_setr_ps(inverses[0].z, inverses[1].z, inverses[2].z, inverses[3].z);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minDistance = _mm_set1_ps(g_MinHitDistance);
+	const __m128 minDeterminant = _mm_set1_ps(g_MinDeterminant);
+	const __m128 absoluteMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	__m128 hitDistance = _mm_set1_ps(maxDistance);
+	__m128 hitU = zero;
+	__m128 hitV = zero;
+	__m128i hitTriangle = _mm_set1_epi32(-1);
+
+	int stack[g_StackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const NODE& node = m_nodes[stack[--stackSize]];
+
+		// the box against the four rays
+		__m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.x), originX), inverseX);
+		__m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.x), originX), inverseX);
+		__m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.y), originY), inverseY);
+		__m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.y), originY), inverseY);
+		__m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.z), originZ), inverseZ);
+		__m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.z), originZ), inverseZ);
+		__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(nearX, farX), _mm_min_ps(nearY, farY)), _mm_max_ps(_mm_min_ps(nearZ, farZ), zero));
+		__m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(nearX, farX), _mm_max_ps(nearY, farY)), _mm_min_ps(_mm_max_ps(nearZ, farZ), hitDistance));
+		if (_mm_movemask_ps(_mm_cmple_ps(enter, leave)) == 0)
+		{
+			continue;
+		}
+
+		if (node.count == 0)
+		{
+			bool bLeftFirst = (directions[0][node.axis] >= 0.0f);
+			stack[stackSize++] = bLeftFirst ? node.first + 1 : node.first;
+			stack[stackSize++] = bLeftFirst ? node.first : node.first + 1;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			const glm::vec3& vertex = m_vertices[i];
+			const glm::vec3& edge1 = m_edges1[i];
+			const glm::vec3& edge2 = m_edges2[i];
+			__m128 edge1X = _mm_set1_ps(edge1.x);
+			__m128 edge1Y = _mm_set1_ps(edge1.y);
+			__m128 edge1Z = _mm_set1_ps(edge1.z);
+			__m128 edge2X = _mm_set1_ps(edge2.x);
+			__m128 edge2Y = _mm_set1_ps(edge2.y);
+			__m128 edge2Z = _mm_set1_ps(edge2.z);
+
+			// p = direction x edge2
+			__m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+			__m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+			__m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+			__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+			__m128 valid = _mm_cmpgt_ps(_mm_and_ps(determinant, absoluteMask), minDeterminant);
+			if (_mm_movemask_ps(valid) == 0)
+			{
+				continue;
+			}
+			__m128 inverseDeterminant = _mm_div_ps(one, Select(valid, determinant, one));
+
+			__m128 toOriginX = _mm_sub_ps(originX, _mm_set1_ps(vertex.x));
+			__m128 toOriginY = _mm_sub_ps(originY, _mm_set1_ps(vertex.y));
+			__m128 toOriginZ = _mm_sub_ps(originZ, _mm_set1_ps(vertex.z));
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toOriginX, pX), _mm_mul_ps(toOriginY, pY)), _mm_mul_ps(toOriginZ, pZ)), inverseDeterminant);
+
+			// q = toOrigin x edge1
+			__m128 qX = _mm_sub_ps(_mm_mul_ps(toOriginY, edge1Z), _mm_mul_ps(toOriginZ, edge1Y));
+			__m128 qY = _mm_sub_ps(_mm_mul_ps(toOriginZ, edge1X), _mm_mul_ps(toOriginX, edge1Z));
+			__m128 qZ = _mm_sub_ps(_mm_mul_ps(toOriginX, edge1Y), _mm_mul_ps(toOriginY, edge1X));
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+			__m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+
+			valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+			valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+			valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			valid = _mm_and_ps(valid, _mm_cmpgt_ps(distance, minDistance));
+			valid = _mm_and_ps(valid, _mm_cmplt_ps(distance, hitDistance));
+			if (_mm_movemask_ps(valid) == 0)
+			{
+				continue;
+			}
+
+			hitDistance = Select(valid, distance, hitDistance);
+			hitU = Select(valid, u, hitU);
+			hitV = Select(valid, v, hitV);
+			hitTriangle = _mm_castps_si128(Select(valid, _mm_castsi128_ps(_mm_set1_epi32(m_triangles[i])), _mm_castsi128_ps(hitTriangle)));
+		}
+	}
+
+	float distances[4];
+	float us[4];
+	float vs[4];
+	int triangles[4];
+	_mm_storeu_ps(distances, hitDistance);
+	_mm_storeu_ps(us, hitU);
+	_mm_storeu_ps(vs, hitV);
+	_mm_storeu_si128((__m128i*)triangles, hitTriangle);
+	for (int lane = 0; lane < 4; lane++)
+	{
+		hits[lane].distance = distances[lane];
+		hits[lane].triangle = triangles[lane];
+		hits[lane].u = us[lane];
+		hits[lane].v = vs[lane];
+	}
+#else
+	for (int lane = 0; lane < 4; lane++)
+	{
+		Intersect(origins[lane], directions[lane], maxDistance, hits[lane]);
+	}
+#endif
+}
+
+/***********************************************************
+ *  GetHemisphereRay()
+ *
+ *  This method is used for getting one of a set of rays
+ *  leaving a surface.  The rays are spread by the cosine of
+ *  their angle to the normal, so every ray counts the same
+ *  towards the light or occlusion they gather, and each is
+ *  jittered inside its own stratum of the disc under the
+ *  hemisphere, which keeps the sets of neighboring points
+ *  alike.
+ ***********************************************************/
+glm::vec3 SceneBVH::GetHemisphereRay(const glm::vec3& normal, int ray, int rayCount, uint32_t& seed)
+{
+	int angles = ((rayCount % g_HemisphereAngles) == 0) ? g_HemisphereAngles : rayCount;
+	int rings = rayCount / angles;
+
+	// two random numbers in [0, 1) from the seed
+	float random[2];
+	for (int i = 0; i < 2; i++)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		random[i] = (float)(seed >> 8) / 16777216.0f;
+	}
+
+	float angle = 2.0f * g_Pi * ((float)(ray % angles) + random[0]) / (float)angles;
+	float radius = std::sqrt(((float)(ray / angles) + random[1]) / (float)rings);
+	glm::vec3 tangent = glm::normalize(glm::cross((std::fabs(normal.x) > 0.5f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), normal));
+	glm::vec3 bitangent = glm::cross(normal, tangent);
+
+	return (tangent * (radius * std::cos(angle))) + (bitangent * (radius * std::sin(angle))) +
+		(normal * std::sqrt(std::max(1.0f - (radius * radius), 0.0f)));
+}
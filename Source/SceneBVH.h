@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.h
+// ============
+// trace rays against the triangles of the scene through a bounding volume
+// hierarchy, one at a time or in packets of four
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SceneBVH
+ *
+ *  This class contains the code for tracing rays against a
+ *  set of triangles.  The triangles are sorted into a tree
+ *  of bounding boxes, split where the surface area of the
+ *  two halves is the cheapest to trace, so a ray only tests
+ *  the triangles of the boxes it passes through.  Four rays
+ *  can be traced together with SSE2, each box and triangle
+ *  being tested against the four at once - the rays of a
+ *  packet should start close together and point the same
+ *  way, so they visit the same boxes.  Once built the tree
+ *  is only read, so any number of threads can trace it.
+ ***********************************************************/
+class SceneBVH
+{
+public:
+	// constructor
+	SceneBVH();
+
+	// the closest triangle a ray hits - the triangle is -1 when the ray
+	// hits nothing, and u and v weight its second and third vertices
+	struct RAY_HIT
+	{
+		float distance;
+		int triangle;
+		float u;
+		float v;
+	};
+
+private:
+	struct NODE
+	{
+		glm::vec3 boundsMin;
+		// the first triangle of a leaf, or the first of the two children
+		// of an inner node, which are next to each other
+		int first;
+		glm::vec3 boundsMax;
+		// the triangles of a leaf, 0 for an inner node
+		int count;
+		// the axis the children of an inner node are split on
+		int axis;
+	};
+
+	std::vector<NODE> m_nodes;
+	// the first vertex and the two edges of every triangle, in the order
+	// of the leaves
+	std::vector<glm::vec3> m_vertices;
+	std::vector<glm::vec3> m_edges1;
+	std::vector<glm::vec3> m_edges2;
+	// the index each triangle was passed in at
+	std::vector<int> m_triangles;
+
+public:
+	// build the tree over triangles given as three vertices each
+	void Build(const std::vector<glm::vec3>& vertices);
+	// get the number of triangles in the tree
+	size_t GetTriangleCount() const;
+
+	// find the closest triangle a ray hits within a distance, returns
+	// false when it hits none
+	bool Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RAY_HIT& hit) const;
+	// check if a ray hits any triangle within a distance
+	bool IsOccluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+	// find the closest triangles four rays hit within a distance
+	void IntersectPacket(const glm::vec3 origins[4], const glm::vec3 directions[4], float maxDistance, RAY_HIT hits[4]) const;
+
+	// get one of a set of rays leaving a surface over the hemisphere of
+	// its normal, spread by the cosine - the seed is advanced
+	static glm::vec3 GetHemisphereRay(const glm::vec3& normal, int ray, int rayCount, uint32_t& seed);
+};
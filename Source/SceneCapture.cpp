@@ -0,0 +1,338 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenecapture.cpp
+// ============
+// capture the triangles the scene draws with transform feedback, for
+// baking its lighting on the CPU
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneCapture.h"
+
+#include "ResourceRegistry.h"
+
+#include <iostream>
+
+namespace
+{
+	// the surface color of a textured object, whose texels are not read
+	const glm::vec3 g_TexturedAlbedo = glm::vec3(0.5f);
+}
+
+/***********************************************************
+ *  SceneCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneCapture::SceneCapture()
+{
+	m_bSupported = false;
+	m_buffer = 0;
+	m_writtenQuery = 0;
+	m_pass = -1;
+	m_currentObject = -1;
+	m_sceneHash = 0;
+	m_bCaptured = false;
+}
+
+/***********************************************************
+ *  ~SceneCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneCapture::~SceneCapture()
+{
+	if (m_buffer != 0)
+	{
+		glDeleteBuffers(1, &m_buffer);
+	}
+	if (!m_objectQueries.empty())
+	{
+		glDeleteQueries((GLsizei)m_objectQueries.size(), m_objectQueries.data());
+	}
+	if (m_writtenQuery != 0)
+	{
+		glDeleteQueries(1, &m_writtenQuery);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the capture buffer.  The
+ *  capture shader lays out its outputs with the transform
+ *  feedback qualifiers of GLSL 4.40.
+ ***********************************************************/
+bool SceneCapture::Initialize()
+{
+	if ((GLEW_VERSION_4_4 == GL_FALSE) && (GLEW_ARB_enhanced_layouts == GL_FALSE))
+	{
+		return false;
+	}
+
+	glGenBuffers(1, &m_buffer);
+	glGenQueries(1, &m_writtenQuery);
+	m_bSupported = (m_buffer != 0) && (m_writtenQuery != 0);
+
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the scene can be
+ *  captured.
+ ***********************************************************/
+bool SceneCapture::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  IsCaptured()
+ *
+ *  This method is used for checking if the triangles of the
+ *  scene have been read back.
+ ***********************************************************/
+bool SceneCapture::IsCaptured() const
+{
+	return m_bCaptured;
+}
+
+/***********************************************************
+ *  GetPassCount()
+ *
+ *  This method is used for getting the number of times the
+ *  scene is drawn for a capture - once counting and once
+ *  writing the triangles.
+ ***********************************************************/
+int SceneCapture::GetPassCount() const
+{
+	return 2;
+}
+
+/***********************************************************
+ *  BeginPass()
+ *
+ *  This method is used for starting a pass.  The second pass
+ *  sizes the buffer for the triangles counted by the first,
+ *  and writes them with transform feedback, which needs the
+ *  capture program to be current already.
+ ***********************************************************/
+void SceneCapture::BeginPass(int pass)
+{
+	m_pass = pass;
+	m_currentObject = -1;
+	glEnable(GL_RASTERIZER_DISCARD);
+
+	if (pass == 0)
+	{
+		m_bCaptured = false;
+		m_objects.clear();
+		m_vertices.clear();
+		return;
+	}
+
+	size_t triangleCount = 0;
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		triangleCount += m_objects[i].triangleCount;
+	}
+	m_vertices.resize(triangleCount * 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, m_buffer);
+	glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, m_vertices.size() * sizeof(CAPTURED_VERTEX), NULL, GL_STREAM_READ);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_buffer);
+	glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, m_writtenQuery);
+	glBeginTransformFeedback(GL_TRIANGLES);
+}
+
+/***********************************************************
+ *  BeginObject()
+ *
+ *  This method is used for starting the next object.  In
+ *  the first pass it is recorded and the query counting its
+ *  triangles is started, in the second pass its transform
+ *  only has to match the one it was recorded with.
+ ***********************************************************/
+void SceneCapture::BeginObject(const glm::mat4& model, uint64_t transformHash)
+{
+	m_currentObject++;
+
+	if (m_pass != 0)
+	{
+		return;
+	}
+
+	if (m_currentObject > 0)
+	{
+		glEndQuery(GL_PRIMITIVES_GENERATED);
+	}
+	if (m_currentObject >= (int)m_objectQueries.size())
+	{
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		m_objectQueries.push_back(query);
+	}
+	glBeginQuery(GL_PRIMITIVES_GENERATED, m_objectQueries[m_currentObject]);
+
+	CAPTURED_OBJECT object;
+	object.model = model;
+	object.transformHash = transformHash;
+	object.albedo = glm::vec3(1.0f);
+	object.diffuseColor = glm::vec3(0.0f);
+	object.firstTriangle = 0;
+	object.triangleCount = 0;
+	m_objects.push_back(object);
+}
+
+/***********************************************************
+ *  SetObjectColor()
+ *
+ *  This method is used for setting the surface color of the
+ *  current object.
+ ***********************************************************/
+void SceneCapture::SetObjectColor(const glm::vec3& color)
+{
+	if ((m_pass == 0) && (m_currentObject >= 0))
+	{
+		m_objects[m_currentObject].albedo = color;
+	}
+}
+
+/***********************************************************
+ *  SetObjectTextured()
+ *
+ *  This method is used for marking the current object as
+ *  textured, which is taken as a mid grey surface.
+ ***********************************************************/
+void SceneCapture::SetObjectTextured()
+{
+	if ((m_pass == 0) && (m_currentObject >= 0))
+	{
+		m_objects[m_currentObject].albedo = g_TexturedAlbedo;
+	}
+}
+
+/***********************************************************
+ *  SetObjectDiffuse()
+ *
+ *  This method is used for setting the diffuse color of the
+ *  material of the current object.
+ ***********************************************************/
+void SceneCapture::SetObjectDiffuse(const glm::vec3& diffuseColor)
+{
+	if ((m_pass == 0) && (m_currentObject >= 0))
+	{
+		m_objects[m_currentObject].diffuseColor = diffuseColor;
+	}
+}
+
+/***********************************************************
+ *  EndPass()
+ *
+ *  This method is used for finishing a pass.  The counts of
+ *  the first pass lay the objects out one after the other,
+ *  and the second pass is read back once the driver reports
+ *  that it wrote every counted triangle - a scene that drew
+ *  differently the second time fails the capture.
+ ***********************************************************/
+bool SceneCapture::EndPass()
+{
+	int pass = m_pass;
+	m_pass = -1;
+
+	if (pass == 0)
+	{
+		glDisable(GL_RASTERIZER_DISCARD);
+		if (m_currentObject >= 0)
+		{
+			glEndQuery(GL_PRIMITIVES_GENERATED);
+		}
+
+		size_t firstTriangle = 0;
+		for (size_t i = 0; i < m_objects.size(); i++)
+		{
+			GLuint count = 0;
+			glGetQueryObjectuiv(m_objectQueries[i], GL_QUERY_RESULT, &count);
+			m_objects[i].firstTriangle = firstTriangle;
+			m_objects[i].triangleCount = count;
+			firstTriangle += count;
+		}
+		return true;
+	}
+
+	GLuint written = 0;
+	if (!m_vertices.empty())
+	{
+		glEndTransformFeedback();
+		glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+		glGetQueryObjectuiv(m_writtenQuery, GL_QUERY_RESULT, &written);
+	}
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	if (((size_t)written * 3 != m_vertices.size()) || ((m_currentObject + 1) != (int)m_objects.size()))
+	{
+		std::cout << "The scene drew differently while its triangles were captured" << std::endl;
+		m_objects.clear();
+		m_vertices.clear();
+		return false;
+	}
+
+	if (!m_vertices.empty())
+	{
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, m_buffer);
+		glGetBufferSubData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_vertices.size() * sizeof(CAPTURED_VERTEX), m_vertices.data());
+		// the buffer is only needed again for another capture
+		glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER, 0, NULL, GL_STREAM_READ);
+		glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+	}
+
+	m_sceneHash = ResourceRegistry::HashBytes(m_vertices.data(), m_vertices.size() * sizeof(CAPTURED_VERTEX));
+	for (size_t i = 0; i < m_objects.size(); i++)
+	{
+		const CAPTURED_OBJECT& object = m_objects[i];
+		m_sceneHash = ResourceRegistry::HashBytes(&object.transformHash, sizeof(object.transformHash), m_sceneHash);
+		m_sceneHash = ResourceRegistry::HashBytes(&object.albedo, sizeof(object.albedo), m_sceneHash);
+		m_sceneHash = ResourceRegistry::HashBytes(&object.diffuseColor, sizeof(object.diffuseColor), m_sceneHash);
+		m_sceneHash = ResourceRegistry::HashBytes(&object.triangleCount, sizeof(object.triangleCount), m_sceneHash);
+	}
+	m_bCaptured = true;
+
+	return true;
+}
+
+/***********************************************************
+ *  GetObjects()
+ *
+ *  This method is used for getting the captured objects in
+ *  the order they were drawn.
+ ***********************************************************/
+const std::vector<SceneCapture::CAPTURED_OBJECT>& SceneCapture::GetObjects() const
+{
+	return m_objects;
+}
+
+/***********************************************************
+ *  GetVertices()
+ *
+ *  This method is used for getting the vertices of the
+ *  captured triangles, three for every triangle.
+ ***********************************************************/
+const std::vector<SceneCapture::CAPTURED_VERTEX>& SceneCapture::GetVertices() const
+{
+	return m_vertices;
+}
+
+/***********************************************************
+ *  GetSceneHash()
+ *
+ *  This method is used for getting the hash of the captured
+ *  triangles and objects, which changes with the geometry.
+ ***********************************************************/
+uint64_t SceneCapture::GetSceneHash() const
+{
+	return m_sceneHash;
+}
@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenecapture.h
+// ============
+// capture the triangles the scene draws with transform feedback, for
+// baking its lighting on the CPU
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  SceneCapture
+ *
+ *  This class contains the code for reading back the
+ *  triangles of the scene as they are drawn.  The meshes
+ *  draw themselves, so their triangles are captured with
+ *  transform feedback from a vertex shader that writes the
+ *  world position, the world normal, the position in the
+ *  object and the ID of every vertex, with the rasterizer
+ *  switched off.
+ *  The scene is drawn twice - first counting the triangles
+ *  of every object, then writing them into a buffer of that
+ *  size - and the objects are recorded with their transform
+ *  and surface color in the order they are drawn.
+ ***********************************************************/
+class SceneCapture
+{
+public:
+	// constructor
+	SceneCapture();
+	// destructor
+	~SceneCapture();
+
+	// the buffer cannot be shared between two objects
+	SceneCapture(const SceneCapture&) = delete;
+	SceneCapture& operator=(const SceneCapture&) = delete;
+
+	// a vertex as the capture shader writes it, with the ID the draw
+	// gave the vertex, which is the same every time the object is drawn
+	struct CAPTURED_VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec3 localPosition;
+		int32_t vertexID;
+	};
+
+	// an object drawn after a transform was set
+	struct CAPTURED_OBJECT
+	{
+		glm::mat4 model;
+		// hash of the model matrix, which matches the object to the one
+		// drawn at the same place of a frame
+		uint64_t transformHash;
+		// the color of the surface - the object color, or a mid grey for
+		// a textured object - and the diffuse color of its material
+		glm::vec3 albedo;
+		glm::vec3 diffuseColor;
+		// the triangles of the object, three vertices each
+		size_t firstTriangle;
+		size_t triangleCount;
+	};
+
+private:
+	bool m_bSupported;
+	GLuint m_buffer;
+	// counts the triangles of an object in the first pass, and the
+	// triangles written in the second
+	std::vector<GLuint> m_objectQueries;
+	GLuint m_writtenQuery;
+	// the pass being drawn, -1 between passes
+	int m_pass;
+	int m_currentObject;
+	std::vector<CAPTURED_OBJECT> m_objects;
+	std::vector<CAPTURED_VERTEX> m_vertices;
+	uint64_t m_sceneHash;
+	bool m_bCaptured;
+
+public:
+	// check that transform feedback can be set up in the shader - needs
+	// the OpenGL context to be current
+	bool Initialize();
+	// check if the scene can be captured
+	bool IsSupported() const;
+	// check if a capture has completed
+	bool IsCaptured() const;
+
+	// get the number of times the scene is drawn for a capture
+	int GetPassCount() const;
+	// start a pass, with the capture program current
+	void BeginPass(int pass);
+	// start the next object, drawn with a transform
+	void BeginObject(const glm::mat4& model, uint64_t transformHash);
+	// set the surface of the current object
+	void SetObjectColor(const glm::vec3& color);
+	void SetObjectTextured();
+	void SetObjectDiffuse(const glm::vec3& diffuseColor);
+	// finish a pass, reading the triangles back after the last one -
+	// returns false when the capture failed
+	bool EndPass();
+
+	// get the objects and their triangles
+	const std::vector<CAPTURED_OBJECT>& GetObjects() const;
+	const std::vector<CAPTURED_VERTEX>& GetVertices() const;
+	// get the hash of the captured triangles and objects
+	uint64_t GetSceneHash() const;
+};
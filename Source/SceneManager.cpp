@@ -14,8 +14,20 @@
 #include "stb_image.h"
 #endif
 
+#include <glm/gtc/constants.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <sstream>
+
 // declaration of global variables
 namespace
 {
@@ -24,6 +36,114 @@ namespace
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UseFaceMaterialsName = "bUseFaceMaterials";
+	const char* g_FaceTextureValueName = "faceTexture";
+	const char* g_FaceMaterialSlotName = "faceMaterialSlot";
+	const char* g_TextureUVRectName = "objectUVRect";
+	const char* g_FaceUVRectName = "faceUVRect";
+	const char* g_ViewName = "view";
+	const char* g_ProjectionName = "projection";
+	const char* g_ViewPositionName = "viewPosition";
+	const char* g_UVScaleName = "UVscale";
+	// number of point lights, as TOTAL_POINT_LIGHTS in the fragment shader
+	const int g_TotalPointLights = 5;
+	// the compute shader assigning the local lights to the clusters
+	const char* g_LightClusterShaderFile = "shaders/lightClusterShader.glsl";
+
+	// folder that is searched for mesh files to import
+	const char* g_MeshFolder = "meshes";
+	// folder the compressed texture cache files are kept in
+	const char* g_TextureCacheFolder = "textures/cache";
+	// texture tag of each atlas page is this prefix and its number
+	const std::string g_AtlasPageTagPrefix = "atlas_page";
+	// GPU memory budget for the streamed mip levels of the compressed textures
+	const size_t g_TextureBudgetBytes = 32 * 1024 * 1024;
+	// file the baked lightmaps are kept in
+	const char* g_LightmapCacheFile = "lightmaps/scene.lightmap";
+	// file the drawn reflection probes are kept in
+	const char* g_ReflectionCacheFile = "lightmaps/scene.reflections";
+	// share of the probe reflection the gold and glass materials
+	// reflect when facing it - the glass mostly reflects at the edges
+	const char* g_ReflectanceName = "reflectionReflectance";
+	const float g_MetalReflectance = 0.5f;
+	const float g_GlassReflectance = 0.08f;
+	// share of the light behind it the glass stops
+	const char* g_OpacityName = "materialOpacity";
+	const float g_GlassOpacity = 0.4f;
+
+	// read back the value of a uniform that was set on a program - a
+	// uniform the program does not use reads as zero
+	bool GetUniformBool(GLuint program, const std::string& name)
+	{
+		GLint value = 0;
+		GLint location = glGetUniformLocation(program, name.c_str());
+		if (location >= 0)
+		{
+			glGetUniformiv(program, location, &value);
+		}
+		return value != 0;
+	}
+
+	float GetUniformFloat(GLuint program, const std::string& name)
+	{
+		GLfloat value = 0.0f;
+		GLint location = glGetUniformLocation(program, name.c_str());
+		if (location >= 0)
+		{
+			glGetUniformfv(program, location, &value);
+		}
+		return value;
+	}
+
+	glm::vec3 GetUniformVec3(GLuint program, const std::string& name)
+	{
+		glm::vec3 value(0.0f);
+		GLint location = glGetUniformLocation(program, name.c_str());
+		if (location >= 0)
+		{
+			glGetUniformfv(program, location, &value[0]);
+		}
+		return value;
+	}
+
+	// write a value as a GLSL float literal that reads back exactly
+	std::string FormatFloat(float value)
+	{
+		std::ostringstream text;
+		text << std::showpoint << std::setprecision(9) << value;
+		return text.str();
+	}
+
+	std::string FormatVec3(const glm::vec3& value)
+	{
+		return "vec3(" + FormatFloat(value.x) + ", " + FormatFloat(value.y) + ", " + FormatFloat(value.z) + ")";
+	}
+
+	// the share of the probe reflection a material reflects, 0 for the
+	// materials that only have a highlight
+	float GetMaterialReflectance(const std::string& tag)
+	{
+		if (tag == "metal")
+		{
+			return g_MetalReflectance;
+		}
+		if (tag == "glass")
+		{
+			return g_GlassReflectance;
+		}
+		return 0.0f;
+	}
+
+	// the share of the light behind an object its material stops, 1 for
+	// the materials that cannot be seen through
+	float GetMaterialOpacity(const std::string& tag)
+	{
+		if (tag == "glass")
+		{
+			return g_GlassOpacity;
+		}
+		return 1.0f;
+	}
 }
 
 /***********************************************************
@@ -31,10 +151,89 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager* pShaderManager)
+SceneManager::SceneManager(ShaderManager* pShaderManager, GLFWwindow* pWindow)
 {
 	m_pShaderManager = pShaderManager;
 	m_basicMeshes = new ShapeMeshes();
+	m_faceMeshes = new FaceMaterialMeshes();
+	m_bFaceMaterialsSet = false;
+	m_loadedTextures = 0;
+	m_threadPool = new ThreadPool();
+	m_meshCache = new MeshCache(m_threadPool);
+	m_textureAtlas = new TextureAtlas();
+	m_textureCache = NULL;
+	m_textureStreamer = NULL;
+	m_textureQuality = high;
+	if (GLEW_EXT_texture_compression_s3tc)
+	{
+		m_textureCache = new TextureCache(g_TextureCacheFolder);
+		m_textureStreamer = new TextureStreamer(g_TextureBudgetBytes);
+	}
+	m_textureUploader = NULL;
+	if (NULL != pWindow)
+	{
+		m_textureUploader = new TextureUploader(pWindow);
+		if (!m_textureUploader->IsRunning())
+		{
+			delete m_textureUploader;
+			m_textureUploader = NULL;
+		}
+	}
+	m_cameraPosition = glm::vec3(0.0f);
+	m_projectionScale = 1.0f;
+	m_viewportHeight = 0;
+	m_objectScale = 1.0f;
+	m_objectPosition = glm::vec3(0.0f);
+	m_objectRadius = 0.0f;
+	m_objectTransformHash = 0;
+	m_objectColor = glm::vec4(1.0f);
+	m_fileWatcher = NULL;
+	m_shaderCompiler = NULL;
+	m_bShaderSourcesRead = false;
+	m_baseProgram = (NULL != pShaderManager) ? pShaderManager->m_programID : 0;
+	m_shaderVariants = new ShaderVariants();
+	m_clusteredLights = new ClusteredLights();
+	m_localLightCount = 0;
+	m_objectLightLists = new ObjectLightLists();
+	m_lightListMode = clusterLightLists;
+	m_deferredShading = new DeferredShading();
+	m_renderPath = forwardShading;
+	m_bDeferredFrame = false;
+	m_shadowMaps = new ShadowMaps();
+	m_bShadowPass = false;
+	m_casterHash = 0;
+	m_casterMin = glm::vec3(0.0f);
+	m_casterMax = glm::vec3(0.0f);
+	m_sceneCapture = new SceneCapture();
+	m_bCapturePass = false;
+	m_lightmapBaker = new LightmapBaker();
+	m_bUseLightmaps = true;
+	m_occlusionBaker = new OcclusionBaker();
+	m_irradianceProbes = new IrradianceProbes();
+	m_reflectionProbes = new ReflectionProbes();
+	m_bReflectionPass = false;
+	m_transparencyPass = new TransparencyPass();
+	m_transparencyMode = weightedBlendedTransparency;
+	m_bTransparentPass = false;
+	m_bWeightedBlending = false;
+	m_sortMilliseconds = 0.0;
+	m_depthPrepass = new DepthPrepass();
+	m_depthPrepassMode = automaticDepthPrepass;
+	m_bDepthPrepass = false;
+	m_resolutionScaler = new ResolutionScaler();
+	m_resolutionMode = dynamicResolution;
+	m_pWindow = pWindow;
+	m_bPrepassFrame = false;
+	m_lightFeatures = 0;
+	m_pointLightMask = 0;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_frame = 0;
+	m_modelMatrix = glm::mat4(1.0f);
+	m_uvScale = glm::vec2(1.0f, 1.0f);
+	m_material.diffuseColor = glm::vec3(0.0f);
+	m_material.specularColor = glm::vec3(0.0f);
+	m_material.shininess = 0.0f;
 }
 
 /***********************************************************
@@ -44,9 +243,309 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
  ***********************************************************/
 SceneManager::~SceneManager()
 {
+	// the shader manager owns the unspecialized program, the
+	// variants are deleted with their builder
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->m_programID = m_baseProgram;
+		m_pShaderManager->use();
+	}
+	delete m_shaderVariants;
+	m_shaderVariants = NULL;
+	delete m_clusteredLights;
+	m_clusteredLights = NULL;
+	delete m_objectLightLists;
+	m_objectLightLists = NULL;
+	delete m_deferredShading;
+	m_deferredShading = NULL;
+	delete m_shadowMaps;
+	m_shadowMaps = NULL;
+	// a bake still running keeps its own copy of the scene, and stops
+	// once the baker is deleted
+	delete m_lightmapBaker;
+	m_lightmapBaker = NULL;
+	delete m_occlusionBaker;
+	m_occlusionBaker = NULL;
+	delete m_irradianceProbes;
+	m_irradianceProbes = NULL;
+	delete m_reflectionProbes;
+	m_reflectionProbes = NULL;
+	delete m_transparencyPass;
+	m_transparencyPass = NULL;
+	delete m_depthPrepass;
+	m_depthPrepass = NULL;
+	delete m_resolutionScaler;
+	m_resolutionScaler = NULL;
+	m_pWindow = NULL;
+	delete m_sceneCapture;
+	m_sceneCapture = NULL;
 	m_pShaderManager = NULL;
+	delete m_fileWatcher;
+	m_fileWatcher = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	delete m_faceMeshes;
+	m_faceMeshes = NULL;
+	delete m_meshCache;
+	m_meshCache = NULL;
+	// the decode jobs hand their images to the texture uploader,
+	// so the thread pool has to finish before it is deleted
+	delete m_threadPool;
+	m_threadPool = NULL;
+	for (size_t i = 0; i < m_reloadedTextures.size(); i++)
+	{
+		delete m_reloadedTextures[i].processed;
+	}
+	m_reloadedTextures.clear();
+	delete m_shaderCompiler;
+	m_shaderCompiler = NULL;
+	delete m_textureUploader;
+	m_textureUploader = NULL;
+	if (NULL != m_textureStreamer)
+	{
+		m_textureStreamer->PrintResidency();
+	}
+	DestroyGLTextures();
+	delete m_textureStreamer;
+	m_textureStreamer = NULL;
+	delete m_textureCache;
+	m_textureCache = NULL;
+	delete m_textureAtlas;
+	m_textureAtlas = NULL;
+}
+
+/***********************************************************
+ *  DecodeTextureImage()
+ *
+ *  This method is used for reading a texture image into
+ *  memory - the compressed mips from the texture cache when
+ *  block compression is supported, or else the RGBA mip
+ *  chain built from the image file.  An image whose content
+ *  is already loaded as a texture is not decoded, it gets
+ *  the shared texture.  An edited image skips the cache, as
+ *  encoding its compressed mips would take too long.  It
+ *  makes no OpenGL calls, so it can be run on a worker
+ *  thread.
+ ***********************************************************/
+bool SceneManager::DecodeTextureImage(TEXTURE_IMAGE& image, bool bUseCache)
+{
+	image.processed = NULL;
+	image.compressed = NULL;
+	image.width = 0;
+	image.height = 0;
+	image.contentHash = 0;
+	image.resource = NULL;
+
+	if (ResourceRegistry::HashFile(image.filename, image.contentHash))
+	{
+		// a texture loaded at a lower resolution is different content
+		if ((image.maxResolution > 0) || (m_textureQuality > 0))
+		{
+			int limits[2] = { image.maxResolution, m_textureQuality };
+			image.contentHash = ResourceRegistry::HashBytes(limits, sizeof(limits), image.contentHash);
+		}
+
+		image.resource = ResourceRegistry::Get().Find<ResourceRegistry::TEXTURE_RESOURCE>(ResourceRegistry::texture, image.contentHash);
+		if (image.resource)
+		{
+			std::cout << "Sharing the loaded texture of image:" << image.filename << std::endl;
+			return true;
+		}
+	}
+
+	if ((NULL != m_textureCache) && bUseCache)
+	{
+		image.compressed = new TextureCache::COMPRESSED_TEXTURE();
+		if (m_textureCache->LoadTexture(image.filename, *image.compressed))
+		{
+			TextureCache::SkipLevels(*image.compressed, ImageDecoder::GetSkippedLevels(
+				image.compressed->width, image.compressed->height, image.maxResolution, m_textureQuality));
+			image.width = image.compressed->width;
+			image.height = image.compressed->height;
+			return true;
+		}
+		delete image.compressed;
+		image.compressed = NULL;
+	}
+
+	return ProcessTextureImage(image, 0);
+}
+
+/***********************************************************
+ *  ProcessTextureImage()
+ *
+ *  This method is used for decoding an image file and
+ *  converting it into RGBA levels, flipped so the first row
+ *  is the bottom of the image as OpenGL expects.  The levels
+ *  over the max resolution of the image and the quality
+ *  preset are skipped - JPEG files are decoded at a reduced
+ *  scale when possible, so they never hold those levels.  At
+ *  most maxLevels levels are built, 0 builds the full chain.
+ *  It makes no OpenGL calls, so it can be run on a worker
+ *  thread.
+ ***********************************************************/
+bool SceneManager::ProcessTextureImage(TEXTURE_IMAGE& image, int maxLevels)
+{
+	ImageDecoder::DECODED_IMAGE decoded;
+
+	image.processed = NULL;
+
+	if (!ImageDecoder::Decode(image.filename, image.maxResolution, m_textureQuality, decoded))
+	{
+		return false;
+	}
+
+	ImageProcessing::PROCESS_OPTIONS options;
+	options.bFlipVertical = true;
+	options.bPremultiplyAlpha = false;
+	options.mipFilter = ImageProcessing::kaiser;
+	options.maxLevels = maxLevels;
+	// the levels the decoder could not skip are dropped with the mips
+	options.skipLevels = decoded.skippedLevels - decoded.scaledLevels;
+
+	image.processed = new ImageProcessing::PROCESSED_IMAGE();
+	bool bProcessed = ImageProcessing::Process(decoded.pixels, decoded.width, decoded.height, decoded.colorChannels, options, *image.processed);
+	ImageDecoder::Free(decoded);
+
+	// only RGB and RGBA images are supported
+	if (!bProcessed)
+	{
+		std::cout << "Not implemented to handle image with " << decoded.colorChannels << " channels" << std::endl;
+		delete image.processed;
+		image.processed = NULL;
+		return false;
+	}
+
+	image.width = image.processed->width;
+	image.height = image.processed->height;
+
+	return true;
+}
+
+/***********************************************************
+ *  UploadGLTexture()
+ *
+ *  This method is used for configuring the texture mapping
+ *  parameters in OpenGL, uploading the mip levels of the
+ *  decoded image, and freeing the decoded levels.  Returns
+ *  the new texture ID, or 0 on failure.
+ ***********************************************************/
+GLuint SceneManager::UploadGLTexture(TEXTURE_IMAGE& image)
+{
+	GLuint textureID = 0;
+
+	// the compressed mips are uploaded as they are
+	if (image.compressed != NULL)
+	{
+		std::cout << "Successfully loaded compressed image:" << image.filename << ", width:" << image.width << ", height:" << image.height << ", mips:" << image.compressed->levels.size() << std::endl;
+		textureID = TextureCache::CreateGLTexture(*image.compressed, false);
+		delete image.compressed;
+		image.compressed = NULL;
+		return textureID;
+	}
+
+	if (image.processed == NULL)
+	{
+		std::cout << "Could not load image:" << image.filename << std::endl;
+		return 0;
+	}
+
+	std::cout << "Successfully loaded image:" << image.filename << ", width:" << image.width << ", height:" << image.height << ", mips:" << image.processed->levels.size() << std::endl;
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// every level is already RGBA, so the driver copies the
+	// texels as they are - the mips were filtered on the worker
+	// threads, so none are generated here
+	const ImageProcessing::PROCESSED_IMAGE& processed = *image.processed;
+	for (size_t i = 0; i < processed.levels.size(); i++)
+	{
+		const ImageProcessing::IMAGE_LEVEL& level = processed.levels[i];
+		glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &processed.texels[level.offset]);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)processed.levels.size() - 1);
+
+	// free the image data from local memory
+	delete image.processed;
+	image.processed = NULL;
+	glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+
+	return textureID;
+}
+
+/***********************************************************
+ *  CreateTextureResource()
+ *
+ *  This method is used for getting the shared texture of a
+ *  decoded image.  The compressed mips are handed to the
+ *  texture streamer, which creates the texture objects on
+ *  the next frame, and the pixels are uploaded - only that
+ *  needs the OpenGL context.  Returns NULL on failure.
+ ***********************************************************/
+std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> SceneManager::CreateTextureResource(TEXTURE_IMAGE& image, int slot)
+{
+	// the same content was already loaded
+	if (image.resource)
+	{
+		return image.resource;
+	}
+
+	if ((image.compressed != NULL) && (NULL != m_textureStreamer))
+	{
+		bool bRegistered = false;
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource =
+			ResourceRegistry::Get().RegisterTexture(image.contentHash, image.tag, 0, &bRegistered);
+
+		// the mips are only streamed once, when the same content
+		// was registered meanwhile its texture is shared
+		if (bRegistered)
+		{
+			m_textureStreamer->QueueTexture(image.tag, slot, image.compressed, resource);
+		}
+		else
+		{
+			delete image.compressed;
+		}
+		image.compressed = NULL;
+
+		return resource;
+	}
+
+	GLuint textureID = UploadGLTexture(image);
+	if (textureID == 0)
+	{
+		return NULL;
+	}
+
+	return ResourceRegistry::Get().RegisterTexture(image.contentHash, image.tag, textureID);
+}
+
+/***********************************************************
+ *  SetTextureSlot()
+ *
+ *  This method is used for putting a shared texture into a
+ *  texture slot.  A missing texture leaves the slot empty.
+ *  A streamed texture that is replaced, by a reload of its
+ *  file, stops streaming.
+ ***********************************************************/
+void SceneManager::SetTextureSlot(int slot, std::string tag, std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource)
+{
+	if ((NULL != m_textureStreamer) && m_textureIDs[slot].resource && (m_textureIDs[slot].resource != resource))
+	{
+		m_textureStreamer->RemoveTexture(m_textureIDs[slot].resource);
+	}
+
+	m_textureIDs[slot].resource = resource;
+	m_textureIDs[slot].ID = resource ? resource->textureID : 0;
+	m_textureIDs[slot].tag = resource ? tag : "";
 }
 
 /***********************************************************
@@ -59,68 +558,280 @@ SceneManager::~SceneManager()
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
+	TEXTURE_IMAGE image;
+	image.filename = filename;
+	image.tag = tag;
+	image.maxResolution = 0;
+	image.processed = NULL;
+	image.compressed = NULL;
+	m_textureFiles[AssetPack::GetAssetName(filename)] = image;
+
+	DecodeTextureImage(image);
+	std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource = CreateTextureResource(image, m_loadedTextures);
+	if (!resource)
+	{
+		// Error loading the image
+		return false;
+	}
 
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+	// register the loaded texture and associate it with the special tag string
+	SetTextureSlot(m_loadedTextures, tag, resource);
+	m_loadedTextures++;
+
+	return true;
+}
+
+/***********************************************************
+ *  CreateGLTextures()
+ *
+ *  This method is used for loading a list of textures.  The
+ *  image files are decoded on the worker threads, and each
+ *  decoded image is uploaded on this thread, which owns the
+ *  OpenGL context, as soon as it is ready.  Every texture
+ *  keeps the slot of its position in the list no matter
+ *  which order the decodes finish in - a texture that fails
+ *  to load leaves its slot empty.
+ ***********************************************************/
+int SceneManager::CreateGLTextures(std::vector<TEXTURE_IMAGE>& images)
+{
+	// indices of the decoded images, in completion order
+	struct DECODE_QUEUE
+	{
+		std::mutex mutex;
+		std::condition_variable decoded;
+		std::deque<int> ready;
+	};
+	DECODE_QUEUE queue;
+	int firstSlot = m_loadedTextures;
+	int count = (int)images.size();
+	int created = 0;
+
+	// there are a total of 16 available slots for scene textures
+	if (firstSlot + count > 16)
+	{
+		std::cout << "Too many textures - only the first " << (16 - firstSlot) << " will be loaded" << std::endl;
+		count = 16 - firstSlot;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		m_threadPool->QueueJob([this, &images, &queue, i]()
+		{
+			DecodeTextureImage(images[i]);
+
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.ready.push_back(i);
+			queue.decoded.notify_one();
+		});
+	}
+
+	for (int uploaded = 0; uploaded < count; uploaded++)
+	{
+		int index = 0;
+		{
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			queue.decoded.wait(lock, [&queue] { return !queue.ready.empty(); });
+			index = queue.ready.front();
+			queue.ready.pop_front();
+		}
+
+		// register the loaded texture in the slot of its list position -
+		// a streamed texture is created with only its smallest levels
+		// on the next frame
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource = CreateTextureResource(images[index], firstSlot + index);
+		SetTextureSlot(firstSlot + index, images[index].tag, resource);
+		if (resource)
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			created++;
 		}
+	}
+	m_loadedTextures = firstSlot + count;
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+	return created;
+}
 
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+/***********************************************************
+ *  StreamGLTextures()
+ *
+ *  This method is used for loading a list of textures while
+ *  the scene keeps rendering.  The image files are decoded
+ *  on the worker threads and handed to the texture uploader,
+ *  which creates the textures on its own shared context.
+ *  The slots are reserved now and stay unbound until
+ *  UpdateStreamedTextures() receives the finished textures.
+ ***********************************************************/
+void SceneManager::StreamGLTextures(std::vector<TEXTURE_IMAGE>& images)
+{
+	int firstSlot = m_loadedTextures;
+	int count = (int)images.size();
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	// there are a total of 16 available slots for scene textures
+	if (firstSlot + count > 16)
+	{
+		std::cout << "Too many textures - only the first " << (16 - firstSlot) << " will be loaded" << std::endl;
+		count = 16 - firstSlot;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		m_textureIDs[firstSlot + i].ID = 0;
+		m_textureIDs[firstSlot + i].tag = images[i].tag;
+
+		TEXTURE_IMAGE image = images[i];
+		int slot = firstSlot + i;
+		m_threadPool->QueueJob([this, image, slot]() mutable
+		{
+			if (!DecodeTextureImage(image))
+			{
+				std::cout << "Could not load image:" << image.filename << std::endl;
+			}
+			QueueTextureUpload(image, slot);
+		});
+	}
+	m_loadedTextures = firstSlot + count;
+}
+
+/***********************************************************
+ *  QueueTextureUpload()
+ *
+ *  This method is used for handing a decoded texture image
+ *  to the texture uploader, which publishes the finished
+ *  texture for its slot - an image that failed to decode
+ *  empties the slot.  It is run on a worker thread.
+ ***********************************************************/
+void SceneManager::QueueTextureUpload(TEXTURE_IMAGE& image, int slot)
+{
+	TextureUploader::UPLOAD_REQUEST request;
+	request.tag = image.tag;
+	request.slot = slot;
+	request.contentHash = image.contentHash;
+	// shared and streamed textures need no upload, they are
+	// passed through the uploader to reach their slots in order
+	if (image.resource || ((image.compressed != NULL) && (NULL != m_textureStreamer)))
+	{
+		request.resource = CreateTextureResource(image, slot);
+	}
+	request.processed = image.processed;
+	request.compressed = image.compressed;
+	m_textureUploader->QueueUpload(request);
+}
+
+/***********************************************************
+ *  UpdateStreamedTextures()
+ *
+ *  This method is used for binding the textures that the
+ *  texture uploader has finished since the last frame into
+ *  their reserved slots, and the textures whose objects were
+ *  replaced by a texture streamer moving their resident
+ *  levels toward the levels the last frame needed.  It never
+ *  waits on the loader.
+ ***********************************************************/
+void SceneManager::UpdateStreamedTextures()
+{
+	std::vector<TextureUploader::UPLOAD_RESULT> results;
+
+	if (NULL != m_textureStreamer)
+	{
+		m_textureStreamer->Update();
+	}
+
+	if (NULL != m_textureUploader)
+	{
+		m_textureUploader->PollCompletedUploads(results);
+	}
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		// a texture that fails to load leaves its slot empty
+		int slot = results[i].slot;
+		SetTextureSlot(slot, results[i].tag, results[i].resource);
+		if (!results[i].resource)
+		{
+			continue;
+		}
+
+		std::cout << "Streamed texture:" << results[i].tag << " into slot " << slot << std::endl;
+		glActiveTexture(GL_TEXTURE0 + slot);
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[slot].ID);
+	}
+
+	// a streamed texture may also be shared with another scene,
+	// whose streamer replaces its objects
+	for (int slot = 0; slot < m_loadedTextures; slot++)
+	{
+		if (m_textureIDs[slot].resource && (m_textureIDs[slot].ID != m_textureIDs[slot].resource->textureID))
+		{
+			m_textureIDs[slot].ID = m_textureIDs[slot].resource->textureID;
+			glActiveTexture(GL_TEXTURE0 + slot);
+			glBindTexture(GL_TEXTURE_2D, m_textureIDs[slot].ID);
+		}
+	}
+}
+
+/***********************************************************
+ *  CreateTextureAtlas()
+ *
+ *  This method is used for decoding a list of textures in
+ *  parallel and packing them into atlas pages.  Each page
+ *  takes the next texture slot, and the packed textures are
+ *  found through the atlas by their own tags.  Returns false
+ *  when the images could not be packed.
+ ***********************************************************/
+bool SceneManager::CreateTextureAtlas(std::vector<TEXTURE_IMAGE>& images)
+{
+	std::vector<TextureAtlas::ATLAS_IMAGE> atlasImages;
+	bool bBuilt = false;
+
+	if (images.empty())
+	{
+		return(true);
+	}
+
+	// the atlas needs the pixels, so the compressed cache is not
+	// used, and it builds the mips of its pages itself
+	m_threadPool->ParallelFor((int)images.size(), [this, &images](int index)
+	{
+		ProcessTextureImage(images[index], 1);
+	});
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (images[i].processed == NULL)
+		{
+			std::cout << "Could not load image:" << images[i].filename << std::endl;
+			continue;
+		}
+
+		TextureAtlas::ATLAS_IMAGE atlasImage;
+		atlasImage.tag = images[i].tag;
+		atlasImage.pixels = images[i].processed->texels.data();
+		atlasImage.width = images[i].width;
+		atlasImage.height = images[i].height;
+		atlasImage.colorChannels = 4;
+		atlasImages.push_back(atlasImage);
+	}
+
+	bBuilt = m_textureAtlas->Build(atlasImages);
+	if (bBuilt)
+	{
+		m_textureAtlas->CreateGLTextures();
+	}
 
-		return true;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		delete images[i].processed;
+		images[i].processed = NULL;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	// register the pages in the next texture slots
+	for (int page = 0; (page < m_textureAtlas->GetPageCount()) && (m_loadedTextures < 16); page++)
+	{
+		m_textureIDs[m_loadedTextures].ID = m_textureAtlas->GetPageTextureID(page);
+		m_textureIDs[m_loadedTextures].tag = g_AtlasPageTagPrefix + std::to_string(page);
+		m_loadedTextures++;
+	}
 
-	// Error loading the image
-	return false;
+	return(bBuilt);
 }
 
 /***********************************************************
@@ -147,10 +858,19 @@ void SceneManager::BindGLTextures()
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
+	// the streamer holds the streamed textures as well
+	if (NULL != m_textureStreamer)
+	{
+		m_textureStreamer->Clear();
+	}
+
+	// the shared textures are deleted with their last handle
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
-		glGenTextures(1, &m_textureIDs[i].ID);
+		SetTextureSlot(i, "", NULL);
 	}
+	m_textureAtlas->DestroyGLTextures();
+	m_loadedTextures = 0;
 }
 
 /***********************************************************
@@ -205,6 +925,47 @@ int SceneManager::FindTextureSlot(std::string tag)
 	return(textureSlot);
 }
 
+/***********************************************************
+ *  FindTextureLocation()
+ *
+ *  This method is used for getting the slot index and the
+ *  UV rectangle of a texture.  A texture packed into the
+ *  atlas returns the slot of its page and its place in the
+ *  page; any other texture covers the whole of its slot.
+ ***********************************************************/
+int SceneManager::FindTextureLocation(std::string tag, glm::vec4& uvRect)
+{
+	TextureAtlas::ATLAS_ENTRY entry;
+
+	if (m_textureAtlas->FindEntry(tag, entry))
+	{
+		uvRect = entry.uvRect;
+		return(FindTextureSlot(g_AtlasPageTagPrefix + std::to_string(entry.page)));
+	}
+
+	uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	return(FindTextureSlot(tag));
+}
+
+/***********************************************************
+ *  RecordTextureUse()
+ *
+ *  This method is used for telling the texture streamer that
+ *  the texture in a slot is drawn on the last transformed
+ *  object, and how many pixels that object spans on screen.
+ ***********************************************************/
+void SceneManager::RecordTextureUse(int slot)
+{
+	if ((NULL == m_textureStreamer) || (slot < 0) || !m_textureStreamer->IsStreamed(slot))
+	{
+		return;
+	}
+
+	float distance = glm::length(m_objectPosition - m_cameraPosition);
+	float projectedPixels = (m_objectScale * m_projectionScale * (float)m_viewportHeight * 0.5f) / glm::max(distance, 0.001f);
+	m_textureStreamer->RecordUse(slot, projectedPixels);
+}
+
 /***********************************************************
  *  FindMaterial()
  *
@@ -228,6 +989,7 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 			material.diffuseColor = m_objectMaterials[index].diffuseColor;
 			material.specularColor = m_objectMaterials[index].specularColor;
 			material.shininess = m_objectMaterials[index].shininess;
+			material.tag = m_objectMaterials[index].tag;
 		}
 		else
 		{
@@ -259,6 +1021,10 @@ void SceneManager::SetTransformations(
 	glm::mat4 rotationZ;
 	glm::mat4 translation;
 
+	// a face material table only applies to the object it
+	// was set for, so reset it before the next object
+	ClearShaderFaceMaterials();
+
 	// set the scale value in the transform buffer
 	scale = glm::scale(scaleXYZ);
 	// set the rotation values in the transform buffer
@@ -270,11 +1036,40 @@ void SceneManager::SetTransformations(
 
 	modelView = translation * rotationZ * rotationY * rotationX * scale;
 
-	if (NULL != m_pShaderManager)
+	// remember the object placement for the level of detail selection
+	m_objectScale = glm::max(scaleXYZ.x, glm::max(scaleXYZ.y, scaleXYZ.z));
+	m_objectPosition = positionXYZ;
+	// a shape fits in the sphere of its scale around its position
+	m_objectRadius = glm::length(scaleXYZ);
+
+	// the objects drawn into the capture are recorded for the
+	// lightmaps, which are matched to them by their transforms
+	uint64_t transformHash = ResourceRegistry::HashBytes(&modelView, sizeof(modelView));
+	m_objectTransformHash = transformHash;
+	if (m_bCapturePass)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		m_sceneCapture->BeginObject(modelView, transformHash);
+		m_sceneCapture->SetObjectDiffuse(m_material.diffuseColor);
 	}
-}
+	// the objects seen by the camera are the shadow casters, and are
+	// lit when they are drawn in color
+	else if (!m_bShadowPass && !m_bDepthPrepass)
+	{
+		m_casterHash = ResourceRegistry::HashBytes(&modelView, sizeof(modelView), m_casterHash);
+		m_casterMin = glm::min(m_casterMin, positionXYZ - glm::vec3(m_objectRadius));
+		m_casterMax = glm::max(m_casterMax, positionXYZ + glm::vec3(m_objectRadius));
+
+		m_lightmapBaker->SetObject(transformHash);
+		m_occlusionBaker->SetObject(transformHash);
+		SetObjectLighting(positionXYZ, m_objectRadius);
+	}
+
+	m_modelMatrix = modelView;
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+	}
+}
 
 /***********************************************************
  *  SetShaderColor()
@@ -295,12 +1090,19 @@ void SceneManager::SetShaderColor(
 	currentColor.g = greenColorValue;
 	currentColor.b = blueColorValue;
 	currentColor.a = alphaValue;
+	m_objectTextureTag.clear();
+	m_objectColor = currentColor;
 
 	if (NULL != m_pShaderManager)
 	{
+		SelectShaderVariant(false);
 		m_pShaderManager->setIntValue(g_UseTextureName, false);
 		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
 	}
+	if (m_bCapturePass)
+	{
+		m_sceneCapture->SetObjectColor(glm::vec3(currentColor));
+	}
 }
 
 /***********************************************************
@@ -312,13 +1114,28 @@ void SceneManager::SetShaderColor(
 void SceneManager::SetShaderTexture(
 	std::string textureTag)
 {
+	m_objectTextureTag = textureTag;
 	if (NULL != m_pShaderManager)
 	{
+		SelectShaderVariant(true);
 		m_pShaderManager->setIntValue(g_UseTextureName, true);
 
 		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
+		glm::vec4 uvRect;
+		textureID = FindTextureLocation(textureTag, uvRect);
 		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		// the shadow maps, the capture and the depth pre-pass do not
+		// show the textures, and the reflection probes are not seen
+		// from the camera
+		if (!m_bShadowPass && !m_bCapturePass && !m_bDepthPrepass && !m_bReflectionPass)
+		{
+			RecordTextureUse(textureID);
+		}
+		if (m_bCapturePass)
+		{
+			m_sceneCapture->SetObjectTextured();
+		}
+		m_pShaderManager->setVec4Value(g_TextureUVRectName, uvRect);
 	}
 }
 
@@ -332,10 +1149,23 @@ void SceneManager::SetTextureUVScale(float u, float v)
 {
 	if (NULL != m_pShaderManager)
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		m_uvScale = glm::vec2(u, v);
+		m_pShaderManager->setVec2Value(g_UVScaleName, m_uvScale);
 	}
 }
 
+/***********************************************************
+ *  SetTextureQuality()
+ *
+ *  This method is used for setting the quality preset the
+ *  textures are loaded at.  Lower presets skip the largest
+ *  levels of every texture, for machines with little memory.
+ ***********************************************************/
+void SceneManager::SetTextureQuality(TextureQuality quality)
+{
+	m_textureQuality = quality;
+}
+
 /***********************************************************
  *  LoadSceneTextures()
  *
@@ -345,61 +1175,218 @@ void SceneManager::SetTextureUVScale(float u, float v)
  ***********************************************************/
 void SceneManager::LoadSceneTextures()
 {
-	bool bReturn = false;
+	// the textures marked for the atlas are packed together, the
+	// rest keep the slot of their list position after the atlas pages -
+	// the fine felt and leather grain is not visible past 512 texels
+	struct TEXTURE_FILE
+	{
+		const char* filename;
+		const char* tag;
+		bool bAtlas;
+		int maxResolution;
+	};
+	const TEXTURE_FILE textureFiles[] =
+	{
+		{ "textures/marble.jpg", "marble", false, 0 },
+		{ "textures/gold.jpg", "gold", false, 0 },
+		{ "textures/versace.jpg", "versace", true, 0 },
+		{ "textures/blue_glass.jpg", "blue_glass", true, 0 },
+		{ "textures/perfume.jpg", "perfume", true, 0 },
+		{ "textures/gray_felt.jpg", "gray_felt", false, 512 },
+		{ "textures/black_felt.jpg", "black_felt", false, 512 },
+		{ "textures/green_felt.jpg", "green_felt", false, 512 },
+		{ "textures/peach_felt.jpg", "peach_felt", false, 512 },
+		{ "textures/white_leather.jpg", "white_leather", false, 512 },
+		{ "textures/brown_leather.jpg", "brown_leather", false, 512 },
+		{ "textures/chain.jpg", "gold_chain", false, 0 }
+	};
+	std::vector<TEXTURE_IMAGE> images;
+	std::vector<TEXTURE_IMAGE> atlasImages;
+
+	for (size_t i = 0; i < sizeof(textureFiles) / sizeof(textureFiles[0]); i++)
+	{
+		TEXTURE_IMAGE image;
+		image.filename = textureFiles[i].filename;
+		image.tag = textureFiles[i].tag;
+		image.maxResolution = textureFiles[i].maxResolution;
+		image.processed = NULL;
+		image.compressed = NULL;
+		m_textureFiles[AssetPack::GetAssetName(image.filename)] = image;
+		if (textureFiles[i].bAtlas)
+		{
+			atlasImages.push_back(image);
+		}
+		else
+		{
+			images.push_back(image);
+		}
+	}
+
+	// the bottle textures share an atlas page, so the bottles and
+	// their caps are drawn without switching textures - if they
+	// cannot be packed they are loaded as separate textures
+	if (!CreateTextureAtlas(atlasImages))
+	{
+		images.insert(images.end(), atlasImages.begin(), atlasImages.end());
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/marble.jpg",
-		"marble");
+	// with a texture uploader the scene starts rendering right
+	// away and the textures appear as they finish loading
+	if (NULL != m_textureUploader)
+	{
+		StreamGLTextures(images);
+	}
+	else
+	{
+		// decode the image files in parallel and upload each one
+		// as soon as it has been decoded
+		CreateGLTextures(images);
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/gold.jpg",
-		"gold");
+	// after the texture image data is loaded into memory, the 
+	// loaded textures need to be bound to texture slots - there
+	// are a total of 16 available slots for scene textures
+	BindGLTextures();
+}
 
-	bReturn = CreateGLTexture(
-		"textures/versace.jpg",
-		"versace");
+/***********************************************************
+ *  LoadSceneMeshes()
+ *
+ *  This method is used for importing every OBJ mesh file in
+ *  the meshes folder, or its folder in the asset pack,
+ *  tagged with its file name.  The level
+ *  of detail chains are built across the worker threads.
+ ***********************************************************/
+void SceneManager::LoadSceneMeshes()
+{
+	std::vector<std::string> filenames;
+	std::vector<std::string> tags;
+	std::vector<std::filesystem::path> paths;
+	std::error_code error;
+
+	// the meshes come from the asset pack when one is mounted, and
+	// the meshes folder is optional
+	const AssetPack* pPack = AssetPack::GetMounted();
+	if (NULL != pPack)
+	{
+		std::vector<std::string> names = pPack->GetNames(g_MeshFolder);
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			if (std::filesystem::path(names[i]).parent_path() == g_MeshFolder)
+			{
+				paths.push_back(names[i]);
+			}
+		}
+	}
+	else if (std::filesystem::is_directory(g_MeshFolder, error))
+	{
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(g_MeshFolder, error))
+		{
+			if (entry.is_regular_file())
+			{
+				paths.push_back(entry.path());
+			}
+		}
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/blue_glass.jpg",
-		"blue_glass");
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		if (paths[i].extension() == ".obj")
+		{
+			filenames.push_back(paths[i].string());
+			tags.push_back(paths[i].stem().string());
+		}
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/perfume.jpg",
-		"perfume");
+	int imported = m_meshCache->ImportMeshFiles(filenames, tags);
+	std::cout << "Imported " << imported << " of " << filenames.size() << " mesh files" << std::endl;
+}
 
-	bReturn = CreateGLTexture(
-		"textures/gray_felt.jpg",
-		"gray_felt");
-	
-	bReturn = CreateGLTexture(
-		"textures/black_felt.jpg",
-		"black_felt");
+/***********************************************************
+ *  SetCameraView()
+ *
+ *  This method is used for setting the camera values that
+ *  the level of detail selection and the shader program
+ *  variants need for the next frame.
+ ***********************************************************/
+void SceneManager::SetCameraView(
+	glm::mat4 view,
+	glm::mat4 projection,
+	glm::vec3 cameraPosition,
+	int viewportHeight)
+{
+	// the programs receive the new matrices when they are next used
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_frame++;
+
+	m_projectionScale = projection[1][1];
+	m_cameraPosition = cameraPosition;
+	// the levels of detail are chosen for the pixels the frame is
+	// drawn with
+	m_viewportHeight = std::max((int)((viewportHeight * m_resolutionScaler->GetFrameScale()) + 0.5f), 1);
+}
 
-	bReturn = CreateGLTexture(
-		"textures/green_felt.jpg",
-		"green_felt");
+/***********************************************************
+ *  DrawImportedMesh()
+ *
+ *  This method is used for drawing an imported mesh with
+ *  the coarsest level of detail whose error stays under a
+ *  pixel at the distance of the last transformed object.
+ ***********************************************************/
+void SceneManager::DrawImportedMesh(
+	std::string meshTag)
+{
+	float distance = glm::length(m_objectPosition - m_cameraPosition);
 
-	bReturn = CreateGLTexture(
-		"textures/peach_felt.jpg",
-		"peach_felt");
+	int level = m_meshCache->SelectLODLevel(
+		meshTag,
+		m_objectScale,
+		distance,
+		m_projectionScale,
+		m_viewportHeight);
 
-	bReturn = CreateGLTexture(
-		"textures/white_leather.jpg",
-		"white_leather");
+	m_meshCache->DrawMesh(meshTag, level);
+}
 
-	bReturn = CreateGLTexture(
-		"textures/brown_leather.jpg",
-		"brown_leather");
-	
-	
-	
-	bReturn = CreateGLTexture(
-		"textures/chain.jpg",
-		"gold_chain");
-	// after the texture image data is loaded into memory, the 
-	// loaded textures need to be bound to texture slots - there
-	// are a total of 16 available slots for scene textures
-	BindGLTextures();
+/***********************************************************
+ *  DrawTransparentMesh()
+ *
+ *  This method is used for drawing a mesh of a see through
+ *  material.  While the objects are drawn in color - for
+ *  the camera or into a reflection probe - it is kept with
+ *  the values it was set up with, and drawn after the
+ *  opaque objects so they show through it.  The shadow
+ *  maps and the capture draw it in place, and the depth
+ *  pre-pass leaves it out.
+ ***********************************************************/
+void SceneManager::DrawTransparentMesh(
+	std::function<void()> drawMesh)
+{
+	if (m_bShadowPass || m_bCapturePass || (GetMaterialOpacity(m_material.tag) >= 1.0f))
+	{
+		drawMesh();
+		return;
+	}
+	// the objects behind it are not hidden by its depth
+	if (m_bDepthPrepass)
+	{
+		return;
+	}
+
+	BLENDED_OBJECT object;
+	object.modelMatrix = m_modelMatrix;
+	object.position = m_objectPosition;
+	object.scale = m_objectScale;
+	object.radius = m_objectRadius;
+	object.bakedObject = m_lightmapBaker->GetCurrentObject();
+	object.transformHash = m_objectTransformHash;
+	object.textureTag = m_objectTextureTag;
+	object.color = m_objectColor;
+	object.uvScale = m_uvScale;
+	object.materialTag = m_material.tag;
+	object.drawMesh = drawMesh;
+	m_blendedObjects.push_back(object);
 }
 
 /***********************************************************
@@ -419,11 +1406,86 @@ void SceneManager::SetShaderMaterial(
 		bReturn = FindMaterial(materialTag, material);
 		if (bReturn == true)
 		{
+			m_material = material;
+			if (m_bCapturePass)
+			{
+				m_sceneCapture->SetObjectDiffuse(material.diffuseColor);
+			}
 			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
 			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
 			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			m_pShaderManager->setFloatValue(g_ReflectanceName, GetMaterialReflectance(material.tag));
+			// only the kept transparent objects are blended - an object that
+			// keeps the material of one is drawn with the opaque objects
+			m_pShaderManager->setFloatValue(g_OpacityName, m_bTransparentPass ? GetMaterialOpacity(material.tag) : 1.0f);
+		}
+	}
+}
+
+/***********************************************************
+ *  SetShaderFaceMaterial()
+ *
+ *  This method is used for passing an alternate texture and
+ *  material into the shader, and mapping the passed in face
+ *  of the next drawn multi-material mesh to it.  All other
+ *  faces keep the object texture and material, so a capped
+ *  container can be rendered with one draw command.
+ ***********************************************************/
+void SceneManager::SetShaderFaceMaterial(
+	FaceMaterialMeshes::MeshFace face,
+	std::string textureTag,
+	std::string materialTag)
+{
+	if (NULL != m_pShaderManager)
+	{
+		OBJECT_MATERIAL material;
+		bool bReturn = false;
+
+		m_pShaderManager->setBoolValue(g_UseFaceMaterialsName, true);
+		glm::vec4 uvRect;
+		int textureSlot = FindTextureLocation(textureTag, uvRect);
+		m_pShaderManager->setSampler2DValue(g_FaceTextureValueName, textureSlot);
+		RecordTextureUse(textureSlot);
+		m_pShaderManager->setVec4Value(g_FaceUVRectName, uvRect);
+
+		bReturn = FindMaterial(materialTag, material);
+		if (bReturn == true)
+		{
+			m_pShaderManager->setVec3Value("faceMaterial.diffuseColor", material.diffuseColor);
+			m_pShaderManager->setVec3Value("faceMaterial.specularColor", material.specularColor);
+			m_pShaderManager->setFloatValue("faceMaterial.shininess", material.shininess);
 		}
+
+		// slot 1 selects the alternate face texture and material
+		m_pShaderManager->setIntValue(
+			std::string(g_FaceMaterialSlotName) + "[" + std::to_string((int)face) + "]", 1);
+
+		m_bFaceMaterialsSet = true;
+	}
+}
+
+/***********************************************************
+ *  ClearShaderFaceMaterials()
+ *
+ *  This method is used for resetting the per-face material
+ *  table in the shader so every face uses the object texture
+ *  and material again.
+ ***********************************************************/
+void SceneManager::ClearShaderFaceMaterials()
+{
+	if ((NULL == m_pShaderManager) || (m_bFaceMaterialsSet == false))
+	{
+		return;
+	}
+
+	for (int face = 0; face < FaceMaterialMeshes::TOTAL_MESH_FACES; face++)
+	{
+		m_pShaderManager->setIntValue(
+			std::string(g_FaceMaterialSlotName) + "[" + std::to_string(face) + "]", 0);
 	}
+	m_pShaderManager->setBoolValue(g_UseFaceMaterialsName, false);
+
+	m_bFaceMaterialsSet = false;
 }
 
 /**************************************************************/
@@ -454,81 +1516,1418 @@ void SceneManager::DefineObjectMaterials()
 	glassMaterial.shininess = 95.0;
 	glassMaterial.tag = "glass";
 
-	m_objectMaterials.push_back(glassMaterial);
+	m_objectMaterials.push_back(glassMaterial);
+
+	OBJECT_MATERIAL marbleMaterial;
+	marbleMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
+	marbleMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
+	marbleMaterial.shininess = 30.0;
+	marbleMaterial.tag = "marble";
+
+	m_objectMaterials.push_back(marbleMaterial);
+
+	OBJECT_MATERIAL feltMaterial;
+	feltMaterial.diffuseColor = glm::vec3(0.1f, 0.1f, 0.1f);
+	feltMaterial.specularColor = glm::vec3(0.0f, 0.0f, 0.f);
+	feltMaterial.shininess = 1.0;
+	feltMaterial.tag = "felt";
+
+	m_objectMaterials.push_back(feltMaterial);
+
+	OBJECT_MATERIAL leatherMaterial;
+	leatherMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
+	leatherMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
+	leatherMaterial.shininess = 30.0;
+	leatherMaterial.tag = "leather";
+
+	m_objectMaterials.push_back(leatherMaterial);
+
+	
+}
+
+/***********************************************************
+ *  SetupSceneLights()
+ *
+ *  This method is called to add and configure the light
+ *  sources for the 3D scene.  There are up to 4 light sources.
+ ***********************************************************/
+void SceneManager::SetupSceneLights()
+{
+	// this line of code is NEEDED for telling the shaders to render 
+	// the 3D scene with custom lighting, if no light sources have
+	// been added then the display window will be black - to use the 
+	// default OpenGL lighting then comment out the following line
+	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+
+	/*** STUDENTS - add the code BELOW for setting up light sources ***/
+	/*** Up to four light sources can be defined. Refer to the code ***/
+	/*** in the OpenGL Sample for help                              ***/
+
+	// Directional Light - simulates sunlight coming from the right side
+	//m_pShaderManager->setVec3Value("directionalLight.direction", 0.0f, -1.0f, 0.0f); 
+	//m_pShaderManager->setVec3Value("directionalLight.ambient", 0.2f, 0.2f, 0.2f);  // Adjusted ambient for a base light
+	//m_pShaderManager->setVec3Value("directionalLight.diffuse", .8f, .8f, .8f);  // Stronger diffuse light for brighter highlights
+	//m_pShaderManager->setVec3Value("directionalLight.specular", 1.0f, 1.0f, 1.0f); // Strong specular for reflections
+	//m_pShaderManager->setBoolValue("directionalLight.bActive", true);
+
+	// Point Light - simulates a nearby light source, like a window or a lamp
+	m_pShaderManager->setVec3Value("pointLights.position", 0.0f, 20.0f, 0.0f); // Positioned slightly above and to the side
+	m_pShaderManager->setVec3Value("pointLights[0].ambient", .55f, 0.5f, 0.5f);  // Adjusted ambient for more shadow contrast
+	m_pShaderManager->setVec3Value("pointLights[0].diffuse", .75f, .7f, .7f);  // Stronger diffuse for more intense lighting
+	m_pShaderManager->setVec3Value("pointLights[0].specular", 1.0f, 0.9f, 0.9);  // Strong specular highlights for shinier surfaces
+	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
+
+	// Set the position of the spotlight to emulate the sun's position
+	m_pShaderManager->setVec3Value("spotLight.position", -18.0f, 10.0f, 55.0f); // Place the sun high and behind the objects
+	m_pShaderManager->setVec3Value("spotLight.direction", 1.0f, -0.5f, -1.0f); // Adjust this to match the sunlight direction from the image
+	m_pShaderManager->setVec3Value("spotLight.ambient", 6.0f, 6.0f, 6.0f); // Increase ambient for more overall light
+	m_pShaderManager->setVec3Value("spotLight.diffuse", 15.0f, 15.0f, 15.0f); // Increase diffuse light for more brightness
+	m_pShaderManager->setVec3Value("spotLight.specular", 10.0f, 10.0f, 10.0f); // Brighten specular highlights
+	m_pShaderManager->setFloatValue("spotLight.constant", 1.0f);   // Minimal distance attenuation
+	m_pShaderManager->setFloatValue("spotLight.linear", 0.01f);    // Further reduced attenuation over distance
+	m_pShaderManager->setFloatValue("spotLight.quadratic", 0.005f); // Further reduced quadratic term for greater reach
+	m_pShaderManager->setFloatValue("spotLight.cutOff", glm::cos(glm::radians(110.0f))); // Wide inner angle for full scene coverage
+	m_pShaderManager->setFloatValue("spotLight.outerCutOff", glm::cos(glm::radians(130.0f))); // Even wider outer angle for soft edges
+	m_pShaderManager->setBoolValue("spotLight.bActive", true);
+
+
+}
+
+/***********************************************************
+ *  BakeSceneLights()
+ *
+ *  This method is used for reading back the light values
+ *  that SetupSceneLights() set on the unspecialized program,
+ *  and compiling them into the lit program variants as
+ *  constants.  Only the lights that are active are kept in
+ *  the variant keys, so the others are compiled out, and
+ *  handed to the lightmaps.
+ ***********************************************************/
+void SceneManager::BakeSceneLights()
+{
+	std::ostringstream declarations;
+	uint32_t features = 0;
+	uint32_t pointLightMask = 0;
+	// the active lights, as the lightmaps bake them
+	std::vector<LightmapBaker::BAKED_LIGHT> bakedLights;
+	LightmapBaker::BAKED_LIGHT bakedLight = {};
+
+	if (GetUniformBool(m_baseProgram, g_UseLightingName))
+	{
+		features |= ShaderVariants::lit | ShaderVariants::bakedLights;
+		if (m_clusteredLights->IsSupported())
+		{
+			features |= ShaderVariants::clusteredLights;
+		}
+		if (m_shadowMaps->IsSupported())
+		{
+			features |= ShaderVariants::shadows;
+		}
+	}
+
+	bool bActive = GetUniformBool(m_baseProgram, "directionalLight.bActive");
+	if (bActive)
+	{
+		features |= ShaderVariants::directionalLight;
+		bakedLight.type = LightmapBaker::directionalLight;
+		bakedLight.direction = GetUniformVec3(m_baseProgram, "directionalLight.direction");
+		bakedLight.ambient = GetUniformVec3(m_baseProgram, "directionalLight.ambient");
+		bakedLight.diffuse = GetUniformVec3(m_baseProgram, "directionalLight.diffuse");
+		bakedLights.push_back(bakedLight);
+	}
+	declarations << "const DirectionalLight directionalLight = DirectionalLight("
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "directionalLight.direction")) << ", "
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "directionalLight.ambient")) << ", "
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "directionalLight.diffuse")) << ", "
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "directionalLight.specular")) << ", "
+		<< (bActive ? "true" : "false") << "); ";
+
+	declarations << "const PointLight pointLights[TOTAL_POINT_LIGHTS] = PointLight[TOTAL_POINT_LIGHTS](";
+	for (int i = 0; i < g_TotalPointLights; i++)
+	{
+		std::string light = "pointLights[" + std::to_string(i) + "].";
+		bActive = GetUniformBool(m_baseProgram, light + "bActive");
+		if (bActive)
+		{
+			pointLightMask |= 1u << i;
+			bakedLight = LightmapBaker::BAKED_LIGHT();
+			bakedLight.type = LightmapBaker::pointLight;
+			bakedLight.position = GetUniformVec3(m_baseProgram, light + "position");
+			bakedLight.ambient = GetUniformVec3(m_baseProgram, light + "ambient");
+			bakedLight.diffuse = GetUniformVec3(m_baseProgram, light + "diffuse");
+			bakedLights.push_back(bakedLight);
+		}
+		m_shadowMaps->SetPointLight(i, bActive, GetUniformVec3(m_baseProgram, light + "position"));
+		declarations << ((i > 0) ? ", " : "") << "PointLight("
+			<< FormatVec3(GetUniformVec3(m_baseProgram, light + "position")) << ", "
+			<< FormatVec3(GetUniformVec3(m_baseProgram, light + "ambient")) << ", "
+			<< FormatVec3(GetUniformVec3(m_baseProgram, light + "diffuse")) << ", "
+			<< FormatVec3(GetUniformVec3(m_baseProgram, light + "specular")) << ", "
+			<< (bActive ? "true" : "false") << ")";
+	}
+	declarations << "); ";
+
+	bActive = GetUniformBool(m_baseProgram, "spotLight.bActive");
+	if (bActive)
+	{
+		features |= ShaderVariants::spotLight;
+		bakedLight = LightmapBaker::BAKED_LIGHT();
+		bakedLight.type = LightmapBaker::spotLight;
+		bakedLight.position = GetUniformVec3(m_baseProgram, "spotLight.position");
+		bakedLight.direction = GetUniformVec3(m_baseProgram, "spotLight.direction");
+		bakedLight.ambient = GetUniformVec3(m_baseProgram, "spotLight.ambient");
+		bakedLight.diffuse = GetUniformVec3(m_baseProgram, "spotLight.diffuse");
+		bakedLight.cutOff = GetUniformFloat(m_baseProgram, "spotLight.cutOff");
+		bakedLight.outerCutOff = GetUniformFloat(m_baseProgram, "spotLight.outerCutOff");
+		bakedLight.constant = GetUniformFloat(m_baseProgram, "spotLight.constant");
+		bakedLight.linear = GetUniformFloat(m_baseProgram, "spotLight.linear");
+		bakedLight.quadratic = GetUniformFloat(m_baseProgram, "spotLight.quadratic");
+		bakedLights.push_back(bakedLight);
+	}
+	m_shadowMaps->SetSpotLight(bActive, GetUniformVec3(m_baseProgram, "spotLight.position"),
+		GetUniformVec3(m_baseProgram, "spotLight.direction"));
+	declarations << "const SpotLight spotLight = SpotLight("
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "spotLight.position")) << ", "
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "spotLight.direction")) << ", "
+		<< FormatFloat(GetUniformFloat(m_baseProgram, "spotLight.cutOff")) << ", "
+		<< FormatFloat(GetUniformFloat(m_baseProgram, "spotLight.outerCutOff")) << ", "
+		<< FormatFloat(GetUniformFloat(m_baseProgram, "spotLight.constant")) << ", "
+		<< FormatFloat(GetUniformFloat(m_baseProgram, "spotLight.linear")) << ", "
+		<< FormatFloat(GetUniformFloat(m_baseProgram, "spotLight.quadratic")) << ", "
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "spotLight.ambient")) << ", "
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "spotLight.diffuse")) << ", "
+		<< FormatVec3(GetUniformVec3(m_baseProgram, "spotLight.specular")) << ", "
+		<< (bActive ? "true" : "false") << ");";
+
+	m_lightFeatures = features;
+	m_pointLightMask = pointLightMask;
+	m_shaderVariants->SetBakedLights(declarations.str());
+	m_programFrames.clear();
+	m_lightmapBaker->SetLights(bakedLights);
+	m_irradianceProbes->SetLights(bakedLights);
+	m_reflectionProbes->SetLights(bakedLights);
+	m_objectLightLists->SetSceneLights(pointLightMask, bActive,
+		GetUniformVec3(m_baseProgram, "spotLight.position"),
+		GetUniformVec3(m_baseProgram, "spotLight.direction"),
+		GetUniformFloat(m_baseProgram, "spotLight.outerCutOff"));
+
+	// start building the variants of the textured and the colored
+	// objects, so they are ready by the first frames
+	m_shaderVariants->GetProgram(ShaderVariants::MakeKey(GetForwardLightFeatures() | ShaderVariants::textured, m_pointLightMask));
+	m_shaderVariants->GetProgram(ShaderVariants::MakeKey(GetForwardLightFeatures(), m_pointLightMask));
+	if (m_renderPath == deferredShading)
+	{
+		DeferredProgramsReady();
+	}
+}
+
+/***********************************************************
+ *  SelectShaderVariant()
+ *
+ *  This method is used for making the program variant for
+ *  the features of the next drawn object current.  While
+ *  the variant is building the object is drawn with the
+ *  unspecialized program, which branches on its uniforms.
+ ***********************************************************/
+void SceneManager::SelectShaderVariant(bool bTextured)
+{
+	// the shadow maps are only drawn once their program is built
+	if (m_bShadowPass)
+	{
+		UseShaderProgram(m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::shadowPass, 0)));
+		return;
+	}
+	// the capture writes every object with its one program
+	if (m_bCapturePass)
+	{
+		UseShaderProgram(m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::sceneCapture, 0)));
+		return;
+	}
+	// the depth pre-pass only starts once its program is built
+	if (m_bDepthPrepass)
+	{
+		UseShaderProgram(m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::depthPrepass, 0)));
+		return;
+	}
+	// a deferred frame only starts once its programs are built
+	if (m_bDeferredFrame)
+	{
+		UseShaderProgram(GetDeferredProgram(ShaderVariants::geometryPass, bTextured));
+		return;
+	}
+
+	uint32_t features = m_bReflectionPass ? GetReflectionPassFeatures() : GetForwardLightFeatures();
+	features |= (bTextured ? (uint32_t)ShaderVariants::textured : 0);
+	// the transparent objects add themselves to the weighted sums
+	if (m_bTransparentPass && m_bWeightedBlending)
+	{
+		features |= ShaderVariants::transparencyPass;
+	}
+	GLuint program = m_shaderVariants->GetProgram(ShaderVariants::MakeKey(features, m_pointLightMask));
+
+	UseShaderProgram((program != 0) ? program : m_baseProgram);
+}
+
+/***********************************************************
+ *  GetForwardLightFeatures()
+ *
+ *  This method is used for getting the variant features of
+ *  the lights of the forward frames, which read the local
+ *  lights from the object light lists instead of the
+ *  clusters when they are selected, the scene lights from
+ *  the lightmaps once they are baked, the ambient light
+ *  from the irradiance probes once they are baked, and the
+ *  reflections from the reflection probes once they are
+ *  drawn.
+ ***********************************************************/
+uint32_t SceneManager::GetForwardLightFeatures() const
+{
+	uint32_t features = m_lightFeatures;
+	if ((m_lightListMode == objectLightLists) && ((features & ShaderVariants::clusteredLights) != 0))
+	{
+		features = (features & ~(uint32_t)ShaderVariants::clusteredLights) | ShaderVariants::objectLightLists;
+	}
+	if (m_bUseLightmaps && ((features & ShaderVariants::lit) != 0) && m_lightmapBaker->IsReady())
+	{
+		features |= ShaderVariants::lightmap;
+	}
+	if (((features & ShaderVariants::lit) != 0) && m_occlusionBaker->IsReady())
+	{
+		features |= ShaderVariants::ambientOcclusion;
+	}
+	if (((features & ShaderVariants::lit) != 0) && m_irradianceProbes->IsReady())
+	{
+		features |= ShaderVariants::irradianceProbes;
+	}
+	if (((features & ShaderVariants::lit) != 0) && m_reflectionProbes->IsReady())
+	{
+		features |= ShaderVariants::reflectionProbes;
+	}
+
+	return features;
+}
+
+/***********************************************************
+ *  GetReflectionPassFeatures()
+ *
+ *  This method is used for getting the variant features of
+ *  the faces of the reflection probes.  They are lit like
+ *  the forward frames apart from the local lights, whose
+ *  lists are built for the view of the camera, and from
+ *  the probes themselves.
+ ***********************************************************/
+uint32_t SceneManager::GetReflectionPassFeatures() const
+{
+	return GetForwardLightFeatures() &
+		~(uint32_t)(ShaderVariants::clusteredLights | ShaderVariants::objectLightLists | ShaderVariants::reflectionProbes);
+}
+
+/***********************************************************
+ *  UseShaderProgram()
+ *
+ *  This method is used for making a program current.  Each
+ *  program keeps its own uniforms, so a program that is
+ *  switched to is given the uniforms it has missed - the
+ *  lights on its first use, the camera once per frame, and
+ *  the values that stay set across objects.
+ ***********************************************************/
+void SceneManager::UseShaderProgram(GLuint program)
+{
+	std::unordered_map<GLuint, unsigned int>::iterator found = m_programFrames.find(program);
+	bool bFirstUse = (found == m_programFrames.end());
+	bool bSwitched = (m_pShaderManager->m_programID != program);
+
+	if (!bSwitched && !bFirstUse && (found->second == m_frame))
+	{
+		return;
+	}
+
+	m_pShaderManager->m_programID = program;
+	m_pShaderManager->use();
+
+	if (bFirstUse)
+	{
+		SetupSceneLights();
+	}
+	if (bFirstUse || (found->second != m_frame))
+	{
+		m_pShaderManager->setMat4Value(g_ViewName, m_viewMatrix);
+		m_pShaderManager->setMat4Value(g_ProjectionName, m_projectionMatrix);
+		m_pShaderManager->setVec3Value(g_ViewPositionName, m_cameraPosition);
+		m_clusteredLights->SetShaderValues(program);
+		m_shadowMaps->SetShaderValues(program);
+		m_programFrames[program] = m_frame;
+	}
+
+	m_pShaderManager->setMat4Value(g_ModelName, m_modelMatrix);
+	m_pShaderManager->setVec2Value(g_UVScaleName, m_uvScale);
+	m_pShaderManager->setVec3Value("material.diffuseColor", m_material.diffuseColor);
+	m_pShaderManager->setVec3Value("material.specularColor", m_material.specularColor);
+	m_pShaderManager->setFloatValue("material.shininess", m_material.shininess);
+	m_pShaderManager->setFloatValue(g_ReflectanceName, GetMaterialReflectance(m_material.tag));
+	m_pShaderManager->setFloatValue(g_OpacityName, m_bTransparentPass ? GetMaterialOpacity(m_material.tag) : 1.0f);
+	if (m_lightListMode == objectLightLists)
+	{
+		m_objectLightLists->SetShaderValues(program);
+	}
+	if (m_lightmapBaker->IsReady())
+	{
+		m_lightmapBaker->SetShaderValues(program);
+	}
+	if (m_occlusionBaker->IsReady())
+	{
+		m_occlusionBaker->SetShaderValues(program);
+	}
+	if (m_irradianceProbes->IsReady())
+	{
+		m_irradianceProbes->SetShaderValues(program);
+	}
+	if (m_reflectionProbes->IsReady())
+	{
+		m_reflectionProbes->SetShaderValues(program);
+	}
+}
+
+/***********************************************************
+ *  BeginForwardLights()
+ *
+ *  This method is used for starting the local light lists
+ *  of a frame whose objects are lit while they are drawn -
+ *  the lists of the objects are selected as they are
+ *  drawn, and the lists of the clusters are built for the
+ *  view.
+ ***********************************************************/
+void SceneManager::BeginForwardLights()
+{
+	if (m_lightListMode == objectLightLists)
+	{
+		m_objectLightLists->BeginFrame(m_clusteredLights->GetLightBuffer());
+	}
+	else
+	{
+		m_clusteredLights->Update(m_viewMatrix, m_projectionMatrix);
+	}
+}
+
+/***********************************************************
+ *  SetObjectLighting()
+ *
+ *  This method is used for setting the lights that reach
+ *  the current object on its program.  The forward frames
+ *  light it from its own light lists and read its baked
+ *  scene lights from its brick, and every frame reads the
+ *  occlusion of its vertices.
+ ***********************************************************/
+void SceneManager::SetObjectLighting(const glm::vec3& position, float radius)
+{
+	if ((m_lightListMode == objectLightLists) && !m_bDeferredFrame && !m_bReflectionPass)
+	{
+		m_objectLightLists->SetObject(position, radius);
+		if (NULL != m_pShaderManager)
+		{
+			m_objectLightLists->SetShaderValues(m_pShaderManager->m_programID);
+		}
+	}
+
+	uint32_t features = GetForwardLightFeatures();
+	if (((features & ShaderVariants::lightmap) != 0) && !m_bDeferredFrame && (NULL != m_pShaderManager))
+	{
+		m_lightmapBaker->SetShaderValues(m_pShaderManager->m_programID);
+	}
+	if (((features & ShaderVariants::ambientOcclusion) != 0) && (NULL != m_pShaderManager))
+	{
+		m_occlusionBaker->SetShaderValues(m_pShaderManager->m_programID);
+	}
+}
+
+/***********************************************************
+ *  SetupLocalLights()
+ *
+ *  This method is used for dressing the table with local
+ *  lights - a quarter of them are candles standing on the
+ *  table, the rest are fairy lights strung in rows above
+ *  it.  They are placed the same way on every run.
+ ***********************************************************/
+void SceneManager::SetupLocalLights()
+{
+	const int fairyLightRows = 6;
+	std::vector<ClusteredLights::LOCAL_LIGHT> lights;
+	unsigned int seed = 12345;
+
+	auto random = [&seed]()
+	{
+		seed = (seed * 1103515245u) + 12345u;
+		return (float)((seed >> 8) & 0xFFFF) / 65535.0f;
+	};
+
+	int candles = m_localLightCount / 4;
+	for (int i = 0; i < candles; i++)
+	{
+		ClusteredLights::LOCAL_LIGHT candle;
+		candle.position = glm::vec3(-30.0f + (60.0f * random()), 1.5f, -32.0f + (50.0f * random()));
+		candle.radius = 6.0f;
+		candle.diffuse = glm::vec3(0.8f, 0.45f, 0.2f);
+		candle.specular = glm::vec3(0.5f, 0.35f, 0.2f);
+		lights.push_back(candle);
+	}
+
+	// the fairy lights hang lower in the middle of each row
+	int fairyLights = m_localLightCount - candles;
+	int rowLength = (fairyLights + fairyLightRows - 1) / fairyLightRows;
+	for (int i = 0; i < fairyLights; i++)
+	{
+		int row = i / rowLength;
+		float along = (rowLength > 1) ? (float)(i % rowLength) / (rowLength - 1) : 0.5f;
+		ClusteredLights::LOCAL_LIGHT fairyLight;
+		fairyLight.position = glm::vec3(
+			-32.0f + (64.0f * along),
+			9.0f - (2.5f * glm::sin(glm::pi<float>() * along)),
+			-32.0f + (50.0f * row / (fairyLightRows - 1)));
+		fairyLight.radius = 3.5f;
+		fairyLight.diffuse = glm::vec3(0.6f, 0.5f, 0.35f);
+		fairyLight.specular = glm::vec3(0.4f, 0.35f, 0.25f);
+		lights.push_back(fairyLight);
+	}
+
+	m_clusteredLights->SetLights(lights);
+	m_objectLightLists->SetLocalLights(lights);
+}
+
+/***********************************************************
+ *  SetLocalLightCount()
+ *
+ *  This method is used for setting the number of candles
+ *  and fairy lights on the table.  Once the scene is
+ *  prepared they are placed again right away.
+ ***********************************************************/
+void SceneManager::SetLocalLightCount(int count)
+{
+	m_localLightCount = std::max(count, 0);
+	if (m_clusteredLights->IsSupported())
+	{
+		SetupLocalLights();
+	}
+}
+
+/***********************************************************
+ *  SetLightAssignMode()
+ *
+ *  This method is used for choosing where the local lights
+ *  are assigned to the clusters, for comparing the modes.
+ ***********************************************************/
+bool SceneManager::SetLightAssignMode(ClusteredLights::AssignMode mode)
+{
+	if (!m_clusteredLights->IsSupported() ||
+		((mode == ClusteredLights::computeShader) && !m_clusteredLights->CanAssignOnGPU()))
+	{
+		return false;
+	}
+
+	m_clusteredLights->SetAssignMode(mode);
+	return true;
+}
+
+/***********************************************************
+ *  GetLightAssignTime()
+ *
+ *  This method is used for getting the time the last
+ *  assignment of the local lights took in milliseconds.
+ ***********************************************************/
+double SceneManager::GetLightAssignTime() const
+{
+	if (m_lightListMode == objectLightLists)
+	{
+		return m_objectLightLists->GetAssignTime();
+	}
+	return m_clusteredLights->GetAssignTime();
+}
+
+/***********************************************************
+ *  SetLightListMode()
+ *
+ *  This method is used for choosing if the forward frames
+ *  read the local lights from the lists of the clusters or
+ *  of the objects, for comparing the two.  The object lists
+ *  read the light buffer of the clusters, so they need the
+ *  same driver support.
+ ***********************************************************/
+bool SceneManager::SetLightListMode(LightListMode mode)
+{
+	if ((mode == objectLightLists) && !m_clusteredLights->IsSupported())
+	{
+		return false;
+	}
+
+	m_lightListMode = mode;
+	// start building the variants of the mode
+	m_shaderVariants->GetProgram(ShaderVariants::MakeKey(GetForwardLightFeatures() | ShaderVariants::textured, m_pointLightMask));
+	m_shaderVariants->GetProgram(ShaderVariants::MakeKey(GetForwardLightFeatures(), m_pointLightMask));
+	return true;
+}
+
+/***********************************************************
+ *  GetLightListMode()
+ *
+ *  This method is used for getting where the local light
+ *  lists of the forward frames come from.
+ ***********************************************************/
+SceneManager::LightListMode SceneManager::GetLightListMode() const
+{
+	return m_lightListMode;
+}
+
+/***********************************************************
+ *  GetLightListModeName()
+ *
+ *  This method is used for getting the name of a light list
+ *  mode for the console messages.
+ ***********************************************************/
+const char* SceneManager::GetLightListModeName(LightListMode mode)
+{
+	return (mode == objectLightLists) ? "per object" : "per cluster";
+}
+
+/***********************************************************
+ *  SetUseLightmaps()
+ *
+ *  This method is used for choosing whether the forward
+ *  frames read the scene lights from the baked lightmaps,
+ *  or light every fragment in the shader.  The lightmaps
+ *  leave out the highlights the scene lights put on the
+ *  shiny objects.
+ ***********************************************************/
+void SceneManager::SetUseLightmaps(bool bUseLightmaps)
+{
+	m_bUseLightmaps = bUseLightmaps;
+}
+
+/***********************************************************
+ *  IsSceneCaptured()
+ *
+ *  This method is used for checking if the triangles of the
+ *  scene have been captured for baking.
+ ***********************************************************/
+bool SceneManager::IsSceneCaptured() const
+{
+	return m_sceneCapture->IsCaptured();
+}
+
+/***********************************************************
+ *  TimeOcclusionBake()
+ *
+ *  This method is used for timing the bake of the ambient
+ *  occlusion of copies of the captured scene, set side by
+ *  side in a square so each copy occludes its neighbors no
+ *  more than the scene occludes itself.  The baked values
+ *  are not uploaded.
+ ***********************************************************/
+bool SceneManager::TimeOcclusionBake(int copies, size_t& vertexCount, double& milliseconds)
+{
+	if (!m_sceneCapture->IsCaptured() || (copies < 1))
+	{
+		return false;
+	}
+
+	const std::vector<SceneCapture::CAPTURED_OBJECT>& sceneObjects = m_sceneCapture->GetObjects();
+	const std::vector<SceneCapture::CAPTURED_VERTEX>& sceneVertices = m_sceneCapture->GetVertices();
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < sceneVertices.size(); i++)
+	{
+		boundsMin = glm::min(boundsMin, sceneVertices[i].position);
+		boundsMax = glm::max(boundsMax, sceneVertices[i].position);
+	}
+	glm::vec3 spacing = (boundsMax - boundsMin) + glm::vec3(OcclusionBaker::GetRayLength());
+	int columns = (int)std::ceil(std::sqrt((float)copies));
+
+	std::vector<SceneCapture::CAPTURED_OBJECT> objects;
+	std::vector<SceneCapture::CAPTURED_VERTEX> vertices;
+	objects.reserve(sceneObjects.size() * copies);
+	vertices.reserve(sceneVertices.size() * copies);
+	for (int copy = 0; copy < copies; copy++)
+	{
+		glm::vec3 offset((float)(copy % columns) * spacing.x, 0.0f, (float)(copy / columns) * spacing.z);
+		size_t firstTriangle = vertices.size() / 3;
+		for (size_t i = 0; i < sceneVertices.size(); i++)
+		{
+			SceneCapture::CAPTURED_VERTEX vertex = sceneVertices[i];
+			vertex.position += offset;
+			vertices.push_back(vertex);
+		}
+		for (size_t i = 0; i < sceneObjects.size(); i++)
+		{
+			SceneCapture::CAPTURED_OBJECT object = sceneObjects[i];
+			object.firstTriangle += firstTriangle;
+			objects.push_back(object);
+		}
+	}
+
+	std::vector<OcclusionBaker::OBJECT_VERTICES> objectVertices;
+	std::vector<unsigned char> values;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	OcclusionBaker::BakeOcclusion(objects, vertices, m_threadPool, objectVertices, values);
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+
+	vertexCount = values.size();
+	milliseconds = time.count();
+	return true;
+}
+
+/***********************************************************
+ *  GetDeferredProgram()
+ *
+ *  This method is used for getting the program variant of a
+ *  deferred shading pass.  The scene lights are lit with the
+ *  lights baked for the forward frames, apart from the
+ *  clusters, as the local lights have a pass of their own.
+ ***********************************************************/
+GLuint SceneManager::GetDeferredProgram(ShaderVariants::VariantFeature pass, bool bTextured)
+{
+	uint32_t features = pass | (bTextured ? (uint32_t)ShaderVariants::textured : 0);
+	if ((pass == ShaderVariants::geometryPass) && m_occlusionBaker->IsReady())
+	{
+		// the occlusion of the vertices is kept in the G-buffer
+		features |= ShaderVariants::ambientOcclusion;
+	}
+	else if (pass == ShaderVariants::deferredLighting)
+	{
+		features |= m_lightFeatures & ~(uint32_t)ShaderVariants::clusteredLights;
+		if (((features & ShaderVariants::lit) != 0) && m_irradianceProbes->IsReady())
+		{
+			features |= ShaderVariants::irradianceProbes;
+		}
+		if (((features & ShaderVariants::lit) != 0) && m_reflectionProbes->IsReady())
+		{
+			features |= ShaderVariants::reflectionProbes;
+		}
+	}
+	else if (pass == ShaderVariants::lightVolumes)
+	{
+		features |= ShaderVariants::lit;
+	}
+
+	return m_shaderVariants->GetProgram(ShaderVariants::MakeKey(features, m_pointLightMask));
+}
+
+/***********************************************************
+ *  DeferredProgramsReady()
+ *
+ *  This method is used for checking if the programs of
+ *  every deferred shading pass are built.  Each one is asked
+ *  for, so the builds of the missing ones are started.
+ ***********************************************************/
+bool SceneManager::DeferredProgramsReady()
+{
+	bool bReady = (GetDeferredProgram(ShaderVariants::geometryPass, true) != 0);
+	bReady = (GetDeferredProgram(ShaderVariants::geometryPass, false) != 0) && bReady;
+	bReady = (GetDeferredProgram(ShaderVariants::deferredLighting, true) != 0) && bReady;
+	bReady = (GetDeferredProgram(ShaderVariants::lightVolumes, true) != 0) && bReady;
+
+	return bReady;
+}
+
+/***********************************************************
+ *  ShadeDeferredFrame()
+ *
+ *  This method is used for lighting the surfaces that the
+ *  objects of a deferred frame wrote to the G-buffer - the
+ *  scene lights over the whole screen, then the local
+ *  lights over the screen bounds of their spheres.
+ ***********************************************************/
+void SceneManager::ShadeDeferredFrame()
+{
+	GLuint sceneLightProgram = GetDeferredProgram(ShaderVariants::deferredLighting, true);
+	GLuint localLightProgram = GetDeferredProgram(ShaderVariants::lightVolumes, true);
+
+	m_deferredShading->BeginLightPass(m_viewMatrix, m_projectionMatrix);
+	UseShaderProgram(sceneLightProgram);
+	m_deferredShading->DrawSceneLights(sceneLightProgram);
+	if (m_clusteredLights->IsSupported())
+	{
+		UseShaderProgram(localLightProgram);
+		m_deferredShading->DrawLocalLights(localLightProgram, m_clusteredLights->GetLightBuffer(), m_clusteredLights->GetLightCount());
+	}
+	m_deferredShading->EndLightPass();
+}
+
+/***********************************************************
+ *  SetRenderPath()
+ *
+ *  This method is used for choosing how the lights are
+ *  applied, for comparing the render paths.  Deferred
+ *  shading needs the G-buffer and a lit scene.
+ ***********************************************************/
+bool SceneManager::SetRenderPath(RenderPath path)
+{
+	if ((path == deferredShading) &&
+		(!m_deferredShading->IsSupported() || ((m_lightFeatures & ShaderVariants::lit) == 0)))
+	{
+		return false;
+	}
+
+	m_renderPath = path;
+	if (m_renderPath == deferredShading)
+	{
+		DeferredProgramsReady();
+	}
+	return true;
+}
+
+/***********************************************************
+ *  GetRenderPath()
+ *
+ *  This method is used for getting how the lights are
+ *  applied.
+ ***********************************************************/
+SceneManager::RenderPath SceneManager::GetRenderPath() const
+{
+	return m_renderPath;
+}
+
+/***********************************************************
+ *  IsRenderPathReady()
+ *
+ *  This method is used for checking if the frames are drawn
+ *  with the chosen render path, which for deferred shading
+ *  waits for its programs to be built.
+ ***********************************************************/
+bool SceneManager::IsRenderPathReady()
+{
+	return (m_renderPath == forwardShading) || DeferredProgramsReady();
+}
+
+/***********************************************************
+ *  GetRenderPathName()
+ *
+ *  This method is used for getting the name of a render
+ *  path for the console messages.
+ ***********************************************************/
+const char* SceneManager::GetRenderPathName(RenderPath path)
+{
+	return (path == deferredShading) ? "deferred shading" : "forward shading";
+}
+
+/***********************************************************
+ *  SetTransparencyMode()
+ *
+ *  This method is used for choosing how the transparent
+ *  objects are blended, for comparing the modes.  The
+ *  weighted sums need their targets, and are only drawn
+ *  once their programs are built.
+ ***********************************************************/
+bool SceneManager::SetTransparencyMode(TransparencyMode mode)
+{
+	if ((mode == weightedBlendedTransparency) && !m_transparencyPass->IsSupported())
+	{
+		return false;
+	}
+
+	m_transparencyMode = mode;
+	if (m_transparencyMode == weightedBlendedTransparency)
+	{
+		TransparencyProgramsReady();
+	}
+	return true;
+}
+
+/***********************************************************
+ *  GetTransparencyMode()
+ *
+ *  This method is used for getting how the transparent
+ *  objects are blended.
+ ***********************************************************/
+SceneManager::TransparencyMode SceneManager::GetTransparencyMode() const
+{
+	return m_transparencyMode;
+}
+
+/***********************************************************
+ *  IsTransparencyModeReady()
+ *
+ *  This method is used for checking if the transparent
+ *  objects are blended with the chosen mode, which for the
+ *  weighted sums waits for their programs to be built.
+ ***********************************************************/
+bool SceneManager::IsTransparencyModeReady()
+{
+	return (m_transparencyMode == sortedTransparency) || TransparencyProgramsReady();
+}
+
+/***********************************************************
+ *  GetTransparencySortTime()
+ *
+ *  This method is used for getting the time the last sort
+ *  of the transparent objects took in milliseconds, 0 when
+ *  they were blended without sorting.
+ ***********************************************************/
+double SceneManager::GetTransparencySortTime() const
+{
+	return m_sortMilliseconds;
+}
+
+/***********************************************************
+ *  GetTransparencyModeName()
+ *
+ *  This method is used for getting the name of a
+ *  transparency mode for the console messages.
+ ***********************************************************/
+const char* SceneManager::GetTransparencyModeName(TransparencyMode mode)
+{
+	return (mode == sortedTransparency) ? "sorted" : "weighted blended";
+}
+
+/***********************************************************
+ *  TransparencyProgramsReady()
+ *
+ *  This method is used for checking if the programs that
+ *  draw the transparent objects into the weighted sums and
+ *  composite them are built.  Each one is asked for, so the
+ *  builds of the missing ones are started.
+ ***********************************************************/
+bool SceneManager::TransparencyProgramsReady()
+{
+	uint32_t features = GetForwardLightFeatures() | ShaderVariants::transparencyPass;
+	bool bReady = (m_shaderVariants->GetProgram(ShaderVariants::MakeKey(features | ShaderVariants::textured, m_pointLightMask)) != 0);
+	bReady = (m_shaderVariants->GetProgram(ShaderVariants::MakeKey(features, m_pointLightMask)) != 0) && bReady;
+	bReady = (m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::transparencyComposite, 0)) != 0) && bReady;
+
+	return bReady;
+}
+
+/***********************************************************
+ *  SetDepthPrepassMode()
+ *
+ *  This method is used for choosing whether the forward
+ *  frames draw the depth pre-pass, for comparing the modes.
+ *  Choosing it automatically needs the passes to be timed,
+ *  and the pre-pass is only drawn once its program is
+ *  built.
+ ***********************************************************/
+bool SceneManager::SetDepthPrepassMode(DepthPrepassMode mode)
+{
+	if ((mode == automaticDepthPrepass) && !m_depthPrepass->IsSupported())
+	{
+		return false;
+	}
+
+	m_depthPrepassMode = mode;
+	if (m_depthPrepassMode != noDepthPrepass)
+	{
+		DepthPrepassProgramReady();
+	}
+	return true;
+}
+
+/***********************************************************
+ *  GetDepthPrepassMode()
+ *
+ *  This method is used for getting whether the forward
+ *  frames draw the depth pre-pass.
+ ***********************************************************/
+SceneManager::DepthPrepassMode SceneManager::GetDepthPrepassMode() const
+{
+	return m_depthPrepassMode;
+}
+
+/***********************************************************
+ *  IsDepthPrepassModeReady()
+ *
+ *  This method is used for checking if the frames are drawn
+ *  with the chosen mode, which waits for the program of the
+ *  pre-pass to be built.
+ ***********************************************************/
+bool SceneManager::IsDepthPrepassModeReady()
+{
+	return (m_depthPrepassMode == noDepthPrepass) || DepthPrepassProgramReady();
+}
+
+/***********************************************************
+ *  IsDepthPrepassDrawn()
+ *
+ *  This method is used for checking if the last frame drew
+ *  the depth pre-pass.
+ ***********************************************************/
+bool SceneManager::IsDepthPrepassDrawn() const
+{
+	return m_bPrepassFrame;
+}
+
+/***********************************************************
+ *  GetOverdrawRatio()
+ *
+ *  This method is used for getting the fragments the opaque
+ *  objects light for every visible one without the depth
+ *  pre-pass, as last measured.
+ ***********************************************************/
+double SceneManager::GetOverdrawRatio() const
+{
+	return m_depthPrepass->GetOverdrawRatio();
+}
+
+/***********************************************************
+ *  GetFragmentCost()
+ *
+ *  This method is used for getting the time a lit fragment
+ *  of the opaque objects takes in nanoseconds, as last
+ *  measured.
+ ***********************************************************/
+double SceneManager::GetFragmentCost() const
+{
+	return m_depthPrepass->GetFragmentCost();
+}
+
+/***********************************************************
+ *  GetDepthPrepassModeName()
+ *
+ *  This method is used for getting the name of a depth
+ *  pre-pass mode for the console messages.
+ ***********************************************************/
+const char* SceneManager::GetDepthPrepassModeName(DepthPrepassMode mode)
+{
+	if (mode == alwaysDepthPrepass)
+	{
+		return "always";
+	}
+	return (mode == automaticDepthPrepass) ? "automatic" : "off";
+}
+
+/***********************************************************
+ *  DepthPrepassProgramReady()
+ *
+ *  This method is used for checking if the program of the
+ *  depth pre-pass is built, starting its build when it is
+ *  missing.
+ ***********************************************************/
+bool SceneManager::DepthPrepassProgramReady()
+{
+	return m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::depthPrepass, 0)) != 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for binding the target the frame is
+ *  drawn into and its viewport.  The frame is scaled down
+ *  in the fixed and dynamic modes once the program that
+ *  filters it up to the window is built, and drawn into
+ *  the window otherwise.
+ ***********************************************************/
+void SceneManager::BeginFrame()
+{
+	int width = 0;
+	int height = 0;
+	if (NULL != m_pWindow)
+	{
+		glfwGetFramebufferSize(m_pWindow, &width, &height);
+	}
+
+	bool bCanUpscale = (m_resolutionMode != nativeResolution) && UpscaleProgramReady();
+	m_resolutionScaler->BeginFrame(width, height, bCanUpscale);
+}
+
+/***********************************************************
+ *  SetResolutionMode()
+ *
+ *  This method is used for choosing the resolution the
+ *  frames are drawn at, for comparing the modes.  Scaling
+ *  the frames needs the scaled target, and the scale only
+ *  follows the frame time in the dynamic mode.
+ ***********************************************************/
+bool SceneManager::SetResolutionMode(ResolutionMode mode)
+{
+	if ((mode != nativeResolution) && !m_resolutionScaler->IsSupported())
+	{
+		return false;
+	}
+
+	m_resolutionMode = mode;
+	m_resolutionScaler->SetDynamic(m_resolutionMode == dynamicResolution);
+	if (m_resolutionMode != nativeResolution)
+	{
+		UpscaleProgramReady();
+	}
+	return true;
+}
+
+/***********************************************************
+ *  GetResolutionMode()
+ *
+ *  This method is used for getting the resolution the
+ *  frames are drawn at.
+ ***********************************************************/
+SceneManager::ResolutionMode SceneManager::GetResolutionMode() const
+{
+	return m_resolutionMode;
+}
+
+/***********************************************************
+ *  IsResolutionModeReady()
+ *
+ *  This method is used for checking if the frames are drawn
+ *  with the chosen mode, which waits for the program that
+ *  filters them up to be built.
+ ***********************************************************/
+bool SceneManager::IsResolutionModeReady()
+{
+	return (m_resolutionMode == nativeResolution) || UpscaleProgramReady();
+}
+
+/***********************************************************
+ *  SetResolutionScale()
+ *
+ *  This method is used for setting the scale of the width
+ *  and height of the frames in the fixed mode, which the
+ *  dynamic mode moves from.
+ ***********************************************************/
+void SceneManager::SetResolutionScale(float scale)
+{
+	m_resolutionScaler->SetScale(scale);
+}
+
+/***********************************************************
+ *  SetFrameTimeTarget()
+ *
+ *  This method is used for setting the frame time the
+ *  dynamic mode keeps the frames within in milliseconds.
+ ***********************************************************/
+void SceneManager::SetFrameTimeTarget(double milliseconds)
+{
+	m_resolutionScaler->SetTargetFrameTime(milliseconds);
+}
+
+/***********************************************************
+ *  GetFrameTimeTarget()
+ *
+ *  This method is used for getting the frame time the
+ *  dynamic mode keeps the frames within in milliseconds.
+ ***********************************************************/
+double SceneManager::GetFrameTimeTarget() const
+{
+	return m_resolutionScaler->GetTargetFrameTime();
+}
+
+/***********************************************************
+ *  SetResolutionScaleBounds()
+ *
+ *  This method is used for setting the lowest and highest
+ *  scale of the width and height of the frames.
+ ***********************************************************/
+void SceneManager::SetResolutionScaleBounds(float minScale, float maxScale)
+{
+	m_resolutionScaler->SetScaleBounds(minScale, maxScale);
+}
+
+/***********************************************************
+ *  GetResolutionScale()
+ *
+ *  This method is used for getting the scale of the width
+ *  and height the last frame was drawn at.
+ ***********************************************************/
+float SceneManager::GetResolutionScale() const
+{
+	return m_resolutionScaler->GetFrameScale();
+}
+
+/***********************************************************
+ *  GetGpuFrameTime()
+ *
+ *  This method is used for getting the averaged GPU time of
+ *  the frames in milliseconds, as last measured.
+ ***********************************************************/
+double SceneManager::GetGpuFrameTime() const
+{
+	return m_resolutionScaler->GetGpuFrameTime();
+}
+
+/***********************************************************
+ *  GetCpuFrameTime()
+ *
+ *  This method is used for getting the averaged CPU time of
+ *  the frames up to the swap of the buffers in milliseconds,
+ *  as last measured.
+ ***********************************************************/
+double SceneManager::GetCpuFrameTime() const
+{
+	return m_resolutionScaler->GetCpuFrameTime();
+}
+
+/***********************************************************
+ *  GetResolutionModeName()
+ *
+ *  This method is used for getting the name of a resolution
+ *  mode for the console messages.
+ ***********************************************************/
+const char* SceneManager::GetResolutionModeName(ResolutionMode mode)
+{
+	if (mode == fixedResolution)
+	{
+		return "fixed";
+	}
+	return (mode == dynamicResolution) ? "dynamic" : "native";
+}
+
+/***********************************************************
+ *  UpscaleProgramReady()
+ *
+ *  This method is used for checking if the program that
+ *  filters the scaled frames up to the window is built,
+ *  starting its build when it is missing.
+ ***********************************************************/
+bool SceneManager::UpscaleProgramReady()
+{
+	return m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::resolutionUpscale, 0)) != 0;
+}
+
+/***********************************************************
+ *  SetShaderFiles()
+ *
+ *  This method is used for setting the shader files of the
+ *  program the shader manager loaded, and reading them as
+ *  the sources of the program variants.  Without them every
+ *  object is drawn with the loaded program.
+ ***********************************************************/
+void SceneManager::SetShaderFiles(
+	const std::string& vertexShaderFile,
+	const std::string& fragmentShaderFile)
+{
+	std::string vertexSource;
+	std::string fragmentSource;
+
+	m_vertexShaderFile = AssetPack::GetAssetName(vertexShaderFile);
+	m_fragmentShaderFile = AssetPack::GetAssetName(fragmentShaderFile);
+	m_baseProgram = m_pShaderManager->m_programID;
+
+	if (ShaderCompiler::ReadSource(m_vertexShaderFile, vertexSource) &&
+		ShaderCompiler::ReadSource(m_fragmentShaderFile, fragmentSource))
+	{
+		m_shaderVariants->SetSources("scene shaders", vertexSource, fragmentSource);
+	}
+}
+
+/***********************************************************
+ *  WatchAssetFiles()
+ *
+ *  This method is used for watching the folders of the
+ *  loaded texture files and of the scene program's shader
+ *  files, so an edit to one of them is seen while the scene
+ *  is rendering.  The assets of a mounted pack are not read
+ *  from the loose files, so they are not watched.
+ ***********************************************************/
+void SceneManager::WatchAssetFiles()
+{
+	std::vector<std::string> folders;
+	std::vector<std::string> files;
+
+	if ((NULL != m_fileWatcher) || (NULL != AssetPack::GetMounted()))
+	{
+		return;
+	}
+
+	if (!m_vertexShaderFile.empty())
+	{
+		files.push_back(m_vertexShaderFile);
+		files.push_back(m_fragmentShaderFile);
+	}
+	for (std::map<std::string, TEXTURE_IMAGE>::const_iterator file = m_textureFiles.begin(); file != m_textureFiles.end(); file++)
+	{
+		files.push_back(file->first);
+	}
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::string folder = std::filesystem::path(files[i]).parent_path().generic_string();
+		if (folder.empty())
+		{
+			folder = ".";
+		}
+		if (std::find(folders.begin(), folders.end(), folder) == folders.end())
+		{
+			folders.push_back(folder);
+		}
+	}
 
-	OBJECT_MATERIAL marbleMaterial;
-	marbleMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
-	marbleMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
-	marbleMaterial.shininess = 30.0;
-	marbleMaterial.tag = "marble";
+	m_shaderCompiler = new ShaderCompiler();
+	m_fileWatcher = new FileWatcher(folders);
+}
 
-	m_objectMaterials.push_back(marbleMaterial);
+/***********************************************************
+ *  ReloadTextureFile()
+ *
+ *  This method is used for decoding an edited texture file
+ *  on a worker thread.  The finished texture goes through
+ *  the texture uploader when there is one, or else waits
+ *  for the next frame to be uploaded, and either way takes
+ *  the slot of the texture it replaces.  The compressed
+ *  cache is skipped, and a file that fails to decode keeps
+ *  the previous texture.
+ ***********************************************************/
+void SceneManager::ReloadTextureFile(const TEXTURE_IMAGE& source)
+{
+	TextureAtlas::ATLAS_ENTRY entry;
+	int slot = FindTextureSlot(source.tag);
 
-	OBJECT_MATERIAL feltMaterial;
-	feltMaterial.diffuseColor = glm::vec3(0.1f, 0.1f, 0.1f);
-	feltMaterial.specularColor = glm::vec3(0.0f, 0.0f, 0.f);
-	feltMaterial.shininess = 1.0;
-	feltMaterial.tag = "felt";
+	if (slot < 0)
+	{
+		if (m_textureAtlas->FindEntry(source.tag, entry))
+		{
+			std::cout << "Texture is packed in the atlas, restart to reload image:" << source.filename << std::endl;
+		}
+		return;
+	}
 
-	m_objectMaterials.push_back(feltMaterial);
+	std::cout << "Reloading image:" << source.filename << std::endl;
+	TEXTURE_IMAGE image = source;
+	m_threadPool->QueueJob([this, image, slot]() mutable
+	{
+		if (!DecodeTextureImage(image, false))
+		{
+			std::cout << "Could not reload image:" << image.filename << ", keeping the previous texture" << std::endl;
+			return;
+		}
 
-	OBJECT_MATERIAL leatherMaterial;
-	leatherMaterial.diffuseColor = glm::vec3(0.4f, 0.4f, 0.4f);
-	leatherMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
-	leatherMaterial.shininess = 30.0;
-	leatherMaterial.tag = "leather";
+		if (NULL != m_textureUploader)
+		{
+			QueueTextureUpload(image, slot);
+			return;
+		}
 
-	m_objectMaterials.push_back(leatherMaterial);
+		std::lock_guard<std::mutex> lock(m_reloadMutex);
+		m_reloadedTextures.push_back(image);
+	});
+}
 
-	
+/***********************************************************
+ *  ReloadShaderFiles()
+ *
+ *  This method is used for reading the edited shader files
+ *  of the scene program on a worker thread.  Their build is
+ *  started on the next frame.
+ ***********************************************************/
+void SceneManager::ReloadShaderFiles()
+{
+	std::cout << "Reloading shaders:" << m_vertexShaderFile << ", " << m_fragmentShaderFile << std::endl;
+	m_threadPool->QueueJob([this]()
+	{
+		std::string vertexSource;
+		std::string fragmentSource;
+		if (!ShaderCompiler::ReadSource(m_vertexShaderFile, vertexSource) ||
+			!ShaderCompiler::ReadSource(m_fragmentShaderFile, fragmentSource))
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_reloadMutex);
+		m_vertexShaderSource = vertexSource;
+		m_fragmentShaderSource = fragmentSource;
+		m_bShaderSourcesRead = true;
+	});
 }
 
 /***********************************************************
- *  SetupSceneLights()
+ *  ReloadChangedAssets()
  *
- *  This method is called to add and configure the light
- *  sources for the 3D scene.  There are up to 4 light sources.
+ *  This method is used for starting the reload of the files
+ *  that were edited since the last frame, and swapping in
+ *  the assets that finished reloading.  A reloaded texture
+ *  keeps its slot, and the shader program is replaced once
+ *  its build has completed, with the light uniforms set
+ *  again - the previous program keeps rendering until then,
+ *  and stays when the edit does not build.  It is called
+ *  between frames, so no frame mixes old and new assets,
+ *  and it never waits on the worker threads.
  ***********************************************************/
-void SceneManager::SetupSceneLights()
+void SceneManager::ReloadChangedAssets()
 {
-	// this line of code is NEEDED for telling the shaders to render 
-	// the 3D scene with custom lighting, if no light sources have
-	// been added then the display window will be black - to use the 
-	// default OpenGL lighting then comment out the following line
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	std::vector<std::string> changed;
+	std::vector<TEXTURE_IMAGE> reloadedTextures;
+	bool bShadersChanged = false;
+	bool bShaderSourcesRead = false;
+	std::string vertexSource;
+	std::string fragmentSource;
+
+	if (NULL == m_fileWatcher)
+	{
+		return;
+	}
 
-	/*** STUDENTS - add the code BELOW for setting up light sources ***/
-	/*** Up to four light sources can be defined. Refer to the code ***/
-	/*** in the OpenGL Sample for help                              ***/
+	m_fileWatcher->PollChanges(changed);
+	for (size_t i = 0; i < changed.size(); i++)
+	{
+		if (!m_vertexShaderFile.empty() && ((changed[i] == m_vertexShaderFile) || (changed[i] == m_fragmentShaderFile)))
+		{
+			bShadersChanged = true;
+			continue;
+		}
 
-	// Directional Light - simulates sunlight coming from the right side
-	//m_pShaderManager->setVec3Value("directionalLight.direction", 0.0f, -1.0f, 0.0f); 
-	//m_pShaderManager->setVec3Value("directionalLight.ambient", 0.2f, 0.2f, 0.2f);  // Adjusted ambient for a base light
-	//m_pShaderManager->setVec3Value("directionalLight.diffuse", .8f, .8f, .8f);  // Stronger diffuse light for brighter highlights
-	//m_pShaderManager->setVec3Value("directionalLight.specular", 1.0f, 1.0f, 1.0f); // Strong specular for reflections
-	//m_pShaderManager->setBoolValue("directionalLight.bActive", true);
+		std::map<std::string, TEXTURE_IMAGE>::const_iterator file = m_textureFiles.find(changed[i]);
+		if (file != m_textureFiles.end())
+		{
+			ReloadTextureFile(file->second);
+		}
+	}
+	if (bShadersChanged)
+	{
+		ReloadShaderFiles();
+	}
 
-	// Point Light - simulates a nearby light source, like a window or a lamp
-	m_pShaderManager->setVec3Value("pointLights.position", 0.0f, 20.0f, 0.0f); // Positioned slightly above and to the side
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", .55f, 0.5f, 0.5f);  // Adjusted ambient for more shadow contrast
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", .75f, .7f, .7f);  // Stronger diffuse for more intense lighting
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 1.0f, 0.9f, 0.9);  // Strong specular highlights for shinier surfaces
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
+	{
+		std::lock_guard<std::mutex> lock(m_reloadMutex);
+		reloadedTextures.swap(m_reloadedTextures);
+		if (m_bShaderSourcesRead)
+		{
+			vertexSource.swap(m_vertexShaderSource);
+			fragmentSource.swap(m_fragmentShaderSource);
+			m_bShaderSourcesRead = false;
+			bShaderSourcesRead = true;
+		}
+	}
 
-	// Set the position of the spotlight to emulate the sun's position
-	m_pShaderManager->setVec3Value("spotLight.position", -18.0f, 10.0f, 55.0f); // Place the sun high and behind the objects
-	m_pShaderManager->setVec3Value("spotLight.direction", 1.0f, -0.5f, -1.0f); // Adjust this to match the sunlight direction from the image
-	m_pShaderManager->setVec3Value("spotLight.ambient", 6.0f, 6.0f, 6.0f); // Increase ambient for more overall light
-	m_pShaderManager->setVec3Value("spotLight.diffuse", 15.0f, 15.0f, 15.0f); // Increase diffuse light for more brightness
-	m_pShaderManager->setVec3Value("spotLight.specular", 10.0f, 10.0f, 10.0f); // Brighten specular highlights
-	m_pShaderManager->setFloatValue("spotLight.constant", 1.0f);   // Minimal distance attenuation
-	m_pShaderManager->setFloatValue("spotLight.linear", 0.01f);    // Further reduced attenuation over distance
-	m_pShaderManager->setFloatValue("spotLight.quadratic", 0.005f); // Further reduced quadratic term for greater reach
-	m_pShaderManager->setFloatValue("spotLight.cutOff", glm::cos(glm::radians(110.0f))); // Wide inner angle for full scene coverage
-	m_pShaderManager->setFloatValue("spotLight.outerCutOff", glm::cos(glm::radians(130.0f))); // Even wider outer angle for soft edges
-	m_pShaderManager->setBoolValue("spotLight.bActive", true);
+	for (size_t i = 0; i < reloadedTextures.size(); i++)
+	{
+		int slot = FindTextureSlot(reloadedTextures[i].tag);
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource;
+		if (slot >= 0)
+		{
+			resource = CreateTextureResource(reloadedTextures[i], slot);
+		}
+		delete reloadedTextures[i].processed;
+		if (!resource)
+		{
+			continue;
+		}
+
+		SetTextureSlot(slot, reloadedTextures[i].tag, resource);
+		glActiveTexture(GL_TEXTURE0 + slot);
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[slot].ID);
+	}
 
+	// a newer edit replaces a build that has not completed
+	if (bShaderSourcesRead)
+	{
+		m_shaderCompiler->Start("scene shaders", vertexSource, fragmentSource);
+		m_reloadVertexSource.swap(vertexSource);
+		m_reloadFragmentSource.swap(fragmentSource);
+	}
+	if (m_shaderCompiler->IsComplete())
+	{
+		GLuint program = m_shaderCompiler->Finish();
+		if (program == 0)
+		{
+			std::cout << "Keeping the previous shader program" << std::endl;
+			return;
+		}
 
+		// the new program is given the uniforms set once for the
+		// scene when it is made current, and the variants are
+		// built again from the edited sources with its lights
+		GLuint previousProgram = m_baseProgram;
+		m_baseProgram = program;
+		m_shaderVariants->SetSources("scene shaders", m_reloadVertexSource, m_reloadFragmentSource);
+		m_programFrames.clear();
+		UseShaderProgram(m_baseProgram);
+		glDeleteProgram(previousProgram);
+		BakeSceneLights();
+		std::cout << "Reloaded shader program" << std::endl;
+	}
 }
 
 /***********************************************************
@@ -546,6 +2945,49 @@ void SceneManager::PrepareScene()
 	DefineObjectMaterials();
 	// add and define the light sources for the scene
 	SetupSceneLights();
+	// place the candles and fairy lights, which are not baked as
+	// they are read from the clusters of the view
+	m_clusteredLights->Initialize(g_LightClusterShaderFile);
+	if (m_clusteredLights->IsSupported())
+	{
+		m_objectLightLists->Initialize();
+	}
+	SetupLocalLights();
+	// create the G-buffer the deferred frames are drawn into
+	m_deferredShading->Initialize();
+	// create the shadow maps, which are drawn once the objects that
+	// cast the shadows are known
+	m_shadowMaps->Initialize();
+	// the lightmaps are baked from the triangles of the first frames,
+	// or loaded from their cache file
+	if (!m_sceneCapture->Initialize())
+	{
+		std::cout << "Transform feedback layouts are not supported - the scene lights are not baked" << std::endl;
+	}
+	m_lightmapBaker->Initialize(g_LightmapCacheFile);
+	m_occlusionBaker->Initialize();
+	m_irradianceProbes->Initialize();
+	m_reflectionProbes->Initialize(g_ReflectionCacheFile);
+	// the transparent objects are sorted when the weighted sums
+	// cannot be drawn
+	if (!m_transparencyPass->Initialize())
+	{
+		m_transparencyMode = sortedTransparency;
+	}
+	// the depth pre-pass is only drawn when asked for if the passes
+	// cannot be timed to choose it
+	if (!m_depthPrepass->Initialize())
+	{
+		m_depthPrepassMode = noDepthPrepass;
+	}
+	// the frames are drawn at the window resolution when they cannot be
+	// drawn into a scaled target
+	if (!m_resolutionScaler->Initialize())
+	{
+		m_resolutionMode = nativeResolution;
+	}
+	// compile the lights into the program variants
+	BakeSceneLights();
 
 	// only one instance of a particular mesh needs to be
 	// loaded in memory no matter how many times it is drawn
@@ -562,6 +3004,14 @@ void SceneManager::PrepareScene()
 	m_basicMeshes->LoadTorusMesh();
 	m_basicMeshes->LoadHexagonMesh();
 
+	// the multi-material meshes are used for the capped objects
+	// that need a different texture on some of their faces
+	m_faceMeshes->LoadBoxMesh();
+	m_faceMeshes->LoadCylinderMesh();
+	m_faceMeshes->LoadTaperedCylinderMesh();
+
+	// import the detailed meshes and build their levels of detail
+	LoadSceneMeshes();
 }
 
 /***********************************************************
@@ -571,6 +3021,103 @@ void SceneManager::PrepareScene()
  *  transforming and drawing the basic 3D shapes
  ***********************************************************/
 void SceneManager::RenderScene()
+{
+	// bind any textures that finished loading in the background
+	UpdateStreamedTextures();
+	// use the program variants that finished building
+	m_shaderVariants->Update();
+
+	// draw the shadow map of one changed light, then start gathering
+	// the casters of this frame
+	UpdateShadowMaps();
+	m_shadowMaps->BindTextures();
+	// capture the scene once, baking the occlusion of its vertices
+	// and then its lightmaps on the worker threads while the shader
+	// lights the frames
+	CaptureScene();
+	if (m_bUseLightmaps)
+	{
+		m_lightmapBaker->Update(m_threadPool);
+		m_lightmapBaker->BindTexture();
+	}
+	m_occlusionBaker->BindTexture();
+	// the probes around a change of the scene or the lights are baked
+	// again on the worker threads
+	m_irradianceProbes->Update(m_threadPool);
+	m_irradianceProbes->BindTexture();
+	// the reflections are drawn once the scene is lit, or loaded from
+	// their cache file
+	UpdateReflectionProbes();
+	m_reflectionProbes->BindTexture();
+	m_lightmapBaker->BeginFrame();
+	m_occlusionBaker->BeginFrame();
+	m_casterHash = ResourceRegistry::HashBytes(NULL, 0);
+	m_casterMin = glm::vec3(std::numeric_limits<float>::max());
+	m_casterMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	// a deferred frame draws the objects into the G-buffer and lights
+	// them afterwards - until its programs are built the frames are
+	// shaded forward
+	m_bDeferredFrame = (m_renderPath == deferredShading) && DeferredProgramsReady();
+	// a forward frame may draw the depth of the opaque objects first,
+	// so only the nearest fragment of every pixel is lit - when it is
+	// chosen automatically, while the fragments it saves cost more
+	// than the pass
+	bool bPrepassWorthwhile = m_depthPrepass->BeginFrame();
+	m_bPrepassFrame = !m_bDeferredFrame && (m_depthPrepassMode != noDepthPrepass) &&
+		((m_depthPrepassMode == alwaysDepthPrepass) || bPrepassWorthwhile) && DepthPrepassProgramReady();
+	if (m_bDeferredFrame)
+	{
+		m_deferredShading->BeginGeometryPass();
+	}
+	else
+	{
+		BeginForwardLights();
+		if (m_bPrepassFrame)
+		{
+			DrawDepthPrepass();
+		}
+		m_depthPrepass->BeginColorPass(m_bPrepassFrame);
+	}
+
+	DrawSceneObjects();
+
+	if (!m_bDeferredFrame)
+	{
+		m_depthPrepass->EndColorPass();
+	}
+	else
+	{
+		ShadeDeferredFrame();
+		m_bDeferredFrame = false;
+		// the transparent objects are lit forward over the lit pixels
+		if (!m_blendedObjects.empty())
+		{
+			BeginForwardLights();
+		}
+	}
+	DrawBlendedObjects();
+
+	// the maps are drawn again when the casters have changed
+	m_shadowMaps->SetCasters(m_casterHash, m_casterMin, m_casterMax);
+
+	// a frame drawn at a lower resolution is filtered up to the window
+	GLuint upscaleProgram = 0;
+	if (m_resolutionScaler->IsFrameScaled())
+	{
+		upscaleProgram = m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::resolutionUpscale, 0));
+		UseShaderProgram(upscaleProgram);
+	}
+	m_resolutionScaler->EndFrame(upscaleProgram);
+}
+
+/***********************************************************
+ *  DrawSceneObjects()
+ *
+ *  This method is used for drawing every object of the 3D
+ *  scene, for the camera or into a shadow map.
+ ***********************************************************/
+void SceneManager::DrawSceneObjects()
 {
 	RenderTable();
 	RenderCologneBottle();
@@ -583,6 +3130,292 @@ void SceneManager::RenderScene()
 	RenderBrownVowBook();
 }
 
+/***********************************************************
+ *  DrawDepthPrepass()
+ *
+ *  This method is used for drawing the opaque objects into
+ *  the depth buffer alone, before they are drawn in color
+ *  where they are the nearest.  The meshes are read from
+ *  their positions only, and the see through objects are
+ *  left out so they do not hide what is behind them.
+ ***********************************************************/
+void SceneManager::DrawDepthPrepass()
+{
+	m_bDepthPrepass = true;
+	m_faceMeshes->SetPositionOnly(true);
+	m_meshCache->SetPositionOnly(true);
+	m_depthPrepass->BeginPrepass();
+	DrawSceneObjects();
+	m_depthPrepass->EndPrepass();
+	m_faceMeshes->SetPositionOnly(false);
+	m_meshCache->SetPositionOnly(false);
+	m_bDepthPrepass = false;
+}
+
+/***********************************************************
+ *  DrawBlendedObjects()
+ *
+ *  This method is used for drawing the transparent objects
+ *  that were kept while the opaque objects were drawn.  The
+ *  frames of the camera add them to the weighted sums in
+ *  the order they were kept, once the programs are built.
+ *  Otherwise they are sorted by their distance along the
+ *  view and blended from the farthest.  Neither writes the
+ *  depth, so the objects behind a transparent one are not
+ *  hidden by it.
+ ***********************************************************/
+void SceneManager::DrawBlendedObjects()
+{
+	m_sortMilliseconds = 0.0;
+	if (m_blendedObjects.empty())
+	{
+		return;
+	}
+
+	m_bWeightedBlending = !m_bReflectionPass && (m_transparencyMode == weightedBlendedTransparency) &&
+		m_transparencyPass->IsSupported() && TransparencyProgramsReady();
+	std::vector<uint32_t> order;
+	if (m_bWeightedBlending)
+	{
+		order.resize(m_blendedObjects.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = (uint32_t)i;
+		}
+		m_transparencyPass->BeginAccumulation();
+	}
+	else
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<float> distances(m_blendedObjects.size());
+		for (size_t i = 0; i < distances.size(); i++)
+		{
+			distances[i] = -(m_viewMatrix * glm::vec4(m_blendedObjects[i].position, 1.0f)).z;
+		}
+		TransparencyPass::SortBackToFront(distances, order);
+		std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+		m_sortMilliseconds = time.count();
+		glDepthMask(GL_FALSE);
+	}
+
+	m_bTransparentPass = true;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		DrawBlendedObject(m_blendedObjects[order[i]]);
+	}
+	m_bTransparentPass = false;
+	m_blendedObjects.clear();
+
+	if (m_bWeightedBlending)
+	{
+		GLuint program = m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::transparencyComposite, 0));
+		UseShaderProgram(program);
+		m_transparencyPass->Composite(program);
+		m_bWeightedBlending = false;
+	}
+	else
+	{
+		glDepthMask(GL_TRUE);
+	}
+}
+
+/***********************************************************
+ *  DrawBlendedObject()
+ *
+ *  This method is used for drawing a kept transparent
+ *  object with the values it was set up with.  Its program
+ *  is selected first, so the values are set on it, and its
+ *  baked light is selected by the drawing order it was
+ *  kept at.
+ ***********************************************************/
+void SceneManager::DrawBlendedObject(const BLENDED_OBJECT& object)
+{
+	ClearShaderFaceMaterials();
+	m_modelMatrix = object.modelMatrix;
+	m_uvScale = object.uvScale;
+	m_objectPosition = object.position;
+	m_objectScale = object.scale;
+	if (object.textureTag.empty())
+	{
+		SetShaderColor(object.color.r, object.color.g, object.color.b, object.color.a);
+	}
+	else
+	{
+		SetShaderTexture(object.textureTag);
+	}
+	SetShaderMaterial(object.materialTag);
+	m_pShaderManager->setMat4Value(g_ModelName, m_modelMatrix);
+	m_pShaderManager->setVec2Value(g_UVScaleName, m_uvScale);
+
+	m_lightmapBaker->SelectObject(object.bakedObject, object.transformHash);
+	m_occlusionBaker->SelectObject(object.bakedObject, object.transformHash);
+	SetObjectLighting(object.position, object.radius);
+
+	object.drawMesh();
+}
+
+/***********************************************************
+ *  UpdateShadowMaps()
+ *
+ *  This method is used for drawing the objects into the
+ *  shadow map of one light that has changed, a face at a
+ *  time.  The levels of detail are selected for the view
+ *  of the light while the map is drawn.
+ ***********************************************************/
+void SceneManager::UpdateShadowMaps()
+{
+	GLuint program = m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::shadowPass, 0));
+	if ((program == 0) || !m_shadowMaps->BeginUpdate())
+	{
+		return;
+	}
+
+	glm::vec3 cameraPosition = m_cameraPosition;
+	float projectionScale = m_projectionScale;
+	int viewportHeight = m_viewportHeight;
+	m_cameraPosition = m_shadowMaps->GetUpdatePosition();
+	m_projectionScale = m_shadowMaps->GetUpdateProjection()[1][1];
+	m_viewportHeight = m_shadowMaps->GetUpdateMapSize();
+
+	// the shadow maps only read the positions of the meshes
+	m_bShadowPass = true;
+	m_faceMeshes->SetPositionOnly(true);
+	m_meshCache->SetPositionOnly(true);
+	UseShaderProgram(program);
+	for (int face = 0; face < m_shadowMaps->GetFaceCount(); face++)
+	{
+		m_shadowMaps->BeginFace(face, program);
+		DrawSceneObjects();
+	}
+	m_faceMeshes->SetPositionOnly(false);
+	m_meshCache->SetPositionOnly(false);
+	m_bShadowPass = false;
+	m_shadowMaps->EndUpdate();
+
+	m_cameraPosition = cameraPosition;
+	m_projectionScale = projectionScale;
+	m_viewportHeight = viewportHeight;
+}
+
+/***********************************************************
+ *  UpdateReflectionProbes()
+ *
+ *  This method is used for drawing the objects into the
+ *  faces of every reflection probe, with the lit programs
+ *  given the view of each face as their camera.  The probes
+ *  are drawn once the scene they show is complete - every
+ *  texture loaded, the shadow maps drawn and the baked
+ *  light of the scene finished - so the cache file does not
+ *  keep a half lit scene.
+ ***********************************************************/
+void SceneManager::UpdateReflectionProbes()
+{
+	if (!m_reflectionProbes->NeedsUpdate() || !m_shadowMaps->IsUpdated())
+	{
+		return;
+	}
+	if ((NULL != m_textureUploader) && (m_textureUploader->GetPendingUploads() > 0))
+	{
+		return;
+	}
+	if ((m_bUseLightmaps && m_lightmapBaker->IsBaking()) ||
+		(m_irradianceProbes->IsSupported() && !m_irradianceProbes->IsReady()))
+	{
+		return;
+	}
+	uint32_t features = GetReflectionPassFeatures();
+	if ((m_shaderVariants->GetProgram(ShaderVariants::MakeKey(features | ShaderVariants::textured, m_pointLightMask)) == 0) ||
+		(m_shaderVariants->GetProgram(ShaderVariants::MakeKey(features, m_pointLightMask)) == 0) ||
+		!m_reflectionProbes->BeginUpdate())
+	{
+		return;
+	}
+
+	glm::mat4 viewMatrix = m_viewMatrix;
+	glm::mat4 projectionMatrix = m_projectionMatrix;
+	glm::vec3 cameraPosition = m_cameraPosition;
+	float projectionScale = m_projectionScale;
+	int viewportHeight = m_viewportHeight;
+	m_projectionMatrix = m_reflectionProbes->GetFaceProjection();
+	m_projectionScale = m_projectionMatrix[1][1];
+	m_viewportHeight = m_reflectionProbes->GetFaceSize();
+
+	m_bReflectionPass = true;
+	for (int probe = 0; probe < m_reflectionProbes->GetProbeCount(); probe++)
+	{
+		m_cameraPosition = m_reflectionProbes->GetProbePosition(probe);
+		for (int face = 0; face < m_reflectionProbes->GetFaceCount(); face++)
+		{
+			// every face is a frame of its own for the programs
+			m_viewMatrix = m_reflectionProbes->GetFaceView(probe, face);
+			m_frame++;
+			m_reflectionProbes->BeginFace(probe, face);
+			m_lightmapBaker->BeginFrame();
+			m_occlusionBaker->BeginFrame();
+			DrawSceneObjects();
+			DrawBlendedObjects();
+			m_reflectionProbes->EndFace();
+		}
+	}
+	m_bReflectionPass = false;
+	m_reflectionProbes->EndUpdate(m_threadPool);
+
+	m_viewMatrix = viewMatrix;
+	m_projectionMatrix = projectionMatrix;
+	m_cameraPosition = cameraPosition;
+	m_projectionScale = projectionScale;
+	m_viewportHeight = viewportHeight;
+	m_frame++;
+}
+
+/***********************************************************
+ *  CaptureScene()
+ *
+ *  This method is used for reading back the triangles of
+ *  the scene for baking the occlusion of its vertices and
+ *  its lightmaps, once its program is built.  The finest
+ *  levels of detail are captured so the bakes do not depend
+ *  on the view.
+ ***********************************************************/
+void SceneManager::CaptureScene()
+{
+	if (!m_sceneCapture->IsSupported() || m_sceneCapture->IsCaptured())
+	{
+		return;
+	}
+	GLuint program = m_shaderVariants->GetProgram(ShaderVariants::MakeKey(ShaderVariants::sceneCapture, 0));
+	if (program == 0)
+	{
+		return;
+	}
+
+	float projectionScale = m_projectionScale;
+	m_projectionScale = std::numeric_limits<float>::max();
+
+	m_bCapturePass = true;
+	UseShaderProgram(program);
+	bool bCaptured = true;
+	for (int pass = 0; pass < m_sceneCapture->GetPassCount(); pass++)
+	{
+		m_sceneCapture->BeginPass(pass);
+		DrawSceneObjects();
+		bCaptured = m_sceneCapture->EndPass() && bCaptured;
+	}
+	m_bCapturePass = false;
+
+	m_projectionScale = projectionScale;
+
+	if (bCaptured)
+	{
+		std::cout << "Captured " << m_sceneCapture->GetVertices().size() / 3 << " triangles of "
+			<< m_sceneCapture->GetObjects().size() << " objects for baking" << std::endl;
+		m_occlusionBaker->SetScene(*m_sceneCapture, m_threadPool);
+		m_lightmapBaker->SetScene(*m_sceneCapture);
+		m_irradianceProbes->SetScene(*m_sceneCapture);
+		m_reflectionProbes->SetScene(*m_sceneCapture);
+	}
+}
+
 
 
 /***********************************************************
@@ -659,7 +3492,7 @@ void SceneManager::RenderCologneBottle()
 	SetShaderTexture("blue_glass");
 	SetShaderMaterial("glass");
 
-	m_basicMeshes->DrawBoxMesh();
+	DrawTransparentMesh([this]() { m_basicMeshes->DrawBoxMesh(); });
 
 	// --- Gold Sphere (Center of the Blue Box) ---
 	scaleXYZ = glm::vec3(0.75f, 0.75f, 0.3f);  // Scaled up by 1.5
@@ -695,9 +3528,8 @@ void SceneManager::RenderCologneBottle()
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("gold");
 	SetShaderMaterial("metal");
-	m_basicMeshes->DrawCylinderMesh(false, true, true);
-	SetShaderTexture("versace");
-	m_basicMeshes->DrawCylinderMesh(true, false, false);  // Using different texture for the top of the cylinder
+	SetShaderFaceMaterial(FaceMaterialMeshes::top, "versace", "metal");  // Using different texture for the top of the cylinder
+	m_faceMeshes->DrawCylinderMesh();
 #pragma endregion
 
 }
@@ -727,7 +3559,7 @@ void SceneManager::RenderPerfumeBottle()
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("perfume");
 	SetShaderMaterial("glass");
-	m_basicMeshes->DrawBoxMesh();
+	DrawTransparentMesh([this]() { m_basicMeshes->DrawBoxMesh(); });
 
 	// --- Red Label ---
 	scaleXYZ = glm::vec3(1.3f, 2.0f, 2.5f);  
@@ -759,18 +3591,10 @@ void SceneManager::RenderPerfumeBottle()
 	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
 	SetShaderTexture("gold");
 	SetShaderMaterial("metal");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
 
 	// Draw the top with a different texture
-	SetShaderMaterial("metal");
-	SetShaderTexture("versace");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);  // Different texture for top of cap
-
-
+	SetShaderFaceMaterial(FaceMaterialMeshes::top, "versace", "metal");  // Different texture for top of cap
+	m_faceMeshes->DrawBoxMesh();
 }
 
 /***********************************************************
@@ -848,17 +3672,9 @@ void SceneManager::RenderNecklaceBox()
 	SetShaderTexture("green_felt");
 	SetShaderMaterial("felt");
 
-	// Draw the sides of the cap
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::bottom);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::right);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::left);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::back);
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::front);
-
 	// Draw the top with a different texture
-	SetShaderMaterial("felt");
-	SetShaderTexture("black_felt");
-	m_basicMeshes->DrawBoxMeshSide(ShapeMeshes::BoxSide::top);
+	SetShaderFaceMaterial(FaceMaterialMeshes::top, "black_felt", "felt");
+	m_faceMeshes->DrawBoxMesh();
 
 	// --- Necklace Platform ---
 	scaleXYZ = glm::vec3(4.3f, 0.2f, 4.3f);
@@ -1103,7 +3919,7 @@ void SceneManager::RenderRingBox()
 	//SetShaderColor(0.4f, 0.7f, 1.0f, 1.0f); // Light blue color
 	SetShaderTexture("blue_glass");
 	SetShaderMaterial("glass");
-	m_basicMeshes->DrawBoxMesh();
+	DrawTransparentMesh([this]() { m_basicMeshes->DrawBoxMesh(); });
 
 	// --- Bride Engagement Ring --- // 
 	scaleXYZ = glm::vec3(.8f, 1.f, .8f);
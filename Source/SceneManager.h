@@ -11,8 +11,38 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "AssetPack.h"
+#include "ClusteredLights.h"
+#include "DeferredShading.h"
+#include "DepthPrepass.h"
+#include "FaceMaterialMeshes.h"
+#include "FileWatcher.h"
+#include "ImageDecoder.h"
+#include "ImageProcessing.h"
+#include "LightmapBaker.h"
+#include "MeshCache.h"
+#include "IrradianceProbes.h"
+#include "ObjectLightLists.h"
+#include "OcclusionBaker.h"
+#include "ReflectionProbes.h"
+#include "ResolutionScaler.h"
+#include "ResourceRegistry.h"
+#include "SceneCapture.h"
+#include "ShaderCompiler.h"
+#include "ShaderVariants.h"
+#include "ShadowMaps.h"
+#include "TextureAtlas.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "TextureUploader.h"
+#include "ThreadPool.h"
+#include "TransparencyPass.h"
 
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 /***********************************************************
@@ -24,15 +54,93 @@
 class SceneManager
 {
 public:
-	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	// constructor - textures are uploaded in the background when
+	// the display window is passed in for sharing its context
+	SceneManager(ShaderManager *pShaderManager, GLFWwindow* pWindow = NULL);
 	// destructor
 	~SceneManager();
 
+	// global texture quality presets - each step below high halves
+	// the resolution every texture is loaded at
+	enum TextureQuality
+	{
+		high,
+		medium,
+		low,
+		lowest
+	};
+
+	// how the lights are applied to the objects - while they are drawn,
+	// or afterwards from a G-buffer
+	enum RenderPath
+	{
+		forwardShading,
+		deferredShading
+	};
+
+	// how a forward shaded fragment finds the local lights that reach
+	// it - from the list of its cluster of the view, or of its object
+	enum LightListMode
+	{
+		clusterLightLists,
+		objectLightLists
+	};
+
+	// how the transparent objects are blended over the opaque ones -
+	// into weighted sums that need no order, or one by one from the
+	// farthest
+	enum TransparencyMode
+	{
+		weightedBlendedTransparency,
+		sortedTransparency
+	};
+
+	// whether the forward frames draw the depth of the opaque objects
+	// before lighting them - never, always, or while it saves more
+	// fragments than it costs
+	enum DepthPrepassMode
+	{
+		noDepthPrepass,
+		alwaysDepthPrepass,
+		automaticDepthPrepass
+	};
+
+	// the resolution the frames are drawn at - the window resolution, a
+	// fixed scale of it, or the scale that keeps the frames within their
+	// frame time
+	enum ResolutionMode
+	{
+		nativeResolution,
+		fixedResolution,
+		dynamicResolution
+	};
+
 	struct TEXTURE_INFO
 	{
 		std::string tag;
 		uint32_t ID;
+		// the shared texture, NULL for the atlas pages
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource;
+	};
+
+	// a texture image file and its decoded texels
+	struct TEXTURE_IMAGE
+	{
+		std::string filename;
+		std::string tag;
+		// the RGBA mip chain built from the image file
+		ImageProcessing::PROCESSED_IMAGE* processed;
+		int width;
+		int height;
+		// largest width or height the texture is loaded at, 0 for no
+		// limit - larger images skip their largest levels
+		int maxResolution;
+		// the block compressed mips, used instead of the RGBA mips
+		TextureCache::COMPRESSED_TEXTURE* compressed;
+		// hash of the image file, and the texture already loaded from
+		// the same content, which is used instead of decoding
+		uint64_t contentHash;
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource;
 	};
 
 	struct OBJECT_MATERIAL
@@ -43,20 +151,188 @@ public:
 		std::string tag;
 	};
 
+	// a transparent object kept for drawing after the opaque ones, with
+	// the values it was set up with
+	struct BLENDED_OBJECT
+	{
+		glm::mat4 modelMatrix;
+		glm::vec3 position;
+		float scale;
+		float radius;
+		// the drawing order and transform that select its baked light
+		int bakedObject;
+		uint64_t transformHash;
+		// the texture, or the color when there is none
+		std::string textureTag;
+		glm::vec4 color;
+		glm::vec2 uvScale;
+		std::string materialTag;
+		std::function<void()> drawMesh;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// pointer to basic shapes object
 	ShapeMeshes* m_basicMeshes;
+	// pointer to multi-material shapes object
+	FaceMaterialMeshes* m_faceMeshes;
+	// true when a per-face material table has been set for the current object
+	bool m_bFaceMaterialsSet;
 	// total number of loaded textures
 	int m_loadedTextures;
 	// loaded textures info
 	TEXTURE_INFO m_textureIDs[16];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// worker threads used for importing assets
+	ThreadPool* m_threadPool;
+	// imported meshes and their level-of-detail chains
+	MeshCache* m_meshCache;
+	// background texture loader, NULL when textures load in place
+	TextureUploader* m_textureUploader;
+	// compressed texture cache, NULL when block compression is unsupported
+	TextureCache* m_textureCache;
+	// mip level residency of the compressed textures, NULL with the cache
+	TextureStreamer* m_textureStreamer;
+	// levels every texture skips, from the quality preset
+	int m_textureQuality;
+	// pages of textures packed together
+	TextureAtlas* m_textureAtlas;
+	// camera values used for selecting the level of detail
+	glm::vec3 m_cameraPosition;
+	float m_projectionScale;
+	int m_viewportHeight;
+	// scale and position of the last transformed object, and the
+	// sphere and transform hash its baked light is found by
+	float m_objectScale;
+	glm::vec3 m_objectPosition;
+	float m_objectRadius;
+	uint64_t m_objectTransformHash;
+	// the texture of the last drawn object, or its color when it is
+	// not textured
+	std::string m_objectTextureTag;
+	glm::vec4 m_objectColor;
+	// the unspecialized program loaded by the shader manager, and its
+	// variants specialized for the features of each draw
+	GLuint m_baseProgram;
+	ShaderVariants* m_shaderVariants;
+	// the candles and fairy lights, drawn through the clusters of the view
+	ClusteredLights* m_clusteredLights;
+	int m_localLightCount;
+	// the lights that reach each drawn object, and whether the forward
+	// frames are lit from them instead of the clusters
+	ObjectLightLists* m_objectLightLists;
+	LightListMode m_lightListMode;
+	// the G-buffer of deferred shading, the selected render path, and
+	// whether the current frame is shaded deferred
+	DeferredShading* m_deferredShading;
+	RenderPath m_renderPath;
+	bool m_bDeferredFrame;
+	// the cached shadow maps of the scene lights, and whether the
+	// objects are being drawn into one
+	ShadowMaps* m_shadowMaps;
+	bool m_bShadowPass;
+	// hash and world bounds of the objects drawn in the current frame,
+	// which cast the shadows
+	uint64_t m_casterHash;
+	glm::vec3 m_casterMin;
+	glm::vec3 m_casterMax;
+	// the triangles of the scene read back for the lightmaps, and
+	// whether the objects are being drawn into the capture
+	SceneCapture* m_sceneCapture;
+	bool m_bCapturePass;
+	// the lightmaps of the scene lights, and whether the forward frames
+	// are lit from them once they are baked
+	LightmapBaker* m_lightmapBaker;
+	bool m_bUseLightmaps;
+	// the ambient occlusion baked for the vertices of the objects
+	OcclusionBaker* m_occlusionBaker;
+	// the ambient light of the scene baked into a grid of probes
+	IrradianceProbes* m_irradianceProbes;
+	// the scene drawn into cube maps for the reflective materials, and
+	// whether the objects are being drawn into one
+	ReflectionProbes* m_reflectionProbes;
+	bool m_bReflectionPass;
+	// the targets of the transparent objects, the selected mode, the
+	// objects kept for drawing after the opaque ones, and whether they
+	// are being drawn - into the weighted sums or one by one
+	TransparencyPass* m_transparencyPass;
+	TransparencyMode m_transparencyMode;
+	std::vector<BLENDED_OBJECT> m_blendedObjects;
+	bool m_bTransparentPass;
+	bool m_bWeightedBlending;
+	double m_sortMilliseconds;
+	// the measurements of the depth pre-pass, the selected mode, whether
+	// the objects are being drawn into it, and whether the current frame
+	// drew it
+	DepthPrepass* m_depthPrepass;
+	DepthPrepassMode m_depthPrepassMode;
+	bool m_bDepthPrepass;
+	bool m_bPrepassFrame;
+	// the scaled target of the frames, the selected mode, and the window
+	// the frames are filtered up to
+	ResolutionScaler* m_resolutionScaler;
+	ResolutionMode m_resolutionMode;
+	GLFWwindow* m_pWindow;
+	// variant features of the scene lights, and their active point lights
+	uint32_t m_lightFeatures;
+	uint32_t m_pointLightMask;
+	// camera matrices of the current frame, and the frame each program
+	// last received them on
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	unsigned int m_frame;
+	std::unordered_map<GLuint, unsigned int> m_programFrames;
+	// the uniforms that stay set across objects, which a program that
+	// is switched to receives again
+	glm::mat4 m_modelMatrix;
+	glm::vec2 m_uvScale;
+	OBJECT_MATERIAL m_material;
+	// watcher of the loose asset files, NULL when they are not watched
+	FileWatcher* m_fileWatcher;
+	// the image of every loaded texture file by its asset name, for
+	// reloading the texture when the file changes
+	std::map<std::string, TEXTURE_IMAGE> m_textureFiles;
+	// the shader files of the scene program, and the build of their edits
+	std::string m_vertexShaderFile;
+	std::string m_fragmentShaderFile;
+	ShaderCompiler* m_shaderCompiler;
+	// edited assets read on the worker threads, swapped in at the
+	// start of the next frame
+	std::mutex m_reloadMutex;
+	std::vector<TEXTURE_IMAGE> m_reloadedTextures;
+	bool m_bShaderSourcesRead;
+	std::string m_vertexShaderSource;
+	std::string m_fragmentShaderSource;
+	// the sources of the shader build in progress
+	std::string m_reloadVertexSource;
+	std::string m_reloadFragmentSource;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
+	// load a list of texture images, decoding them in parallel
+	int CreateGLTextures(std::vector<TEXTURE_IMAGE>& images);
+	// read the pixels of a texture image file - safe on worker threads
+	bool DecodeTextureImage(TEXTURE_IMAGE& image, bool bUseCache = true);
+	// decode an image file into RGBA levels in the OpenGL row order
+	bool ProcessTextureImage(TEXTURE_IMAGE& image, int maxLevels);
+	// upload decoded pixels into a new OpenGL texture
+	GLuint UploadGLTexture(TEXTURE_IMAGE& image);
+	// get the shared texture of a decoded image, uploading it or
+	// handing its compressed mips to the texture streamer
+	std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> CreateTextureResource(TEXTURE_IMAGE& image, int slot);
+	// put a shared texture in a slot
+	void SetTextureSlot(int slot, std::string tag, std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource);
+	// load a list of texture images in the background
+	void StreamGLTextures(std::vector<TEXTURE_IMAGE>& images);
+	// hand a decoded texture image to the texture uploader for a
+	// slot - run on a worker thread
+	void QueueTextureUpload(TEXTURE_IMAGE& image, int slot);
+	// bind the textures that finished loading in the background
+	void UpdateStreamedTextures();
+	// load a list of texture images packed into atlas pages
+	bool CreateTextureAtlas(std::vector<TEXTURE_IMAGE>& images);
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
@@ -64,8 +340,63 @@ private:
 	// find a loaded texture by tag
 	int FindTextureID(std::string tag);
 	int FindTextureSlot(std::string tag);
+	// find the slot and UV rectangle of a texture, which may be in the atlas
+	int FindTextureLocation(std::string tag, glm::vec4& uvRect);
+	// record the projected size of the texture in a slot for streaming
+	void RecordTextureUse(int slot);
 	// find a defined material by tag
 	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	// read an edited texture file on a worker thread for its slot
+	void ReloadTextureFile(const TEXTURE_IMAGE& source);
+	// read the edited shader files on a worker thread
+	void ReloadShaderFiles();
+	// compile the light values set on the unspecialized program into
+	// the lit variants
+	void BakeSceneLights();
+	// draw the next object with the variant for its features
+	void SelectShaderVariant(bool bTextured);
+	// get the variant features of the lights of the forward frames
+	uint32_t GetForwardLightFeatures() const;
+	// get the variant features of the faces of the reflection probes
+	uint32_t GetReflectionPassFeatures() const;
+	// make a program current, giving it the uniforms it has missed
+	void UseShaderProgram(GLuint program);
+	// start the local light lists of a frame that is shaded forward
+	void BeginForwardLights();
+	// set the lights that reach the current object on its program
+	void SetObjectLighting(const glm::vec3& position, float radius);
+	// check if the programs of the weighted sums are built, starting
+	// the builds of the missing ones
+	bool TransparencyProgramsReady();
+	// draw the transparent objects kept during the opaque ones
+	void DrawBlendedObjects();
+	void DrawBlendedObject(const BLENDED_OBJECT& object);
+	// check if the program of the depth pre-pass is built, starting its
+	// build when it is missing
+	bool DepthPrepassProgramReady();
+	// draw the depth of the opaque objects before they are lit
+	void DrawDepthPrepass();
+	// check if the program that filters the scaled frames up to the
+	// window is built, starting its build when it is missing
+	bool UpscaleProgramReady();
+	// place the local lights around the table
+	void SetupLocalLights();
+	// get the program variant of a deferred shading pass - 0 until it
+	// is built
+	GLuint GetDeferredProgram(ShaderVariants::VariantFeature pass, bool bTextured);
+	// check if every deferred shading program is built, starting the
+	// builds of the missing ones
+	bool DeferredProgramsReady();
+	// light the G-buffer of a deferred frame into the display window
+	void ShadeDeferredFrame();
+	// draw the next shadow map that does not match its light
+	void UpdateShadowMaps();
+	// draw the reflection probes once the scene they show is complete
+	void UpdateReflectionProbes();
+	// read back the triangles of the scene for the lightmaps
+	void CaptureScene();
+	// draw every object of the scene
+	void DrawSceneObjects();
 
 	// set the transformation values 
 	// into the transform buffer
@@ -95,6 +426,27 @@ private:
 	void SetShaderMaterial(
 		std::string materialTag);
 
+	// set a different texture and material for one face of
+	// the next drawn multi-material mesh
+	void SetShaderFaceMaterial(
+		FaceMaterialMeshes::MeshFace face,
+		std::string textureTag,
+		std::string materialTag);
+
+	// reset the per-face material table so all faces use the
+	// object texture and material
+	void ClearShaderFaceMaterials();
+
+	// draw an imported mesh at the level of detail selected for
+	// the last transformed object and the current camera
+	void DrawImportedMesh(
+		std::string meshTag);
+
+	// draw a mesh of a see through material, which is kept for
+	// after the opaque objects when they are drawn in color
+	void DrawTransparentMesh(
+		std::function<void()> drawMesh);
+
 public:
 
 	// prepare the 3D scene for rendering
@@ -102,8 +454,118 @@ public:
 	// render the objects in the 3D scene
 	void RenderScene();
 
+	// set the camera values used for the level of detail selection
+	// and by the shader program variants
+	void SetCameraView(
+		glm::mat4 view,
+		glm::mat4 projection,
+		glm::vec3 cameraPosition,
+		int viewportHeight);
+
+	// set the texture quality preset - call before the textures are loaded
+	void SetTextureQuality(TextureQuality quality);
+	// set the number of candles and fairy lights dressing the table
+	void SetLocalLightCount(int count);
+	// choose where the local lights are assigned to the clusters,
+	// returns false when the mode cannot be used
+	bool SetLightAssignMode(ClusteredLights::AssignMode mode);
+	// get the time the last assignment of the local lights took in
+	// milliseconds
+	double GetLightAssignTime() const;
+	// choose where the local light lists of the forward frames come
+	// from, returns false when the mode cannot be used
+	bool SetLightListMode(LightListMode mode);
+	LightListMode GetLightListMode() const;
+	// get the name of a light list mode for the console messages
+	static const char* GetLightListModeName(LightListMode mode);
+	// choose whether the scene lights of the forward frames are baked
+	// into lightmaps or lit by the shader
+	void SetUseLightmaps(bool bUseLightmaps);
+	// check if the triangles of the scene have been captured for baking
+	bool IsSceneCaptured() const;
+	// time baking the ambient occlusion of copies of the captured scene,
+	// returns false before the scene is captured
+	bool TimeOcclusionBake(int copies, size_t& vertexCount, double& milliseconds);
+	// choose how the lights are applied, returns false when the path
+	// cannot be used - the frames stay forward shaded until the
+	// deferred programs are built
+	bool SetRenderPath(RenderPath path);
+	RenderPath GetRenderPath() const;
+	// check if the frames are drawn with the chosen render path yet
+	bool IsRenderPathReady();
+	// get the name of a render path for the console messages
+	static const char* GetRenderPathName(RenderPath path);
+	// choose how the transparent objects are blended, returns false
+	// when the mode cannot be used - the objects are sorted until the
+	// programs of the weighted sums are built
+	bool SetTransparencyMode(TransparencyMode mode);
+	TransparencyMode GetTransparencyMode() const;
+	// check if the transparent objects are blended with the chosen
+	// mode yet
+	bool IsTransparencyModeReady();
+	// get the time the last sort of the transparent objects took in
+	// milliseconds
+	double GetTransparencySortTime() const;
+	// get the name of a transparency mode for the console messages
+	static const char* GetTransparencyModeName(TransparencyMode mode);
+	// choose whether the forward frames draw the depth pre-pass, returns
+	// false when the mode cannot be used - the pre-pass is not drawn
+	// until its program is built
+	bool SetDepthPrepassMode(DepthPrepassMode mode);
+	DepthPrepassMode GetDepthPrepassMode() const;
+	// check if the frames are drawn with the chosen mode yet
+	bool IsDepthPrepassModeReady();
+	// check if the last frame drew the depth pre-pass
+	bool IsDepthPrepassDrawn() const;
+	// get the lit fragments of the opaque objects for every visible
+	// one, and the time a lit fragment takes in nanoseconds, as last
+	// measured
+	double GetOverdrawRatio() const;
+	double GetFragmentCost() const;
+	// get the name of a depth pre-pass mode for the console messages
+	static const char* GetDepthPrepassModeName(DepthPrepassMode mode);
+	// bind the target the frame is drawn into, at the scale of the
+	// resolution mode - call before the frame is cleared
+	void BeginFrame();
+	// choose the resolution the frames are drawn at, returns false when
+	// the mode cannot be used - the frames are drawn at the window
+	// resolution until the program that filters them up is built
+	bool SetResolutionMode(ResolutionMode mode);
+	ResolutionMode GetResolutionMode() const;
+	// check if the frames are drawn with the chosen mode yet
+	bool IsResolutionModeReady();
+	// set the scale of the fixed mode, which the dynamic mode starts
+	// from
+	void SetResolutionScale(float scale);
+	// set the frame time the dynamic mode aims for in milliseconds, and
+	// the bounds of its scale
+	void SetFrameTimeTarget(double milliseconds);
+	double GetFrameTimeTarget() const;
+	void SetResolutionScaleBounds(float minScale, float maxScale);
+	// get the scale the last frame was drawn at, 1 for the window
+	// resolution
+	float GetResolutionScale() const;
+	// get the averaged GPU and CPU time of the frames in milliseconds
+	double GetGpuFrameTime() const;
+	double GetCpuFrameTime() const;
+	// get the name of a resolution mode for the console messages
+	static const char* GetResolutionModeName(ResolutionMode mode);
 	// load all of the needed textures before rendering
 	void LoadSceneTextures();
+	// import the mesh files and build their levels of detail
+	void LoadSceneMeshes();
+	// set the shader files of the program loaded by the shader manager,
+	// which its variants are built from - call before the scene is
+	// prepared
+	void SetShaderFiles(
+		const std::string& vertexShaderFile,
+		const std::string& fragmentShaderFile);
+	// watch the loaded texture files and the shader files for edits -
+	// call after the scene is prepared
+	void WatchAssetFiles();
+	// swap in the edited assets that finished loading - call at the
+	// start of every frame, before the view is set
+	void ReloadChangedAssets();
 	// define all the object materials before rendering
 	void DefineObjectMaterials();
 	// add and define the light sources before rendering
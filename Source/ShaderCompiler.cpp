@@ -0,0 +1,349 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadercompiler.cpp
+// ============
+// compile and link shader programs without stalling the render thread
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderCompiler.h"
+
+#include "AssetFile.h"
+#include "ProgramCache.h"
+
+#include <iostream>
+#include <vector>
+
+/***********************************************************
+ *  ShaderCompiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderCompiler::ShaderCompiler()
+{
+	m_vertexShader = 0;
+	m_fragmentShader = 0;
+	m_computeShader = 0;
+	m_program = 0;
+	m_bParallel = (GLEW_KHR_parallel_shader_compile != GL_FALSE);
+	m_cacheKey = 0;
+	m_bCached = false;
+
+	// let the driver pick how many threads compile the shaders
+	if (m_bParallel)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+}
+
+/***********************************************************
+ *  ~ShaderCompiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderCompiler::~ShaderCompiler()
+{
+	DeleteObjects();
+}
+
+/***********************************************************
+ *  DeleteObjects()
+ *
+ *  This method is used for deleting the shader and program
+ *  objects of an unfinished build.
+ ***********************************************************/
+void ShaderCompiler::DeleteObjects()
+{
+	if (m_vertexShader != 0)
+	{
+		glDeleteShader(m_vertexShader);
+		m_vertexShader = 0;
+	}
+	if (m_fragmentShader != 0)
+	{
+		glDeleteShader(m_fragmentShader);
+		m_fragmentShader = 0;
+	}
+	if (m_computeShader != 0)
+	{
+		glDeleteShader(m_computeShader);
+		m_computeShader = 0;
+	}
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
+
+/***********************************************************
+ *  LoadCachedProgram()
+ *
+ *  This method is used for loading the program of the build
+ *  from the program cache when it is opened and holds the
+ *  program of the same sources.
+ ***********************************************************/
+bool ShaderCompiler::LoadCachedProgram(const std::string& firstSource, const std::string& secondSource, uint64_t permutationKey)
+{
+	ProgramCache* pCache = ProgramCache::GetOpened();
+	if (pCache == NULL)
+	{
+		return false;
+	}
+
+	m_cacheKey = ProgramCache::MakeKey(firstSource, secondSource, permutationKey);
+	m_program = pCache->LoadProgram(m_cacheKey);
+	m_bCached = (m_program != 0);
+	return m_bCached;
+}
+
+/***********************************************************
+ *  LinkProgram()
+ *
+ *  This method is used for linking the attached shaders of
+ *  the build.  When the program cache is opened the binary
+ *  has to be made retrievable before linking, so it can be
+ *  saved once the build finishes.
+ ***********************************************************/
+void ShaderCompiler::LinkProgram()
+{
+	if (ProgramCache::GetOpened() != NULL)
+	{
+		glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(m_program);
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the build of a program.
+ *  The shaders are compiled and the program linked without
+ *  checking any status, which is what lets a parallel
+ *  compiling driver return right away.  A program that is
+ *  in the program cache is loaded instead, and is complete
+ *  at once.
+ ***********************************************************/
+void ShaderCompiler::Start(
+	const std::string& name,
+	const std::string& vertexSource,
+	const std::string& fragmentSource,
+	uint64_t permutationKey)
+{
+	DeleteObjects();
+	m_name = name;
+	m_bCached = false;
+
+	if (LoadCachedProgram(vertexSource, fragmentSource, permutationKey))
+	{
+		return;
+	}
+
+	const char* pVertexSource = vertexSource.c_str();
+	m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(m_vertexShader, 1, &pVertexSource, NULL);
+	glCompileShader(m_vertexShader);
+
+	const char* pFragmentSource = fragmentSource.c_str();
+	m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(m_fragmentShader, 1, &pFragmentSource, NULL);
+	glCompileShader(m_fragmentShader);
+
+	m_program = glCreateProgram();
+	glAttachShader(m_program, m_vertexShader);
+	glAttachShader(m_program, m_fragmentShader);
+	LinkProgram();
+}
+
+/***********************************************************
+ *  StartCompute()
+ *
+ *  This method is used for starting the build of a compute
+ *  program, the same way as the build of a program that
+ *  draws.
+ ***********************************************************/
+void ShaderCompiler::StartCompute(const std::string& name, const std::string& computeSource)
+{
+	DeleteObjects();
+	m_name = name;
+	m_bCached = false;
+
+	if (LoadCachedProgram(computeSource, std::string(), 0))
+	{
+		return;
+	}
+
+	const char* pComputeSource = computeSource.c_str();
+	m_computeShader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(m_computeShader, 1, &pComputeSource, NULL);
+	glCompileShader(m_computeShader);
+
+	m_program = glCreateProgram();
+	glAttachShader(m_program, m_computeShader);
+	LinkProgram();
+}
+
+/***********************************************************
+ *  IsBuilding()
+ *
+ *  This method is used for checking if a build is started
+ *  and has not been finished.
+ ***********************************************************/
+bool ShaderCompiler::IsBuilding() const
+{
+	return m_program != 0;
+}
+
+/***********************************************************
+ *  IsComplete()
+ *
+ *  This method is used for checking if the driver has
+ *  completed the started build, so finishing it will not
+ *  wait.
+ ***********************************************************/
+bool ShaderCompiler::IsComplete() const
+{
+	if (m_program == 0)
+	{
+		return false;
+	}
+	if (!m_bParallel || m_bCached)
+	{
+		return true;
+	}
+
+	GLint bComplete = GL_FALSE;
+	glGetProgramiv(m_program, GL_COMPLETION_STATUS_KHR, &bComplete);
+	return bComplete != GL_FALSE;
+}
+
+/***********************************************************
+ *  CheckShader()
+ *
+ *  This method is used for checking that a shader compiled,
+ *  printing its log when it did not.
+ ***********************************************************/
+bool ShaderCompiler::CheckShader(GLuint shader, const char* stage, const std::string& name)
+{
+	GLint bCompiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &bCompiled);
+	if (bCompiled != GL_FALSE)
+	{
+		return true;
+	}
+
+	GLint logLength = 0;
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+	std::vector<GLchar> log(logLength + 1, '\0');
+	glGetShaderInfoLog(shader, logLength, NULL, log.data());
+	std::cout << "Could not compile " << stage << " shader of " << name << ":" << std::endl << log.data() << std::endl;
+	return false;
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for checking the result of the build
+ *  and handing over the linked program.  A program that
+ *  failed to compile or link is deleted and 0 is returned,
+ *  after the logs are printed.  A compiled program is saved
+ *  to the program cache when it is opened.
+ ***********************************************************/
+GLuint ShaderCompiler::Finish()
+{
+	GLuint program = 0;
+
+	if (m_program == 0)
+	{
+		return 0;
+	}
+
+	// the cache checked the program when it was loaded
+	if (m_bCached)
+	{
+		program = m_program;
+		m_program = 0;
+		return program;
+	}
+
+	bool bCompiled = true;
+	if (m_vertexShader != 0)
+	{
+		bCompiled = CheckShader(m_vertexShader, "vertex", m_name) && bCompiled;
+	}
+	if (m_fragmentShader != 0)
+	{
+		bCompiled = CheckShader(m_fragmentShader, "fragment", m_name) && bCompiled;
+	}
+	if (m_computeShader != 0)
+	{
+		bCompiled = CheckShader(m_computeShader, "compute", m_name) && bCompiled;
+	}
+
+	GLint bLinked = GL_FALSE;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &bLinked);
+	if (bCompiled && (bLinked == GL_FALSE))
+	{
+		GLint logLength = 0;
+		glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<GLchar> log(logLength + 1, '\0');
+		glGetProgramInfoLog(m_program, logLength, NULL, log.data());
+		std::cout << "Could not link " << m_name << ":" << std::endl << log.data() << std::endl;
+	}
+
+	// the linked program keeps its code without the shaders
+	if (bCompiled && (bLinked != GL_FALSE))
+	{
+		if (m_vertexShader != 0)
+		{
+			glDetachShader(m_program, m_vertexShader);
+		}
+		if (m_fragmentShader != 0)
+		{
+			glDetachShader(m_program, m_fragmentShader);
+		}
+		if (m_computeShader != 0)
+		{
+			glDetachShader(m_program, m_computeShader);
+		}
+		program = m_program;
+		m_program = 0;
+
+		ProgramCache* pCache = ProgramCache::GetOpened();
+		if (pCache != NULL)
+		{
+			pCache->SaveProgram(m_cacheKey, program);
+		}
+	}
+	DeleteObjects();
+
+	return program;
+}
+
+/***********************************************************
+ *  WasCached()
+ *
+ *  This method is used for checking if the last program
+ *  that was started was loaded from the program cache.
+ ***********************************************************/
+bool ShaderCompiler::WasCached() const
+{
+	return m_bCached;
+}
+
+/***********************************************************
+ *  ReadSource()
+ *
+ *  This method is used for reading the text of a shader
+ *  source file.  It can be run on a worker thread.
+ ***********************************************************/
+bool ShaderCompiler::ReadSource(const std::string& filename, std::string& source)
+{
+	AssetFile file;
+	if (!file.Open(filename))
+	{
+		std::cout << "Could not read shader source:" << filename << std::endl;
+		return false;
+	}
+
+	source.assign((const char*)file.GetData(), file.GetSize());
+	return true;
+}
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadercompiler.h
+// ============
+// compile and link shader programs without stalling the render thread
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  ShaderCompiler
+ *
+ *  This class contains the code for building a shader
+ *  program from its vertex and fragment shader sources.
+ *  When the driver compiles in parallel the build is only
+ *  started, and polled once per frame until it completes,
+ *  so the frames keep rendering with the previous program.
+ *  Without parallel compiling the build completes on the
+ *  first poll.  When the program cache is opened a program
+ *  it holds is loaded instead of compiled, and a program
+ *  that is compiled is saved to it.
+ ***********************************************************/
+class ShaderCompiler
+{
+public:
+	// constructor
+	ShaderCompiler();
+	// destructor
+	~ShaderCompiler();
+
+	// the shader objects cannot be shared between two objects
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+private:
+	// name of the program for the console messages
+	std::string m_name;
+	GLuint m_vertexShader;
+	GLuint m_fragmentShader;
+	GLuint m_computeShader;
+	// the program being built, 0 when no build is started
+	GLuint m_program;
+	// true when the driver reports the completion of a build
+	bool m_bParallel;
+	// program cache key of the build, and true when the program was
+	// loaded from the cache
+	uint64_t m_cacheKey;
+	bool m_bCached;
+
+	// check the compile status of a shader, printing its log on failure
+	static bool CheckShader(GLuint shader, const char* stage, const std::string& name);
+	// delete the shader and program objects of the build
+	void DeleteObjects();
+	// load the program of the build from the program cache, returns
+	// false when it has to be compiled
+	bool LoadCachedProgram(const std::string& firstSource, const std::string& secondSource, uint64_t permutationKey);
+	// link the attached shaders of the build
+	void LinkProgram();
+
+public:
+	// start building a program from its shader sources, cancelling any
+	// build that was already started - the permutation key tells the
+	// specialized programs of the same sources apart in the cache
+	void Start(
+		const std::string& name,
+		const std::string& vertexSource,
+		const std::string& fragmentSource,
+		uint64_t permutationKey = 0);
+	// start building a compute program from its shader source
+	void StartCompute(const std::string& name, const std::string& computeSource);
+	// check if a build is started and not yet finished
+	bool IsBuilding() const;
+	// check if the started build has completed - never waits when the
+	// driver compiles in parallel
+	bool IsComplete() const;
+	// get the linked program, or 0 when it failed to build - the caller
+	// owns the program, and the compiler is ready for the next build
+	GLuint Finish();
+	// check if the last program was loaded from the program cache
+	bool WasCached() const;
+
+	// read a shader source file, from the asset pack when it is packed
+	static bool ReadSource(const std::string& filename, std::string& source);
+};
@@ -0,0 +1,342 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.cpp
+// ============
+// build specialized variants of a shader program from preprocessor keys
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderVariants.h"
+
+#include <sstream>
+
+namespace
+{
+	// the point light mask of a key starts at this bit
+	const int g_PointLightShift = 24;
+	const uint32_t g_PointLightBits = 0xFF;
+	// the version the fragment shader of the clustered lights and of the
+	// object light lists needs
+	const char* g_ClusteredLightsVersion = "#version 430 core";
+	// the version the fragment shader of the shadows and of the
+	// reflection probes needs, as both read cube map arrays
+	const char* g_ShadowsVersion = "#version 400 core";
+	// the version the vertex shader of the scene capture needs
+	const char* g_SceneCaptureVersion = "#version 440 core";
+}
+
+/***********************************************************
+ *  ShaderVariants()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderVariants::ShaderVariants()
+{
+}
+
+/***********************************************************
+ *  ~ShaderVariants()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderVariants::~ShaderVariants()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for deleting the programs of every
+ *  variant and cancelling the builds in progress.
+ ***********************************************************/
+void ShaderVariants::Clear()
+{
+	for (std::unordered_map<uint32_t, VARIANT>::iterator variant = m_variants.begin(); variant != m_variants.end(); variant++)
+	{
+		delete variant->second.compiler;
+		if (variant->second.program != 0)
+		{
+			glDeleteProgram(variant->second.program);
+		}
+	}
+	m_variants.clear();
+}
+
+/***********************************************************
+ *  SetSources()
+ *
+ *  This method is used for setting the sources of the
+ *  variants.  The variants of the previous sources are
+ *  deleted, and are built again when they are asked for.
+ ***********************************************************/
+void ShaderVariants::SetSources(
+	const std::string& name,
+	const std::string& vertexSource,
+	const std::string& fragmentSource)
+{
+	Clear();
+	m_name = name;
+	m_vertexSource = vertexSource;
+	m_fragmentSource = fragmentSource;
+}
+
+/***********************************************************
+ *  SetBakedLights()
+ *
+ *  This method is used for setting the declarations of the
+ *  light constants that are compiled into the variants with
+ *  baked lights.  Every variant is deleted, and built again
+ *  when it is asked for.
+ ***********************************************************/
+void ShaderVariants::SetBakedLights(const std::string& declarations)
+{
+	Clear();
+	m_bakedLights = declarations;
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  This method is used for getting the program of a variant.
+ *  The first time a variant is asked for its build is
+ *  started, and 0 is returned until it has finished, so the
+ *  caller keeps drawing with the unspecialized program.
+ ***********************************************************/
+GLuint ShaderVariants::GetProgram(uint32_t key)
+{
+	std::unordered_map<uint32_t, VARIANT>::iterator found = m_variants.find(key);
+	if (found != m_variants.end())
+	{
+		return found->second.program;
+	}
+
+	VARIANT variant;
+	variant.program = 0;
+	variant.compiler = NULL;
+	if (!m_fragmentSource.empty())
+	{
+		std::ostringstream name;
+		name << m_name << " variant 0x" << std::hex << key;
+		std::string defines = GetDefines(key, m_bakedLights);
+
+		std::string vertexSource = m_vertexSource;
+		if ((key & sceneCapture) != 0)
+		{
+			vertexSource = SetVersion(vertexSource, g_SceneCaptureVersion);
+		}
+
+		std::string fragmentSource = m_fragmentSource;
+		if ((key & (clusteredLights | objectLightLists)) != 0)
+		{
+			fragmentSource = SetVersion(fragmentSource, g_ClusteredLightsVersion);
+		}
+		else if ((key & (shadows | reflectionProbes)) != 0)
+		{
+			fragmentSource = SetVersion(fragmentSource, g_ShadowsVersion);
+		}
+
+		variant.compiler = new ShaderCompiler();
+		variant.compiler->Start(name.str(), InsertDefines(vertexSource, defines), InsertDefines(fragmentSource, defines), key);
+	}
+	m_variants[key] = variant;
+
+	return 0;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for finishing the variant builds the
+ *  driver has completed.  A variant that fails to build is
+ *  not tried again, its objects keep the unspecialized
+ *  program.
+ ***********************************************************/
+void ShaderVariants::Update()
+{
+	for (std::unordered_map<uint32_t, VARIANT>::iterator variant = m_variants.begin(); variant != m_variants.end(); variant++)
+	{
+		if ((variant->second.compiler == NULL) || !variant->second.compiler->IsComplete())
+		{
+			continue;
+		}
+
+		variant->second.program = variant->second.compiler->Finish();
+		delete variant->second.compiler;
+		variant->second.compiler = NULL;
+	}
+}
+
+/***********************************************************
+ *  GetProgramCount()
+ *
+ *  This method is used for getting the number of variants
+ *  whose programs are built.
+ ***********************************************************/
+int ShaderVariants::GetProgramCount() const
+{
+	int count = 0;
+
+	for (std::unordered_map<uint32_t, VARIANT>::const_iterator variant = m_variants.begin(); variant != m_variants.end(); variant++)
+	{
+		if (variant->second.program != 0)
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method is used for making the key of a variant from
+ *  its feature bits and the mask of its active point
+ *  lights.
+ ***********************************************************/
+uint32_t ShaderVariants::MakeKey(uint32_t features, uint32_t pointLightMask)
+{
+	return (features & ((1u << g_PointLightShift) - 1)) | ((pointLightMask & g_PointLightBits) << g_PointLightShift);
+}
+
+/***********************************************************
+ *  GetDefines()
+ *
+ *  This method is used for getting the defines that select
+ *  the features of a variant.  Every feature is defined as a
+ *  constant, so the shader compiler removes the branches
+ *  that are never taken.
+ ***********************************************************/
+std::string ShaderVariants::GetDefines(uint32_t key, const std::string& bakedLightDeclarations)
+{
+	std::ostringstream defines;
+
+	defines << "#define SHADER_VARIANT" << std::endl;
+	defines << "#define USE_TEXTURE " << (((key & textured) != 0) ? "true" : "false") << std::endl;
+	defines << "#define USE_LIGHTING " << (((key & lit) != 0) ? "true" : "false") << std::endl;
+	defines << "#define DIRECTIONAL_LIGHT_ACTIVE " << (((key & directionalLight) != 0) ? "true" : "false") << std::endl;
+	defines << "#define SPOT_LIGHT_ACTIVE " << (((key & spotLight) != 0) ? "true" : "false") << std::endl;
+	defines << "#define POINT_LIGHT_MASK " << ((key >> g_PointLightShift) & g_PointLightBits) << std::endl;
+	if ((key & clusteredLights) != 0)
+	{
+		defines << "#define CLUSTERED_LIGHTS" << std::endl;
+	}
+	if ((key & geometryPass) != 0)
+	{
+		defines << "#define GEOMETRY_PASS" << std::endl;
+	}
+	if ((key & deferredLighting) != 0)
+	{
+		defines << "#define DEFERRED_LIGHTING" << std::endl;
+	}
+	if ((key & lightVolumes) != 0)
+	{
+		defines << "#define LIGHT_VOLUMES" << std::endl;
+	}
+	if ((key & objectLightLists) != 0)
+	{
+		defines << "#define OBJECT_LIGHT_LISTS" << std::endl;
+	}
+	if ((key & sceneCapture) != 0)
+	{
+		defines << "#define SCENE_CAPTURE" << std::endl;
+	}
+	if ((key & lightmap) != 0)
+	{
+		defines << "#define LIGHTMAP" << std::endl;
+	}
+	if ((key & ambientOcclusion) != 0)
+	{
+		defines << "#define AMBIENT_OCCLUSION" << std::endl;
+	}
+	if ((key & irradianceProbes) != 0)
+	{
+		defines << "#define IRRADIANCE_PROBES" << std::endl;
+	}
+	if ((key & reflectionProbes) != 0)
+	{
+		defines << "#define REFLECTION_PROBES" << std::endl;
+	}
+	if ((key & transparencyPass) != 0)
+	{
+		defines << "#define TRANSPARENCY_PASS" << std::endl;
+	}
+	if ((key & transparencyComposite) != 0)
+	{
+		defines << "#define TRANSPARENCY_COMPOSITE" << std::endl;
+	}
+	if ((key & depthPrepass) != 0)
+	{
+		defines << "#define DEPTH_PREPASS" << std::endl;
+	}
+	if ((key & resolutionUpscale) != 0)
+	{
+		defines << "#define RESOLUTION_UPSCALE" << std::endl;
+	}
+	if ((key & shadowPass) != 0)
+	{
+		defines << "#define SHADOW_PASS" << std::endl;
+	}
+	if ((key & shadows) != 0)
+	{
+		defines << "#define SHADOWS" << std::endl;
+	}
+	if (((key & bakedLights) != 0) && !bakedLightDeclarations.empty())
+	{
+		defines << "#define BAKED_LIGHTS " << bakedLightDeclarations << std::endl;
+	}
+
+	return defines.str();
+}
+
+/***********************************************************
+ *  InsertDefines()
+ *
+ *  This method is used for inserting defines into a shader
+ *  source.  They must follow the #version line, which has
+ *  to come first.
+ ***********************************************************/
+std::string ShaderVariants::InsertDefines(const std::string& source, const std::string& defines)
+{
+	size_t position = 0;
+
+	size_t version = source.find("#version");
+	if (version != std::string::npos)
+	{
+		size_t lineEnd = source.find('\n', version);
+		position = (lineEnd == std::string::npos) ? source.size() : lineEnd + 1;
+	}
+
+	std::string result = source.substr(0, position);
+	if ((position > 0) && (result.back() != '\n'))
+	{
+		result += '\n';
+	}
+	result += defines;
+	result += source.substr(position);
+
+	return result;
+}
+
+/***********************************************************
+ *  SetVersion()
+ *
+ *  This method is used for replacing the #version line of a
+ *  shader source, for the variants that need a later GLSL
+ *  version than the unspecialized program.
+ ***********************************************************/
+std::string ShaderVariants::SetVersion(const std::string& source, const std::string& version)
+{
+	size_t start = source.find("#version");
+	if (start == std::string::npos)
+	{
+		return version + "\n" + source;
+	}
+
+	size_t lineEnd = source.find('\n', start);
+	if (lineEnd == std::string::npos)
+	{
+		lineEnd = source.size();
+	}
+
+	return source.substr(0, start) + version + source.substr(lineEnd);
+}
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.h
+// ============
+// build specialized variants of a shader program from preprocessor keys
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderCompiler.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/***********************************************************
+ *  ShaderVariants
+ *
+ *  This class contains the code for building the variants
+ *  of a shader program.  A variant is selected by a compact
+ *  key of the features it is specialized for, which become
+ *  defines inserted after the #version line of its sources,
+ *  so the branches on those features are compiled out.  A
+ *  variant is built the first time it is asked for, in the
+ *  background when the driver compiles in parallel, and is
+ *  then kept - until it is ready the caller draws with the
+ *  unspecialized program.
+ ***********************************************************/
+class ShaderVariants
+{
+public:
+	// constructor
+	ShaderVariants();
+	// destructor
+	~ShaderVariants();
+
+	// the programs cannot be shared between two objects
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// the features a variant is specialized for - the active point
+	// lights are a mask above these bits, see MakeKey()
+	enum VariantFeature
+	{
+		textured = 1 << 0,
+		lit = 1 << 1,
+		directionalLight = 1 << 2,
+		spotLight = 1 << 3,
+		// the light values are compiled in as constants
+		bakedLights = 1 << 4,
+		// the local lights are read from the clusters of the view, which
+		// needs GLSL 4.30
+		clusteredLights = 1 << 5,
+		// the passes of deferred shading - writing the surfaces to the
+		// G-buffer, lighting them with the scene lights over the whole
+		// screen, and adding the local lights over their screen bounds
+		geometryPass = 1 << 6,
+		deferredLighting = 1 << 7,
+		lightVolumes = 1 << 8,
+		// drawing the casters into a shadow map, and lighting with the
+		// shadow maps, which needs GLSL 4.00 for the cube map array
+		shadowPass = 1 << 9,
+		shadows = 1 << 10,
+		// the lights are read from the lists of the drawn object, which
+		// needs GLSL 4.30 like the clusters
+		objectLightLists = 1 << 11,
+		// writing the triangles of the scene with transform feedback,
+		// which needs GLSL 4.40 in the vertex shader, and lighting with
+		// the baked lightmaps in place of the scene lights
+		sceneCapture = 1 << 12,
+		lightmap = 1 << 13,
+		// darkening the ambient light by the occlusion baked for the
+		// vertices
+		ambientOcclusion = 1 << 14,
+		// lighting with the irradiance of the probe grid in place of the
+		// flat ambient of the scene lights
+		irradianceProbes = 1 << 15,
+		// adding the reflections of the nearest reflection probe to the
+		// reflective materials
+		reflectionProbes = 1 << 16,
+		// writing the transparent objects into the weighted sums of their
+		// pixels, and blending the sums over the opaque objects
+		transparencyPass = 1 << 17,
+		transparencyComposite = 1 << 18,
+		// writing the depth of the opaque objects alone, before they are
+		// lit where they are the nearest
+		depthPrepass = 1 << 19,
+		// filtering the frame drawn at a lower resolution up to the
+		// window and sharpening it
+		resolutionUpscale = 1 << 20
+	};
+
+private:
+	struct VARIANT
+	{
+		// the linked program, 0 while it is building or when it failed
+		GLuint program;
+		// the build in progress, NULL once it is finished
+		ShaderCompiler* compiler;
+	};
+
+	std::string m_name;
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+	// declarations of the baked light constants
+	std::string m_bakedLights;
+	std::unordered_map<uint32_t, VARIANT> m_variants;
+
+	// delete every variant, finished or not
+	void Clear();
+
+public:
+	// set the sources the variants are built from - the variants of the
+	// previous sources are deleted
+	void SetSources(
+		const std::string& name,
+		const std::string& vertexSource,
+		const std::string& fragmentSource);
+	// set the declarations of the baked light constants - the variants
+	// with the previous lights baked in are deleted
+	void SetBakedLights(const std::string& declarations);
+	// get the program of a variant, starting its build the first time -
+	// 0 until the build has finished, or when it failed
+	GLuint GetProgram(uint32_t key);
+	// finish the builds that have completed - call once per frame
+	void Update();
+	// get the number of variants that are built
+	int GetProgramCount() const;
+
+	// make the key of a variant from its features and point light mask
+	static uint32_t MakeKey(uint32_t features, uint32_t pointLightMask);
+	// get the defines that select the features of a variant
+	static std::string GetDefines(uint32_t key, const std::string& bakedLightDeclarations);
+	// insert defines into a shader source after its #version line
+	static std::string InsertDefines(const std::string& source, const std::string& defines);
+	// replace the #version line of a shader source
+	static std::string SetVersion(const std::string& source, const std::string& version);
+};
@@ -0,0 +1,520 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.cpp
+// ============
+// cache the shadow maps of the scene lights and re-render them on change
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowMaps.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	// number of point lights, as TOTAL_POINT_LIGHTS in the fragment shader
+	const int g_TotalPointLights = 5;
+	// the spot light map, then the point light maps
+	const int g_MapCount = 1 + g_TotalPointLights;
+	// pixels across the spot light map and a face of a point light map
+	const int g_SpotMapSize = 1024;
+	const int g_PointMapSize = 512;
+	// distance from a light to the near plane of its map
+	const float g_NearDepth = 0.1f;
+	// widest view of the spot light map, for a light inside the casters
+	const float g_MaxSpotHalfAngle = glm::radians(80.0f);
+	// texture units of the maps, after the scene textures and G-buffer
+	const int g_SpotTextureUnit = 21;
+	const int g_PointTextureUnit = 22;
+
+	// the direction and up vector of the faces of a cube map, in the
+	// order of the cube map layers
+	const glm::vec3 g_CubeFaceDirections[6] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+	const glm::vec3 g_CubeFaceUps[6] = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+
+	// set the comparison of a depth texture, so a lookup returns the
+	// lit fraction of the texels around it
+	void SetShadowCompare(GLenum target)
+	{
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+}
+
+/***********************************************************
+ *  ShadowMaps()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowMaps::ShadowMaps()
+{
+	m_bSupported = false;
+	m_framebuffer = 0;
+	m_spotTexture = 0;
+	m_pointTexture = 0;
+	for (int i = 0; i < g_MapCount; i++)
+	{
+		m_maps[i].bActive = false;
+		m_maps[i].position = glm::vec3(0.0f);
+		m_maps[i].direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		m_maps[i].bDirty = false;
+		m_maps[i].drawnPosition = glm::vec3(0.0f);
+		m_maps[i].drawnRange = 0.0f;
+		m_maps[i].drawnMatrix = glm::mat4(1.0f);
+	}
+	m_casterHash = 0;
+	m_casterMin = glm::vec3(0.0f);
+	m_casterMax = glm::vec3(0.0f);
+	m_bCastersKnown = false;
+	m_updateMap = -1;
+	m_nextMap = 0;
+	m_updateView = glm::mat4(1.0f);
+	m_updateProjection = glm::mat4(1.0f);
+	m_savedFramebuffer = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_savedViewport[i] = 0;
+	}
+	m_updateCount = 0;
+}
+
+/***********************************************************
+ *  ~ShadowMaps()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowMaps::~ShadowMaps()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteTextures(1, &m_spotTexture);
+		glDeleteTextures(1, &m_pointTexture);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the map textures.  The
+ *  point light maps are the layers of a cube map array,
+ *  which needs OpenGL 4.0.  Every map starts cleared to the
+ *  far distance, so it casts no shadow until it is drawn.
+ ***********************************************************/
+bool ShadowMaps::Initialize()
+{
+	if ((GLEW_VERSION_4_0 == GL_FALSE) && (GLEW_ARB_texture_cube_map_array == GL_FALSE))
+	{
+		std::cout << "Shadow maps need cube map arrays, the scene is drawn without shadows" << std::endl;
+		return false;
+	}
+
+	glGenTextures(1, &m_spotTexture);
+	glBindTexture(GL_TEXTURE_2D, m_spotTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, g_SpotMapSize, g_SpotMapSize, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, NULL);
+	SetShadowCompare(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenTextures(1, &m_pointTexture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_pointTexture);
+	glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT16, g_PointMapSize, g_PointMapSize,
+		6 * g_TotalPointLights, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, NULL);
+	SetShadowCompare(GL_TEXTURE_CUBE_MAP_ARRAY);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+	// the maps are only drawn to, so the framebuffer has no colors
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_spotTexture, 0);
+	m_bSupported = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if (m_bSupported)
+	{
+		glClear(GL_DEPTH_BUFFER_BIT);
+		for (int layer = 0; layer < 6 * g_TotalPointLights; layer++)
+		{
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_pointTexture, 0, layer);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!m_bSupported)
+	{
+		std::cout << "The shadow maps cannot be drawn to, the scene is drawn without shadows" << std::endl;
+	}
+
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the lights can cast
+ *  shadows.
+ ***********************************************************/
+bool ShadowMaps::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  SetLight()
+ *
+ *  This method is used for setting the light of a map.  The
+ *  map is marked for drawing when the light has changed - a
+ *  light that is switched off clears its map right away.
+ ***********************************************************/
+void ShadowMaps::SetLight(int map, bool bActive, const glm::vec3& position, const glm::vec3& direction)
+{
+	SHADOW_MAP& shadowMap = m_maps[map];
+
+	if ((bActive == shadowMap.bActive) && (position == shadowMap.position) && (direction == shadowMap.direction))
+	{
+		return;
+	}
+
+	shadowMap.bActive = bActive;
+	shadowMap.position = position;
+	shadowMap.direction = direction;
+	shadowMap.bDirty = bActive;
+	if (!bActive)
+	{
+		shadowMap.drawnRange = 0.0f;
+	}
+}
+
+/***********************************************************
+ *  SetSpotLight()
+ *
+ *  This method is used for setting the spot light that
+ *  casts shadows through the perspective map.
+ ***********************************************************/
+void ShadowMaps::SetSpotLight(bool bActive, const glm::vec3& position, const glm::vec3& direction)
+{
+	SetLight(0, bActive, position, direction);
+}
+
+/***********************************************************
+ *  SetPointLight()
+ *
+ *  This method is used for setting a point light that casts
+ *  shadows through its cube map.
+ ***********************************************************/
+void ShadowMaps::SetPointLight(int index, bool bActive, const glm::vec3& position)
+{
+	if ((index < 0) || (index >= g_TotalPointLights))
+	{
+		return;
+	}
+
+	SetLight(1 + index, bActive, position, glm::vec3(0.0f, -1.0f, 0.0f));
+}
+
+/***********************************************************
+ *  SetCasters()
+ *
+ *  This method is used for setting the hash of the casters
+ *  drawn in a frame - their transformations and meshes -
+ *  and their world bounds, which the maps are fitted to.
+ *  When the hash changes a caster has moved, so every map
+ *  of an active light is marked for drawing.
+ ***********************************************************/
+void ShadowMaps::SetCasters(uint64_t hash, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	if (m_bCastersKnown && (hash == m_casterHash))
+	{
+		return;
+	}
+
+	m_casterHash = hash;
+	m_casterMin = boundsMin;
+	m_casterMax = boundsMax;
+	m_bCastersKnown = true;
+	for (int i = 0; i < g_MapCount; i++)
+	{
+		m_maps[i].bDirty = m_maps[i].bActive;
+	}
+}
+
+/***********************************************************
+ *  BeginUpdate()
+ *
+ *  This method is used for starting to draw the next map
+ *  that does not match its light, taking the maps in turn
+ *  so none waits behind the others.  The view of the map is
+ *  fitted around the casters - the range of a point light
+ *  reaches their farthest corner, and the spot light map
+ *  looks at their bounding sphere, as the cone of the light
+ *  can be wider than a perspective view.
+ ***********************************************************/
+bool ShadowMaps::BeginUpdate()
+{
+	if (!m_bSupported || !m_bCastersKnown)
+	{
+		return false;
+	}
+
+	m_updateMap = -1;
+	for (int i = 0; i < g_MapCount; i++)
+	{
+		int map = (m_nextMap + i) % g_MapCount;
+		if (m_maps[map].bDirty)
+		{
+			m_updateMap = map;
+			break;
+		}
+	}
+	if (m_updateMap < 0)
+	{
+		return false;
+	}
+	m_nextMap = (m_updateMap + 1) % g_MapCount;
+
+	SHADOW_MAP& shadowMap = m_maps[m_updateMap];
+	glm::vec3 center = (m_casterMin + m_casterMax) * 0.5f;
+	float radius = glm::length(m_casterMax - m_casterMin) * 0.5f;
+	float distance = glm::length(center - shadowMap.position);
+	float range = distance + radius;
+
+	if (m_updateMap == 0)
+	{
+		float halfAngle = g_MaxSpotHalfAngle;
+		if (distance > radius)
+		{
+			halfAngle = std::min(std::asin(radius / distance), g_MaxSpotHalfAngle);
+		}
+		glm::vec3 direction = (distance > 0.0f) ? (center - shadowMap.position) / distance : shadowMap.direction;
+		glm::vec3 up = (std::abs(direction.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		m_updateProjection = glm::perspective(2.0f * halfAngle, 1.0f, std::max(distance - radius, g_NearDepth), range);
+		// clip space to texture coordinates
+		glm::mat4 bias = glm::translate(glm::vec3(0.5f)) * glm::scale(glm::vec3(0.5f));
+		m_updateView = glm::lookAt(shadowMap.position, shadowMap.position + direction, up);
+		shadowMap.drawnMatrix = bias * m_updateProjection * m_updateView;
+	}
+	else
+	{
+		m_updateProjection = glm::perspective(glm::radians(90.0f), 1.0f, g_NearDepth, range);
+	}
+	shadowMap.drawnPosition = shadowMap.position;
+	shadowMap.drawnRange = range;
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	int mapSize = GetUpdateMapSize();
+	glViewport(0, 0, mapSize, mapSize);
+	glEnable(GL_DEPTH_TEST);
+
+	return true;
+}
+
+/***********************************************************
+ *  GetFaceCount()
+ *
+ *  This method is used for getting the number of faces of
+ *  the map being drawn - one for the spot light, six for
+ *  the cube map of a point light.
+ ***********************************************************/
+int ShadowMaps::GetFaceCount() const
+{
+	return (m_updateMap == 0) ? 1 : 6;
+}
+
+/***********************************************************
+ *  GetFaceView()
+ *
+ *  This method is used for getting the view matrix of a
+ *  face of the map being drawn.
+ ***********************************************************/
+glm::mat4 ShadowMaps::GetFaceView(int face) const
+{
+	const SHADOW_MAP& shadowMap = m_maps[m_updateMap];
+
+	if (m_updateMap == 0)
+	{
+		return m_updateView;
+	}
+	return glm::lookAt(shadowMap.drawnPosition, shadowMap.drawnPosition + g_CubeFaceDirections[face], g_CubeFaceUps[face]);
+}
+
+/***********************************************************
+ *  BeginFace()
+ *
+ *  This method is used for drawing the following casters
+ *  into a face of the map being drawn.  The shadow pass
+ *  program writes the distance to the light itself, so it
+ *  is given the light along with the matrix of the face.
+ ***********************************************************/
+void ShadowMaps::BeginFace(int face, GLuint program)
+{
+	const SHADOW_MAP& shadowMap = m_maps[m_updateMap];
+
+	if (m_updateMap == 0)
+	{
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_spotTexture, 0);
+	}
+	else
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_pointTexture, 0, 6 * (m_updateMap - 1) + face);
+	}
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glm::mat4 viewProjection = m_updateProjection * GetFaceView(face);
+	glUniformMatrix4fv(glGetUniformLocation(program, "shadowViewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniform4f(glGetUniformLocation(program, "shadowLight"),
+		shadowMap.drawnPosition.x, shadowMap.drawnPosition.y, shadowMap.drawnPosition.z, shadowMap.drawnRange);
+}
+
+/***********************************************************
+ *  EndUpdate()
+ *
+ *  This method is used for finishing the map being drawn
+ *  and restoring the framebuffer and viewport of the frame.
+ ***********************************************************/
+void ShadowMaps::EndUpdate()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+
+	m_maps[m_updateMap].bDirty = false;
+	m_updateMap = -1;
+	m_updateCount++;
+}
+
+/***********************************************************
+ *  GetUpdatePosition()
+ *
+ *  This method is used for getting the position of the
+ *  light whose map is being drawn.
+ ***********************************************************/
+glm::vec3 ShadowMaps::GetUpdatePosition() const
+{
+	return m_maps[m_updateMap].drawnPosition;
+}
+
+/***********************************************************
+ *  GetUpdateProjection()
+ *
+ *  This method is used for getting the projection matrix of
+ *  the map being drawn.
+ ***********************************************************/
+glm::mat4 ShadowMaps::GetUpdateProjection() const
+{
+	return m_updateProjection;
+}
+
+/***********************************************************
+ *  GetUpdateMapSize()
+ *
+ *  This method is used for getting the pixels across the
+ *  map being drawn.
+ ***********************************************************/
+int ShadowMaps::GetUpdateMapSize() const
+{
+	return (m_updateMap == 0) ? g_SpotMapSize : g_PointMapSize;
+}
+
+/***********************************************************
+ *  GetUpdateCount()
+ *
+ *  This method is used for getting the number of maps that
+ *  were drawn since the start.
+ ***********************************************************/
+int ShadowMaps::GetUpdateCount() const
+{
+	return m_updateCount;
+}
+
+/***********************************************************
+ *  IsUpdated()
+ *
+ *  This method is used for checking if every map has been
+ *  drawn for its light and the current casters, so the
+ *  views lit with the shadows can be kept.
+ ***********************************************************/
+bool ShadowMaps::IsUpdated() const
+{
+	if (!m_bSupported)
+	{
+		return true;
+	}
+	if (!m_bCastersKnown)
+	{
+		return false;
+	}
+	for (int i = 0; i < g_MapCount; i++)
+	{
+		if (m_maps[i].bDirty)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  BindTextures()
+ *
+ *  This method is used for binding the map textures to
+ *  their texture units.
+ ***********************************************************/
+void ShadowMaps::BindTextures() const
+{
+	if (!m_bSupported)
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + g_SpotTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, m_spotTexture);
+	glActiveTexture(GL_TEXTURE0 + g_PointTextureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, m_pointTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  SetShaderValues()
+ *
+ *  This method is used for setting the map samplers, and
+ *  the lights the maps were drawn from, on a program that
+ *  draws with the shadows.  A light whose map has nothing
+ *  drawn has a range of 0, and casts no shadow.
+ ***********************************************************/
+void ShadowMaps::SetShaderValues(GLuint program) const
+{
+	if (!m_bSupported)
+	{
+		return;
+	}
+
+	glUniform1i(glGetUniformLocation(program, "spotShadowMap"), g_SpotTextureUnit);
+	glUniform1i(glGetUniformLocation(program, "pointShadowMaps"), g_PointTextureUnit);
+	glUniformMatrix4fv(glGetUniformLocation(program, "spotShadowMatrix"), 1, GL_FALSE, glm::value_ptr(m_maps[0].drawnMatrix));
+	glUniform4f(glGetUniformLocation(program, "spotShadowLight"),
+		m_maps[0].drawnPosition.x, m_maps[0].drawnPosition.y, m_maps[0].drawnPosition.z, m_maps[0].drawnRange);
+	for (int i = 0; i < g_TotalPointLights; i++)
+	{
+		const SHADOW_MAP& shadowMap = m_maps[1 + i];
+		std::string name = "pointShadowLights[" + std::to_string(i) + "]";
+		glUniform4f(glGetUniformLocation(program, name.c_str()),
+			shadowMap.drawnPosition.x, shadowMap.drawnPosition.y, shadowMap.drawnPosition.z, shadowMap.drawnRange);
+	}
+}
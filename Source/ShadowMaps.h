@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.h
+// ============
+// cache the shadow maps of the scene lights and re-render them on change
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/***********************************************************
+ *  ShadowMaps
+ *
+ *  This class contains the code for the shadows of the
+ *  scene lights - a perspective map for the spot light and
+ *  a cube map for every point light.  A map keeps the
+ *  distance from its light to the nearest caster, divided
+ *  by the range of the light.  The maps are cached, and one
+ *  is only drawn again when its light moves or the objects
+ *  casting the shadows change - at most one light a frame,
+ *  so a change of several lights is spread over the next
+ *  frames while the others keep their previous maps.
+ ***********************************************************/
+class ShadowMaps
+{
+public:
+	// constructor
+	ShadowMaps();
+	// destructor
+	~ShadowMaps();
+
+	// the textures cannot be shared between two objects
+	ShadowMaps(const ShadowMaps&) = delete;
+	ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+private:
+	struct SHADOW_MAP
+	{
+		// the light as it was last set
+		bool bActive;
+		glm::vec3 position;
+		glm::vec3 direction;
+		// true when the map does not match the light or the casters
+		bool bDirty;
+		// the light the map was drawn from - its range is 0 while the
+		// map has nothing drawn
+		glm::vec3 drawnPosition;
+		float drawnRange;
+		// world to map texture coordinates, for the spot light
+		glm::mat4 drawnMatrix;
+	};
+
+	bool m_bSupported;
+	GLuint m_framebuffer;
+	// the spot light map, and the cube maps of the point lights as the
+	// layers of one cube map array
+	GLuint m_spotTexture;
+	GLuint m_pointTexture;
+	// the spot light map first, then one map per point light
+	SHADOW_MAP m_maps[6];
+	// hash and world bounds of the casters drawn the last frame
+	uint64_t m_casterHash;
+	glm::vec3 m_casterMin;
+	glm::vec3 m_casterMax;
+	bool m_bCastersKnown;
+	// the map being drawn, and the view it is drawn from
+	int m_updateMap;
+	int m_nextMap;
+	glm::mat4 m_updateView;
+	glm::mat4 m_updateProjection;
+	// the framebuffer and viewport of the frame, restored after the map
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	// number of maps drawn since the start
+	int m_updateCount;
+
+	// mark a map for drawing when its light has changed
+	void SetLight(int map, bool bActive, const glm::vec3& position, const glm::vec3& direction);
+	// get the view of a face of the map being drawn - the spot light
+	// map has a single face
+	glm::mat4 GetFaceView(int face) const;
+
+public:
+	// create the map textures - needs the OpenGL context to be current
+	bool Initialize();
+	// check if the lights can cast shadows
+	bool IsSupported() const;
+
+	// set the spot light casting shadows
+	void SetSpotLight(bool bActive, const glm::vec3& position, const glm::vec3& direction);
+	// set a point light casting shadows
+	void SetPointLight(int index, bool bActive, const glm::vec3& position);
+	// set the hash and the world bounds of the casters drawn in a frame -
+	// every map is drawn again when the hash changes
+	void SetCasters(uint64_t hash, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	// start drawing the next map that does not match its light, returns
+	// false when every map matches - call at most once per frame
+	bool BeginUpdate();
+	// get the number of faces of the map being drawn
+	int GetFaceCount() const;
+	// draw the following casters into a face of the map, with the
+	// shadow pass program current
+	void BeginFace(int face, GLuint program);
+	// finish drawing the map and restore the viewport
+	void EndUpdate();
+	// get the view the map is drawn from, for selecting the level of
+	// detail of the casters
+	glm::vec3 GetUpdatePosition() const;
+	glm::mat4 GetUpdateProjection() const;
+	int GetUpdateMapSize() const;
+	// get the number of maps drawn since the start
+	int GetUpdateCount() const;
+	// check if every map matches its light and the casters - true when
+	// the lights cast no shadows
+	bool IsUpdated() const;
+
+	// bind the map textures for the lit programs - call once per frame
+	void BindTextures() const;
+	// set the map values on a program that draws with the shadows
+	void SetShaderValues(GLuint program) const;
+};
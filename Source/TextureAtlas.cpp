@@ -0,0 +1,304 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.cpp
+// ============
+// pack several texture images into shared atlas pages so the objects using
+// them can be drawn without switching textures
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// highest mip level generated for the pages
+	const int g_AtlasMaxMipLevel = 3;
+	// gutter width around each image on level 0 - halved on every
+	// mip level, so this leaves one texel on the highest level
+	const int g_AtlasGutter = 1 << g_AtlasMaxMipLevel;
+	// the cells start and end on this grid so that no 2x2 mip
+	// filter footprint straddles two images
+	const int g_AtlasCellAlignment = 1 << g_AtlasMaxMipLevel;
+
+	int AlignSize(int size, int alignment)
+	{
+		return ((size + alignment - 1) / alignment) * alignment;
+	}
+
+	// wrap a coordinate into 0..size-1, repeating like GL_REPEAT
+	int WrapCoordinate(int value, int size)
+	{
+		value %= size;
+		return (value < 0) ? (value + size) : value;
+	}
+}
+
+/***********************************************************
+ *  TextureAtlas()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureAtlas::TextureAtlas(int maxPageSize)
+{
+	m_maxPageSize = maxPageSize;
+}
+
+/***********************************************************
+ *  ~TextureAtlas()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureAtlas::~TextureAtlas()
+{
+	DestroyGLTextures();
+}
+
+/***********************************************************
+ *  CopyImageToPage()
+ *
+ *  This method is used for filling a page cell with an
+ *  image.  The gutter and any alignment padding repeat the
+ *  image as GL_REPEAT would, so bilinear taps across the edge
+ *  of a tiled image see the opposite edge.
+ ***********************************************************/
+void TextureAtlas::CopyImageToPage(ATLAS_PAGE& page, int cellX, int cellY, int cellWidth, int cellHeight, const ATLAS_IMAGE& image)
+{
+	for (int y = 0; y < cellHeight; y++)
+	{
+		int sourceY = WrapCoordinate(y - g_AtlasGutter, image.height);
+		for (int x = 0; x < cellWidth; x++)
+		{
+			int sourceX = WrapCoordinate(x - g_AtlasGutter, image.width);
+			const unsigned char* source = image.pixels + (((size_t)sourceY * image.width + sourceX) * image.colorChannels);
+			unsigned char* target = &page.texels[(((size_t)(cellY + y) * page.width) + (cellX + x)) * 4];
+
+			target[0] = source[0];
+			target[1] = source[1];
+			target[2] = source[2];
+			target[3] = (image.colorChannels == 4) ? source[3] : 255;
+		}
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for packing the images into pages
+ *  with a shelf packer - the tallest cells are placed first,
+ *  left to right along rows, and a new page is started when
+ *  the next row would not fit.
+ ***********************************************************/
+bool TextureAtlas::Build(const std::vector<ATLAS_IMAGE>& images)
+{
+	struct PLACEMENT
+	{
+		int image;
+		int page;
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+	std::vector<PLACEMENT> placements;
+	std::vector<int> order;
+
+	DestroyGLTextures();
+	m_pages.clear();
+	m_entries.clear();
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if ((images[i].pixels == NULL) || ((images[i].colorChannels != 3) && (images[i].colorChannels != 4)))
+		{
+			std::cout << "Could not add image to the texture atlas:" << images[i].tag << std::endl;
+			continue;
+		}
+		order.push_back((int)i);
+	}
+	std::sort(order.begin(), order.end(), [&images](int a, int b) { return images[a].height > images[b].height; });
+
+	// the size used on every page, grown as cells are placed
+	std::vector<int> pageWidths;
+	std::vector<int> pageHeights;
+	int rowX = 0;
+	int rowY = 0;
+	int rowHeight = 0;
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const ATLAS_IMAGE& image = images[order[i]];
+		PLACEMENT placement;
+		placement.image = order[i];
+		placement.width = AlignSize(image.width + (2 * g_AtlasGutter), g_AtlasCellAlignment);
+		placement.height = AlignSize(image.height + (2 * g_AtlasGutter), g_AtlasCellAlignment);
+
+		if ((placement.width > m_maxPageSize) || (placement.height > m_maxPageSize))
+		{
+			std::cout << "Image is too large for the texture atlas:" << image.tag << std::endl;
+			return false;
+		}
+
+		if (pageWidths.empty())
+		{
+			pageWidths.push_back(0);
+			pageHeights.push_back(0);
+		}
+		// start a new row, or a new page when the row does not fit
+		if (rowX + placement.width > m_maxPageSize)
+		{
+			rowX = 0;
+			rowY += rowHeight;
+			rowHeight = 0;
+		}
+		if (rowY + placement.height > m_maxPageSize)
+		{
+			pageWidths.push_back(0);
+			pageHeights.push_back(0);
+			rowX = 0;
+			rowY = 0;
+			rowHeight = 0;
+		}
+
+		placement.page = (int)pageWidths.size() - 1;
+		placement.x = rowX;
+		placement.y = rowY;
+		placements.push_back(placement);
+
+		rowX += placement.width;
+		rowHeight = std::max(rowHeight, placement.height);
+		pageWidths.back() = std::max(pageWidths.back(), rowX);
+		pageHeights.back() = std::max(pageHeights.back(), rowY + rowHeight);
+	}
+
+	m_pages.resize(pageWidths.size());
+	for (size_t i = 0; i < m_pages.size(); i++)
+	{
+		m_pages[i].width = pageWidths[i];
+		m_pages[i].height = pageHeights[i];
+		m_pages[i].textureID = 0;
+		m_pages[i].texels.assign((size_t)pageWidths[i] * pageHeights[i] * 4, 0);
+	}
+
+	for (size_t i = 0; i < placements.size(); i++)
+	{
+		const PLACEMENT& placement = placements[i];
+		const ATLAS_IMAGE& image = images[placement.image];
+		ATLAS_PAGE& page = m_pages[placement.page];
+
+		CopyImageToPage(page, placement.x, placement.y, placement.width, placement.height, image);
+
+		ATLAS_ENTRY entry;
+		entry.tag = image.tag;
+		entry.page = placement.page;
+		entry.uvRect = glm::vec4(
+			(float)(placement.x + g_AtlasGutter) / (float)page.width,
+			(float)(placement.y + g_AtlasGutter) / (float)page.height,
+			(float)image.width / (float)page.width,
+			(float)image.height / (float)page.height);
+		m_entries.push_back(entry);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  CreateGLTextures()
+ *
+ *  This method is used for uploading every page into an
+ *  OpenGL texture.  Only the mip levels that still have a
+ *  gutter around every image are generated.
+ ***********************************************************/
+void TextureAtlas::CreateGLTextures()
+{
+	for (size_t i = 0; i < m_pages.size(); i++)
+	{
+		ATLAS_PAGE& page = m_pages[i];
+		if (page.texels.empty())
+		{
+			continue;
+		}
+
+		glGenTextures(1, &page.textureID);
+		glBindTexture(GL_TEXTURE_2D, page.textureID);
+
+		// the shader wraps the coordinates inside each image, so the
+		// page itself is clamped
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, g_AtlasMaxMipLevel);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, page.width, page.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, page.texels.data());
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		std::cout << "Created texture atlas page " << i << ", width:" << page.width << ", height:" << page.height << std::endl;
+
+		// the page memory is no longer needed
+		std::vector<unsigned char>().swap(page.texels);
+	}
+}
+
+/***********************************************************
+ *  DestroyGLTextures()
+ *
+ *  This method is used for freeing the page textures.
+ ***********************************************************/
+void TextureAtlas::DestroyGLTextures()
+{
+	for (size_t i = 0; i < m_pages.size(); i++)
+	{
+		if (m_pages[i].textureID != 0)
+		{
+			glDeleteTextures(1, &m_pages[i].textureID);
+			m_pages[i].textureID = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetPageCount()
+ *
+ *  This method is used for getting the number of pages.
+ ***********************************************************/
+int TextureAtlas::GetPageCount()
+{
+	return (int)m_pages.size();
+}
+
+/***********************************************************
+ *  GetPageTextureID()
+ *
+ *  This method is used for getting the texture of a page.
+ ***********************************************************/
+GLuint TextureAtlas::GetPageTextureID(int page)
+{
+	if ((page < 0) || (page >= (int)m_pages.size()))
+	{
+		return 0;
+	}
+
+	return m_pages[page].textureID;
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used for finding the page and the UV
+ *  rectangle of a packed image by its tag.
+ ***********************************************************/
+bool TextureAtlas::FindEntry(std::string tag, ATLAS_ENTRY& entry)
+{
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		if (m_entries[i].tag.compare(tag) == 0)
+		{
+			entry = m_entries[i];
+			return true;
+		}
+	}
+
+	return false;
+}
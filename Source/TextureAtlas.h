@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.h
+// ============
+// pack several texture images into shared atlas pages so the objects using
+// them can be drawn without switching textures
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureAtlas
+ *
+ *  This class contains the code for packing decoded images
+ *  into atlas pages.  Every image is surrounded by a gutter
+ *  of wrapped texels and placed on a grid that keeps the
+ *  gutter at least one texel wide on every mip level that is
+ *  used, so tiled and filtered lookups never bleed into the
+ *  neighbouring images.
+ ***********************************************************/
+class TextureAtlas
+{
+public:
+	// constructor
+	TextureAtlas(int maxPageSize = 4096);
+	// destructor
+	~TextureAtlas();
+
+	// a decoded image to be packed
+	struct ATLAS_IMAGE
+	{
+		std::string tag;
+		const unsigned char* pixels;
+		int width;
+		int height;
+		int colorChannels;
+	};
+
+	// where a packed image was placed
+	struct ATLAS_ENTRY
+	{
+		std::string tag;
+		int page;
+		// offset in xy and scale in zw of the image in the page
+		glm::vec4 uvRect;
+	};
+
+private:
+	struct ATLAS_PAGE
+	{
+		std::vector<unsigned char> texels;
+		int width;
+		int height;
+		GLuint textureID;
+	};
+
+	// largest width and height of one page
+	int m_maxPageSize;
+	std::vector<ATLAS_PAGE> m_pages;
+	std::vector<ATLAS_ENTRY> m_entries;
+
+	// copy an image and its wrapped gutter into a page cell
+	void CopyImageToPage(ATLAS_PAGE& page, int cellX, int cellY, int cellWidth, int cellHeight, const ATLAS_IMAGE& image);
+
+public:
+	// pack the images into pages in memory, returns false if an
+	// image is too large to fit on a page
+	bool Build(const std::vector<ATLAS_IMAGE>& images);
+	// upload the pages into OpenGL textures and free the page memory
+	void CreateGLTextures();
+	// free the page textures
+	void DestroyGLTextures();
+
+	// get the number of pages and the texture of a page
+	int GetPageCount();
+	GLuint GetPageTextureID(int page);
+	// find where a packed image was placed by its tag
+	bool FindEntry(std::string tag, ATLAS_ENTRY& entry);
+};
@@ -0,0 +1,679 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// transcode texture images into block compressed mip chains, store them in
+// cache files, and upload the compressed mips directly on later runs
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include "ImageProcessing.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// the block encoder uses SSE2 whenever the target guarantees it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TEXTURE_CACHE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// the KTX2 file identifier
+	const unsigned char g_KTX2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	// sizes of the fixed KTX2 sections
+	const size_t g_KTX2HeaderSize = 80;
+	const size_t g_KTX2LevelIndexSize = 24;
+	// Vulkan format numbers stored in the KTX2 header
+	const uint32_t g_VkFormatBC1RGB = 131;
+	const uint32_t g_VkFormatBC3 = 137;
+
+	// a 4x4 block of texels, one float array per channel
+	struct BLOCK_TEXELS
+	{
+		alignas(16) float r[16];
+		alignas(16) float g[16];
+		alignas(16) float b[16];
+		alignas(16) float a[16];
+	};
+
+	void WriteUInt32(std::vector<unsigned char>& file, size_t offset, uint32_t value)
+	{
+		memcpy(&file[offset], &value, sizeof(value));
+	}
+
+	void WriteUInt64(std::vector<unsigned char>& file, size_t offset, uint64_t value)
+	{
+		memcpy(&file[offset], &value, sizeof(value));
+	}
+
+	uint32_t ReadUInt32(const unsigned char* data, size_t offset)
+	{
+		uint32_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	uint64_t ReadUInt64(const unsigned char* data, size_t offset)
+	{
+		uint64_t value = 0;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+	size_t AlignOffset(size_t offset, size_t alignment)
+	{
+		return ((offset + alignment - 1) / alignment) * alignment;
+	}
+
+	// size in bytes of one compressed mip level
+	size_t GetLevelSize(int width, int height, size_t blockSize)
+	{
+		return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * blockSize;
+	}
+
+	/***********************************************************
+	 *  ComputeColorBounds()
+	 *
+	 *  Find the per channel minimum and maximum of the block.
+	 ***********************************************************/
+	void ComputeColorBounds(const BLOCK_TEXELS& block, float minColor[3], float maxColor[3])
+	{
+#ifdef TEXTURE_CACHE_SSE2
+		const float* channels[3] = { block.r, block.g, block.b };
+		for (int c = 0; c < 3; c++)
+		{
+			__m128 low = _mm_load_ps(channels[c]);
+			__m128 high = low;
+			for (int i = 4; i < 16; i += 4)
+			{
+				__m128 texels = _mm_load_ps(channels[c] + i);
+				low = _mm_min_ps(low, texels);
+				high = _mm_max_ps(high, texels);
+			}
+			// reduce the four lanes to one
+			low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(1, 0, 3, 2)));
+			low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(2, 3, 0, 1)));
+			high = _mm_max_ps(high, _mm_shuffle_ps(high, high, _MM_SHUFFLE(1, 0, 3, 2)));
+			high = _mm_max_ps(high, _mm_shuffle_ps(high, high, _MM_SHUFFLE(2, 3, 0, 1)));
+			minColor[c] = _mm_cvtss_f32(low);
+			maxColor[c] = _mm_cvtss_f32(high);
+		}
+#else
+		const float* channels[3] = { block.r, block.g, block.b };
+		for (int c = 0; c < 3; c++)
+		{
+			minColor[c] = channels[c][0];
+			maxColor[c] = channels[c][0];
+			for (int i = 1; i < 16; i++)
+			{
+				minColor[c] = std::min(minColor[c], channels[c][i]);
+				maxColor[c] = std::max(maxColor[c], channels[c][i]);
+			}
+		}
+#endif
+	}
+
+	/***********************************************************
+	 *  ProjectOntoLine()
+	 *
+	 *  Project every texel onto the line between the two
+	 *  endpoints and quantize the position to 0..steps.
+	 ***********************************************************/
+	void ProjectOntoLine(const BLOCK_TEXELS& block, const float start[3], const float end[3], int steps, int positions[16])
+	{
+		float direction[3] = { end[0] - start[0], end[1] - start[1], end[2] - start[2] };
+		float lengthSquared = (direction[0] * direction[0]) + (direction[1] * direction[1]) + (direction[2] * direction[2]);
+		float scale = (lengthSquared > 0.0f) ? ((float)steps / lengthSquared) : 0.0f;
+
+#ifdef TEXTURE_CACHE_SSE2
+		__m128 startR = _mm_set1_ps(start[0]);
+		__m128 startG = _mm_set1_ps(start[1]);
+		__m128 startB = _mm_set1_ps(start[2]);
+		__m128 directionR = _mm_set1_ps(direction[0] * scale);
+		__m128 directionG = _mm_set1_ps(direction[1] * scale);
+		__m128 directionB = _mm_set1_ps(direction[2] * scale);
+		__m128 zero = _mm_setzero_ps();
+		__m128 maximum = _mm_set1_ps((float)steps);
+
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128 t = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.r + i), startR), directionR);
+			t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.g + i), startG), directionG));
+			t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.b + i), startB), directionB));
+			t = _mm_min_ps(_mm_max_ps(t, zero), maximum);
+			// the conversion rounds to the nearest step
+			_mm_storeu_si128((__m128i*)(positions + i), _mm_cvtps_epi32(t));
+		}
+#else
+		for (int i = 0; i < 16; i++)
+		{
+			float t = ((block.r[i] - start[0]) * direction[0]
+				+ (block.g[i] - start[1]) * direction[1]
+				+ (block.b[i] - start[2]) * direction[2]) * scale;
+			t = std::min(std::max(t, 0.0f), (float)steps);
+			positions[i] = (int)(t + 0.5f);
+		}
+#endif
+	}
+
+	uint16_t PackColor565(const float color[3])
+	{
+		int r = (int)((color[0] * 31.0f / 255.0f) + 0.5f);
+		int g = (int)((color[1] * 63.0f / 255.0f) + 0.5f);
+		int b = (int)((color[2] * 31.0f / 255.0f) + 0.5f);
+		return (uint16_t)((std::min(r, 31) << 11) | (std::min(g, 63) << 5) | std::min(b, 31));
+	}
+
+	void UnpackColor565(uint16_t packed, float color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+	}
+
+	/***********************************************************
+	 *  EncodeColorBlock()
+	 *
+	 *  Encode the colors of a block into 8 bytes of BC1 data,
+	 *  always in the four color mode.  The endpoints are the
+	 *  inset corners of the bounding box, on the diagonal that
+	 *  follows the correlation of the channels with green.
+	 ***********************************************************/
+	void EncodeColorBlock(const BLOCK_TEXELS& block, unsigned char* output)
+	{
+		float minColor[3];
+		float maxColor[3];
+		ComputeColorBounds(block, minColor, maxColor);
+
+		// pull the endpoints in slightly, since the extremes are
+		// rarely the best fit for the other texels
+		for (int c = 0; c < 3; c++)
+		{
+			float inset = (maxColor[c] - minColor[c]) / 16.0f;
+			minColor[c] += inset;
+			maxColor[c] -= inset;
+		}
+
+		// flip the red and blue range when they fall as green rises
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			mean[0] += block.r[i];
+			mean[1] += block.g[i];
+			mean[2] += block.b[i];
+		}
+		float covarianceRG = 0.0f;
+		float covarianceBG = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float dg = block.g[i] - (mean[1] / 16.0f);
+			covarianceRG += (block.r[i] - (mean[0] / 16.0f)) * dg;
+			covarianceBG += (block.b[i] - (mean[2] / 16.0f)) * dg;
+		}
+		if (covarianceRG < 0.0f)
+		{
+			std::swap(minColor[0], maxColor[0]);
+		}
+		if (covarianceBG < 0.0f)
+		{
+			std::swap(minColor[2], maxColor[2]);
+		}
+
+		uint16_t color0 = PackColor565(maxColor);
+		uint16_t color1 = PackColor565(minColor);
+		uint32_t indices = 0;
+
+		// the larger packed value first selects the four color mode
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		if (color0 != color1)
+		{
+			float endpoint0[3];
+			float endpoint1[3];
+			int positions[16];
+			// line positions 0..3 map to the palette entries 0, 2, 3, 1
+			const uint32_t paletteIndex[4] = { 0, 2, 3, 1 };
+
+			UnpackColor565(color0, endpoint0);
+			UnpackColor565(color1, endpoint1);
+			ProjectOntoLine(block, endpoint0, endpoint1, 3, positions);
+			for (int i = 0; i < 16; i++)
+			{
+				indices |= paletteIndex[positions[i]] << (i * 2);
+			}
+		}
+
+		memcpy(output, &color0, 2);
+		memcpy(output + 2, &color1, 2);
+		memcpy(output + 4, &indices, 4);
+	}
+
+	/***********************************************************
+	 *  EncodeAlphaBlock()
+	 *
+	 *  Encode the alpha of a block into 8 bytes of BC3 alpha
+	 *  data, using the eight value mode between its extremes.
+	 ***********************************************************/
+	void EncodeAlphaBlock(const BLOCK_TEXELS& block, unsigned char* output)
+	{
+		float minAlpha = block.a[0];
+		float maxAlpha = block.a[0];
+		for (int i = 1; i < 16; i++)
+		{
+			minAlpha = std::min(minAlpha, block.a[i]);
+			maxAlpha = std::max(maxAlpha, block.a[i]);
+		}
+
+		unsigned char alpha0 = (unsigned char)maxAlpha;
+		unsigned char alpha1 = (unsigned char)minAlpha;
+		uint64_t indices = 0;
+
+		if (alpha0 != alpha1)
+		{
+			float scale = 7.0f / (maxAlpha - minAlpha);
+			for (int i = 0; i < 16; i++)
+			{
+				int position = (int)(((block.a[i] - minAlpha) * scale) + 0.5f);
+				// line positions 0..7 from the minimum map to palette
+				// entry 1 for the minimum, 0 for the maximum, and 8-n
+				// for the values in between
+				uint64_t paletteIndex = (position == 7) ? 0 : ((position == 0) ? 1 : (uint64_t)(8 - position));
+				indices |= paletteIndex << (i * 3);
+			}
+		}
+
+		output[0] = alpha0;
+		output[1] = alpha1;
+		for (int i = 0; i < 6; i++)
+		{
+			output[2 + i] = (unsigned char)(indices >> (i * 8));
+		}
+	}
+
+	/***********************************************************
+	 *  CompressLevel()
+	 *
+	 *  Encode one RGBA mip level into BC1 or BC3 blocks.  The
+	 *  blocks along the right and bottom edges repeat the last
+	 *  texel when the level is not a multiple of four.
+	 ***********************************************************/
+	void CompressLevel(const unsigned char* texels, int width, int height, bool bAlpha, unsigned char* output)
+	{
+		BLOCK_TEXELS block;
+		int blocksX = (width + 3) / 4;
+		int blocksY = (height + 3) / 4;
+
+		for (int by = 0; by < blocksY; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				for (int i = 0; i < 16; i++)
+				{
+					int x = std::min((bx * 4) + (i % 4), width - 1);
+					int y = std::min((by * 4) + (i / 4), height - 1);
+					const unsigned char* texel = &texels[((size_t)y * width + x) * 4];
+					block.r[i] = texel[0];
+					block.g[i] = texel[1];
+					block.b[i] = texel[2];
+					block.a[i] = texel[3];
+				}
+
+				if (bAlpha)
+				{
+					EncodeAlphaBlock(block, output);
+					output += 8;
+				}
+				EncodeColorBlock(block, output);
+				output += 8;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache(std::string cacheFolder)
+{
+	m_cacheFolder = cacheFolder;
+}
+
+/***********************************************************
+ *  GetCacheFilename()
+ *
+ *  This method is used for getting the name of the cache
+ *  file that holds the compressed mips of a source image.
+ ***********************************************************/
+std::string TextureCache::GetCacheFilename(const std::string& sourceFile)
+{
+	std::filesystem::path cacheFile = std::filesystem::path(m_cacheFolder) / std::filesystem::path(sourceFile).filename();
+	cacheFile.replace_extension(".ktx2");
+	return cacheFile.string();
+}
+
+/***********************************************************
+ *  ParseCacheFile()
+ *
+ *  This method is used for checking the header of a mapped
+ *  cache file and reading its mip level table.  Every level
+ *  must have the size its dimensions need, inside the file.
+ ***********************************************************/
+bool TextureCache::ParseCacheFile(COMPRESSED_TEXTURE& texture)
+{
+	const unsigned char* data = texture.data;
+	size_t dataSize = texture.dataSize;
+
+	if ((data == NULL) || (dataSize < g_KTX2HeaderSize) || (memcmp(data, g_KTX2Identifier, sizeof(g_KTX2Identifier)) != 0))
+	{
+		return false;
+	}
+
+	uint32_t vkFormat = ReadUInt32(data, 12);
+	size_t blockSize = 0;
+	if (vkFormat == g_VkFormatBC1RGB)
+	{
+		texture.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		blockSize = 8;
+	}
+	else if (vkFormat == g_VkFormatBC3)
+	{
+		texture.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		blockSize = 16;
+	}
+	else
+	{
+		return false;
+	}
+
+	texture.width = (int)ReadUInt32(data, 20);
+	texture.height = (int)ReadUInt32(data, 24);
+	uint32_t levelCount = ReadUInt32(data, 40);
+	if ((texture.width <= 0) || (texture.height <= 0) || (levelCount == 0) || (levelCount > 16) ||
+		(g_KTX2HeaderSize + (levelCount * g_KTX2LevelIndexSize) > dataSize))
+	{
+		return false;
+	}
+
+	texture.levels.clear();
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		size_t entry = g_KTX2HeaderSize + (i * g_KTX2LevelIndexSize);
+		COMPRESSED_LEVEL level;
+		level.width = std::max(1, texture.width >> i);
+		level.height = std::max(1, texture.height >> i);
+		level.offset = (size_t)ReadUInt64(data, entry);
+		level.size = (size_t)ReadUInt64(data, entry + 8);
+
+		if ((level.size != GetLevelSize(level.width, level.height, blockSize)) ||
+			(level.offset > dataSize) || (level.size > dataSize - level.offset))
+		{
+			return false;
+		}
+		texture.levels.push_back(level);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  EncodeTexture()
+ *
+ *  This method is used for decoding a source image, building
+ *  its full mip chain and compressing every level - BC1 for
+ *  images without alpha, BC3 for images with alpha.  The
+ *  result is laid out as a KTX2 file, with the levels stored
+ *  smallest first, and kept in memory as the texture data.
+ *  The rows keep the bottom-up order of the other textures.
+ ***********************************************************/
+bool TextureCache::EncodeTexture(const std::string& sourceFile, COMPRESSED_TEXTURE& texture)
+{
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+
+	AssetFile source;
+	if (!source.Open(sourceFile))
+	{
+		return false;
+	}
+
+	unsigned char* image = stbi_load_from_memory(source.GetData(), (int)source.GetSize(), &width, &height, &colorChannels, 0);
+	if (image == NULL)
+	{
+		return false;
+	}
+
+	// expand to RGBA so every level is encoded the same way, and
+	// filter the mips in linear space
+	ImageProcessing::PROCESS_OPTIONS options;
+	options.bFlipVertical = true;
+	options.bPremultiplyAlpha = false;
+	options.mipFilter = ImageProcessing::kaiser;
+	options.maxLevels = 0;
+	options.skipLevels = 0;
+	ImageProcessing::PROCESSED_IMAGE mips;
+	bool bProcessed = ImageProcessing::Process(image, width, height, colorChannels, options, mips);
+	stbi_image_free(image);
+	if (!bProcessed)
+	{
+		return false;
+	}
+
+	bool bAlpha = mips.bAlpha;
+	size_t blockSize = bAlpha ? 16 : 8;
+
+	size_t levelCount = mips.levels.size();
+	uint32_t sampleCount = bAlpha ? 2 : 1;
+	size_t dfdOffset = g_KTX2HeaderSize + (levelCount * g_KTX2LevelIndexSize);
+	size_t dfdSize = 4 + 24 + (16 * sampleCount);
+
+	// lay out the levels, smallest first, aligned to the block size
+	texture.levels.resize(levelCount);
+	size_t fileSize = dfdOffset + dfdSize;
+	for (int i = (int)levelCount - 1; i >= 0; i--)
+	{
+		fileSize = AlignOffset(fileSize, blockSize);
+		texture.levels[i].offset = fileSize;
+		texture.levels[i].size = GetLevelSize(mips.levels[i].width, mips.levels[i].height, blockSize);
+		texture.levels[i].width = mips.levels[i].width;
+		texture.levels[i].height = mips.levels[i].height;
+		fileSize += texture.levels[i].size;
+	}
+
+	std::vector<unsigned char>& file = texture.encodedFile;
+	file.assign(fileSize, 0);
+
+	// header
+	memcpy(&file[0], g_KTX2Identifier, sizeof(g_KTX2Identifier));
+	WriteUInt32(file, 12, bAlpha ? g_VkFormatBC3 : g_VkFormatBC1RGB);
+	WriteUInt32(file, 16, 1);
+	WriteUInt32(file, 20, (uint32_t)width);
+	WriteUInt32(file, 24, (uint32_t)height);
+	WriteUInt32(file, 28, 0);
+	WriteUInt32(file, 32, 0);
+	WriteUInt32(file, 36, 1);
+	WriteUInt32(file, 40, (uint32_t)levelCount);
+	WriteUInt32(file, 44, 0);
+
+	// index - a data format descriptor, no key/value or global data
+	WriteUInt32(file, 48, (uint32_t)dfdOffset);
+	WriteUInt32(file, 52, (uint32_t)dfdSize);
+
+	// level index
+	for (size_t i = 0; i < levelCount; i++)
+	{
+		size_t entry = g_KTX2HeaderSize + (i * g_KTX2LevelIndexSize);
+		WriteUInt64(file, entry, texture.levels[i].offset);
+		WriteUInt64(file, entry + 8, texture.levels[i].size);
+		WriteUInt64(file, entry + 16, (uint64_t)mips.levels[i].width * mips.levels[i].height * 4);
+	}
+
+	// basic data format descriptor - BC1 or BC3 model, BT.709
+	// primaries, linear transfer, 4x4 blocks
+	WriteUInt32(file, dfdOffset, (uint32_t)dfdSize);
+	WriteUInt32(file, dfdOffset + 4, 0);
+	WriteUInt32(file, dfdOffset + 8, 2 | ((uint32_t)(dfdSize - 4) << 16));
+	WriteUInt32(file, dfdOffset + 12, (bAlpha ? 130 : 128) | (1 << 8) | (1 << 16));
+	WriteUInt32(file, dfdOffset + 16, 3 | (3 << 8));
+	WriteUInt32(file, dfdOffset + 20, (uint32_t)blockSize);
+	WriteUInt32(file, dfdOffset + 24, 0);
+	for (uint32_t i = 0; i < sampleCount; i++)
+	{
+		size_t sample = dfdOffset + 28 + (i * 16);
+		// BC3 stores the alpha block before the color block
+		uint32_t channel = (bAlpha && (i == 0)) ? 15 : 0;
+		WriteUInt32(file, sample, (i * 64) | (63 << 16) | (channel << 24));
+		WriteUInt32(file, sample + 8, 0);
+		WriteUInt32(file, sample + 12, 0xFFFFFFFF);
+	}
+
+	for (size_t i = 0; i < levelCount; i++)
+	{
+		CompressLevel(&mips.texels[mips.levels[i].offset], mips.levels[i].width, mips.levels[i].height, bAlpha, &file[texture.levels[i].offset]);
+	}
+
+	texture.format = bAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	texture.width = width;
+	texture.height = height;
+	texture.data = file.data();
+	texture.dataSize = file.size();
+
+	return true;
+}
+
+/***********************************************************
+ *  LoadTexture()
+ *
+ *  This method is used for getting the compressed mips of a
+ *  source image.  An up to date cache file is mapped and
+ *  used as is.  Otherwise the image is encoded and the cache
+ *  file is rewritten for the next run - written to a
+ *  temporary name first so a reader never sees half a file.
+ ***********************************************************/
+bool TextureCache::LoadTexture(const std::string& sourceFile, COMPRESSED_TEXTURE& texture)
+{
+	std::string cacheFile = GetCacheFilename(sourceFile);
+	std::error_code error;
+
+	// the cache is stale when the source image has been changed
+	// since - a packed cache file was built with its source
+	bool bCacheValid = AssetFile::IsPacked(cacheFile);
+	if (!bCacheValid)
+	{
+		bCacheValid = std::filesystem::exists(cacheFile, error);
+		if (bCacheValid && std::filesystem::exists(sourceFile, error))
+		{
+			bCacheValid = std::filesystem::last_write_time(cacheFile, error) >= std::filesystem::last_write_time(sourceFile, error);
+		}
+	}
+
+	if (bCacheValid && texture.cacheFile.Open(cacheFile))
+	{
+		texture.data = texture.cacheFile.GetData();
+		texture.dataSize = texture.cacheFile.GetSize();
+		if (ParseCacheFile(texture))
+		{
+			return true;
+		}
+		std::cout << "Ignoring invalid texture cache file:" << cacheFile << std::endl;
+		texture.cacheFile.Close();
+	}
+
+	if (!EncodeTexture(sourceFile, texture))
+	{
+		return false;
+	}
+
+	std::string tempFile = cacheFile + ".tmp";
+	std::filesystem::create_directories(m_cacheFolder, error);
+	{
+		std::ofstream output(tempFile, std::ios::binary | std::ios::trunc);
+		output.write((const char*)texture.encodedFile.data(), (std::streamsize)texture.encodedFile.size());
+		if (!output.good())
+		{
+			std::cout << "Could not write texture cache file:" << cacheFile << std::endl;
+			return true;
+		}
+	}
+	std::filesystem::rename(tempFile, cacheFile, error);
+	if (error)
+	{
+		std::cout << "Could not write texture cache file:" << cacheFile << std::endl;
+		std::filesystem::remove(tempFile, error);
+	}
+
+	return true;
+}
+
+/***********************************************************
+ *  SkipLevels()
+ *
+ *  This method is used for leaving the largest mip levels
+ *  out of a loaded texture, which is then created at the
+ *  size of the first level that is left.  The data of the
+ *  skipped levels stays in the mapped file, so it is never
+ *  read.  The smallest level is always kept.
+ ***********************************************************/
+void TextureCache::SkipLevels(COMPRESSED_TEXTURE& texture, int count)
+{
+	count = std::min(count, (int)texture.levels.size() - 1);
+	if (count <= 0)
+	{
+		return;
+	}
+
+	texture.levels.erase(texture.levels.begin(), texture.levels.begin() + count);
+	texture.width = texture.levels[0].width;
+	texture.height = texture.levels[0].height;
+}
+
+/***********************************************************
+ *  CreateGLTexture()
+ *
+ *  This method is used for creating an OpenGL texture with
+ *  the same mapping parameters as the uncompressed textures
+ *  and uploading every compressed mip level, so no mipmaps
+ *  have to be generated.  With a pixel unpack buffer bound
+ *  the level offsets are used as buffer offsets.
+ ***********************************************************/
+GLuint TextureCache::CreateGLTexture(const COMPRESSED_TEXTURE& texture, bool bFromPixelBuffer)
+{
+	GLuint textureID = 0;
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		const COMPRESSED_LEVEL& level = texture.levels[i];
+		const void* pLevelData = bFromPixelBuffer ? (const void*)level.offset : (const void*)(texture.data + level.offset);
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, texture.format, level.width, level.height, 0, (GLsizei)level.size, pLevelData);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return textureID;
+}
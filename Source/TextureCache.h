@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// transcode texture images into block compressed mip chains, store them in
+// cache files, and upload the compressed mips directly on later runs
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AssetFile.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class contains the code for loading block compressed
+ *  textures.  The first time an image is loaded it is decoded,
+ *  its mip levels are built and encoded to BC1 (RGB) or BC3
+ *  (RGBA), and the result is written to a KTX2 file in the
+ *  cache folder.  Later loads map the cache file and hand the
+ *  compressed mips straight to OpenGL.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// constructor
+	TextureCache(std::string cacheFolder);
+
+	// one mip level inside the compressed texture data
+	struct COMPRESSED_LEVEL
+	{
+		size_t offset;
+		size_t size;
+		int width;
+		int height;
+	};
+
+	// a compressed texture and the memory holding its mip levels -
+	// either the mapped cache file, packed or loose, or a freshly
+	// encoded copy
+	struct COMPRESSED_TEXTURE
+	{
+		GLenum format;
+		int width;
+		int height;
+		std::vector<COMPRESSED_LEVEL> levels;
+		const unsigned char* data;
+		size_t dataSize;
+		AssetFile cacheFile;
+		std::vector<unsigned char> encodedFile;
+	};
+
+private:
+	// folder the cache files are written to
+	std::string m_cacheFolder;
+
+	// get the cache file name for a source image
+	std::string GetCacheFilename(const std::string& sourceFile);
+	// read the mip level table of a mapped cache file
+	bool ParseCacheFile(COMPRESSED_TEXTURE& texture);
+	// decode, build the mips of and compress a source image
+	bool EncodeTexture(const std::string& sourceFile, COMPRESSED_TEXTURE& texture);
+
+public:
+	// load the compressed mips of a source image, encoding them and
+	// writing the cache file when needed - safe on worker threads
+	bool LoadTexture(const std::string& sourceFile, COMPRESSED_TEXTURE& texture);
+
+	// leave the largest mip levels out of a loaded texture
+	static void SkipLevels(COMPRESSED_TEXTURE& texture, int count);
+
+	// create an OpenGL texture from the compressed mips - the data
+	// is read from the bound pixel unpack buffer when requested
+	static GLuint CreateGLTexture(const COMPRESSED_TEXTURE& texture, bool bFromPixelBuffer);
+};
@@ -0,0 +1,472 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.cpp
+// ============
+// keep only the mip levels of each compressed texture that the view needs
+// resident, within a GPU memory budget
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	// levels up to this size are loaded first and never evicted
+	const int g_MinimumResidentSize = 64;
+	// levels added per frame, so streaming never stalls a frame
+	const int g_MaxLevelLoadsPerFrame = 2;
+}
+
+/***********************************************************
+ *  TextureStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureStreamer::TextureStreamer(size_t budgetBytes)
+{
+	m_budgetBytes = budgetBytes;
+	m_residentBytes = 0;
+	m_frame = 0;
+}
+
+/***********************************************************
+ *  ~TextureStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureStreamer::~TextureStreamer()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for releasing every streamed texture
+ *  and its mapped mips.  The texture objects are freed with
+ *  the last handle of their shared resources.
+ ***********************************************************/
+void TextureStreamer::Clear()
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		delete m_textures[i].source;
+	}
+	m_textures.clear();
+	m_residentBytes = 0;
+
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	for (size_t i = 0; i < m_queuedTextures.size(); i++)
+	{
+		delete m_queuedTextures[i].source;
+	}
+	m_queuedTextures.clear();
+}
+
+/***********************************************************
+ *  SetBudget()
+ *
+ *  This method is used for setting the GPU memory budget of
+ *  the streamed levels.  A smaller budget is reached by the
+ *  evictions of the following frames.
+ ***********************************************************/
+void TextureStreamer::SetBudget(size_t budgetBytes)
+{
+	m_budgetBytes = budgetBytes;
+}
+
+/***********************************************************
+ *  GetLevelRangeBytes()
+ *
+ *  This method is used for getting the GPU memory used by
+ *  the levels from the passed in base level to the smallest.
+ ***********************************************************/
+size_t TextureStreamer::GetLevelRangeBytes(const STREAMED_TEXTURE& texture, int baseLevel)
+{
+	size_t bytes = 0;
+	for (size_t i = (size_t)baseLevel; i < texture.source->levels.size(); i++)
+	{
+		bytes += texture.source->levels[i].size;
+	}
+	return bytes;
+}
+
+/***********************************************************
+ *  SetResidentBaseLevel()
+ *
+ *  This method is used for changing the resident levels of
+ *  a texture.  Raising the base level of an existing texture
+ *  object does not free its memory, so a new object holding
+ *  only the levels from the base level down is created from
+ *  the mapped cache file and replaces the old one in the
+ *  shared resource.
+ ***********************************************************/
+void TextureStreamer::SetResidentBaseLevel(STREAMED_TEXTURE& texture, int baseLevel)
+{
+	const TextureCache::COMPRESSED_TEXTURE& source = *texture.source;
+	int levelCount = (int)source.levels.size();
+	GLuint textureID = 0;
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1 - baseLevel);
+
+	for (int i = baseLevel; i < levelCount; i++)
+	{
+		const TextureCache::COMPRESSED_LEVEL& level = source.levels[i];
+		glCompressedTexImage2D(GL_TEXTURE_2D, i - baseLevel, source.format, level.width, level.height, 0,
+			(GLsizei)level.size, source.data + level.offset);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (texture.resource->textureID != 0)
+	{
+		glDeleteTextures(1, &texture.resource->textureID);
+	}
+	m_residentBytes -= texture.residentBytes;
+
+	texture.resource->textureID = textureID;
+	texture.residentBaseLevel = baseLevel;
+	texture.residentBytes = GetLevelRangeBytes(texture, baseLevel);
+	m_residentBytes += texture.residentBytes;
+}
+
+/***********************************************************
+ *  EvictOneLevel()
+ *
+ *  This method is used for dropping the most detailed level
+ *  of one texture to make room in the budget.  Textures with
+ *  more detail than they want go first, then the least
+ *  recently sampled.  A texture sampled as recently as the
+ *  one that needs the room is never evicted for it, so two
+ *  visible textures cannot keep trading the same memory.
+ ***********************************************************/
+bool TextureStreamer::EvictOneLevel(int keepIndex)
+{
+	int victim = -1;
+	// without a texture to keep, the textures sampled last frame are kept
+	unsigned int keepFrame = (keepIndex >= 0) ? m_textures[keepIndex].lastUsedFrame : m_frame;
+
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		const STREAMED_TEXTURE& texture = m_textures[i];
+		if ((i == keepIndex) || (texture.residentBaseLevel >= texture.minimumBaseLevel))
+		{
+			continue;
+		}
+
+		bool bOverDetailed = (texture.residentBaseLevel < texture.wantedBaseLevel);
+		if (!bOverDetailed && (texture.lastUsedFrame >= keepFrame))
+		{
+			continue;
+		}
+
+		if (victim < 0)
+		{
+			victim = i;
+			continue;
+		}
+
+		bool bVictimOverDetailed = (m_textures[victim].residentBaseLevel < m_textures[victim].wantedBaseLevel);
+		if ((bOverDetailed && !bVictimOverDetailed) ||
+			((bOverDetailed == bVictimOverDetailed) && (texture.lastUsedFrame < m_textures[victim].lastUsedFrame)))
+		{
+			victim = i;
+		}
+	}
+
+	if (victim < 0)
+	{
+		return false;
+	}
+
+	STREAMED_TEXTURE& texture = m_textures[victim];
+	SetResidentBaseLevel(texture, texture.residentBaseLevel + 1);
+	std::cout << "Evicted texture level " << (texture.residentBaseLevel - 1) << " of " << texture.tag
+		<< " - " << (m_residentBytes / 1024) << " KB of " << (m_budgetBytes / 1024) << " KB resident" << std::endl;
+
+	return true;
+}
+
+/***********************************************************
+ *  FindTexture()
+ *
+ *  This method is used for getting the index of the streamed
+ *  texture in a slot, or -1 when the slot is not streamed.
+ ***********************************************************/
+int TextureStreamer::FindTexture(int slot)
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if (m_textures[i].slot == slot)
+		{
+			return (int)i;
+		}
+	}
+
+	return -1;
+}
+
+/***********************************************************
+ *  QueueTexture()
+ *
+ *  This method is used for handing over a compressed texture
+ *  to be streamed into a texture slot.  It may be called from
+ *  the decoding workers; the texture is adopted on the next
+ *  Update() on the render thread, which is when the resource
+ *  receives its first texture object.
+ ***********************************************************/
+void TextureStreamer::QueueTexture(
+	std::string tag,
+	int slot,
+	TextureCache::COMPRESSED_TEXTURE* texture,
+	std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource)
+{
+	STREAMED_TEXTURE streamed;
+	streamed.tag = tag;
+	streamed.slot = slot;
+	streamed.source = texture;
+	streamed.resource = resource;
+	streamed.residentBaseLevel = (int)texture->levels.size();
+	streamed.residentBytes = 0;
+	streamed.lastUsedFrame = 0;
+	streamed.requestedBaseLevel = INT_MAX;
+
+	// the smallest levels are always resident
+	streamed.minimumBaseLevel = (int)texture->levels.size() - 1;
+	for (int i = 0; i < (int)texture->levels.size(); i++)
+	{
+		if ((texture->levels[i].width <= g_MinimumResidentSize) && (texture->levels[i].height <= g_MinimumResidentSize))
+		{
+			streamed.minimumBaseLevel = i;
+			break;
+		}
+	}
+	streamed.wantedBaseLevel = streamed.minimumBaseLevel;
+
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	m_queuedTextures.push_back(streamed);
+}
+
+/***********************************************************
+ *  RemoveTexture()
+ *
+ *  This method is used for stopping the streaming of the
+ *  texture of a shared resource, when its slot is given a
+ *  texture that replaces it.  The texture object stays with
+ *  the resource, and is freed with its last handle.
+ ***********************************************************/
+void TextureStreamer::RemoveTexture(std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource)
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if (m_textures[i].resource == resource)
+		{
+			m_residentBytes -= m_textures[i].residentBytes;
+			delete m_textures[i].source;
+			m_textures.erase(m_textures.begin() + i);
+			return;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+	for (size_t i = 0; i < m_queuedTextures.size(); i++)
+	{
+		if (m_queuedTextures[i].resource == resource)
+		{
+			delete m_queuedTextures[i].source;
+			m_queuedTextures.erase(m_queuedTextures.begin() + i);
+			return;
+		}
+	}
+}
+
+/***********************************************************
+ *  IsStreamed()
+ *
+ *  This method is used for checking if a slot holds a
+ *  streamed texture.
+ ***********************************************************/
+bool TextureStreamer::IsStreamed(int slot)
+{
+	return FindTexture(slot) >= 0;
+}
+
+/***********************************************************
+ *  RecordUse()
+ *
+ *  This method is used for recording that the texture in a
+ *  slot is sampled this frame.  A texture spread across fewer
+ *  pixels than its width only needs the level whose width is
+ *  closest to that number of pixels.
+ ***********************************************************/
+void TextureStreamer::RecordUse(int slot, float projectedPixels)
+{
+	int index = FindTexture(slot);
+	if (index < 0)
+	{
+		return;
+	}
+
+	STREAMED_TEXTURE& texture = m_textures[index];
+	int levelCount = (int)texture.source->levels.size();
+	float textureSize = (float)std::max(texture.source->width, texture.source->height);
+	float texelsPerPixel = textureSize / std::max(projectedPixels, 1.0f);
+	int level = (texelsPerPixel > 1.0f) ? (int)std::floor(std::log2(texelsPerPixel)) : 0;
+	level = std::min(level, levelCount - 1);
+
+	texture.requestedBaseLevel = std::min(texture.requestedBaseLevel, level);
+	texture.lastUsedFrame = m_frame;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for adopting the queued textures with
+ *  their smallest levels, then adding the next level to the
+ *  textures that want more detail, most recently used first.
+ *  Room is made by evicting levels when the budget is full.
+ *  The texture objects that changed are published through
+ *  their shared resources, so their slots must be bound
+ *  again.
+ ***********************************************************/
+void TextureStreamer::Update()
+{
+	std::vector<STREAMED_TEXTURE> queued;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		queued.swap(m_queuedTextures);
+	}
+	for (size_t i = 0; i < queued.size(); i++)
+	{
+		m_textures.push_back(queued[i]);
+		SetResidentBaseLevel(m_textures.back(), m_textures.back().minimumBaseLevel);
+	}
+
+	// the requests recorded during the last frame set the wanted levels,
+	// textures that were not sampled keep what they wanted before
+	std::vector<int> order;
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		STREAMED_TEXTURE& texture = m_textures[i];
+		if (texture.requestedBaseLevel != INT_MAX)
+		{
+			texture.wantedBaseLevel = std::min(texture.requestedBaseLevel, texture.minimumBaseLevel);
+			texture.requestedBaseLevel = INT_MAX;
+		}
+		if (texture.residentBaseLevel > texture.wantedBaseLevel)
+		{
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b)
+	{
+		if (m_textures[a].lastUsedFrame != m_textures[b].lastUsedFrame)
+		{
+			return m_textures[a].lastUsedFrame > m_textures[b].lastUsedFrame;
+		}
+		return (m_textures[a].residentBaseLevel - m_textures[a].wantedBaseLevel) >
+			(m_textures[b].residentBaseLevel - m_textures[b].wantedBaseLevel);
+	});
+
+	int loads = 0;
+	for (size_t i = 0; (i < order.size()) && (loads < g_MaxLevelLoadsPerFrame); i++)
+	{
+		STREAMED_TEXTURE& texture = m_textures[order[i]];
+		int nextLevel = texture.residentBaseLevel - 1;
+		size_t extraBytes = GetLevelRangeBytes(texture, nextLevel) - texture.residentBytes;
+
+		while ((m_residentBytes + extraBytes > m_budgetBytes) && EvictOneLevel(order[i]))
+		{
+		}
+		if (m_residentBytes + extraBytes > m_budgetBytes)
+		{
+			continue;
+		}
+
+		SetResidentBaseLevel(texture, nextLevel);
+		loads++;
+	}
+
+	// a lowered budget is met by evicting from the unused textures
+	while ((m_residentBytes > m_budgetBytes) && EvictOneLevel(-1))
+	{
+	}
+
+	m_frame++;
+}
+
+/***********************************************************
+ *  GetResidentBytes()
+ *
+ *  This method is used for getting the GPU memory used by
+ *  the resident levels of all streamed textures.
+ ***********************************************************/
+size_t TextureStreamer::GetResidentBytes()
+{
+	return m_residentBytes;
+}
+
+/***********************************************************
+ *  GetBudgetBytes()
+ *
+ *  This method is used for getting the GPU memory budget.
+ ***********************************************************/
+size_t TextureStreamer::GetBudgetBytes()
+{
+	return m_budgetBytes;
+}
+
+/***********************************************************
+ *  GetResidency()
+ *
+ *  This method is used for getting the current residency of
+ *  every streamed texture.
+ ***********************************************************/
+void TextureStreamer::GetResidency(std::vector<TEXTURE_RESIDENCY>& residency)
+{
+	residency.clear();
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		TEXTURE_RESIDENCY entry;
+		entry.tag = m_textures[i].tag;
+		entry.slot = m_textures[i].slot;
+		entry.levelCount = (int)m_textures[i].source->levels.size();
+		entry.residentBaseLevel = m_textures[i].residentBaseLevel;
+		entry.wantedBaseLevel = m_textures[i].wantedBaseLevel;
+		entry.residentBytes = m_textures[i].residentBytes;
+		entry.lastUsedFrame = m_textures[i].lastUsedFrame;
+		residency.push_back(entry);
+	}
+}
+
+/***********************************************************
+ *  PrintResidency()
+ *
+ *  This method is used for printing the residency of every
+ *  streamed texture and the budget use to the console.
+ ***********************************************************/
+void TextureStreamer::PrintResidency()
+{
+	std::vector<TEXTURE_RESIDENCY> residency;
+	GetResidency(residency);
+
+	std::cout << "\n***** TEXTURE RESIDENCY: *****\n";
+	for (size_t i = 0; i < residency.size(); i++)
+	{
+		std::cout << residency[i].tag << " - levels " << residency[i].residentBaseLevel << "-" << (residency[i].levelCount - 1)
+			<< " resident, level " << residency[i].wantedBaseLevel << " wanted, "
+			<< (residency[i].residentBytes / 1024) << " KB, last used frame " << residency[i].lastUsedFrame << "\n";
+	}
+	std::cout << (m_residentBytes / 1024) << " KB of " << (m_budgetBytes / 1024) << " KB budget resident" << std::endl;
+}
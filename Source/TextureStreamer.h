@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.h
+// ============
+// keep only the mip levels of each compressed texture that the view needs
+// resident, within a GPU memory budget
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ResourceRegistry.h"
+#include "TextureCache.h"
+
+#include <GL/glew.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureStreamer
+ *
+ *  This class contains the code for streaming the mip levels
+ *  of block compressed textures.  New textures start with
+ *  only their smallest levels resident.  Every frame the
+ *  projected size of each sampled texture decides the most
+ *  detailed level it needs, and levels are added one at a
+ *  time while the budget allows.  When the budget is full,
+ *  the top levels of the least recently sampled textures are
+ *  evicted first.
+ ***********************************************************/
+class TextureStreamer
+{
+public:
+	// constructor
+	TextureStreamer(size_t budgetBytes);
+	// destructor
+	~TextureStreamer();
+
+	// instrumentation for one streamed texture
+	struct TEXTURE_RESIDENCY
+	{
+		std::string tag;
+		int slot;
+		int levelCount;
+		// most detailed level that is resident, and that is wanted
+		int residentBaseLevel;
+		int wantedBaseLevel;
+		size_t residentBytes;
+		unsigned int lastUsedFrame;
+	};
+
+private:
+	struct STREAMED_TEXTURE
+	{
+		std::string tag;
+		int slot;
+		// the mip levels, kept mapped for reloading
+		TextureCache::COMPRESSED_TEXTURE* source;
+		// the shared texture, whose object is replaced on every change
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource;
+		int residentBaseLevel;
+		int wantedBaseLevel;
+		// least detailed level that is never evicted
+		int minimumBaseLevel;
+		size_t residentBytes;
+		unsigned int lastUsedFrame;
+		// most detailed level requested during the current frame
+		int requestedBaseLevel;
+	};
+
+	size_t m_budgetBytes;
+	size_t m_residentBytes;
+	unsigned int m_frame;
+	std::vector<STREAMED_TEXTURE> m_textures;
+
+	// textures queued from other threads, adopted in Update()
+	std::mutex m_queueMutex;
+	std::vector<STREAMED_TEXTURE> m_queuedTextures;
+
+	// get the bytes needed for the levels from base to the smallest
+	size_t GetLevelRangeBytes(const STREAMED_TEXTURE& texture, int baseLevel);
+	// replace the texture object with one holding the levels from base
+	void SetResidentBaseLevel(STREAMED_TEXTURE& texture, int baseLevel);
+	// evict one level from the best candidate other than the passed in
+	// texture, returns false when nothing can be evicted
+	bool EvictOneLevel(int keepIndex);
+	int FindTexture(int slot);
+
+public:
+	// set the GPU memory budget for the streamed levels
+	void SetBudget(size_t budgetBytes);
+	// hand over a compressed texture to be streamed into a slot and
+	// the shared resource that receives its texture objects - safe to
+	// call from any thread, the streamer takes ownership of the mips
+	void QueueTexture(
+		std::string tag,
+		int slot,
+		TextureCache::COMPRESSED_TEXTURE* texture,
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource);
+	// stop streaming the texture of a shared resource, which keeps the
+	// levels that are resident - call on the render thread
+	void RemoveTexture(std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource);
+	// check if a slot holds a streamed texture
+	bool IsStreamed(int slot);
+	// record that the texture in a slot is sampled this frame across
+	// the passed in number of pixels on screen
+	void RecordUse(int slot, float projectedPixels);
+	// adopt queued textures and move the resident levels toward the
+	// wanted levels - call once per frame on the render thread
+	void Update();
+	// stop streaming all of the textures
+	void Clear();
+
+	// instrumentation
+	size_t GetResidentBytes();
+	size_t GetBudgetBytes();
+	void GetResidency(std::vector<TEXTURE_RESIDENCY>& residency);
+	void PrintResidency();
+};
@@ -0,0 +1,338 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureuploader.cpp
+// ============
+// upload decoded texture images on a loader thread with its own shared
+// OpenGL context, streaming the texels through a ring of pixel buffers
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureUploader.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// number of pixel buffers in the upload ring - enough for the
+	// loader to fill one while the GPU still reads the others
+	const int g_StagingBufferCount = 3;
+}
+
+/***********************************************************
+ *  TextureUploader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureUploader::TextureUploader(GLFWwindow* pSharedWindow)
+{
+	m_pLoaderWindow = NULL;
+	m_pendingUploads = 0;
+	m_bStopping = false;
+	m_nextStagingBuffer = 0;
+
+	if (NULL == pSharedWindow)
+	{
+		return;
+	}
+
+	// the loader context only needs a tiny invisible window, and
+	// it is created with the same context version as the display
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_pLoaderWindow = glfwCreateWindow(1, 1, "texture loader", NULL, pSharedWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (NULL == m_pLoaderWindow)
+	{
+		std::cout << "Could not create the texture loader context - textures will load on the render thread" << std::endl;
+		return;
+	}
+
+	m_thread = std::thread(&TextureUploader::LoaderLoop, this);
+}
+
+/***********************************************************
+ *  ~TextureUploader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureUploader::~TextureUploader()
+{
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStopping = true;
+		}
+		m_requestAvailable.notify_all();
+		m_thread.join();
+	}
+
+	// free the texels of any requests that were never uploaded
+	for (size_t i = 0; i < m_requests.size(); i++)
+	{
+		delete m_requests[i].processed;
+		delete m_requests[i].compressed;
+	}
+	m_requests.clear();
+
+	// the fences belong to the shared object namespace, so they
+	// can be deleted from the render thread
+	for (size_t i = 0; i < m_results.size(); i++)
+	{
+		glDeleteSync(m_results[i].fence);
+	}
+	m_results.clear();
+
+	if (NULL != m_pLoaderWindow)
+	{
+		glfwDestroyWindow(m_pLoaderWindow);
+		m_pLoaderWindow = NULL;
+	}
+}
+
+/***********************************************************
+ *  LoaderLoop()
+ *
+ *  This method is run by the loader thread.  It makes the
+ *  shared context current, uploads the queued requests, and
+ *  frees the pixel buffers before the thread exits.
+ ***********************************************************/
+void TextureUploader::LoaderLoop()
+{
+	glfwMakeContextCurrent(m_pLoaderWindow);
+
+	// the decoded rows are tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	m_stagingBuffers.resize(g_StagingBufferCount);
+	for (int i = 0; i < g_StagingBufferCount; i++)
+	{
+		glGenBuffers(1, &m_stagingBuffers[i].pbo);
+		m_stagingBuffers[i].size = 0;
+		m_stagingBuffers[i].fence = NULL;
+	}
+
+	while (true)
+	{
+		UPLOAD_REQUEST request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_requestAvailable.wait(lock, [this] { return m_bStopping || !m_requests.empty(); });
+			if (m_bStopping)
+			{
+				break;
+			}
+			request = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		PENDING_RESULT pending;
+		pending.result.tag = request.tag;
+		pending.result.slot = request.slot;
+		pending.result.resource = request.resource;
+		if (!pending.result.resource)
+		{
+			GLuint textureID = UploadTexture(request);
+			if (textureID != 0)
+			{
+				pending.result.resource = ResourceRegistry::Get().RegisterTexture(request.contentHash, request.tag, textureID);
+			}
+		}
+
+		// publish the texture once the GPU has finished with it - the
+		// flush makes the fence visible to the render context
+		pending.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_results.push_back(pending);
+	}
+
+	for (size_t i = 0; i < m_stagingBuffers.size(); i++)
+	{
+		if (m_stagingBuffers[i].fence != NULL)
+		{
+			glDeleteSync(m_stagingBuffers[i].fence);
+		}
+		glDeleteBuffers(1, &m_stagingBuffers[i].pbo);
+	}
+	m_stagingBuffers.clear();
+
+	glfwMakeContextCurrent(NULL);
+}
+
+/***********************************************************
+ *  UploadTexture()
+ *
+ *  This method is used for copying the pixels of a request
+ *  into the next pixel buffer of the ring and creating the
+ *  texture from it, so the copy into video memory happens
+ *  asynchronously.  The buffer is only reused after the
+ *  fence of its previous upload has been signalled.
+ ***********************************************************/
+GLuint TextureUploader::UploadTexture(UPLOAD_REQUEST& request)
+{
+	GLuint textureID = 0;
+	bool bCompressed = (request.compressed != NULL);
+
+	if (!bCompressed && (request.processed == NULL))
+	{
+		std::cout << "Could not upload texture:" << request.tag << std::endl;
+		return 0;
+	}
+
+	STAGING_BUFFER& staging = m_stagingBuffers[m_nextStagingBuffer];
+	m_nextStagingBuffer = (m_nextStagingBuffer + 1) % (int)m_stagingBuffers.size();
+
+	// wait for the GPU to finish reading the previous upload
+	if (staging.fence != NULL)
+	{
+		glClientWaitSync(staging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(staging.fence);
+		staging.fence = NULL;
+	}
+
+	// both kinds of texture copy all of their levels at once, so the
+	// level offsets in the source are the offsets in the buffer
+	GLsizeiptr imageSize = bCompressed ?
+		(GLsizeiptr)request.compressed->dataSize :
+		(GLsizeiptr)request.processed->texels.size();
+	const void* pSource = bCompressed ? (const void*)request.compressed->data : (const void*)request.processed->texels.data();
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.pbo);
+	if (staging.size < imageSize)
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, imageSize, NULL, GL_STREAM_DRAW);
+		staging.size = imageSize;
+	}
+
+	void* pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, imageSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (pMapped != NULL)
+	{
+		memcpy(pMapped, pSource, (size_t)imageSize);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	if (pMapped == NULL)
+	{
+		std::cout << "Could not map the texture staging buffer for:" << request.tag << std::endl;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		delete request.processed;
+		request.processed = NULL;
+		delete request.compressed;
+		request.compressed = NULL;
+		return 0;
+	}
+
+	if (bCompressed)
+	{
+		textureID = TextureCache::CreateGLTexture(*request.compressed, true);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		delete request.compressed;
+		request.compressed = NULL;
+
+		staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		return textureID;
+	}
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// the pixel data pointers are offsets into the bound pixel buffer
+	const ImageProcessing::PROCESSED_IMAGE& processed = *request.processed;
+	for (size_t i = 0; i < processed.levels.size(); i++)
+	{
+		const ImageProcessing::IMAGE_LEVEL& level = processed.levels[i];
+		glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)level.offset);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)processed.levels.size() - 1);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// the decoded data is no longer needed
+	delete request.processed;
+	request.processed = NULL;
+
+	staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	return textureID;
+}
+
+/***********************************************************
+ *  IsRunning()
+ *
+ *  This method is used for checking if the loader context
+ *  and thread were created.
+ ***********************************************************/
+bool TextureUploader::IsRunning()
+{
+	return m_thread.joinable();
+}
+
+/***********************************************************
+ *  QueueUpload()
+ *
+ *  This method is used for queueing a decoded image to be
+ *  uploaded on the loader thread.  It may be called from any
+ *  thread, including the decoding workers.
+ ***********************************************************/
+void TextureUploader::QueueUpload(const UPLOAD_REQUEST& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(request);
+		m_pendingUploads++;
+	}
+	m_requestAvailable.notify_one();
+}
+
+/***********************************************************
+ *  PollCompletedUploads()
+ *
+ *  This method is used for collecting the uploaded textures
+ *  whose fences have been signalled, without blocking.  The
+ *  textures added to the list are ready to be bound.
+ ***********************************************************/
+int TextureUploader::PollCompletedUploads(std::vector<UPLOAD_RESULT>& results)
+{
+	int completed = 0;
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (size_t i = 0; i < m_results.size();)
+	{
+		GLenum status = glClientWaitSync(m_results[i].fence, 0, 0);
+		if ((status == GL_ALREADY_SIGNALED) || (status == GL_CONDITION_SATISFIED))
+		{
+			glDeleteSync(m_results[i].fence);
+			results.push_back(m_results[i].result);
+			m_results.erase(m_results.begin() + i);
+			m_pendingUploads--;
+			completed++;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	return completed;
+}
+
+/***********************************************************
+ *  GetPendingUploads()
+ *
+ *  This method is used for getting the number of queued
+ *  uploads that have not been published yet.
+ ***********************************************************/
+int TextureUploader::GetPendingUploads()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pendingUploads;
+}
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureuploader.h
+// ============
+// upload decoded texture images on a loader thread with its own shared
+// OpenGL context, streaming the texels through a ring of pixel buffers
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageProcessing.h"
+#include "ResourceRegistry.h"
+#include "TextureCache.h"
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureUploader
+ *
+ *  This class contains the code for creating OpenGL textures
+ *  away from the render thread.  A hidden window provides a
+ *  context that shares its objects with the display window,
+ *  and a loader thread copies the texels into a ring of pixel
+ *  buffer objects and uploads every mip level from them.
+ *  Each finished texture is published with a fence that the
+ *  render thread polls once per frame.
+ ***********************************************************/
+class TextureUploader
+{
+public:
+	// constructor - must be called on the thread that created
+	// the display window, which owns the GLFW event loop
+	TextureUploader(GLFWwindow* pSharedWindow);
+	// destructor
+	~TextureUploader();
+
+	// a decoded image waiting to be uploaded
+	struct UPLOAD_REQUEST
+	{
+		std::string tag;
+		int slot;
+		// the RGBA mip chain - deleted after the upload
+		ImageProcessing::PROCESSED_IMAGE* processed;
+		// the block compressed mips, used instead of the RGBA mips -
+		// deleted after the upload
+		TextureCache::COMPRESSED_TEXTURE* compressed;
+		// hash of the image file the texture is registered under
+		uint64_t contentHash;
+		// a texture that was already loaded, passed on without an upload
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource;
+	};
+
+	// a texture that is ready to be used by the render thread
+	struct UPLOAD_RESULT
+	{
+		std::string tag;
+		int slot;
+		// NULL when the upload failed
+		std::shared_ptr<ResourceRegistry::TEXTURE_RESOURCE> resource;
+	};
+
+private:
+	// one pixel buffer of the upload ring
+	struct STAGING_BUFFER
+	{
+		GLuint pbo;
+		GLsizeiptr size;
+		// signalled when the upload reading this buffer completes
+		GLsync fence;
+	};
+
+	// an uploaded texture waiting for its fence
+	struct PENDING_RESULT
+	{
+		UPLOAD_RESULT result;
+		GLsync fence;
+	};
+
+	// hidden window that owns the loader context
+	GLFWwindow* m_pLoaderWindow;
+	// the loader thread
+	std::thread m_thread;
+	// guards the request and result queues
+	std::mutex m_mutex;
+	// signalled when a request is queued or the loader is stopping
+	std::condition_variable m_requestAvailable;
+	std::deque<UPLOAD_REQUEST> m_requests;
+	std::vector<PENDING_RESULT> m_results;
+	// number of requests that have not been published yet
+	int m_pendingUploads;
+	// true when the loader thread should exit
+	bool m_bStopping;
+
+	// the ring of pixel buffers - only used on the loader thread
+	std::vector<STAGING_BUFFER> m_stagingBuffers;
+	int m_nextStagingBuffer;
+
+	// the loop run by the loader thread
+	void LoaderLoop();
+	// upload one request through the next pixel buffer of the ring
+	GLuint UploadTexture(UPLOAD_REQUEST& request);
+
+public:
+	// check if the loader context and thread were created
+	bool IsRunning();
+	// queue a decoded image to be uploaded on the loader thread
+	void QueueUpload(const UPLOAD_REQUEST& request);
+	// collect the textures whose uploads have completed on the GPU -
+	// call once per frame on the render thread
+	int PollCompletedUploads(std::vector<UPLOAD_RESULT>& results);
+	// get the number of queued uploads that are not yet published
+	int GetPendingUploads();
+};
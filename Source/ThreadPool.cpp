@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.cpp
+// ============
+// manage a fixed set of worker threads for running background jobs -
+// asset importing, decoding, baking
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+/***********************************************************
+ *  ThreadPool()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	m_activeJobs = 0;
+	m_bStopping = false;
+
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	// hardware_concurrency() may report 0 when it cannot be determined
+	if (threadCount == 0)
+	{
+		threadCount = 2;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+}
+
+/***********************************************************
+ *  ~ThreadPool()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_jobAvailable.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is run by every worker thread.  It waits for
+ *  queued jobs and runs them until the pool is stopped.
+ ***********************************************************/
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this] { return m_bStopping || !m_jobs.empty(); });
+
+			// finish all queued jobs before exiting
+			if (m_jobs.empty())
+			{
+				return;
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			m_activeJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeJobs--;
+			if ((m_activeJobs == 0) && m_jobs.empty())
+			{
+				m_jobsDone.notify_all();
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  QueueJob()
+ *
+ *  This method is used for adding a job to the queue to be
+ *  run on the next available worker thread.
+ ***********************************************************/
+void ThreadPool::QueueJob(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobAvailable.notify_one();
+}
+
+/***********************************************************
+ *  WaitForJobs()
+ *
+ *  This method is used for blocking the calling thread until
+ *  every queued job has been run.
+ ***********************************************************/
+void ThreadPool::WaitForJobs()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_jobsDone.wait(lock, [this] { return (m_activeJobs == 0) && m_jobs.empty(); });
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running the passed in job for
+ *  every index in the range, spread over the worker threads.
+ *  Each worker pulls the next index from a shared counter so
+ *  uneven jobs stay balanced.  The calling thread blocks
+ *  until the whole range has completed, so this must not be
+ *  called from inside a job running on the same pool.
+ ***********************************************************/
+void ThreadPool::ParallelFor(int count, std::function<void(int)> job)
+{
+	// the shared state outlives this call in case a worker is
+	// still leaving its loop after the last index completed
+	struct PARALLEL_STATE
+	{
+		std::atomic<int> nextIndex;
+		int remaining;
+		std::mutex doneMutex;
+		std::condition_variable doneCondition;
+	};
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	std::shared_ptr<PARALLEL_STATE> state = std::make_shared<PARALLEL_STATE>();
+	state->nextIndex = 0;
+	state->remaining = count;
+
+	int jobCount = (int)m_workers.size();
+	if (jobCount > count)
+	{
+		jobCount = count;
+	}
+
+	for (int i = 0; i < jobCount; i++)
+	{
+		QueueJob([state, job, count]()
+		{
+			int index = state->nextIndex++;
+			while (index < count)
+			{
+				job(index);
+				{
+					std::lock_guard<std::mutex> lock(state->doneMutex);
+					state->remaining--;
+					if (state->remaining == 0)
+					{
+						state->doneCondition.notify_all();
+					}
+				}
+				index = state->nextIndex++;
+			}
+		});
+	}
+
+	std::unique_lock<std::mutex> lock(state->doneMutex);
+	state->doneCondition.wait(lock, [&state] { return state->remaining == 0; });
+}
+
+/***********************************************************
+ *  GetThreadCount()
+ *
+ *  This method is used for getting the number of worker
+ *  threads in the pool.
+ ***********************************************************/
+unsigned int ThreadPool::GetThreadCount() const
+{
+	return (unsigned int)m_workers.size();
+}
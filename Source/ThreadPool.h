@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// threadpool.h
+// ============
+// manage a fixed set of worker threads for running background jobs -
+// asset importing, decoding, baking
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  ThreadPool
+ *
+ *  This class contains the code for queueing jobs onto a
+ *  fixed number of worker threads and waiting for them to
+ *  complete.
+ ***********************************************************/
+class ThreadPool
+{
+public:
+	// constructor - a thread count of 0 uses one thread per core
+	ThreadPool(unsigned int threadCount = 0);
+	// destructor
+	~ThreadPool();
+
+private:
+	// the worker threads
+	std::vector<std::thread> m_workers;
+	// jobs waiting for a worker
+	std::deque<std::function<void()>> m_jobs;
+	// guards the job queue and counters
+	std::mutex m_mutex;
+	// signalled when a job is queued or the pool is stopping
+	std::condition_variable m_jobAvailable;
+	// signalled when the last running job completes
+	std::condition_variable m_jobsDone;
+	// number of jobs currently being run by workers
+	int m_activeJobs;
+	// true when the workers should exit
+	bool m_bStopping;
+
+	// the loop run by every worker thread
+	void WorkerLoop();
+
+public:
+	// add a job to the queue to be run on a worker thread
+	void QueueJob(std::function<void()> job);
+	// block until every queued job has completed
+	void WaitForJobs();
+	// run the job for every index from 0 to count-1 across the
+	// workers and block until all of them have completed
+	void ParallelFor(int count, std::function<void(int)> job);
+	// get the number of worker threads
+	unsigned int GetThreadCount() const;
+};
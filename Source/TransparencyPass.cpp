@@ -0,0 +1,348 @@
+///////////////////////////////////////////////////////////////////////////////
+// transparencypass.cpp
+// ============
+// blend the see through objects over the opaque scene without sorting them
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransparencyPass.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// the sums are bound to the texture units after the reflection probes
+	const int g_AccumulationTextureUnit = 27;
+	const int g_RevealageTextureUnit = 28;
+	const char* g_AccumulationSamplerName = "accumulationTexture";
+	const char* g_RevealageSamplerName = "revealageTexture";
+	// the digits of the radix sort - four passes over the 32 bits of a key
+	const int g_RadixBits = 8;
+	const uint32_t g_RadixMask = (1u << g_RadixBits) - 1;
+}
+
+/***********************************************************
+ *  TransparencyPass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransparencyPass::TransparencyPass()
+{
+	m_bSupported = false;
+	m_framebuffer = 0;
+	m_accumulationTexture = 0;
+	m_revealageTexture = 0;
+	m_depthBuffer = 0;
+	m_depthFormat = GL_DEPTH24_STENCIL8;
+	m_width = 0;
+	m_height = 0;
+	m_screenVertexArray = 0;
+	m_targetFramebuffer = 0;
+}
+
+/***********************************************************
+ *  ~TransparencyPass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TransparencyPass::~TransparencyPass()
+{
+	DeleteTargets();
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+	}
+	if (m_screenVertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_screenVertexArray);
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method is used for creating the targets at the size
+ *  of the viewport.  The two targets are blended with their
+ *  own functions, which needs OpenGL 4.0, and the depth of
+ *  the display window is copied into a buffer of the same
+ *  format, so the copy is tried once here.
+ ***********************************************************/
+bool TransparencyPass::Initialize()
+{
+	if ((GLEW_VERSION_4_0 == GL_FALSE) && (GLEW_ARB_draw_buffers_blend == GL_FALSE))
+	{
+		std::cout << "Blending the draw buffers separately is not supported - the transparent objects are sorted" << std::endl;
+		return false;
+	}
+	GLint drawBuffers = 0;
+	glGetIntegerv(GL_MAX_DRAW_BUFFERS, &drawBuffers);
+	if (drawBuffers < 2)
+	{
+		std::cout << "Weighted blended transparency needs 2 draw buffers" << std::endl;
+		return false;
+	}
+
+	// the depth buffer matches the display window, which a copy
+	// needs
+	GLint depthBits = 0;
+	GLint stencilBits = 0;
+	glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthBits);
+	glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+	if (stencilBits > 0)
+	{
+		m_depthFormat = (depthBits > 24) ? GL_DEPTH32F_STENCIL8 : GL_DEPTH24_STENCIL8;
+	}
+	else
+	{
+		m_depthFormat = (depthBits > 24) ? GL_DEPTH_COMPONENT32 : ((depthBits > 16) ? GL_DEPTH_COMPONENT24 : GL_DEPTH_COMPONENT16);
+	}
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glGenVertexArrays(1, &m_screenVertexArray);
+
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	m_bSupported = CreateTargets(std::max(viewport[2], 1), std::max(viewport[3], 1));
+	if (!m_bSupported)
+	{
+		std::cout << "The transparency targets cannot be drawn to - the transparent objects are sorted" << std::endl;
+		return false;
+	}
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_targetFramebuffer);
+	m_bSupported = CopyDepth();
+	glBindFramebuffer(GL_FRAMEBUFFER, m_targetFramebuffer);
+	if (!m_bSupported)
+	{
+		std::cout << "The depth of the window cannot be copied - the transparent objects are sorted" << std::endl;
+	}
+
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking if the objects can be
+ *  blended without sorting.
+ ***********************************************************/
+bool TransparencyPass::IsSupported() const
+{
+	return m_bSupported;
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the targets at a size
+ *  and attaching them to the framebuffer.  The color sums
+ *  need the range of half floats, as every surface adds its
+ *  weighted color, and the pixels are read one to one.
+ ***********************************************************/
+bool TransparencyPass::CreateTargets(int width, int height)
+{
+	DeleteTargets();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glGenTextures(1, &m_accumulationTexture);
+	glBindTexture(GL_TEXTURE_2D, m_accumulationTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_accumulationTexture, 0);
+
+	glGenTextures(1, &m_revealageTexture);
+	glBindTexture(GL_TEXTURE_2D, m_revealageTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_revealageTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, m_depthFormat, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	bool bStencil = (m_depthFormat == GL_DEPTH24_STENCIL8) || (m_depthFormat == GL_DEPTH32F_STENCIL8);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, bStencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_width = width;
+	m_height = height;
+	return (status == GL_FRAMEBUFFER_COMPLETE);
+}
+
+/***********************************************************
+ *  DeleteTargets()
+ *
+ *  This method is used for deleting the targets.
+ ***********************************************************/
+void TransparencyPass::DeleteTargets()
+{
+	if (m_depthBuffer != 0)
+	{
+		glDeleteTextures(1, &m_accumulationTexture);
+		glDeleteTextures(1, &m_revealageTexture);
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_accumulationTexture = 0;
+		m_revealageTexture = 0;
+		m_depthBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  CopyDepth()
+ *
+ *  This method is used for copying the depth of the opaque
+ *  objects from the target framebuffer, so the transparent
+ *  objects behind them are hidden.  The copy fails when the
+ *  depth formats differ.
+ ***********************************************************/
+bool TransparencyPass::CopyDepth()
+{
+	while (glGetError() != GL_NO_ERROR)
+	{
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_targetFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	return (glGetError() == GL_NO_ERROR);
+}
+
+/***********************************************************
+ *  BeginAccumulation()
+ *
+ *  This method is used for drawing the following objects
+ *  into the weighted sums.  The targets are sized to the
+ *  viewport and take the depth of the opaque objects.  The
+ *  objects do not write the depth, so every surface of a
+ *  pixel is added - the colors are summed, and the light
+ *  let through is multiplied down by each coverage.
+ ***********************************************************/
+void TransparencyPass::BeginAccumulation()
+{
+	// creating the targets unbinds the framebuffer of the frame
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_targetFramebuffer);
+
+	GLint viewport[4] = { 0, 0, 1, 1 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	int width = std::max(viewport[2], 1);
+	int height = std::max(viewport[3], 1);
+	if ((width != m_width) || (height != m_height))
+	{
+		CreateTargets(width, height);
+	}
+
+	CopyDepth();
+
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	const GLfloat noColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat allLight[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glDrawBuffers(2, drawBuffers);
+	glClearBufferfv(GL_COLOR, 0, noColor);
+	glClearBufferfv(GL_COLOR, 1, allLight);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+/***********************************************************
+ *  Composite()
+ *
+ *  This method is used for blending the sums over the
+ *  framebuffer the opaque objects were drawn into, with one
+ *  triangle that covers the screen.  The average color of
+ *  the transparent surfaces of a pixel covers it by the
+ *  share of the light they do not let through.
+ ***********************************************************/
+void TransparencyPass::Composite(GLuint program)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_targetFramebuffer);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_DEPTH_TEST);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glActiveTexture(GL_TEXTURE0 + g_AccumulationTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, m_accumulationTexture);
+	glActiveTexture(GL_TEXTURE0 + g_RevealageTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, m_revealageTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, g_AccumulationSamplerName), g_AccumulationTextureUnit);
+	glUniform1i(glGetUniformLocation(program, g_RevealageSamplerName), g_RevealageTextureUnit);
+
+	glBindVertexArray(m_screenVertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glEnable(GL_DEPTH_TEST);
+}
+
+/***********************************************************
+ *  SortBackToFront()
+ *
+ *  This method is used for getting the order that draws a
+ *  list of objects from the farthest to the nearest, with
+ *  a radix sort on the bits of their distances.  The bits
+ *  of a float are flipped so they sort as an unsigned
+ *  integer, and inverted so the farthest sorts first.  A
+ *  pass whose digit is the same for every key is skipped.
+ ***********************************************************/
+void TransparencyPass::SortBackToFront(const std::vector<float>& distances, std::vector<uint32_t>& order)
+{
+	size_t count = distances.size();
+	std::vector<uint32_t> keys(count);
+	std::vector<uint32_t> sortedKeys(count);
+	std::vector<uint32_t> sortedOrder(count);
+
+	order.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t bits = 0;
+		memcpy(&bits, &distances[i], sizeof(bits));
+		bits = ((bits & 0x80000000u) != 0) ? ~bits : (bits | 0x80000000u);
+		keys[i] = ~bits;
+		order[i] = (uint32_t)i;
+	}
+	if (count < 2)
+	{
+		return;
+	}
+
+	for (int shift = 0; shift < 32; shift += g_RadixBits)
+	{
+		size_t offsets[g_RadixMask + 1] = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			offsets[(keys[i] >> shift) & g_RadixMask]++;
+		}
+		if (offsets[(keys[0] >> shift) & g_RadixMask] == count)
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		for (uint32_t digit = 0; digit <= g_RadixMask; digit++)
+		{
+			size_t digitCount = offsets[digit];
+			offsets[digit] = offset;
+			offset += digitCount;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t target = offsets[(keys[i] >> shift) & g_RadixMask]++;
+			sortedKeys[target] = keys[i];
+			sortedOrder[target] = order[i];
+		}
+		keys.swap(sortedKeys);
+		order.swap(sortedOrder);
+	}
+}
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////
+// transparencypass.h
+// ============
+// blend the see through objects over the opaque scene without sorting them
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  TransparencyPass
+ *
+ *  This class contains the code for the weighted blended
+ *  order independent transparency of the scene.  The see
+ *  through objects are drawn after the opaque ones into two
+ *  targets - the sum of their colors weighted by their
+ *  coverage and distance, and the share of the light behind
+ *  them that every one of them lets through - which are the
+ *  same in any drawing order.  The composite then blends
+ *  the average color over the opaque scene by the light
+ *  that is not let through.  The objects can instead be
+ *  sorted back to front with a radix sort on their
+ *  distances, and blended in that order.
+ ***********************************************************/
+class TransparencyPass
+{
+public:
+	// constructor
+	TransparencyPass();
+	// destructor
+	~TransparencyPass();
+
+	// the framebuffer cannot be shared between two objects
+	TransparencyPass(const TransparencyPass&) = delete;
+	TransparencyPass& operator=(const TransparencyPass&) = delete;
+
+private:
+	bool m_bSupported;
+	GLuint m_framebuffer;
+	// the weighted sums of the colors and the light let through, and
+	// the depth of the opaque objects they are tested against
+	GLuint m_accumulationTexture;
+	GLuint m_revealageTexture;
+	GLuint m_depthBuffer;
+	GLenum m_depthFormat;
+	int m_width;
+	int m_height;
+	// the vertex array of the screen triangle, which has no attributes
+	GLuint m_screenVertexArray;
+	// the framebuffer the opaque objects were drawn into, which the
+	// sums are blended over
+	GLint m_targetFramebuffer;
+
+	// create the targets at a size, and check that they can be drawn to
+	bool CreateTargets(int width, int height);
+	// delete the targets
+	void DeleteTargets();
+	// copy the depth of the target framebuffer, returns false when the
+	// driver cannot copy it
+	bool CopyDepth();
+
+public:
+	// create the targets at the size of the viewport, with the depth
+	// format of the display window - needs the OpenGL context to be
+	// current
+	bool Initialize();
+	// check if the objects can be blended without sorting
+	bool IsSupported() const;
+
+	// draw the following objects into the weighted sums, tested against
+	// the depth of the framebuffer that is bound
+	void BeginAccumulation();
+	// blend the sums over the framebuffer the opaque objects were drawn
+	// into, and restore the state the objects are drawn with
+	void Composite(GLuint program);
+
+	// get the order that draws a list of objects back to front from
+	// their distances in front of the camera
+	static void SortBackToFront(const std::vector<float>& distances, std::vector<uint32_t>& order);
+};
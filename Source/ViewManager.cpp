@@ -54,6 +54,10 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_view = glm::mat4(1.0f);
+	m_projection = glm::mat4(1.0f);
+	m_bRenderPathKeyDown = false;
+	m_bRenderPathToggled = false;
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 35.0f, -10.0f);
@@ -180,6 +184,14 @@ void ViewManager::ProcessKeyboardEvents()
 		glfwSetWindowShouldClose(m_pWindow, true);
 	}
 
+	// switch the render path once per press of the key
+	bool bRenderPathKeyDown = (glfwGetKey(m_pWindow, GLFW_KEY_G) == GLFW_PRESS);
+	if (bRenderPathKeyDown && !m_bRenderPathKeyDown)
+	{
+		m_bRenderPathToggled = true;
+	}
+	m_bRenderPathKeyDown = bRenderPathKeyDown;
+
 	// if the camera object is null, then exit this method
 	if (NULL == g_pCamera)
 	{
@@ -281,9 +293,11 @@ void ViewManager::PrepareSceneView()
 
 	// get the current view matrix from the camera
 	view = g_pCamera->GetViewMatrix();
+	m_view = view;
 
 	// define the current projection matrix
 	projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+	m_projection = projection;
 
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
@@ -295,4 +309,76 @@ void ViewManager::PrepareSceneView()
 		// set the view position of the camera into the shader for proper rendering
 		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
 	}
-}
\ No newline at end of file
+}
+
+/***********************************************************
+ *  GetViewMatrix()
+ *
+ *  This method is used for getting the view matrix that was
+ *  set for the current frame.
+ ***********************************************************/
+glm::mat4 ViewManager::GetViewMatrix()
+{
+	return(m_view);
+}
+
+/***********************************************************
+ *  GetProjectionMatrix()
+ *
+ *  This method is used for getting the projection matrix
+ *  that was set for the current frame.
+ ***********************************************************/
+glm::mat4 ViewManager::GetProjectionMatrix()
+{
+	return(m_projection);
+}
+
+/***********************************************************
+ *  GetCameraPosition()
+ *
+ *  This method is used for getting the current position of
+ *  the camera.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraPosition()
+{
+	if (NULL == g_pCamera)
+	{
+		return(glm::vec3(0.0f));
+	}
+
+	return(g_pCamera->Position);
+}
+
+/***********************************************************
+ *  GetViewportHeight()
+ *
+ *  This method is used for getting the height of the display
+ *  window framebuffer in pixels.
+ ***********************************************************/
+int ViewManager::GetViewportHeight()
+{
+	int width = 0;
+	int height = WINDOW_HEIGHT;
+
+	if (NULL != m_pWindow)
+	{
+		glfwGetFramebufferSize(m_pWindow, &width, &height);
+	}
+
+	return(height);
+}
+
+/***********************************************************
+ *  WasRenderPathToggled()
+ *
+ *  This method is used for checking if the key that switches
+ *  between forward and deferred shading was pressed since
+ *  the last check.
+ ***********************************************************/
+bool ViewManager::WasRenderPathToggled()
+{
+	bool bToggled = m_bRenderPathToggled;
+	m_bRenderPathToggled = false;
+
+	return(bToggled);
+}
@@ -35,6 +35,13 @@ private:
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// the view and projection matrices of the current frame
+	glm::mat4 m_view;
+	glm::mat4 m_projection;
+	// true while the render path key is held, and when it was pressed
+	// since the last check
+	bool m_bRenderPathKeyDown;
+	bool m_bRenderPathToggled;
 
 	// process keyboard events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
@@ -45,4 +52,15 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+
+	// get the view matrix of the current frame
+	glm::mat4 GetViewMatrix();
+	// get the projection matrix of the current frame
+	glm::mat4 GetProjectionMatrix();
+	// get the position of the camera
+	glm::vec3 GetCameraPosition();
+	// get the height of the display window in pixels
+	int GetViewportHeight();
+	// check if the render path key was pressed since the last check
+	bool WasRenderPathToggled();
 };
\ No newline at end of file
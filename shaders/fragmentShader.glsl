@@ -1,9 +1,26 @@
 #version 330 core
+#ifdef GEOMETRY_PASS
+// the surface of the fragment, lit later from the G-buffer - the normal
+// is packed into two values, and the shininess is kept with the specular
+// color
+layout (location = 0) out vec4 gBufferAlbedo;
+layout (location = 1) out vec4 gBufferNormal;
+layout (location = 2) out vec4 gBufferDiffuse;
+layout (location = 3) out vec4 gBufferSpecular;
+#elif defined(TRANSPARENCY_PASS)
+// the weighted sums of the transparent surfaces of the pixel - the color
+// of the fragment is worked out first, then added to the sums
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out float revealage;
+vec4 fragmentColor;
+#else
 out vec4 fragmentColor;
+#endif
 
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+flat in int fragmentFaceID;
 
 struct Material {
     vec3 diffuseColor;
@@ -49,60 +66,365 @@ struct SpotLight {
 };
 
 #define TOTAL_POINT_LIGHTS 5
+#define TOTAL_MESH_FACES 7
+// the shininess the G-buffer stores as 1
+#define GBUFFER_MAX_SHININESS 255.0f
+
+// a program variant defines its features after the #version line, so
+// their branches are compiled out - without a variant every feature
+// is switched by its uniform
+#ifdef SHADER_VARIANT
+#define POINT_LIGHT_ACTIVE(i) (((POINT_LIGHT_MASK >> (i)) & 1) != 0)
+#else
+#define USE_TEXTURE bUseTexture
+#define USE_LIGHTING bUseLighting
+#define DIRECTIONAL_LIGHT_ACTIVE directionalLight.bActive
+#define POINT_LIGHT_ACTIVE(i) pointLights[i].bActive
+#define SPOT_LIGHT_ACTIVE spotLight.bActive
+#endif
+// an object drawn with its light lists only evaluates the scene lights
+// that reach it - bit i of its mask for point light i, then the spot
+// light
+#ifdef OBJECT_LIGHT_LISTS
+#define OBJECT_REACHED_BY(i) (((objectSceneLights >> (i)) & 1u) != 0u)
+#else
+#define OBJECT_REACHED_BY(i) true
+#endif
+// the flat ambient of a scene light, which the irradiance probes
+// replace
+#ifdef IRRADIANCE_PROBES
+#define FLAT_AMBIENT(ambient) vec3(0.0f)
+#else
+#define FLAT_AMBIENT(ambient) ((ambient) * ambientOcclusion)
+#endif
 
 uniform bool bUseTexture=false;
 uniform bool bUseLighting=false;
 uniform vec4 objectColor = vec4(1.0f);
 uniform vec3 viewPosition;
+#ifdef BAKED_LIGHTS
+// the light values set up by the scene, compiled in as constants
+BAKED_LIGHTS
+#else
 uniform DirectionalLight directionalLight;
 uniform PointLight pointLights[TOTAL_POINT_LIGHTS];
 uniform SpotLight spotLight;
+#endif
+// a point light that only reaches a limited distance
+struct LocalLight {
+    vec4 positionRadius;
+    vec4 diffuse;
+    vec4 specular;
+};
+#if defined(CLUSTERED_LIGHTS) || defined(OBJECT_LIGHT_LISTS)
+// the local lights
+layout (std430, binding = 0) readonly buffer LocalLightBuffer {
+    LocalLight localLights[];
+};
+#endif
+#ifdef OBJECT_LIGHT_LISTS
+// the lists of the local lights that reach every drawn object, and the
+// offset and count of the list of this object
+layout (std430, binding = 3) readonly buffer ObjectLightIndexBuffer {
+    uint objectLightIndices[];
+};
+uniform uvec2 objectLightList;
+uniform uint objectSceneLights;
+#endif
+#ifdef CLUSTERED_LIGHTS
+// the list of the lights that reach every cluster of the view - a
+// cluster is a screen tile over a range of view depths
+// offset and count of the light list of every cluster
+layout (std430, binding = 1) readonly buffer ClusterGridBuffer {
+    uvec2 clusterGrid[];
+};
+layout (std430, binding = 2) readonly buffer ClusterIndexBuffer {
+    uint clusterLightIndices[];
+};
+uniform mat4 view;
+uniform ivec3 clusterDimensions;
+// pixels of a screen tile, and the depth slice as a log of the view depth
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthScaleBias;
+#endif
+#if defined(DEFERRED_LIGHTING) || defined(LIGHT_VOLUMES)
+// the surfaces written by the geometry pass, and the matrix that takes
+// a screen point and its depth back to the world
+uniform sampler2D gBufferAlbedo;
+uniform sampler2D gBufferNormal;
+uniform sampler2D gBufferDiffuse;
+uniform sampler2D gBufferSpecular;
+uniform sampler2D gBufferDepth;
+uniform mat4 inverseViewProjection;
+#endif
+#ifdef SHADOW_PASS
+// the light whose shadow map is drawn - position and range
+uniform vec4 shadowLight;
+#endif
+#ifdef SHADOWS
+// the shadow maps keep the distance from their light to the nearest
+// caster divided by its range, and the lights they were drawn from -
+// a light with a range of 0 has no map yet
+uniform sampler2DShadow spotShadowMap;
+uniform samplerCubeArrayShadow pointShadowMaps;
+uniform mat4 spotShadowMatrix;
+uniform vec4 spotShadowLight;
+uniform vec4 pointShadowLights[TOTAL_POINT_LIGHTS];
+#endif
+#ifdef AMBIENT_OCCLUSION
+// the share of the ambient light reaching the vertices, baked for them
+in float fragmentOcclusion;
+#endif
+#ifdef LIGHTMAP
+// the light of the scene lights baked into bricks of samples over the
+// objects - the bounds of the brick of this object in its own space,
+// its samples along every axis, and the atlas texel it starts at with
+// the slices it lays out per row. an object with no brick is lit by
+// the scene lights.
+uniform sampler2D lightmapAtlas;
+uniform vec3 lightmapBoundsMin;
+uniform vec3 lightmapBoundsSize;
+uniform ivec3 lightmapBrickSize;
+uniform ivec3 lightmapBrickLayout;
+in vec3 fragmentLocalPosition;
+#endif
+#ifdef IRRADIANCE_PROBES
+// the ambient light of the scene at the probes of a grid over it, as
+// nine spherical harmonics coefficients for every color channel packed
+// into seven sets of the grid stacked along z - the first probe, the
+// distance between two probes and the probes along every axis
+#define IRRADIANCE_SETS 7
+uniform sampler3D irradianceProbes;
+uniform vec3 irradianceGridMin;
+uniform vec3 irradianceGridSpacing;
+uniform ivec3 irradianceGridSize;
+#endif
+#ifdef REFLECTION_PROBES
+// the scene drawn around the probes into the faces of a cube map array,
+// a level for every roughness down to the whole hemisphere - the probes
+// and the box around the scene their reflections are corrected for
+#define MAX_REFLECTION_PROBES 4
+#define REFLECTION_LEVELS 6
+uniform samplerCubeArray reflectionProbes;
+uniform int reflectionProbeCount;
+uniform vec3 reflectionProbePositions[MAX_REFLECTION_PROBES];
+uniform vec3 reflectionBoxMin;
+uniform vec3 reflectionBoxMax;
+#endif
+#ifdef TRANSPARENCY_COMPOSITE
+// the weighted sums of the transparent surfaces of every pixel
+uniform sampler2D accumulationTexture;
+uniform sampler2D revealageTexture;
+#endif
+#ifdef RESOLUTION_UPSCALE
+// the frame drawn at a lower resolution into the corner of its target,
+// the size of that corner and of the window in pixels, and how strongly
+// the filtered pixels are sharpened
+uniform sampler2D scaledFrame;
+uniform vec2 scaledFrameSize;
+uniform vec2 windowSize;
+uniform float upscaleSharpness;
+#endif
+#ifdef LIGHT_VOLUMES
+// the local light whose screen rectangle is drawn
+flat in vec4 volumeLightPositionRadius;
+flat in vec4 volumeLightDiffuse;
+flat in vec4 volumeLightSpecular;
+#endif
 uniform Material material;
 uniform sampler2D objectTexture;
 uniform vec2 UVscale = vec2(1.0f, 1.0f);
+// place of the texture inside its atlas page - offset in xy, scale in zw
+uniform vec4 objectUVRect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+// per-face material table - faces mapped to slot 1 use the face texture and material
+uniform bool bUseFaceMaterials = false;
+uniform int faceMaterialSlot[TOTAL_MESH_FACES];
+uniform sampler2D faceTexture;
+uniform Material faceMaterial;
+uniform vec4 faceUVRect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+// the share of the probe reflection the object material reflects when
+// facing it, 0 for a material without reflections
+uniform float reflectionReflectance = 0.0f;
+// the share of the light behind the object the material stops, below 1
+// for the see through materials
+uniform float materialOpacity = 1.0f;
+
+// the texel and material used for the current fragment, the share
+// of the ambient light that reaches it, and the share of the probe
+// reflection it reflects
+vec4 objectTexel;
+Material activeMaterial;
+float ambientOcclusion = 1.0f;
+float reflectance = 0.0f;
 
 // function prototypes
+vec3 CalcSceneLights(vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
+float CalcPointShadow(int index, vec3 fragPos);
+float CalcSpotShadow(vec3 fragPos);
+#ifdef CLUSTERED_LIGHTS
+vec3 CalcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+#ifdef OBJECT_LIGHT_LISTS
+vec3 CalcObjectLights(vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+vec3 CalcLocalLight(LocalLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+#ifdef LIGHTMAP
+vec3 SampleLightmap(vec3 localPosition);
+vec3 SampleLightmapSlice(int slice, vec2 position);
+#endif
+#ifdef IRRADIANCE_PROBES
+vec3 SampleIrradiance(vec3 position, vec3 normal);
+#endif
+#ifdef REFLECTION_PROBES
+vec3 CalcReflection(vec3 normal, vec3 fragPos, vec3 viewDir);
+#endif
+vec4 SampleObjectTexture(vec2 textureCoordinate);
+vec4 SampleTextureRect(sampler2D textureSampler, vec2 textureCoordinate, vec4 uvRect);
+vec2 EncodeOctahedral(vec3 normal);
+vec3 DecodeOctahedral(vec2 encoded);
+#if defined(DEFERRED_LIGHTING) || defined(LIGHT_VOLUMES)
+bool ReadGeometryBuffer(out vec3 normal, out vec3 fragPos);
+#endif
+#ifdef TRANSPARENCY_PASS
+void WriteTransparentFragment(vec4 color);
+#endif
+#ifdef RESOLUTION_UPSCALE
+vec3 SampleScaledFrame(vec2 position);
+#endif
 
 void main()
 {    
-    if(bUseLighting == true)
+#if defined(SHADOW_PASS)
+    // the distance to the light, so every face of a cube map compares
+    // the same values
+    gl_FragDepth = length(fragmentPosition - shadowLight.xyz) / shadowLight.w;
+#elif defined(DEPTH_PREPASS)
+    // only the depth is written, by the fixed function, so the hidden
+    // fragments are rejected before the shader runs
+#elif defined(DEFERRED_LIGHTING) || defined(LIGHT_VOLUMES)
+    // the surface is read back from the G-buffer, which is empty where
+    // no object was drawn
+    vec3 norm;
+    vec3 fragPos;
+    if(!ReadGeometryBuffer(norm, fragPos))
+    {
+        discard;
+    }
+    vec3 viewDir = normalize(viewPosition - fragPos);
+#ifdef DEFERRED_LIGHTING
+    // the surface keeps its depth in the window, which hides the
+    // transparent objects drawn behind it
+    gl_FragDepth = texelFetch(gBufferDepth, ivec2(gl_FragCoord.xy), 0).r;
+    vec3 sceneLights = CalcSceneLights(norm, fragPos, viewDir);
+#ifdef REFLECTION_PROBES
+    sceneLights += CalcReflection(norm, fragPos, viewDir);
+#endif
+    fragmentColor = vec4(sceneLights, 1.0f);
+#else
+    LocalLight light = LocalLight(volumeLightPositionRadius, volumeLightDiffuse, volumeLightSpecular);
+    fragmentColor = vec4(CalcLocalLight(light, norm, fragPos, viewDir), 1.0f);
+#endif
+#elif defined(TRANSPARENCY_COMPOSITE)
+    // the average color of the transparent surfaces of the pixel covers
+    // it by the share of the light they do not let through
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float revealed = texelFetch(revealageTexture, pixel, 0).r;
+    if(revealed >= 1.0f)
+    {
+        discard;
+    }
+    vec4 accumulated = texelFetch(accumulationTexture, pixel, 0);
+    fragmentColor = vec4(accumulated.rgb / max(accumulated.a, 1.0e-5f), 1.0f - revealed);
+#elif defined(RESOLUTION_UPSCALE)
+    // the window pixel is filtered from the scaled frame and sharpened
+    // against the pixels around it - less where they differ more, as in
+    // contrast adaptive sharpening, so the edges the filter softened are
+    // restored without ringing around them
+    vec2 position = gl_FragCoord.xy * (scaledFrameSize / windowSize);
+    vec3 center = SampleScaledFrame(position);
+    vec3 north = SampleScaledFrame(position + vec2(0.0f, 1.0f));
+    vec3 south = SampleScaledFrame(position - vec2(0.0f, 1.0f));
+    vec3 east = SampleScaledFrame(position + vec2(1.0f, 0.0f));
+    vec3 west = SampleScaledFrame(position - vec2(1.0f, 0.0f));
+    vec3 lowest = min(center, min(min(north, south), min(east, west)));
+    vec3 highest = max(center, max(max(north, south), max(east, west)));
+    vec3 amplitude = sqrt(clamp(min(lowest, 1.0f - highest) / max(highest, vec3(1.0e-5f)), 0.0f, 1.0f));
+    vec3 weight = -amplitude / mix(8.0f, 5.0f, upscaleSharpness);
+    vec3 sharpened = (center + (north + south + east + west) * weight) / (1.0f + 4.0f * weight);
+    fragmentColor = vec4(clamp(sharpened, 0.0f, 1.0f), 1.0f);
+#else
+    activeMaterial = material;
+    if(bUseFaceMaterials == true && faceMaterialSlot[fragmentFaceID] == 1)
+    {
+        activeMaterial = faceMaterial;
+    }
+
+#ifdef GEOMETRY_PASS
+    vec4 surfaceColor = objectColor;
+    if(USE_TEXTURE)
+    {
+        surfaceColor = SampleObjectTexture(fragmentTextureCoordinate);
+    }
+#ifdef AMBIENT_OCCLUSION
+    gBufferAlbedo = vec4(surfaceColor.rgb, fragmentOcclusion);
+#else
+    gBufferAlbedo = vec4(surfaceColor.rgb, 1.0f);
+#endif
+    gBufferNormal = vec4(EncodeOctahedral(normalize(fragmentVertexNormal)), 0.0f, 0.0f);
+    gBufferDiffuse = vec4(activeMaterial.diffuseColor, reflectionReflectance);
+    gBufferSpecular = vec4(activeMaterial.specularColor, activeMaterial.shininess / GBUFFER_MAX_SHININESS);
+#else
+    if(USE_LIGHTING)
     {
-        vec3 phongResult = vec3(0.0f);
         // properties
         vec3 norm = normalize(fragmentVertexNormal);
         vec3 viewDir = normalize(viewPosition - fragmentPosition);
-    
-        // == =====================================================
-        // Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
-        // For each phase, a calculate function is defined that calculates the corresponding color
-        // per light source. In the main() function we take all the calculated colors and sum them 
-        // up for this fragment's final color.
-        // == =====================================================
-        // phase 1: directional lighting
-        if(directionalLight.bActive == true)
+        // the texture is sampled once and shared by every light
+        objectTexel = vec4(1.0f);
+        if(USE_TEXTURE)
         {
-            phongResult += CalcDirectionalLight(directionalLight, norm, viewDir);
+            objectTexel = SampleObjectTexture(fragmentTextureCoordinate);
         }
-        // phase 2: point lights
-        for(int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+#ifdef AMBIENT_OCCLUSION
+        ambientOcclusion = fragmentOcclusion;
+#endif
+    
+#ifdef LIGHTMAP
+        // the scene lights of a baked object, with their shadows and
+        // bounced light, are read from its brick
+        vec3 phongResult;
+        if(lightmapBrickSize.x > 0)
         {
-	    if(pointLights[i].bActive == true)
-            {
-                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir);   
-            }
-        } 
-        // phase 3: spot light
-        if(spotLight.bActive == true)
+            vec3 surfaceColor = USE_TEXTURE ? vec3(objectTexel) : vec3(objectColor);
+            phongResult = SampleLightmap(fragmentLocalPosition) * surfaceColor;
+        }
+        else
         {
-            phongResult += CalcSpotLight(spotLight, norm, fragmentPosition, viewDir);    
+            phongResult = CalcSceneLights(norm, fragmentPosition, viewDir);
         }
+#else
+        vec3 phongResult = CalcSceneLights(norm, fragmentPosition, viewDir);
+#endif
+#ifdef CLUSTERED_LIGHTS
+        // the local lights that reach the cluster of the fragment
+        phongResult += CalcClusterLights(norm, fragmentPosition, viewDir);
+#endif
+#ifdef OBJECT_LIGHT_LISTS
+        // the local lights that reach the object
+        phongResult += CalcObjectLights(norm, fragmentPosition, viewDir);
+#endif
+#ifdef REFLECTION_PROBES
+        // the scene around a reflective material
+        reflectance = reflectionReflectance;
+        phongResult += CalcReflection(norm, fragmentPosition, viewDir);
+#endif
     
-        if(bUseTexture == true)
+        if(USE_TEXTURE)
         {
-            fragmentColor = vec4(phongResult, (texture(objectTexture, fragmentTextureCoordinate)).a);
+            fragmentColor = vec4(phongResult, objectTexel.a);
         }
         else
         {
@@ -111,15 +433,172 @@ void main()
     }
     else
     {
-        if(bUseTexture == true)
+        if(USE_TEXTURE)
         {
-            fragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+            fragmentColor = SampleObjectTexture(fragmentTextureCoordinate * UVscale);
         }
         else
         {
             fragmentColor = objectColor;
         }
     }
+    fragmentColor.a *= materialOpacity;
+#ifdef TRANSPARENCY_PASS
+    WriteTransparentFragment(fragmentColor);
+#endif
+#endif
+#endif
+}
+
+// == =====================================================
+// Our lighting is set up in 3 phases: directional, point lights and an optional flashlight
+// For each phase, a calculate function is defined that calculates the corresponding color
+// per light source. Here we take all the calculated colors and sum them 
+// up for this fragment's final color.
+// == =====================================================
+vec3 CalcSceneLights(vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 phongResult = vec3(0.0f);
+
+    // phase 1: directional lighting
+    if(DIRECTIONAL_LIGHT_ACTIVE)
+    {
+        phongResult += CalcDirectionalLight(directionalLight, normal, viewDir);
+    }
+    // phase 2: point lights
+    for(int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+    {
+        if(POINT_LIGHT_ACTIVE(i) && OBJECT_REACHED_BY(i))
+        {
+            phongResult += CalcPointLight(pointLights[i], normal, fragPos, viewDir, CalcPointShadow(i, fragPos));   
+        }
+    } 
+    // phase 3: spot light
+    if(SPOT_LIGHT_ACTIVE && OBJECT_REACHED_BY(TOTAL_POINT_LIGHTS))
+    {
+        phongResult += CalcSpotLight(spotLight, normal, fragPos, viewDir, CalcSpotShadow(fragPos));    
+    }
+#ifdef IRRADIANCE_PROBES
+    // the ambient light of the scene around the fragment, in place of
+    // the flat ambient of the lights
+    vec3 surfaceColor = USE_TEXTURE ? vec3(objectTexel) : vec3(objectColor);
+    phongResult += SampleIrradiance(fragPos, normal) * surfaceColor * ambientOcclusion;
+#endif
+
+    return phongResult;
+}
+
+#if defined(DEFERRED_LIGHTING) || defined(LIGHT_VOLUMES)
+// reads the surface under the fragment from the G-buffer into the
+// texel and material the lights use. the position is rebuilt from the
+// depth, and false is returned where no object was drawn.
+bool ReadGeometryBuffer(out vec3 normal, out vec3 fragPos)
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gBufferDepth, pixel, 0).r;
+    if(depth >= 1.0f)
+    {
+        return false;
+    }
+
+    vec2 screenPosition = gl_FragCoord.xy / vec2(textureSize(gBufferDepth, 0));
+    vec4 worldPosition = inverseViewProjection * vec4(vec3(screenPosition, depth) * 2.0f - 1.0f, 1.0f);
+    fragPos = worldPosition.xyz / worldPosition.w;
+    normal = DecodeOctahedral(texelFetch(gBufferNormal, pixel, 0).rg);
+
+    vec4 albedo = texelFetch(gBufferAlbedo, pixel, 0);
+    objectTexel = vec4(albedo.rgb, 1.0f);
+    ambientOcclusion = albedo.a;
+    vec4 specular = texelFetch(gBufferSpecular, pixel, 0);
+    vec4 diffuse = texelFetch(gBufferDiffuse, pixel, 0);
+    activeMaterial.diffuseColor = diffuse.rgb;
+    reflectance = diffuse.a;
+    activeMaterial.specularColor = specular.rgb;
+    activeMaterial.shininess = specular.a * GBUFFER_MAX_SHININESS;
+    return true;
+}
+#endif
+
+#ifdef TRANSPARENCY_PASS
+// adds a transparent fragment to the sums of its pixel. its color is
+// weighted by its coverage and falls off with its distance, so the
+// nearer surfaces lead the average where several overlap, and the light
+// let through is multiplied down by its coverage by the blending.
+void WriteTransparentFragment(vec4 color)
+{
+    float distance = length(viewPosition - fragmentPosition);
+    float weight = color.a * clamp(0.03f / (1.0e-5f + pow(distance / 200.0f, 4.0f)), 0.01f, 3000.0f);
+    accumulation = vec4(color.rgb * color.a, color.a) * weight;
+    revealage = color.a;
+}
+#endif
+
+#ifdef RESOLUTION_UPSCALE
+// reads the scaled frame filtered at a position in its pixels, kept
+// inside the drawn corner so the filter does not reach past it.
+vec3 SampleScaledFrame(vec2 position)
+{
+    position = clamp(position, vec2(0.5f), scaledFrameSize - 0.5f);
+    return textureLod(scaledFrame, position / vec2(textureSize(scaledFrame, 0)), 0.0f).rgb;
+}
+#endif
+
+// packs a unit normal into two values in [0, 1] - the normal is
+// projected onto an octahedron, whose lower half is folded over the
+// upper half and flattened into a square.
+vec2 EncodeOctahedral(vec3 normal)
+{
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec2 encoded = normal.xy;
+    if(normal.z < 0.0f)
+    {
+        vec2 signs = vec2((normal.x >= 0.0f) ? 1.0f : -1.0f, (normal.y >= 0.0f) ? 1.0f : -1.0f);
+        encoded = (1.0f - abs(normal.yx)) * signs;
+    }
+    return encoded * 0.5f + 0.5f;
+}
+
+// unpacks a normal packed by EncodeOctahedral().
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    encoded = encoded * 2.0f - 1.0f;
+    vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0f);
+    normal.x += (normal.x >= 0.0f) ? -fold : fold;
+    normal.y += (normal.y >= 0.0f) ? -fold : fold;
+    return normalize(normal);
+}
+
+// samples the object texture, or the face texture for faces mapped to it.
+// both textures are sampled before selecting so the lookups stay in
+// uniform control flow for the mipmap derivatives.
+vec4 SampleObjectTexture(vec2 textureCoordinate)
+{
+    vec4 texel = SampleTextureRect(objectTexture, textureCoordinate, objectUVRect);
+    if(bUseFaceMaterials == true)
+    {
+        vec4 faceTexel = SampleTextureRect(faceTexture, textureCoordinate, faceUVRect);
+        if(faceMaterialSlot[fragmentFaceID] == 1)
+        {
+            texel = faceTexel;
+        }
+    }
+    return texel;
+}
+
+// samples a texture that may be packed into an atlas page. the coordinate
+// is wrapped inside the texture rectangle so tiling still repeats, and the
+// gradients of the unwrapped coordinate keep the mip selection smooth
+// across the wrap.
+vec4 SampleTextureRect(sampler2D textureSampler, vec2 textureCoordinate, vec4 uvRect)
+{
+    if(uvRect == vec4(0.0f, 0.0f, 1.0f, 1.0f))
+    {
+        return texture(textureSampler, textureCoordinate);
+    }
+    vec2 atlasCoordinate = uvRect.xy + fract(textureCoordinate) * uvRect.zw;
+    return textureGrad(textureSampler, atlasCoordinate,
+        dFdx(textureCoordinate) * uvRect.zw, dFdy(textureCoordinate) * uvRect.zw);
 }
 
 // calculates the color when using a directional light.
@@ -134,26 +613,26 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
     float diff = max(dot(normal, lightDirection), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDirection, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), activeMaterial.shininess);
     // combine results
-    if(bUseTexture == true)
+    if(USE_TEXTURE)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        ambient = light.ambient * vec3(objectTexel);
+        diffuse = light.diffuse * diff * activeMaterial.diffuseColor * vec3(objectTexel);
+        specular = light.specular * spec * activeMaterial.specularColor * vec3(objectTexel);
     }
     else
     {
         ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
+        diffuse = light.diffuse * diff * activeMaterial.diffuseColor * vec3(objectColor);
+        specular = light.specular * spec * activeMaterial.specularColor * vec3(objectColor);
     }
     
-    return (ambient + diffuse + specular);
+    return (FLAT_AMBIENT(ambient) + diffuse + specular);
 }
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow)
 {
     vec3 ambient = vec3(0.0f);
     vec3 diffuse = vec3(0.0f);
@@ -165,27 +644,235 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     // Calculate specular component
-    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), activeMaterial.shininess);
    
     // combine results
-    if(bUseTexture == true)
+    if(USE_TEXTURE)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * specularComponent * material.specularColor;
+        ambient = light.ambient * vec3(objectTexel);
+        diffuse = light.diffuse * diff * activeMaterial.diffuseColor * vec3(objectTexel);
+        specular = light.specular * specularComponent * activeMaterial.specularColor;
     }
     else
     {
         ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * specularComponent * material.specularColor;
+        diffuse = light.diffuse * diff * activeMaterial.diffuseColor * vec3(objectColor);
+        specular = light.specular * specularComponent * activeMaterial.specularColor;
     }
     
-    return (ambient + diffuse + specular);
+    return (FLAT_AMBIENT(ambient) + (diffuse + specular) * shadow);
+}
+
+#ifdef CLUSTERED_LIGHTS
+// sums the local lights in the list of the cluster the fragment is in.
+vec3 CalcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 result = vec3(0.0f);
+
+    float viewDepth = -(view * vec4(fragPos, 1.0f)).z;
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy / clusterTileSize),
+        int(floor(log(max(viewDepth, 1.0e-4f)) * clusterDepthScaleBias.x + clusterDepthScaleBias.y)));
+    cluster = clamp(cluster, ivec3(0), clusterDimensions - 1);
+    uvec2 lightList = clusterGrid[(cluster.z * clusterDimensions.y + cluster.y) * clusterDimensions.x + cluster.x];
+
+    for(uint i = 0u; i < lightList.y; i++)
+    {
+        result += CalcLocalLight(localLights[clusterLightIndices[lightList.x + i]], normal, fragPos, viewDir);
+    }
+    return result;
+}
+#endif
+
+// the distance a surface is moved towards a light before it is compared
+// with the shadow map, which grows with the size of the map texels.
+float ShadowBias(float distance)
+{
+    return 0.01f * distance + 0.05f;
+}
+
+// calculates how much of a point light reaches the fragment past the
+// casters in its cube map - 1 when lit, 0 when in shadow.
+float CalcPointShadow(int index, vec3 fragPos)
+{
+#ifdef SHADOWS
+    vec4 light = pointShadowLights[index];
+    if(light.w <= 0.0f)
+    {
+        return 1.0f;
+    }
+    vec3 fromLight = fragPos - light.xyz;
+    float distance = length(fromLight);
+    float reference = min((distance - ShadowBias(distance)) / light.w, 1.0f);
+    return texture(pointShadowMaps, vec4(fromLight, float(index)), reference);
+#else
+    return 1.0f;
+#endif
+}
+
+// calculates how much of the spot light reaches the fragment past the
+// casters in its map - 1 when lit, 0 when in shadow.
+float CalcSpotShadow(vec3 fragPos)
+{
+#ifdef SHADOWS
+    if(spotShadowLight.w <= 0.0f)
+    {
+        return 1.0f;
+    }
+    vec4 mapPosition = spotShadowMatrix * vec4(fragPos, 1.0f);
+    vec2 mapCoordinate = mapPosition.xy / mapPosition.w;
+    // the map covers every caster, so nothing outside it is shadowed
+    if(mapPosition.w <= 0.0f || any(lessThan(mapCoordinate, vec2(0.0f))) || any(greaterThan(mapCoordinate, vec2(1.0f))))
+    {
+        return 1.0f;
+    }
+    float distance = length(fragPos - spotShadowLight.xyz);
+    float reference = min((distance - ShadowBias(distance)) / spotShadowLight.w, 1.0f);
+    return texture(spotShadowMap, vec3(mapCoordinate, reference));
+#else
+    return 1.0f;
+#endif
+}
+
+#ifdef LIGHTMAP
+// reads the baked light at a position in the object. the two slices of
+// the brick around the position are filtered by the texture and blended
+// along the brick.
+vec3 SampleLightmap(vec3 localPosition)
+{
+    vec3 position = clamp((localPosition - lightmapBoundsMin) / max(lightmapBoundsSize, vec3(1.0e-6f)), 0.0f, 1.0f) * vec3(lightmapBrickSize - 1);
+    int slice = min(int(position.z), max(lightmapBrickSize.z - 2, 0));
+    vec3 lower = SampleLightmapSlice(slice, position.xy);
+    vec3 upper = SampleLightmapSlice(min(slice + 1, lightmapBrickSize.z - 1), position.xy);
+    return mix(lower, upper, clamp(position.z - float(slice), 0.0f, 1.0f));
+}
+
+// reads the baked light at a position in a slice of the brick, in
+// samples from its first one.
+vec3 SampleLightmapSlice(int slice, vec2 position)
+{
+    int columns = lightmapBrickLayout.z;
+    vec2 tile = vec2(lightmapBrickLayout.xy + ivec2(slice % columns, slice / columns) * lightmapBrickSize.xy);
+    return textureLod(lightmapAtlas, (tile + position + 0.5f) / vec2(textureSize(lightmapAtlas, 0)), 0.0f).rgb;
+}
+#endif
+
+#ifdef IRRADIANCE_PROBES
+// reads the irradiance of the probes around a position for a normal,
+// over pi like the flat ambient it replaces. the position is moved off
+// its surface by half a probe, so the probes in front of the surface
+// weigh more than the ones behind it, and the probes are blended by the
+// texture, kept inside the grid of every set.
+vec3 SampleIrradiance(vec3 position, vec3 normal)
+{
+    vec3 probe = (position + normal * (0.5f * irradianceGridSpacing) - irradianceGridMin) / irradianceGridSpacing;
+    probe = clamp(probe, vec3(0.0f), vec3(irradianceGridSize - 1));
+    vec3 coordinate = (probe + 0.5f) / vec3(irradianceGridSize.xy, irradianceGridSize.z * IRRADIANCE_SETS);
+    vec4 sets[IRRADIANCE_SETS];
+    for(int i = 0; i < IRRADIANCE_SETS; i++)
+    {
+        sets[i] = textureLod(irradianceProbes, coordinate + vec3(0.0f, 0.0f, float(i) / float(IRRADIANCE_SETS)), 0.0f);
+    }
+
+    vec3 result = sets[0].rgb * 0.282095f;
+    result += vec3(sets[0].a, sets[1].rg) * (0.488603f * normal.y);
+    result += vec3(sets[1].ba, sets[2].r) * (0.488603f * normal.z);
+    result += sets[2].gba * (0.488603f * normal.x);
+    result += sets[3].rgb * (1.092548f * normal.x * normal.y);
+    result += vec3(sets[3].a, sets[4].rg) * (1.092548f * normal.y * normal.z);
+    result += vec3(sets[4].ba, sets[5].r) * (0.315392f * (3.0f * normal.z * normal.z - 1.0f));
+    result += sets[5].gba * (1.092548f * normal.x * normal.z);
+    result += sets[6].rgb * (0.546274f * (normal.x * normal.x - normal.y * normal.y));
+    return max(result, vec3(0.0f));
+}
+#endif
+
+#ifdef REFLECTION_PROBES
+// reads the reflection of the nearest probe for a reflective fragment,
+// tinted like the specular highlights and rising towards the edges of
+// the surface. the reflected view is followed from the fragment to the
+// box around the scene, and the probe is read towards the point it
+// reaches, so the reflection lines up with the objects away from the
+// probe. a rougher material reads a blurred level, its roughness the
+// fourth root of the width of its Phong lobe.
+vec3 CalcReflection(vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    if(reflectance <= 0.0f)
+    {
+        return vec3(0.0f);
+    }
+
+    int nearest = 0;
+    float nearestDistance = 1.0e30f;
+    for(int i = 0; i < reflectionProbeCount; i++)
+    {
+        vec3 offset = reflectionProbePositions[i] - fragPos;
+        if(dot(offset, offset) < nearestDistance)
+        {
+            nearestDistance = dot(offset, offset);
+            nearest = i;
+        }
+    }
+
+    vec3 direction = reflect(-viewDir, normal);
+    vec3 toBoxMax = (reflectionBoxMax - fragPos) / direction;
+    vec3 toBoxMin = (reflectionBoxMin - fragPos) / direction;
+    vec3 exits = max(toBoxMax, toBoxMin);
+    float exit = min(min(exits.x, exits.y), exits.z);
+    if(exit > 0.0f)
+    {
+        direction = fragPos + direction * exit - reflectionProbePositions[nearest];
+    }
+
+    float roughness = pow(2.0f / (activeMaterial.shininess + 2.0f), 0.25f);
+    vec3 probe = textureLod(reflectionProbes, vec4(direction, float(nearest)), roughness * float(REFLECTION_LEVELS - 1)).rgb;
+    float fresnel = reflectance + (1.0f - reflectance) * pow(1.0f - max(dot(normal, viewDir), 0.0f), 5.0f);
+    vec3 surfaceColor = USE_TEXTURE ? vec3(objectTexel) : vec3(objectColor);
+    return probe * activeMaterial.specularColor * surfaceColor * fresnel;
+}
+#endif
+
+#ifdef OBJECT_LIGHT_LISTS
+// sums the local lights in the list of the object.
+vec3 CalcObjectLights(vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 result = vec3(0.0f);
+
+    for(uint i = 0u; i < objectLightList.y; i++)
+    {
+        result += CalcLocalLight(localLights[objectLightIndices[objectLightList.x + i]], normal, fragPos, viewDir);
+    }
+    return result;
+}
+#endif
+
+// calculates the color when using a local light, which fades out
+// smoothly at the end of its range.
+vec3 CalcLocalLight(LocalLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 toLight = light.positionRadius.xyz - fragPos;
+    float distance = length(toLight);
+    float falloff = clamp(1.0f - (distance * distance) / (light.positionRadius.w * light.positionRadius.w), 0.0f, 1.0f);
+    if(falloff <= 0.0f)
+    {
+        return vec3(0.0f);
+    }
+
+    vec3 lightDir = toLight / distance;
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), activeMaterial.shininess);
+    // combine results
+    vec3 surfaceColor = USE_TEXTURE ? vec3(objectTexel) : vec3(objectColor);
+    vec3 diffuse = light.diffuse.rgb * diff * activeMaterial.diffuseColor * surfaceColor;
+    vec3 specular = light.specular.rgb * spec * activeMaterial.specularColor;
+
+    return (diffuse + specular) * (falloff * falloff);
 }
 
 // calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow)
 {
     vec3 ambient = vec3(0.0f);
     vec3 diffuse = vec3(0.0f);
@@ -196,7 +883,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), activeMaterial.shininess);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
@@ -205,21 +892,21 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    if(bUseTexture == true)
+    if(USE_TEXTURE)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        ambient = light.ambient * vec3(objectTexel);
+        diffuse = light.diffuse * diff * activeMaterial.diffuseColor * vec3(objectTexel);
+        specular = light.specular * spec * activeMaterial.specularColor * vec3(objectTexel);
     }
     else
     {
         ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
+        diffuse = light.diffuse * diff * activeMaterial.diffuseColor * vec3(objectColor);
+        specular = light.specular * spec * activeMaterial.specularColor * vec3(objectColor);
     }
     
     ambient *= attenuation * intensity;
-    diffuse *= attenuation * intensity;
-    specular *= attenuation * intensity;
-    return (ambient + diffuse + specular);
+    diffuse *= attenuation * intensity * shadow;
+    specular *= attenuation * intensity * shadow;
+    return (FLAT_AMBIENT(ambient) + diffuse + specular);
 }
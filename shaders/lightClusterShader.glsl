@@ -0,0 +1,102 @@
+#version 430 core
+// assigns the local lights to the clusters of the view - a cluster is a
+// screen tile over a range of view depths, and one invocation builds the
+// light list of one cluster
+layout (local_size_x = 64) in;
+
+struct LocalLight {
+    vec4 positionRadius;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+layout (std430, binding = 0) readonly buffer LocalLightBuffer {
+    LocalLight localLights[];
+};
+// offset and count of the light list of every cluster
+layout (std430, binding = 1) writeonly buffer ClusterGridBuffer {
+    uvec2 clusterGrid[];
+};
+layout (std430, binding = 2) writeonly buffer ClusterIndexBuffer {
+    uint clusterLightIndices[];
+};
+
+uniform mat4 view;
+uniform mat4 inverseProjection;
+uniform ivec3 clusterDimensions;
+// view depths of the near and far planes
+uniform vec2 clusterDepthRange;
+uniform int localLightCount;
+uniform int maxClusterLights;
+
+// the lights are moved to view space a batch at a time, each invocation
+// of the group moving one of them
+shared vec4 batchLights[64];
+
+// the view space point at depth 1 on the ray through a point of the screen
+vec3 ViewRay(vec2 ndc)
+{
+    vec4 point = inverseProjection * vec4(ndc, -1.0f, 1.0f);
+    point /= point.w;
+    return point.xyz / -point.z;
+}
+
+void main()
+{
+    int clusterCount = clusterDimensions.x * clusterDimensions.y * clusterDimensions.z;
+    int clusterIndex = int(gl_GlobalInvocationID.x);
+    bool bValid = clusterIndex < clusterCount;
+
+    // the view space box around the cluster, from its screen tile corners
+    // at its near and far depth
+    ivec3 cluster = ivec3(clusterIndex % clusterDimensions.x,
+        (clusterIndex / clusterDimensions.x) % clusterDimensions.y,
+        clusterIndex / (clusterDimensions.x * clusterDimensions.y));
+    vec2 ndcMin = (vec2(cluster.xy) / vec2(clusterDimensions.xy)) * 2.0f - 1.0f;
+    vec2 ndcMax = (vec2(cluster.xy + 1) / vec2(clusterDimensions.xy)) * 2.0f - 1.0f;
+    float depthRatio = clusterDepthRange.y / clusterDepthRange.x;
+    float nearDepth = clusterDepthRange.x * pow(depthRatio, float(cluster.z) / float(clusterDimensions.z));
+    float farDepth = clusterDepthRange.x * pow(depthRatio, float(cluster.z + 1) / float(clusterDimensions.z));
+
+    vec3 boundsMin = vec3(1.0e30f);
+    vec3 boundsMax = vec3(-1.0e30f);
+    vec3 rays[4] = vec3[4](ViewRay(ndcMin), ViewRay(vec2(ndcMax.x, ndcMin.y)),
+        ViewRay(vec2(ndcMin.x, ndcMax.y)), ViewRay(ndcMax));
+    for(int i = 0; i < 4; i++)
+    {
+        boundsMin = min(boundsMin, min(rays[i] * nearDepth, rays[i] * farDepth));
+        boundsMax = max(boundsMax, max(rays[i] * nearDepth, rays[i] * farDepth));
+    }
+
+    int offset = clusterIndex * maxClusterLights;
+    int count = 0;
+    for(int batch = 0; batch < localLightCount; batch += 64)
+    {
+        int light = batch + int(gl_LocalInvocationIndex);
+        if(light < localLightCount)
+        {
+            vec4 positionRadius = localLights[light].positionRadius;
+            batchLights[gl_LocalInvocationIndex] = vec4(vec3(view * vec4(positionRadius.xyz, 1.0f)), positionRadius.w);
+        }
+        barrier();
+
+        int batchCount = min(64, localLightCount - batch);
+        for(int i = 0; bValid && (i < batchCount); i++)
+        {
+            // the light reaches the cluster when its sphere touches the box
+            vec4 sphere = batchLights[i];
+            vec3 distance = clamp(sphere.xyz, boundsMin, boundsMax) - sphere.xyz;
+            if((dot(distance, distance) <= sphere.w * sphere.w) && (count < maxClusterLights))
+            {
+                clusterLightIndices[offset + count] = uint(batch + i);
+                count++;
+            }
+        }
+        barrier();
+    }
+
+    if(bValid)
+    {
+        clusterGrid[clusterIndex] = uvec2(offset, count);
+    }
+}
@@ -2,19 +2,132 @@
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
+layout (location = 3) in float inFaceID;
 
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+flat out int fragmentFaceID;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// the depth pre-pass and the color pass that is only drawn where it is
+// equal to it compute the same position
+invariant gl_Position;
+
+#ifdef SHADOW_PASS
+// the view and projection of the shadow map face being drawn
+uniform mat4 shadowViewProjection;
+#endif
+
+#ifdef SCENE_CAPTURE
+// the vertices written back for baking the lighting, in the layout of
+// SceneCapture::CAPTURED_VERTEX
+layout (xfb_buffer = 0, xfb_offset = 0) out vec3 capturePosition;
+layout (xfb_buffer = 0, xfb_offset = 12) out vec3 captureNormal;
+layout (xfb_buffer = 0, xfb_offset = 24) out vec3 captureLocalPosition;
+layout (xfb_buffer = 0, xfb_offset = 36) flat out int captureVertexID;
+#endif
+
+#ifdef AMBIENT_OCCLUSION
+// the occlusion baked for the vertices of the objects - the entry of the
+// first vertex of this object, the ID of that vertex and the number of
+// IDs it spans, none for an object that was not baked
+uniform samplerBuffer occlusionBuffer;
+uniform ivec3 occlusionVertices;
+out float fragmentOcclusion;
+#endif
+
+#ifdef LIGHTMAP
+// the position in the object, which places the fragment in its brick
+out vec3 fragmentLocalPosition;
+#endif
+
+#ifdef LIGHT_VOLUMES
+// the local light of the instance, read straight from the light buffer
+layout (location = 4) in vec4 inLightPositionRadius;
+layout (location = 5) in vec4 inLightDiffuse;
+layout (location = 6) in vec4 inLightSpecular;
+
+flat out vec4 volumeLightPositionRadius;
+flat out vec4 volumeLightDiffuse;
+flat out vec4 volumeLightSpecular;
+#endif
+
 void main()
 {
+#if defined(DEFERRED_LIGHTING) || defined(TRANSPARENCY_COMPOSITE) || defined(RESOLUTION_UPSCALE)
+   // one triangle covering the screen
+   vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+   gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+#elif defined(LIGHT_VOLUMES)
+   volumeLightPositionRadius = inLightPositionRadius;
+   volumeLightDiffuse = inLightDiffuse;
+   volumeLightSpecular = inLightSpecular;
+
+   // the light is drawn as the screen rectangle around its sphere - the
+   // projected corners of the view space box of the sphere
+   vec3 center = vec3(view * vec4(inLightPositionRadius.xyz, 1.0f));
+   float radius = inLightPositionRadius.w;
+   float nearDepth = projection[3][2] / (projection[2][2] - 1.0f);
+   vec2 boundsMin = vec2(-1.0f);
+   vec2 boundsMax = vec2(1.0f);
+   if(center.z - radius > -nearDepth)
+   {
+      // the whole sphere is behind the near plane
+      boundsMax = boundsMin;
+   }
+   else if(center.z + radius < -nearDepth)
+   {
+      // a sphere reaching the near plane may cover any part of the
+      // screen, so only the spheres in front of it are bounded
+      boundsMin = vec2(1.0e30f);
+      boundsMax = vec2(-1.0e30f);
+      for(int i = 0; i < 8; i++)
+      {
+         vec3 offset = vec3(((i & 1) != 0) ? radius : -radius,
+            ((i & 2) != 0) ? radius : -radius, ((i & 4) != 0) ? radius : -radius);
+         vec4 clip = projection * vec4(center + offset, 1.0f);
+         boundsMin = min(boundsMin, clip.xy / clip.w);
+         boundsMax = max(boundsMax, clip.xy / clip.w);
+      }
+      boundsMin = clamp(boundsMin, vec2(-1.0f), vec2(1.0f));
+      boundsMax = clamp(boundsMax, vec2(-1.0f), vec2(1.0f));
+   }
+   vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+   gl_Position = vec4(mix(boundsMin, boundsMax, corner), 0.0f, 1.0f);
+#elif defined(DEPTH_PREPASS)
+   // only the position is read, the same way as the color pass
+   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
+#else
    fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
+#ifdef SHADOW_PASS
+   gl_Position = shadowViewProjection * vec4(fragmentPosition, 1.0f);
+#else
    gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
+#endif
    fragmentVertexNormal = inVertexNormal;
    fragmentTextureCoordinate = inTextureCoordinate;
+   // meshes without a face ID attribute read the default value of 0
+   fragmentFaceID = int(inFaceID);
+#ifdef SCENE_CAPTURE
+   capturePosition = fragmentPosition;
+   captureNormal = normalize(mat3(transpose(inverse(model))) * inVertexNormal);
+   captureLocalPosition = inVertexPosition;
+   captureVertexID = gl_VertexID;
+#endif
+#ifdef LIGHTMAP
+   fragmentLocalPosition = inVertexPosition;
+#endif
+#ifdef AMBIENT_OCCLUSION
+   int occlusionVertex = gl_VertexID - occlusionVertices.y;
+   fragmentOcclusion = 1.0f;
+   if(occlusionVertex >= 0 && occlusionVertex < occlusionVertices.z)
+   {
+      fragmentOcclusion = texelFetch(occlusionBuffer, occlusionVertices.x + occlusionVertex).r;
+   }
+#endif
+#endif
 }
\ No newline at end of file